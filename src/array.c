@@ -508,6 +508,205 @@ array_match_path_or_ext (const array * const a, const buffer * const b)
 }
 
 
+/* array_trie: immutable byte trie compiled (at config time) from array keys
+ * or values, for array_match_*() on large arrays.
+ *
+ * Match semantics are the same as the linear array_match_*() routines:
+ * the first element (lowest index in a->data[]) which is a prefix (suffix)
+ * of the string is returned, not necessarily the longest one.  Each node
+ * records the lowest index of keys ending at that node and the lowest index
+ * of keys ending anywhere below it, so that the walk stops as soon as no
+ * deeper match could precede the best match found so far.
+ * (suffix tries are built from reversed keys and walk the string backwards)
+ */
+
+struct array_trie_node {
+    int32_t idx;     /* lowest index of keys ending at node (or INT32_MAX) */
+    int32_t min;     /* lowest index of keys ending below node (or INT32_MAX)*/
+    uint32_t child;  /* first child; children are contiguous, sorted by c */
+    uint16_t nchild;
+    unsigned char c;
+};
+
+typedef struct {
+    struct array_trie_node *ptr;
+    uint32_t used;
+    uint32_t size;
+} array_trie_nodes;
+
+typedef struct {
+    const char *s;
+    uint32_t len;
+    int32_t idx;
+} array_trie_key;
+
+static int array_trie_key_cmp (const void *v1, const void *v2) {
+    const array_trie_key * const k1 = v1;
+    const array_trie_key * const k2 = v2;
+    const uint32_t len = k1->len < k2->len ? k1->len : k2->len;
+    const int rc = memcmp(k1->s, k2->s, len);
+    if (0 != rc) return rc;
+    if (k1->len != k2->len) return k1->len < k2->len ? -1 : 1;
+    return k1->idx < k2->idx ? -1 : k1->idx > k2->idx;
+}
+
+static int32_t array_trie_build (array_trie_nodes * const v, const array_trie_key * const k, uint32_t lo, const uint32_t hi, const uint32_t depth, const uint32_t node) {
+    /* keys in [lo,hi) are sorted and share the first depth chars;
+     * keys ending at this node sort first */
+    int32_t idx = INT32_MAX;
+    for (; lo < hi && k[lo].len == depth; ++lo) {
+        if (k[lo].idx < idx) idx = k[lo].idx;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = lo; i < hi; ++n) {
+        const char c = k[i].s[depth];
+        do { ++i; } while (i < hi && k[i].s[depth] == c);
+    }
+
+    const uint32_t child = v->used;
+    if (v->size - v->used < n) {
+        do { v->size = v->size ? v->size << 1 : 16; } while (v->size - v->used < n);
+        v->ptr = realloc(v->ptr, v->size * sizeof(*v->ptr));
+        force_assert(v->ptr);
+    }
+    v->used += n;
+
+    int32_t min = INT32_MAX;
+    for (uint32_t i = lo, j = child; i < hi; ++j) {
+        uint32_t e = i;
+        const char c = k[i].s[depth];
+        do { ++e; } while (e < hi && k[e].s[depth] == c);
+        v->ptr[j].c = (unsigned char)c;
+        const int32_t m = array_trie_build(v, k, i, e, depth+1, j);
+        if (m < min) min = m;
+        i = e;
+    }
+
+    struct array_trie_node * const t = v->ptr + node; /*(after realloc)*/
+    t->idx = idx;
+    t->min = min;
+    t->child = child;
+    t->nchild = (uint16_t)n;
+    return idx < min ? idx : min;
+}
+
+__attribute_cold__
+static struct array_trie_node * array_trie_compile (const array * const a, const int flags, const int nc) {
+    const uint32_t used = a->used;
+    array_trie_key * const keys = malloc(used * sizeof(*keys));
+    force_assert(keys);
+    size_t total = 0;
+    for (uint32_t i = 0; i < used; ++i) {
+        const buffer * const b = (flags & ARRAY_TRIE_VALUE)
+          ? &((data_string *)a->data[i])->value
+          : &a->data[i]->key;
+        total += buffer_string_length(b);
+    }
+    char * const str = malloc(total+1);
+    force_assert(str);
+
+    char *s = str;
+    for (uint32_t i = 0; i < used; ++i) {
+        const buffer * const b = (flags & ARRAY_TRIE_VALUE)
+          ? &((data_string *)a->data[i])->value
+          : &a->data[i]->key;
+        const uint32_t len = buffer_string_length(b);
+        for (uint32_t j = 0; j < len; ++j) {
+            unsigned char c = (unsigned char)
+              ((flags & ARRAY_TRIE_SUFFIX) ? b->ptr[len-1-j] : b->ptr[j]);
+            if (nc && (unsigned int)(c - 'A') < 26) c |= 0x20;
+            s[j] = (char)c;
+        }
+        keys[i].s = s;
+        keys[i].len = len;
+        keys[i].idx = (int32_t)i;
+        s += len;
+    }
+
+    qsort(keys, used, sizeof(*keys), array_trie_key_cmp);
+
+    array_trie_nodes v = { NULL, 0, 0 };
+    v.size = 16;
+    v.ptr = malloc(v.size * sizeof(*v.ptr));
+    force_assert(v.ptr);
+    v.used = 1; /* root */
+    v.ptr[0].c = '\0';
+    array_trie_build(&v, keys, 0, used, 0, 0);
+
+    free(str);
+    free(keys);
+    return v.ptr;
+}
+
+array_trie *
+array_trie_init (const array * const a, const int flags)
+{
+    array_trie * const t = calloc(1, sizeof(*t));
+    force_assert(t);
+    t->a = a;
+    t->flags = flags;
+    /*(linear scan is faster for a few elements)*/
+    if (a->used > ARRAY_TRIE_LINEAR_MAX) {
+        t->nodes[0] = array_trie_compile(a, flags, 0);
+        if (flags & ARRAY_TRIE_NOCASE)
+            t->nodes[1] = array_trie_compile(a, flags, 1);
+    }
+    return t;
+}
+
+void
+array_trie_free (array_trie * const t)
+{
+    if (NULL == t) return;
+    free(t->nodes[0]);
+    free(t->nodes[1]);
+    free(t);
+}
+
+static int32_t
+array_trie_match_linear (const array_trie * const t, const char * const s, const uint32_t slen, const int nc)
+{
+    const array * const a = t->a;
+    for (uint32_t i = 0; i < a->used; ++i) {
+        const buffer * const b = (t->flags & ARRAY_TRIE_VALUE)
+          ? &((data_string *)a->data[i])->value
+          : &a->data[i]->key;
+        const uint32_t blen = buffer_string_length(b);
+        if (blen > slen) continue;
+        const char * const x = (t->flags & ARRAY_TRIE_SUFFIX) ? s+slen-blen : s;
+        if (nc ? buffer_eq_icase_ssn(x, b->ptr, blen)
+               : 0 == memcmp(x, b->ptr, blen))
+            return (int32_t)i;
+    }
+    return -1;
+}
+
+int32_t
+array_trie_match (const array_trie * const t, const char * const s, const uint32_t slen, const int nc)
+{
+    const struct array_trie_node * const nodes = t->nodes[(nc != 0)];
+    if (NULL == nodes) return array_trie_match_linear(t, s, slen, nc);
+
+    const int suffix = (t->flags & ARRAY_TRIE_SUFFIX);
+    const struct array_trie_node *n = nodes;
+    int32_t best = n->idx;
+    for (uint32_t i = 0; i < slen && best > n->min; ++i) {
+        unsigned int c = (unsigned char)(suffix ? s[slen-1-i] : s[i]);
+        if (nc && c - 'A' < 26) c |= 0x20;
+        uint32_t lo = n->child, hi = lo + n->nchild;
+        while (lo < hi) { /* binary search children */
+            const uint32_t m = (lo + hi) >> 1;
+            if (nodes[m].c < c) lo = m + 1; else hi = m;
+        }
+        if (lo == n->child + n->nchild || nodes[lo].c != c) break;
+        n = nodes + lo;
+        if (n->idx < best) best = n->idx;
+    }
+    return best != INT32_MAX ? best : -1;
+}
+
+
 
 
 
@@ -161,4 +161,47 @@ const buffer * array_match_value_suffix_nc (const array * const a, const buffer
 __attribute_pure__
 data_unset * array_match_path_or_ext (const array * const a, const buffer * const b);
 
+/* compiled matcher for large arrays; same semantics as array_match_*() above
+ * (first matching element in array order) (built at config time) */
+
+struct array_trie_node; /* declaration */
+
+typedef struct array_trie {
+    const array *a;
+    struct array_trie_node *nodes[2]; /*(case-sensitive, case-insensitive)*/
+    int flags;
+} array_trie;
+
+#define ARRAY_TRIE_KEY    0x0  /* match array keys */
+#define ARRAY_TRIE_VALUE  0x1  /* match array values (data_string) */
+#define ARRAY_TRIE_PREFIX 0x0  /* element is prefix of string */
+#define ARRAY_TRIE_SUFFIX 0x2  /* element is suffix of string */
+#define ARRAY_TRIE_NOCASE 0x4  /* also compile for case-insensitive match */
+
+#define ARRAY_TRIE_LINEAR_MAX 8 /* arrays this small are scanned linearly */
+
+__attribute_cold__
+__attribute_returns_nonnull__
+array_trie * array_trie_init (const array *a, int flags);
+
+__attribute_cold__
+void array_trie_free (array_trie *t);
+
+/* returns index into t->a->data[] of first matching element, or -1
+ * (nc: ASCII case-insensitive match) */
+__attribute_pure__
+int32_t array_trie_match (const array_trie *t, const char *s, uint32_t slen, int nc);
+
+static inline data_unset * array_trie_match_key (const array_trie *t, const char *s, uint32_t slen, int nc);
+static inline data_unset * array_trie_match_key (const array_trie * const t, const char * const s, const uint32_t slen, const int nc) {
+    const int32_t i = array_trie_match(t, s, slen, nc);
+    return i >= 0 ? t->a->data[i] : NULL;
+}
+
+static inline const buffer * array_trie_match_value (const array_trie *t, const char *s, uint32_t slen, int nc);
+static inline const buffer * array_trie_match_value (const array_trie * const t, const char * const s, const uint32_t slen, const int nc) {
+    const int32_t i = array_trie_match(t, s, slen, nc);
+    return i >= 0 ? &((data_string *)t->a->data[i])->value : NULL;
+}
+
 #endif
@@ -20,6 +20,7 @@
 #include "sock_addr.h"
 
 struct fdevents;        /* declaration */
+struct h2con;           /* declaration */
 
 
 struct connection {
@@ -59,13 +60,36 @@ struct connection {
 	time_t close_timeout_ts;
 	time_t write_request_ts;
 
+	/* timer wheel entry; time of next connection_check_timeout() */
+	time_t tw_ts;
+	struct connection *tw_next;
+	struct connection **tw_pprev;
+
 	time_t connection_start;
 	uint32_t request_count;      /* number of requests handled in this connection */
 	int keep_alive_idle;         /* remember max_keep_alive_idle from config */
 
 	uint16_t proto_default_port;
+
+	struct h2con *h2;            /* HTTP/2 connection state (if HTTP/2) */
 };
 
+/* bytes written/read for request (for logging, statistics)
+ * (HTTP/2 streams share connection; count per-stream queues instead) */
+static inline off_t request_bytes_written(const request_st * const r);
+static inline off_t request_bytes_written(const request_st * const r) {
+	return r->http_version != HTTP_VERSION_2
+	  ? r->con->bytes_written
+	  : r->write_queue->bytes_out + (off_t)r->resp_header_len;
+}
+
+static inline off_t request_bytes_read(const request_st * const r);
+static inline off_t request_bytes_read(const request_st * const r) {
+	return r->http_version != HTTP_VERSION_2
+	  ? r->con->bytes_read
+	  : r->reqbody_queue->bytes_in + (off_t)r->rqst_header_len;
+}
+
 typedef struct {
 	connection **ptr;
 	uint32_t size;
@@ -106,7 +130,10 @@ typedef struct {
 	unsigned char config_deprecated;
 	unsigned char config_unsupported;
 	unsigned char systemd_socket_activation;
+	unsigned char reuseport;
 	unsigned char errorlog_use_syslog;
+	unsigned char h2proto;
+	unsigned short h2_max_concurrent_streams;
 	const buffer *syslog_facility;
 	const buffer *bindhost;
 	const buffer *changeroot;
@@ -131,6 +158,9 @@ typedef struct server_socket {
 	fdnode *fdn;
 	server *srv;
 	buffer *srv_token;
+
+	int *reuseport_fds; /* per-worker listen sockets (server.reuseport) */
+	uint32_t reuseport_used;
 } server_socket;
 
 typedef struct {
@@ -21,19 +21,59 @@
 #include <errno.h>
 #include <string.h>
 
+#ifdef HAVE_SPLICE
+#include <sys/ioctl.h>
+#endif
+
 /* default 1MB, upper limit 128MB */
 #define DEFAULT_TEMPFILE_SIZE (1 * 1024 * 1024)
 #define MAX_TEMPFILE_SIZE (128 * 1024 * 1024)
 
+/* chunk pools: one pool of chunk_buf_sz chunks, plus size class pools for
+ * larger chunks, with class sizes chunk_buf_sz * 2^(k+1) up to 1M.  Each pool
+ * retains at most CHUNK_POOL_BYTES of chunks (high-water limit); excess chunks
+ * are freed.  chunkqueue_chunk_pool_clear() periodically trims chunks not used
+ * since the prior trim (low-water mark) */
+#define CHUNK_POOL_BYTES     (8 * 1024 * 1024)
+#define CHUNK_CLASS_SHIFT_MAX 20 /* 1M */
+#define CHUNK_CLASSES 10 /* 2k .. 1M for minimum chunk_buf_sz (1k) */
+
+typedef struct chunk_pool {
+    chunk *list;
+    uint32_t count;
+    uint32_t limit;  /* high-water limit (number of chunks) */
+    uint32_t lwm;    /* low-water mark since last trim */
+} chunk_pool;
+
 static size_t chunk_buf_sz = 8192;
-static chunk *chunks, *chunks_oversized;
+static chunk_pool chunks = { NULL, 0, CHUNK_POOL_BYTES / 8192, 0 };
+#define CHUNK_CLASS_INIT(shift) { NULL, 0, CHUNK_POOL_BYTES >> (shift), 0 }
+static uint32_t chunk_classes = 7; /* 16k .. 1M for default chunk_buf_sz */
+static chunk_pool chunks_oversized[CHUNK_CLASSES] = {
+  CHUNK_CLASS_INIT(14), CHUNK_CLASS_INIT(15), CHUNK_CLASS_INIT(16),
+  CHUNK_CLASS_INIT(17), CHUNK_CLASS_INIT(18), CHUNK_CLASS_INIT(19),
+  CHUNK_CLASS_INIT(20)
+};
+#undef CHUNK_CLASS_INIT
 static chunk *chunk_buffers;
+static chunk_pool_stats chunk_stats;
 static const array *chunkqueue_default_tempdirs = NULL;
 static off_t chunkqueue_default_tempfile_size = DEFAULT_TEMPFILE_SIZE;
 
 void chunkqueue_set_chunk_size (size_t sz)
 {
     chunk_buf_sz = sz > 0 ? ((sz + 1023) & ~1023uL) : 8192;
+    chunks.limit = CHUNK_POOL_BYTES / chunk_buf_sz;
+    if (chunks.limit < 16) chunks.limit = 16;
+
+    /* size classes derived from chunk_buf_sz so that every class can be
+     * used to satisfy chunk_acquire() (classes must be empty; called during
+     * config processing, before chunks are pooled) */
+    chunk_classes = 0;
+    for (size_t csz = chunk_buf_sz << 1;
+         csz <= (1uL << CHUNK_CLASS_SHIFT_MAX) && chunk_classes < CHUNK_CLASSES;
+         csz <<= 1)
+        chunks_oversized[chunk_classes++].limit = CHUNK_POOL_BYTES / csz;
 }
 
 void chunkqueue_set_tempdirs_default_reset (void)
@@ -82,9 +122,12 @@ static chunk *chunk_init(size_t sz) {
 	c->mem = buffer_init();
 	c->file.start = c->file.length = c->file.mmap.offset = 0;
 	c->file.fd = -1;
+	c->file.wfd = -1;
 	c->file.mmap.start = MAP_FAILED;
 	c->file.mmap.length = 0;
 	c->file.is_temp = 0;
+	c->file.ref = NULL;
+	c->file.refchg = 0;
 	c->offset = 0;
 	c->next = NULL;
 
@@ -93,11 +136,62 @@ static chunk *chunk_init(size_t sz) {
 	return c;
 }
 
+static int *chunk_cur_fds; /* srv->cur_fds */
+
+void chunkqueue_set_cur_fds (int *cur_fds)
+{
+    chunk_cur_fds = cur_fds;
+}
+
+#ifdef HAVE_SPLICE
+static int chunk_pipe_spare[2] = { -1, -1 };
+
+static int chunk_pipe_open(int fds[2]) {
+	if (0 != pipe2(fds, O_NONBLOCK | O_CLOEXEC)) return -1;
+	if (chunk_cur_fds) *chunk_cur_fds += 2;
+	return 0;
+}
+
+static void chunk_pipe_close(const int rfd, const int wfd) {
+	close(rfd);
+	close(wfd);
+	if (chunk_cur_fds) *chunk_cur_fds -= 2;
+}
+
+static void chunk_reset_pipe_chunk(chunk *c) {
+	/* keep one empty pipe for reuse by chunkqueue_append_splice() */
+	int n;
+	if (-1 == chunk_pipe_spare[0]
+	    && 0 == ioctl(c->file.fd, FIONREAD, &n) && 0 == n) {
+		chunk_pipe_spare[0] = c->file.fd;
+		chunk_pipe_spare[1] = c->file.wfd;
+	}
+	else
+		chunk_pipe_close(c->file.fd, c->file.wfd);
+	c->file.fd = -1;
+	c->file.wfd = -1;
+	c->file.length = 0;
+	c->type = MEM_CHUNK;
+}
+#endif
+
 static void chunk_reset_file_chunk(chunk *c) {
+  #ifdef HAVE_SPLICE
+	if (c->type == PIPE_CHUNK) {
+		chunk_reset_pipe_chunk(c);
+		return;
+	}
+  #endif
 	if (c->file.is_temp && !chunk_buffer_string_is_empty(c->mem)) {
 		unlink(c->mem->ptr);
 	}
-	if (c->file.fd != -1) {
+	if (c->file.refchg) {
+		c->file.refchg(c->file.ref, -1);
+		c->file.refchg = 0; /* NULL fn ptr */
+		c->file.ref = NULL;
+		c->file.fd = -1;
+	}
+	else if (c->file.fd != -1) {
 		close(c->file.fd);
 		c->file.fd = -1;
 	}
@@ -112,26 +206,79 @@ static void chunk_reset_file_chunk(chunk *c) {
 }
 
 static void chunk_reset(chunk *c) {
-	if (c->type == FILE_CHUNK) chunk_reset_file_chunk(c);
+	if (c->type != MEM_CHUNK) chunk_reset_file_chunk(c);
 
 	buffer_clear(c->mem);
 	c->offset = 0;
 }
 
 static void chunk_free(chunk *c) {
-	if (c->type == FILE_CHUNK) chunk_reset_file_chunk(c);
+	if (c->type != MEM_CHUNK) chunk_reset_file_chunk(c);
 	buffer_free(c->mem);
 	free(c);
 }
 
+static chunk * chunk_pool_pop(chunk_pool * const cp) {
+    chunk * const c = cp->list;
+    if (c) {
+        cp->list = c->next;
+        if (--cp->count < cp->lwm) cp->lwm = cp->count;
+        ++chunk_stats.hits;
+        chunk_stats.bytes -= c->mem->size;
+        --chunk_stats.entries;
+    }
+    else
+        ++chunk_stats.misses;
+    return c;
+}
+
+static int chunk_pool_push(chunk_pool * const cp, chunk * const c) {
+    if (cp->count >= cp->limit) return 0;
+    c->next = cp->list;
+    cp->list = c;
+    ++cp->count;
+    chunk_stats.bytes += c->mem->size;
+    ++chunk_stats.entries;
+    return 1;
+}
+
+static void chunk_pool_trim(chunk_pool * const cp, uint32_t n) {
+    /* free n chunks from tail of pool (least recently used) */
+    chunk **cpp = &cp->list;
+    for (uint32_t i = cp->count - n; i; --i) cpp = &(*cpp)->next;
+    for (chunk *next, *c = *cpp; c; c = next) {
+        next = c->next;
+        chunk_stats.bytes -= c->mem->size;
+        --chunk_stats.entries;
+        chunk_free(c);
+    }
+    *cpp = NULL;
+    cp->count -= n;
+}
+
+__attribute_pure__
+static uint32_t chunk_class_acquire(size_t sz) {
+    /* smallest class with class size >= sz
+     * (chunk_buf_sz < sz <= chunk_buf_sz << chunk_classes) */
+    uint32_t k = 0;
+    while ((chunk_buf_sz << (k+1)) < sz) ++k;
+    return k;
+}
+
+__attribute_pure__
+static uint32_t chunk_class_release(size_t sz) {
+    /* largest class with class size <= sz
+     * (chunk_buf_sz << 1 <= sz < chunk_buf_sz << (chunk_classes+1)) */
+    uint32_t k = 0;
+    while ((chunk_buf_sz << (k+2)) <= sz) ++k;
+    return k;
+}
+
 buffer * chunk_buffer_acquire(void) {
     chunk *c;
     buffer *b;
-    if (chunks) {
-        c = chunks;
-        chunks = c->next;
-    }
-    else {
+    c = chunk_pool_pop(&chunks);
+    if (NULL == c) {
         c = chunk_init(chunk_buf_sz);
     }
     c->next = chunk_buffers;
@@ -143,13 +290,13 @@ buffer * chunk_buffer_acquire(void) {
 
 void chunk_buffer_release(buffer *b) {
     if (NULL == b) return;
-    if (b->size >= chunk_buf_sz && chunk_buffers) {
+    if (b->size >= chunk_buf_sz && chunk_buffers
+        && chunks.count < chunks.limit) {
         chunk *c = chunk_buffers;
         chunk_buffers = c->next;
         c->mem = b;
-        c->next = chunks;
-        chunks = c;
         buffer_clear(b);
+        chunk_pool_push(&chunks, c);
     }
     else {
         buffer_free(b);
@@ -158,74 +305,84 @@ void chunk_buffer_release(buffer *b) {
 
 __attribute_returns_nonnull__
 static chunk * chunk_acquire(size_t sz) {
+    chunk *c;
     if (sz <= chunk_buf_sz) {
-        if (chunks) {
-            chunk *c = chunks;
-            chunks = c->next;
-            return c;
-        }
+        c = chunk_pool_pop(&chunks);
         sz = chunk_buf_sz;
     }
+    else if (sz <= (chunk_buf_sz << chunk_classes)) {
+        const uint32_t k = chunk_class_acquire(sz);
+        c = chunk_pool_pop(chunks_oversized+k);
+        sz = chunk_buf_sz << (k+1);
+    }
     else {
+        c = NULL;
+        ++chunk_stats.misses;
         sz = (sz + 8191) & ~8191uL;
-        /* future: might have buckets of certain sizes, up to socket buf sizes*/
-        if (chunks_oversized && chunks_oversized->mem->size >= sz) {
-            chunk *c = chunks_oversized;
-            chunks_oversized = c->next;
-            return c;
-        }
     }
 
-    return chunk_init(sz);
+    return c ? c : chunk_init(sz);
 }
 
 static void chunk_release(chunk *c) {
     const size_t sz = c->mem->size;
     if (sz == chunk_buf_sz) {
         chunk_reset(c);
-        c->next = chunks;
-        chunks = c;
+        if (chunk_pool_push(&chunks, c)) return;
     }
-    else if (sz > chunk_buf_sz) {
+    else if (sz >= (chunk_buf_sz << 1)
+             && sz < (chunk_buf_sz << (chunk_classes+1))) {
         chunk_reset(c);
-        chunk **co = &chunks_oversized;
-        while (*co && sz < (*co)->mem->size) co = &(*co)->next;
-        c->next = *co;
-        *co = c;
-    }
-    else {
-        chunk_free(c);
+        if (chunk_pool_push(chunks_oversized+chunk_class_release(sz), c))
+            return;
     }
+    chunk_free(c);
 }
 
 void chunkqueue_chunk_pool_clear(void)
 {
-    for (chunk *next, *c = chunks; c; c = next) {
-        next = c->next;
-        chunk_free(c);
-    }
-    chunks = NULL;
-    for (chunk *next, *c = chunks_oversized; c; c = next) {
-        next = c->next;
-        chunk_free(c);
+    /* free pooled chunks which were not used since prior trim */
+    if (chunks.lwm) chunk_pool_trim(&chunks, chunks.lwm);
+    chunks.lwm = chunks.count;
+    for (uint32_t k = 0; k < CHUNK_CLASSES; ++k) {
+        chunk_pool * const cp = chunks_oversized+k;
+        if (cp->lwm) chunk_pool_trim(cp, cp->lwm);
+        cp->lwm = cp->count;
     }
-    chunks_oversized = NULL;
+}
+
+const chunk_pool_stats * chunkqueue_chunk_pool_stats (void)
+{
+    return &chunk_stats;
 }
 
 void chunkqueue_chunk_pool_free(void)
 {
-    chunkqueue_chunk_pool_clear();
+    if (chunks.count) chunk_pool_trim(&chunks, chunks.count);
+    chunks.lwm = 0;
+    for (uint32_t k = 0; k < CHUNK_CLASSES; ++k) {
+        chunk_pool * const cp = chunks_oversized+k;
+        if (cp->count) chunk_pool_trim(cp, cp->count);
+        cp->lwm = 0;
+    }
     for (chunk *next, *c = chunk_buffers; c; c = next) {
         next = c->next;
         c->mem = buffer_init(); /*(chunk_reset() expects c->mem != NULL)*/
         chunk_free(c);
     }
     chunk_buffers = NULL;
+  #ifdef HAVE_SPLICE
+    if (-1 != chunk_pipe_spare[0]) {
+        chunk_pipe_close(chunk_pipe_spare[0], chunk_pipe_spare[1]);
+        chunk_pipe_spare[0] = chunk_pipe_spare[1] = -1;
+    }
+  #endif
+    chunk_cur_fds = NULL; /*(srv is about to be freed)*/
 }
 
 __attribute_pure__
 static off_t chunk_remaining_length(const chunk *c) {
-    /* MEM_CHUNK or FILE_CHUNK */
+    /* MEM_CHUNK or FILE_CHUNK or PIPE_CHUNK */
     return (c->type == MEM_CHUNK
               ? (off_t)chunk_buffer_string_length(c->mem)
               : c->file.length)
@@ -283,6 +440,57 @@ static chunk * chunkqueue_append_file_chunk(chunkqueue * const restrict cq, cons
     return c;
 }
 
+#ifdef HAVE_SPLICE
+ssize_t chunkqueue_append_splice(chunkqueue * const cq, const int fd, const size_t len) {
+    /* move data from fd (socket or pipe) into pipe without copy to userspace;
+     * data is appended to pipe in cq->last if cq->last is PIPE_CHUNK
+     * returns bytes moved, 0 on EOF, -1 on error (errno set)
+     * (EAGAIN if no data available from fd, or if pipe is full) */
+    chunk *c = cq->last;
+    if (NULL == c || PIPE_CHUNK != c->type) {
+        int fds[2];
+        if (-1 != chunk_pipe_spare[0]) {
+            fds[0] = chunk_pipe_spare[0];
+            fds[1] = chunk_pipe_spare[1];
+            chunk_pipe_spare[0] = chunk_pipe_spare[1] = -1;
+        }
+        else if (0 != chunk_pipe_open(fds))
+            return -1;
+
+        const ssize_t n =
+          splice(fd, NULL, fds[1], NULL, len, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+        if (n <= 0) {
+            const int errnum = errno;
+            if (-1 == chunk_pipe_spare[0]) {
+                chunk_pipe_spare[0] = fds[0];
+                chunk_pipe_spare[1] = fds[1];
+            }
+            else
+                chunk_pipe_close(fds[0], fds[1]);
+            errno = errnum;
+            return n;
+        }
+
+        c = chunk_acquire(0);
+        chunkqueue_append_chunk(cq, c);
+        c->type = PIPE_CHUNK;
+        c->file.fd = fds[0];
+        c->file.wfd = fds[1];
+        c->file.length = (off_t)n;
+        cq->bytes_in += (off_t)n;
+        return n;
+    }
+
+    const ssize_t n =
+      splice(fd, NULL, c->file.wfd, NULL, len, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+    if (n > 0) {
+        c->file.length += (off_t)n;
+        cq->bytes_in += (off_t)n;
+    }
+    return n;
+}
+#endif
+
 void chunkqueue_reset(chunkqueue *cq) {
     chunkqueue_release_chunks(cq);
     cq->bytes_in = 0;
@@ -299,6 +507,16 @@ void chunkqueue_append_file_fd(chunkqueue * const restrict cq, const buffer * co
     }
 }
 
+void chunkqueue_append_file_fd_ref(chunkqueue * const restrict cq, const buffer * const restrict fn, int fd, off_t offset, off_t len, void(*refchg)(void *, int), void *ref) {
+    if (len > 0) {
+        chunk * const c = chunkqueue_append_file_chunk(cq, fn, offset, len);
+        c->file.fd = fd;
+        c->file.ref = ref;
+        c->file.refchg = refchg;
+        refchg(ref, 1);
+    }
+}
+
 void chunkqueue_append_file(chunkqueue * const restrict cq, const buffer * const restrict fn, off_t offset, off_t len) {
     if (len > 0) {
         chunkqueue_append_file_chunk(cq, fn, offset, len);
@@ -499,7 +717,16 @@ void chunkqueue_steal(chunkqueue * const restrict dest, chunkqueue * const restr
 				break;
 			case FILE_CHUNK:
 				/* tempfile flag is in "last" chunk after the split */
-				chunkqueue_append_file(dest, c->mem, c->file.start + c->offset, use);
+				if (c->file.refchg)
+					chunkqueue_append_file_fd_ref(dest, c->mem, c->file.fd,
+					                              c->file.start + c->offset, use,
+					                              c->file.refchg, c->file.ref);
+				else
+					chunkqueue_append_file(dest, c->mem, c->file.start + c->offset, use);
+				break;
+			case PIPE_CHUNK: /*(pipe data can not be split and shared)*/
+			default:
+				force_assert(c->type != PIPE_CHUNK);
 				break;
 			}
 
@@ -695,6 +922,11 @@ int chunkqueue_steal_with_tempfiles(chunkqueue * const restrict dest, chunkqueue
 				force_assert(0 == len);
 			}
 			break;
+
+		case PIPE_CHUNK: /*(not used in request body)*/
+		default:
+			force_assert(c->type != PIPE_CHUNK);
+			break;
 		}
 
 		src->bytes_out += use;
@@ -762,6 +994,7 @@ void chunkqueue_compact_mem(chunkqueue *cq, size_t clen) {
     chunk *c = cq->first;
     buffer *b = c->mem;
     size_t len = buffer_string_length(b) - c->offset;
+    if (len >= clen) return;
     if (b->size > clen) {
         if (0 != c->offset) {
             memmove(b->ptr, b->ptr+c->offset, len);
@@ -773,14 +1006,20 @@ void chunkqueue_compact_mem(chunkqueue *cq, size_t clen) {
         b = chunkqueue_prepend_buffer_open_sz(cq, clen + 8192);
         buffer_append_string_len(b, c->mem->ptr + c->offset, len);
         cq->first->next = c->next;
+        if (NULL == c->next) cq->last = cq->first;
         chunk_release(c);
         c = cq->first;
     }
     for (chunk *fc = c; ((clen -= len) && (c = fc->next)); ) {
         len = buffer_string_length(c->mem) - c->offset;
-        if (len > clen) len = clen;
+        if (len > clen) {
+            buffer_append_string_len(b, c->mem->ptr + c->offset, clen);
+            c->offset += clen;
+            break;
+        }
         buffer_append_string_len(b, c->mem->ptr + c->offset, len);
         fc->next = c->next;
+        if (NULL == c->next) cq->last = fc;
         chunk_release(c);
     }
     /* chunkqueue_prepend_buffer_commit() is not called here;
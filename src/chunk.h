@@ -13,13 +13,14 @@ struct log_error_st;    /*(declaration)*/
 
 typedef struct chunk {
 	struct chunk *next;
-	enum { MEM_CHUNK, FILE_CHUNK } type;
+	enum { MEM_CHUNK, FILE_CHUNK, PIPE_CHUNK } type;
 
 	buffer *mem; /* either the storage of the mem-chunk or the name of the file */
 
 	/* the size of the chunk is either:
 	 * - mem-chunk: buffer_string_length(chunk::mem)
 	 * - file-chunk: chunk::file.length
+	 * - pipe-chunk: chunk::file.length (data held in pipe chunk::file.fd)
 	 */
 	off_t  offset; /* octets sent from this chunk */
 
@@ -30,6 +31,9 @@ typedef struct chunk {
 
 		int    fd;
 		int is_temp; /* file is temporary and will be deleted if on cleanup */
+		int   wfd;   /* pipechunk: write end of pipe (read end is fd) */
+		void *ref;   /* fd owned by ref (e.g. stat_cache_entry) if refchg */
+		void(*refchg)(void *, int);
 		struct {
 			char   *start; /* the start pointer of the mmap'ed area */
 			size_t length; /* size of the mmap'ed area */
@@ -57,19 +61,33 @@ void chunk_buffer_release(buffer *b);
 void chunkqueue_chunk_pool_clear(void);
 void chunkqueue_chunk_pool_free(void);
 
+typedef struct chunk_pool_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytes;
+    uint32_t entries;
+} chunk_pool_stats;
+
+const chunk_pool_stats * chunkqueue_chunk_pool_stats (void);
+
 __attribute_returns_nonnull__
 chunkqueue *chunkqueue_init(void);
 
 void chunkqueue_set_chunk_size (size_t sz);
+void chunkqueue_set_cur_fds (int *cur_fds); /* pipe fds counted in cur_fds */
 void chunkqueue_set_tempdirs_default_reset (void);
 void chunkqueue_set_tempdirs_default (const array *tempdirs, off_t upload_temp_file_size);
 void chunkqueue_set_tempdirs(chunkqueue * restrict cq, const array * restrict tempdirs, off_t upload_temp_file_size);
 void chunkqueue_append_file(chunkqueue * restrict cq, const buffer * restrict fn, off_t offset, off_t len); /* copies "fn" */
 void chunkqueue_append_file_fd(chunkqueue * restrict cq, const buffer * restrict fn, int fd, off_t offset, off_t len); /* copies "fn" */
+void chunkqueue_append_file_fd_ref(chunkqueue * restrict cq, const buffer * restrict fn, int fd, off_t offset, off_t len, void(*refchg)(void *, int), void *ref); /* copies "fn"; fd shared via refchg() */
 void chunkqueue_append_mem(chunkqueue * restrict cq, const char * restrict mem, size_t len); /* copies memory */
 void chunkqueue_append_mem_min(chunkqueue * restrict cq, const char * restrict mem, size_t len); /* copies memory */
 void chunkqueue_append_buffer(chunkqueue * restrict cq, buffer * restrict mem); /* may reset "mem" */
 void chunkqueue_append_chunkqueue(chunkqueue * restrict cq, chunkqueue * restrict src);
+#ifdef HAVE_SPLICE
+ssize_t chunkqueue_append_splice(chunkqueue *cq, int fd, size_t len); /* splice() from fd into pipe chunk */
+#endif
 
 __attribute_returns_nonnull__
 buffer * chunkqueue_prepend_buffer_open_sz(chunkqueue *cq, size_t sz);
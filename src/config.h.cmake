@@ -15,6 +15,7 @@
 /* System */
 #cmakedefine  HAVE_SYS_DEVPOLL_H
 #cmakedefine  HAVE_SYS_EPOLL_H
+#cmakedefine  HAVE_LINUX_IO_URING_H
 #cmakedefine  HAVE_SYS_EVENT_H
 #cmakedefine  HAVE_SYS_LOADAVG_H
 #cmakedefine  HAVE_SYS_MMAN_H
@@ -51,6 +52,14 @@
 #cmakedefine  HAVE_BZLIB_H
 #cmakedefine  HAVE_LIBBZ2
 
+/* Brotli */
+#cmakedefine  HAVE_BROTLI_ENCODE_H
+#cmakedefine  HAVE_BROTLI
+
+/* Zstandard */
+#cmakedefine  HAVE_ZSTD_H
+#cmakedefine  HAVE_ZSTD
+
 /* FAM */
 #cmakedefine  HAVE_FAM_H
 #cmakedefine  HAVE_FAMNOEXISTS
@@ -73,6 +82,8 @@
 /* PCRE */
 #cmakedefine  HAVE_PCRE_H
 #cmakedefine  HAVE_LIBPCRE
+#cmakedefine  HAVE_PCRE2_H
+#cmakedefine  HAVE_LIBPCRE2
 
 #cmakedefine  HAVE_POLL_H
 #cmakedefine  HAVE_PWD_H
@@ -142,6 +153,7 @@
 #cmakedefine  HAVE_SIGACTION
 #cmakedefine  HAVE_SIGNAL
 #cmakedefine  HAVE_SIGTIMEDWAIT
+#cmakedefine  HAVE_SPLICE
 #cmakedefine  HAVE_STRPTIME
 #cmakedefine  HAVE_SYSLOG
 #cmakedefine  HAVE_WRITEV
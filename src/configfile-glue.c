@@ -9,6 +9,8 @@
 
 #include "configfile.h"
 #include "plugin.h"
+#include "splaytree.h"  /* djbhash() */
+#include "status_counter.h"
 
 #include <string.h>
 #include <stdlib.h>     /* strtol */
@@ -246,11 +248,14 @@ int config_plugin_values_init_block(server * const srv, const array * const ca,
 int config_plugin_values_init(server * const srv, void *p_d, const config_plugin_keys_t * const cpk, const char * const mname) {
     plugin_data_base * const p = (plugin_data_base *)p_d;
     array * const touched = srv->srvconf.config_touched;
-    unsigned char matches[4096];   /*directives matches (4k is way too many!)*/
-    unsigned short contexts[4096]; /*conditions matches (4k is way too many!)*/
+    /*(large vhost configs may have many thousands of conditions)*/
+    unsigned char * const matches =   /*directives matches*/
+      malloc(srv->config_context->used * sizeof(*matches));
+    uint32_t * const contexts =       /*conditions matches*/
+      malloc(srv->config_context->used * sizeof(*contexts));
+    force_assert(matches && contexts);
     uint32_t n = 0;
     int rc = 1; /* default is success */
-    force_assert(sizeof(matches) >= srv->config_context->used);
 
     /* save config reference data for later internal use
      * (config_plugin_values_init() is called with same srv->config_context) */
@@ -280,7 +285,7 @@ int config_plugin_values_init(server * const srv, void *p_d, const config_plugin
                   "variable: %s", cpk[i].k);
             }
         }
-        if (matches[n]) contexts[n++] = (unsigned short)u;
+        if (matches[n]) contexts[n++] = u;
     }
 
     uint32_t elts = 0;
@@ -312,6 +317,8 @@ int config_plugin_values_init(server * const srv, void *p_d, const config_plugin
             rc = 0;
     }
 
+    free(contexts);
+    free(matches);
     return rc;
 }
 
@@ -410,6 +417,211 @@ static int config_addrbuf_eq_remote_ip_mask(request_st * const r, const buffer *
 
 static int data_config_pcre_exec(const data_config *dc, cond_cache_t *cache, const buffer *b, cond_match_t *cond_match);
 
+static int config_cond_index_eligible (const data_config * const dc) {
+    if (CONFIG_COND_EQ != dc->cond || NULL != dc->prev) return 0;
+    switch (dc->comp) {
+      case COMP_HTTP_HOST:
+        /* "host:port" conditions append server port to request authority */
+        return (NULL == strchr(dc->string.ptr, ':'));
+      case COMP_HTTP_REMOTE_IP:
+        /* "addr/bits" conditions are compared as netmask */
+        return (NULL == strchr(dc->string.ptr, '/'));
+      case COMP_SERVER_SOCKET:
+      case COMP_HTTP_URL:
+      case COMP_HTTP_QUERY_STRING:
+      case COMP_HTTP_SCHEME:
+      case COMP_HTTP_REQUEST_METHOD:
+      case COMP_HTTP_REQUEST_HEADER:
+        return 1;
+      default:
+        return 0;
+    }
+}
+
+static int config_cond_index_cmp (const void *v1, const void *v2) {
+    /* group by parent, comp, comp_tag; then context order */
+    const data_config * const dc1 = *(const data_config **)v1;
+    const data_config * const dc2 = *(const data_config **)v2;
+    const int p1 = dc1->parent ? dc1->parent->context_ndx : -1;
+    const int p2 = dc2->parent ? dc2->parent->context_ndx : -1;
+    if (p1 != p2) return p1 < p2 ? -1 : 1;
+    if (dc1->comp != dc2->comp) return dc1->comp < dc2->comp ? -1 : 1;
+    const int rc = strcmp(dc1->comp_tag->ptr ? dc1->comp_tag->ptr : "",
+                          dc2->comp_tag->ptr ? dc2->comp_tag->ptr : "");
+    if (0 != rc) return rc;
+    return dc1->context_ndx < dc2->context_ndx ? -1 : 1;
+}
+
+static int config_cond_index_group (const data_config * const dc1, const data_config * const dc2) {
+    return dc1->parent == dc2->parent
+        && dc1->comp == dc2->comp
+        && buffer_is_equal(dc1->comp_tag, dc2->comp_tag);
+}
+
+__attribute_cold__
+static config_cond_index * config_cond_index_init (data_config ** const dcs, const uint32_t used) {
+    uint32_t sz = 16;
+    while (sz < (used << 1)) sz <<= 1;
+    config_cond_index * const ci = calloc(1, sizeof(*ci));
+    force_assert(ci);
+    ci->dc   = malloc(used * sizeof(*ci->dc));
+    ci->slot = calloc(sz, sizeof(*ci->slot));
+    ci->next = calloc(used, sizeof(*ci->next));
+    force_assert(ci->dc && ci->slot && ci->next);
+    ci->used = used;
+    ci->mask = sz - 1;
+
+    for (uint32_t u = 0; u < used; ++u) {
+        data_config * const dc = dcs[u];
+        ci->dc[u] = dc;
+        dc->cond_index = ci;
+        const buffer * const b = &dc->string;
+        uint32_t h = djbhash(CONST_BUF_LEN(b), DJBHASH_INIT) & ci->mask;
+        for (; ci->slot[h]; h = (h + 1) & ci->mask) {
+            uint32_t m = ci->slot[h];
+            if (!buffer_is_equal(&ci->dc[m-1]->string, b)) continue;
+            /* duplicate string; append to chain (preserve context order) */
+            while (ci->next[m-1]) m = ci->next[m-1];
+            ci->next[m-1] = u+1;
+            break;
+        }
+        if (0 == ci->slot[h]) ci->slot[h] = u+1;
+    }
+
+    return ci;
+}
+
+void config_cond_index_build (const array * const config_context) {
+    /* index large groups of sibling "==" conditions on the same comp_key
+     * (e.g. many $HTTP["host"] == "..." blocks) so that evaluating any one
+     * condition in the group resolves all conditions in the group */
+    const uint32_t used = config_context->used;
+    data_config ** const dcs = malloc(used * sizeof(*dcs));
+    force_assert(dcs);
+    uint32_t n = 0;
+    for (uint32_t i = 1; i < used; ++i) {
+        data_config * const dc = (data_config *)config_context->data[i];
+        if (config_cond_index_eligible(dc)) dcs[n++] = dc;
+    }
+
+    qsort(dcs, n, sizeof(*dcs), config_cond_index_cmp);
+
+    for (uint32_t i = 0, j; i < n; i = j) {
+        for (j = i+1; j < n && config_cond_index_group(dcs[i], dcs[j]); ++j) ;
+        if (j - i >= CONFIG_COND_INDEX_MIN)
+            config_cond_index_init(dcs+i, j-i);
+    }
+
+    free(dcs);
+}
+
+void config_cond_index_free (const array * const config_context) {
+    for (uint32_t i = 1; i < config_context->used; ++i) {
+        data_config * const dc = (data_config *)config_context->data[i];
+        config_cond_index * const ci = (config_cond_index *)dc->cond_index;
+        if (NULL == ci || ci->dc[0] != dc) continue; /*(free once per group)*/
+        for (uint32_t u = 1; u < ci->used; ++u)
+            ((data_config *)ci->dc[u])->cond_index = NULL;
+        dc->cond_index = NULL;
+        free(ci->dc);
+        free(ci->slot);
+        free(ci->next);
+        free(ci);
+    }
+}
+
+__attribute_noinline__
+static cond_result_t config_check_cond_index(request_st * const r, const data_config * const dc, const int debug_cond) {
+	/* dc is member of indexed group of sibling "==" conditions
+	 * (see config_cond_index_build()); all members share parent, comp, and
+	 * comp_tag, have no else-branch precondition, and are reset together.
+	 * Group head local_result is set once the group has been resolved for
+	 * this request, and matching members have local_result TRUE, so any
+	 * member reaching here after group is resolved did not match */
+	const config_cond_index * const ci = dc->cond_index;
+	cond_cache_t * const cond_cache = r->cond_cache;
+	if (COND_RESULT_UNSET != cond_cache[ci->dc[0]->context_ndx].local_result) {
+		if (debug_cond)
+			log_error(r->conf.errh, __FILE__, __LINE__,
+			  "%s (indexed) no match %s", dc->comp_key->ptr, dc->string.ptr);
+		return COND_RESULT_FALSE;
+	}
+
+	static const struct const_char_buffer {
+	  const char *ptr;
+	  uint32_t used;
+	  uint32_t size;
+	} empty_string = { "", 1, 0 };
+
+	const buffer *l;
+	switch (dc->comp) {
+	case COMP_HTTP_HOST:
+		l = &r->uri.authority;
+		if (buffer_string_is_empty(l))
+			l = (const buffer *)&empty_string;
+		else if (0 != sock_addr_get_port(&r->con->srv_socket->addr)) {
+			/* conditions in group do not contain ':' (no port) */
+			const char * const colon = strchr(l->ptr, ':');
+			if (NULL != colon) {
+				buffer * const tb = r->tmp_buf;
+				buffer_copy_string_len(tb, l->ptr, colon - l->ptr);
+				l = tb;
+			}
+		}
+		break;
+	case COMP_HTTP_REMOTE_IP:
+		l = r->con->dst_addr_buf;
+		break;
+	case COMP_HTTP_SCHEME:
+		l = &r->uri.scheme;
+		break;
+	case COMP_HTTP_URL:
+		l = &r->uri.path;
+		break;
+	case COMP_HTTP_QUERY_STRING:
+		l = &r->uri.query;
+		if (NULL == l->ptr) l = (const buffer *)&empty_string;
+		break;
+	case COMP_SERVER_SOCKET:
+		l = r->con->srv_socket->srv_token;
+		break;
+	case COMP_HTTP_REQUEST_HEADER:
+		l = http_header_request_get(r, HTTP_HEADER_UNSPECIFIED, CONST_BUF_LEN(dc->comp_tag));
+		if (NULL == l) l = (const buffer *)&empty_string;
+		break;
+	case COMP_HTTP_REQUEST_METHOD: {
+		buffer * const tb = r->tmp_buf;
+		buffer_clear(tb);
+		http_method_append(tb, r->http_method);
+		l = tb;
+		break;
+	}
+	default:
+		l = NULL;
+		break;
+	}
+
+	cond_result_t result = COND_RESULT_FALSE;
+	cond_cache[ci->dc[0]->context_ndx].local_result = COND_RESULT_FALSE;
+	if (NULL == l) return result; /*(should not happen)*/
+	if (debug_cond)
+		log_error(r->conf.errh, __FILE__, __LINE__,
+		  "%s (%s) compare to %u indexed conditions",
+		  dc->comp_key->ptr, l->ptr, ci->used);
+
+	uint32_t h = djbhash(CONST_BUF_LEN(l), DJBHASH_INIT) & ci->mask;
+	for (uint32_t m; (m = ci->slot[h]); h = (h + 1) & ci->mask) {
+		if (!buffer_is_equal(&ci->dc[m-1]->string, l)) continue;
+		do {
+			const data_config * const mdc = ci->dc[m-1];
+			cond_cache[mdc->context_ndx].local_result = COND_RESULT_TRUE;
+			if (mdc == dc) result = COND_RESULT_TRUE;
+		} while ((m = ci->next[m-1]));
+		break;
+	}
+	return result;
+}
+
 static cond_result_t config_check_cond_nocache(request_st * const r, const data_config * const dc, const int debug_cond, cond_cache_t * const cache) {
 	static struct const_char_buffer {
 	  const char *ptr;
@@ -486,6 +698,9 @@ static cond_result_t config_check_cond_nocache(request_st * const r, const data_
 
 	if (CONFIG_COND_ELSE == dc->cond) return COND_RESULT_TRUE;
 
+	if (dc->cond_index)
+		return config_check_cond_index(r, dc, debug_cond);
+
 	/* pass the rules */
 
 	buffer *l;
@@ -637,6 +852,93 @@ int config_check_cond(request_st * const r, const int context_ndx) {
               : config_check_cond_calc(r, context_ndx, cache));
 }
 
+/* memoized plugin_config merged from defaults and matching conditions,
+ * keyed by the list of true conditions (cvlist indices) for the request.
+ * plugin_config is reset to defaults before merging, so the merged result
+ * depends only on that list.  Table is direct-mapped and bounded; requests
+ * matching more than CONFIG_SNAPSHOT_NMAX of the plugin conditions are merged
+ * without caching.  Allocated on first use, for plugins with conditions. */
+#define CONFIG_SNAPSHOT_SLOTS 256 /*(power of 2)*/
+#define CONFIG_SNAPSHOT_NMAX  8
+
+typedef struct {
+    uint32_t n;                         /* number of true conditions */
+    uint32_t ndx[CONFIG_SNAPSHOT_NMAX]; /* cvlist index of true conditions */
+} config_snapshot_key;
+
+struct config_snapshots {
+    config_snapshot_key key;  /* key of current request (if pending) */
+    config_snapshot_key *pending; /* slot to fill in config_plugin_snapshot_save() */
+    int *hits;
+    int *misses;
+    size_t sz;                /* sizeof(plugin_config) */
+    size_t stride;            /* slot: config_snapshot_key, plugin_config */
+    char *slots;
+};
+
+#define CONFIG_SNAPSHOT_ALIGN(x) (((x) + 15) & ~(size_t)15)
+
+__attribute_cold__
+__attribute_noinline__
+static config_snapshots * config_plugin_snapshots_init (const size_t sz) {
+    const size_t hsz = CONFIG_SNAPSHOT_ALIGN(sizeof(config_snapshots));
+    const size_t stride = CONFIG_SNAPSHOT_ALIGN(sizeof(config_snapshot_key))
+                        + CONFIG_SNAPSHOT_ALIGN(sz);
+    config_snapshots * const cs = calloc(1, hsz + stride*CONFIG_SNAPSHOT_SLOTS);
+    force_assert(cs);
+    cs->sz = sz;
+    cs->stride = stride;
+    cs->slots = (char *)cs + hsz;
+    cs->hits = status_counter_register(CONST_STR_LEN("config.snapshot.hits"));
+    cs->misses=status_counter_register(CONST_STR_LEN("config.snapshot.misses"));
+    return cs;
+}
+
+int config_plugin_snapshot_load (request_st * const r, void * const p_d, void * const pconf, const size_t sz) {
+    /* (pconf must be reset to plugin defaults if snapshot is not loaded) */
+    plugin_data_base * const p = p_d;
+    if (p->nconfig <= 1) return 0; /* no conditions */
+    if (p->snapshots) p->snapshots->pending = NULL;
+
+    config_snapshot_key k;
+    k.n = 0;
+    uint32_t h = DJBHASH_INIT;
+    for (int i = 1, used = p->nconfig; i < used; ++i) {
+        if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id)) {
+            if (k.n == CONFIG_SNAPSHOT_NMAX) return 0;
+            k.ndx[k.n++] = (uint32_t)i;
+            h = ((h << 5) + h) ^ (uint32_t)i;
+        }
+    }
+    if (0 == k.n) return 0; /* merged plugin_config is defaults */
+
+    config_snapshots * cs = p->snapshots;
+    if (NULL == cs) cs = p->snapshots = config_plugin_snapshots_init(sz);
+    config_snapshot_key * const snap = (config_snapshot_key *)
+      (cs->slots + (h & (CONFIG_SNAPSHOT_SLOTS-1)) * cs->stride);
+    if (snap->n == k.n
+        && 0 == memcmp(snap->ndx, k.ndx, k.n * sizeof(*k.ndx))) {
+        ++(*cs->hits);
+        memcpy(pconf, (char *)snap + CONFIG_SNAPSHOT_ALIGN(sizeof(*snap)), sz);
+        return 1;
+    }
+
+    ++(*cs->misses);
+    cs->key = k;
+    cs->pending = snap;
+    return 0;
+}
+
+void config_plugin_snapshot_save (void * const p_d, const void * const pconf) {
+    /* save merged plugin_config if config_plugin_snapshot_load() missed */
+    config_snapshots * const cs = ((plugin_data_base *)p_d)->snapshots;
+    if (NULL == cs || NULL == cs->pending) return;
+    config_snapshot_key * const snap = cs->pending;
+    cs->pending = NULL;
+    *snap = cs->key;
+    memcpy((char *)snap + CONFIG_SNAPSHOT_ALIGN(sizeof(*snap)), pconf, cs->sz);
+}
+
 /* if we reset the cache result for a node, we also need to clear all
  * child nodes and else-branches*/
 static void config_cond_clear_node(cond_cache_t * const cond_cache, const data_config * const dc) {
@@ -687,12 +989,29 @@ void config_cond_cache_reset(request_st * const r) {
 		memset(r->cond_cache, 0, used*sizeof(cond_cache_t));
 }
 
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
 static int data_config_pcre_exec(const data_config *dc, cond_cache_t *cache, const buffer *b, cond_match_t *cond_match) {
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+    const int n = pcre2_match(dc->code, (PCRE2_SPTR)CONST_BUF_LEN(b),
+                              0, 0, dc->match_data, NULL);
+    cache->patterncount = n;
+    if (n > 0) {
+        /* copy offsets (regex captures <= 9; see data_config_pcre_compile())
+         * (PCRE2_UNSET offsets of unset capture groups become -1) */
+        const PCRE2_SIZE * const ovec =
+          pcre2_get_ovector_pointer(dc->match_data);
+        for (int i = 0, used = n << 1; i < used; ++i)
+            cond_match->matches[i] = (int)ovec[i];
+        cond_match->comp_value = b; /*holds pointer to b (!) for pattern subst*/
+    }
+    return n;
+#elif defined(HAVE_PCRE_H)
     #ifndef elementsof
     #define elementsof(x) (sizeof(x) / sizeof(x[0]))
     #endif
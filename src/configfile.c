@@ -56,6 +56,7 @@ static void config_free_config(void * const p_d) {
             }
         }
     }
+    free(p->snapshots);
     free(p->cvlist);
     free(p);
 }
@@ -203,9 +204,27 @@ void config_patch_config(request_st * const r) {
     /* performed by config_reset_config() */
     /*memcpy(&r->conf, &p->defaults, sizeof(request_config));*/
 
-    for (int i = 1, used = p->nconfig; i < used; ++i) {
-        if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
-            config_merge_config(&r->conf, p->cvlist + p->cvlist[i].v.u2[0]);
+    /* r->conf is defaults here, except for stream_request_body flags set
+     * by connection_handle_fdevent() if client half-closed connection.
+     * Those flags are per-connection; exclude them from the snapshot so that
+     * merged r->conf depends only on the list of true conditions
+     * (see config_plugin_snapshot_load()), then reapply them */
+    const unsigned short srb = r->conf.stream_request_body;
+    r->conf.stream_request_body = p->defaults.stream_request_body;
+
+    if (!config_plugin_snapshot_load(r, p, &r->conf, sizeof(request_config))) {
+        for (int i = 1, used = p->nconfig; i < used; ++i) {
+            if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
+                config_merge_config(&r->conf,p->cvlist+p->cvlist[i].v.u2[0]);
+        }
+        config_plugin_snapshot_save(p, &r->conf);
+    }
+
+    if (srb & FDEVENT_STREAM_REQUEST_POLLRDHUP) {
+        r->conf.stream_request_body &=
+          ~(FDEVENT_STREAM_REQUEST_BUFMIN|FDEVENT_STREAM_REQUEST_POLLIN);
+        r->conf.stream_request_body |= srb
+          & (FDEVENT_STREAM_REQUEST_POLLRDHUP|FDEVENT_STREAM_REQUEST_TCP_FIN);
     }
 }
 
@@ -596,6 +615,21 @@ static int config_insert_srvconf(server *srv) {
      ,{ CONST_STR_LEN("debug.log-state-handling"),
         T_CONFIG_BOOL,
         T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.reuseport"),
+        T_CONFIG_BOOL,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.stat-cache-max-fds"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.stat-cache-max-entries"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.h2proto"),
+        T_CONFIG_BOOL,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("server.h2-max-concurrent-streams"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_SERVER }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -728,6 +762,26 @@ static int config_insert_srvconf(server *srv) {
               case 32:/* debug.log-state-handling */
                 srv->srvconf.log_state_handling = (0 != cpv->v.u);
                 break;
+              case 33:/* server.reuseport */
+                srv->srvconf.reuseport = (0 != cpv->v.u);
+                break;
+              case 34:/* server.stat-cache-max-fds */
+                stat_cache_max_fds(cpv->v.u);
+                break;
+              case 35:/* server.stat-cache-max-entries */
+                stat_cache_max_entries(cpv->v.u);
+                break;
+              case 36:/* server.h2proto */
+                srv->srvconf.h2proto = (0 != cpv->v.u);
+                break;
+              case 37:/* server.h2-max-concurrent-streams */
+                srv->srvconf.h2_max_concurrent_streams = cpv->v.shrt;
+                if (0 == cpv->v.shrt || cpv->v.shrt > 256) {
+                    log_error(srv->errh, __FILE__, __LINE__,
+                      "server.h2-max-concurrent-streams must be 1 - 256");
+                    rc = HANDLER_ERROR;
+                }
+                break;
               default:/* should not happen */
                 break;
             }
@@ -1029,6 +1083,8 @@ int config_finalize(server *srv, const buffer *default_server_tag) {
     array_free(srv->srvconf.config_touched);
     srv->srvconf.config_touched = NULL;
 
+    config_cond_index_build(srv->config_context);
+
     if (srv->srvconf.config_unsupported || srv->srvconf.config_deprecated) {
         if (srv->srvconf.config_unsupported)
             log_error(srv->errh, __FILE__, __LINE__,
@@ -1050,6 +1106,7 @@ void config_print(server *srv) {
 void config_free(server *srv) {
     config_free_config(srv->config_data_base);
 
+    config_cond_index_free(srv->config_context);
     array_free(srv->config_context);
     array_free(srv->srvconf.config_touched);
     array_free(srv->srvconf.modules);
@@ -1069,6 +1126,7 @@ void config_init(server *srv) {
 
     srv->srvconf.high_precision_timestamps = 0;
     srv->srvconf.max_request_field_size = 8192;
+    srv->srvconf.h2_max_concurrent_streams = 8;
 
     srv->srvconf.http_header_strict  = 1;
     srv->srvconf.http_host_strict    = 1; /*(implies http_host_normalize)*/
@@ -13,13 +13,32 @@
  * for compare: comp          cond  string/regex
  */
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE_H) && !defined(HAVE_PCRE2_H)
 struct pcre_extra;      /* declaration */
 #endif
 
 typedef struct data_config data_config;
 DEFINE_TYPED_VECTOR_NO_RELEASE(config_weak, data_config*);
 
+/* hash index of sibling "==" conditions on the same comp_key (and comp_tag),
+ * e.g. many $HTTP["host"] == "..." blocks; built at startup so that the
+ * first condition evaluated in a group resolves the whole group */
+typedef struct config_cond_index {
+	const data_config **dc; /* conditions in group, in context order */
+	uint32_t *slot;         /* hash table of (dc index + 1); 0 if empty */
+	uint32_t *next;         /* (dc index + 1) of next dc with same string */
+	uint32_t used;
+	uint32_t mask;
+} config_cond_index;
+
+#define CONFIG_COND_INDEX_MIN 8 /* smaller groups are evaluated one by one */
+
+__attribute_cold__
+void config_cond_index_build (const array *config_context);
+
+__attribute_cold__
+void config_cond_index_free (const array *config_context);
+
 struct data_config {
 	DATA_UNSET;
 	int context_ndx; /* more or less like an id */
@@ -33,7 +52,10 @@ struct data_config {
 	data_config *next;
 
 	buffer string;
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+	void *code;             /* (pcre2_code *) */
+	void *match_data;       /* (pcre2_match_data *) preallocated */
+#elif defined(HAVE_PCRE_H)
 	void *regex;
 	struct pcre_extra *regex_study;
 #endif
@@ -41,6 +63,8 @@ struct data_config {
 	buffer *comp_key;
 	const char *op;
 
+	const config_cond_index *cond_index;
+
 	vector_config_weak children;
 	array *value;
 };
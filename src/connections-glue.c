@@ -416,7 +416,8 @@ handler_t connection_handle_read_post_state(request_st * const r) {
 
 	int is_closed = 0;
 
-	if (con->is_readable) {
+	/* HTTP/2 request body is received in DATA frames by h2_parse_frames() */
+	if (con->is_readable && r->http_version != HTTP_VERSION_2) {
 		con->read_idle_ts = log_epoch_secs;
 
 		switch(con->network_read(con, cq, MAX_READ_LIMIT)) {
@@ -436,7 +437,7 @@ handler_t connection_handle_read_post_state(request_st * const r) {
 	/* Check for Expect: 100-continue in request headers
 	 * if no request body received yet */
 	if (chunkqueue_is_empty(cq) && 0 == dst_cq->bytes_in
-	    && r->http_version != HTTP_VERSION_1_0
+	    && r->http_version == HTTP_VERSION_1_1
 	    && chunkqueue_is_empty(r->write_queue) && con->is_writable) {
 		const buffer *vb = http_header_request_get(r, HTTP_HEADER_EXPECT, CONST_STR_LEN("Expect"));
 		if (NULL != vb && buffer_eq_icase_slen(vb, CONST_STR_LEN("100-continue"))) {
@@ -449,7 +450,9 @@ handler_t connection_handle_read_post_state(request_st * const r) {
 
 	if (r->reqbody_length < 0) {
 		/*(-1: Transfer-Encoding: chunked, -2: unspecified length)*/
-		handler_t rc = (-1 == r->reqbody_length)
+		/*(HTTP/2 -1: length unknown until END_STREAM)*/
+		handler_t rc = (-1 == r->reqbody_length
+		                && r->http_version != HTTP_VERSION_2)
                   ? connection_handle_read_post_chunked(r, cq, dst_cq)
                   : connection_handle_read_body_unknown(r, cq, dst_cq);
 		if (HANDLER_GO_ON != rc) return rc;
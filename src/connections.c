@@ -7,6 +7,7 @@
 #include "log.h"
 #include "connections.h"
 #include "fdevent.h"
+#include "h2.h"
 #include "http_header.h"
 
 #include "request.h"
@@ -42,6 +43,94 @@ static connection *connection_init(server *srv);
 static int connection_reset(connection *con);
 
 
+/* timer wheel for connection timeouts
+ *
+ * Each active connection is linked into the wheel slot for the second at
+ * which connection_check_timeout() might next take action on it, so that
+ * connection_periodic_maint() visits only connections due in elapsed seconds
+ * instead of scanning all connections every second.  Schedule is recomputed
+ * from connection timestamps at the end of each connection_state_machine()
+ * pass, which is where those timestamps change.  A slot is shared by every
+ * (ts % CONNECTION_TW_SLOTS) second; entries due in a later rotation of the
+ * wheel are skipped (and relinked) when the slot is processed. */
+
+#define CONNECTION_TW_SLOTS 512 /* power of 2; > server.max-write-idle default*/
+
+static connection *connection_tw[CONNECTION_TW_SLOTS];
+static time_t connection_tw_ts; /* most recent second processed */
+
+static void connection_tw_del (connection * const con) {
+    if (NULL == con->tw_pprev) return;
+    if ((*con->tw_pprev = con->tw_next))
+        con->tw_next->tw_pprev = con->tw_pprev;
+    con->tw_next = NULL;
+    con->tw_pprev = NULL;
+}
+
+static void connection_tw_add (connection * const con, const time_t ts) {
+    connection ** const slot = connection_tw + (ts & (CONNECTION_TW_SLOTS-1));
+    con->tw_ts = ts;
+    con->tw_pprev = slot;
+    if ((con->tw_next = *slot))
+        con->tw_next->tw_pprev = &con->tw_next;
+    *slot = con;
+}
+
+static time_t connection_tw_min (const time_t a, const time_t b) {
+    return (0 == a || (0 != b && b < a)) ? b : a;
+}
+
+static time_t connection_timeout_ts (connection * const con) {
+    /* earliest time at which connection_check_timeout() might take action
+     * (mirrors checks in connection_check_timeout(); 0 if none) */
+    request_st * const r = &con->request;
+    time_t ts = 0;
+    if (con->h2) {
+        const h2con * const h2c = con->h2;
+        if (0 == h2c->rused)
+            ts = con->read_idle_ts + con->keep_alive_idle + 1;
+        for (uint32_t i = 0; i < h2c->rused; ++i) {
+            const request_st * const hr = h2c->r[i];
+            if (hr->state == CON_STATE_READ_POST)
+                ts = connection_tw_min(ts,
+                  con->read_idle_ts + hr->conf.max_read_idle + 1);
+            else if (hr->state == CON_STATE_WRITE && con->write_request_ts != 0)
+                ts = connection_tw_min(ts,
+                  con->write_request_ts + hr->conf.max_write_idle + 1);
+        }
+    }
+    else if (r->state == CON_STATE_CLOSE)
+        ts = con->close_timeout_ts + HTTP_LINGER_TIMEOUT + 1;
+    else {
+        if (fdevent_fdnode_interest(con->fdn) & FDEVENT_IN)
+            ts = con->read_idle_ts + 1
+               + ((con->request_count == 1 || r->state != CON_STATE_READ)
+                  ? r->conf.max_read_idle
+                  : con->keep_alive_idle);
+        if (r->state == CON_STATE_WRITE && con->write_request_ts != 0)
+            ts = connection_tw_min(ts,
+              con->write_request_ts + r->conf.max_write_idle + 1);
+    }
+
+    /* per-second write throttling and bytes_written_cur_second reset */
+    if (con->traffic_limit_reached || con->bytes_written_cur_second)
+        ts = connection_tw_min(ts, log_epoch_secs + 1);
+
+    /*(schedule overdue connections for next connection_periodic_maint())*/
+    return (0 == ts || ts > connection_tw_ts) ? ts : connection_tw_ts + 1;
+}
+
+static void connection_tw_schedule (connection * const con) {
+    const time_t ts = connection_timeout_ts(con);
+    if (ts == con->tw_ts && (0 == ts || NULL != con->tw_pprev)) return;
+    connection_tw_del(con);
+    if (ts)
+        connection_tw_add(con, ts);
+    else
+        con->tw_ts = 0;
+}
+
+
 static connection *connections_get_new_connection(server *srv) {
 	connections * const conns = &srv->conns;
 	size_t i;
@@ -67,6 +156,9 @@ static void connection_del(server *srv, connection *con) {
 	if (-1 == con->ndx) return;
 	uint32_t i = (uint32_t)con->ndx;
 
+	connection_tw_del(con);
+	con->tw_ts = 0;
+
 	/* not last element */
 
 	if (i != --conns->used) {
@@ -228,6 +320,9 @@ static void connection_handle_response_end_state(request_st * const r, connectio
 
 	if (r->state != CON_STATE_ERROR) ++con->srv->con_written;
 
+	/* HTTP/2 stream is retired in connection_state_machine_h2() */
+	if (r != &con->request) return;
+
 	if (r->reqbody_length != r->reqbody_queue->bytes_in
 	    || r->state == CON_STATE_ERROR) {
 		/* request body is present and has not been read completely */
@@ -434,6 +529,8 @@ static int connection_handle_write_prepare(request_st * const r) {
 			if (r->http_method == HTTP_METHOD_CONNECT
 			    && r->http_status == 200) {
 				/*(no transfer-encoding if successful CONNECT)*/
+			} else if (r->http_version == HTTP_VERSION_2) {
+				/*(HTTP/2 DATA frames; END_STREAM flag ends response)*/
 			} else if (r->http_version == HTTP_VERSION_1_1) {
 				off_t qlen = chunkqueue_length(r->write_queue);
 				r->resp_send_chunked = 1;
@@ -492,10 +589,13 @@ static void connection_handle_write(connection *con) {
 }
 
 static void connection_handle_write_state(request_st * const r, connection * const con) {
+    /* HTTP/2 stream response is framed and written by
+     * connection_state_machine_h2(); only the handler is run here */
+    const int h2stream = (r != &con->request);
     do {
         /* only try to write if we have something in the queue */
-        if (!chunkqueue_is_empty(con->write_queue)) {
-            if (con->is_writable) {
+        if (!chunkqueue_is_empty(r->write_queue)) {
+            if (con->is_writable && !h2stream) {
                 connection_handle_write(con);
                 if (r->state != CON_STATE_WRITE) break;
             }
@@ -527,31 +627,15 @@ static void connection_handle_write_state(request_st * const r, connection * con
             }
         }
     } while (r->state == CON_STATE_WRITE
-             && (!chunkqueue_is_empty(con->write_queue)
-                 ? con->is_writable
+             && (!chunkqueue_is_empty(r->write_queue)
+                 ? con->is_writable && !h2stream
                  : r->resp_body_finished));
 }
 
 
-__attribute_cold__
-static connection *connection_init(server *srv) {
-	connection * const con = calloc(1, sizeof(*con));
-	force_assert(NULL != con);
-
-	con->fd = 0;
-	con->ndx = -1;
-	con->bytes_written = 0;
-	con->bytes_read = 0;
-
-	con->dst_addr_buf = buffer_init();
-	con->srv  = srv;
-	con->plugin_slots = srv->plugin_slots;
-	con->config_data_base = srv->config_data_base;
-
-	request_st * const r = &con->request;
-
-	con->write_queue = r->write_queue = chunkqueue_init();
-	con->read_queue = r->read_queue = chunkqueue_init();
+static void request_init_data(request_st * const r, connection * const con, server * const srv) {
+	r->write_queue = chunkqueue_init();
+	r->read_queue = chunkqueue_init();
 
 	/* init plugin specific connection structures */
 
@@ -566,7 +650,7 @@ static connection *connection_init(server *srv) {
 	r->cond_cache = calloc(srv->config_context->used, sizeof(cond_cache_t));
 	force_assert(NULL != r->cond_cache);
 
-      #ifdef HAVE_PCRE_H
+      #if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
 	if (srv->config_context->used > 1) {/*save 128b per con if no conditions)*/
 		r->cond_match =
 		  calloc(srv->config_context->used, sizeof(cond_match_t));
@@ -577,6 +661,84 @@ static connection *connection_init(server *srv) {
 	r->reqbody_queue = chunkqueue_init();
 
 	config_reset_config(r);
+}
+
+static void request_free_data(request_st * const r) {
+	chunkqueue_free(r->reqbody_queue);
+	chunkqueue_free(r->write_queue);
+	chunkqueue_free(r->read_queue);
+	array_free_data(&r->rqst_headers);
+	array_free_data(&r->resp_headers);
+	array_free_data(&r->env);
+
+	free(r->target.ptr);
+	free(r->target_orig.ptr);
+
+	free(r->uri.scheme.ptr);
+	free(r->uri.authority.ptr);
+	free(r->uri.path.ptr);
+	free(r->uri.query.ptr);
+
+	free(r->physical.doc_root.ptr);
+	free(r->physical.path.ptr);
+	free(r->physical.basedir.ptr);
+	free(r->physical.etag.ptr);
+	free(r->physical.rel_path.ptr);
+
+	free(r->pathinfo.ptr);
+	free(r->server_name_buf.ptr);
+
+	free(r->plugin_ctx);
+	free(r->cond_cache);
+	free(r->cond_match);
+}
+
+request_st * request_acquire(connection * const con) {
+	/* HTTP/2 stream; HTTP/1.x uses con->request */
+	request_st * const r = calloc(1, sizeof(request_st));
+	force_assert(NULL != r);
+	request_init_data(r, con, con->srv);
+	r->http_method = HTTP_METHOD_UNSET;
+	r->http_version = HTTP_VERSION_UNSET;
+	config_cond_cache_reset(r);
+	return r;
+}
+
+void request_release(request_st * const r) {
+	plugins_call_connection_reset(r);
+
+	/* plugins should have cleaned themselves up */
+	server * const srv = r->con->srv;
+	for (uint32_t i = 0; i < srv->plugins.used; ++i) {
+		if (NULL != r->plugin_ctx[i]) {
+			connection_plugin_ctx_check(srv, r);
+			break;
+		}
+	}
+
+	request_free_data(r);
+	free(r);
+}
+
+__attribute_cold__
+static connection *connection_init(server *srv) {
+	connection * const con = calloc(1, sizeof(*con));
+	force_assert(NULL != con);
+
+	con->fd = 0;
+	con->ndx = -1;
+	con->bytes_written = 0;
+	con->bytes_read = 0;
+
+	con->dst_addr_buf = buffer_init();
+	con->srv  = srv;
+	con->plugin_slots = srv->plugin_slots;
+	con->config_data_base = srv->config_data_base;
+
+	request_st * const r = &con->request;
+	request_init_data(r, con, srv);
+	con->write_queue = r->write_queue;
+	con->read_queue = r->read_queue;
 
 	return con;
 }
@@ -587,35 +749,9 @@ void connections_free(server *srv) {
 		connection *con = conns->ptr[i];
 		request_st * const r = &con->request;
 
+		connection_tw_del(con);
 		connection_reset(con);
-
-		chunkqueue_free(r->reqbody_queue);
-		chunkqueue_free(r->write_queue);
-		chunkqueue_free(r->read_queue);
-		array_free_data(&r->rqst_headers);
-		array_free_data(&r->resp_headers);
-		array_free_data(&r->env);
-
-		free(r->target.ptr);
-		free(r->target_orig.ptr);
-
-		free(r->uri.scheme.ptr);
-		free(r->uri.authority.ptr);
-		free(r->uri.path.ptr);
-		free(r->uri.query.ptr);
-
-		free(r->physical.doc_root.ptr);
-		free(r->physical.path.ptr);
-		free(r->physical.basedir.ptr);
-		free(r->physical.etag.ptr);
-		free(r->physical.rel_path.ptr);
-
-		free(r->pathinfo.ptr);
-		free(r->server_name_buf.ptr);
-
-		free(r->plugin_ctx);
-		free(r->cond_cache);
-		free(r->cond_match);
+		request_free_data(r);
 
 		buffer_free(con->dst_addr_buf);
 
@@ -624,11 +760,16 @@ void connections_free(server *srv) {
 
 	free(conns->ptr);
 	conns->ptr = NULL;
+
+	/* (server.c main loop may continue, e.g. SIGTERM during graceful restart)*/
+	memset(connection_tw, 0, sizeof(connection_tw));
+	connection_tw_ts = 0;
 }
 
 
 static int connection_reset(connection *con) {
 	request_st * const r = &con->request;
+	if (con->h2) h2_con_free(con);
 	plugins_call_connection_reset(r);
 
 	connection_response_reset(r);
@@ -641,6 +782,10 @@ static int connection_reset(connection *con) {
 	r->resp_header_len = 0;
 	r->loops_per_request = 0;
 
+	r->hdrs_hp.tv_sec = 0;
+	r->resp_hp.tv_sec = 0;
+	r->backend_usec = 0;
+
 	r->http_method = HTTP_METHOD_UNSET;
 	r->http_version = HTTP_VERSION_UNSET;
 
@@ -825,6 +970,17 @@ static int connection_handle_read_state(connection * const con)  {
 
     char * const hdrs = c->mem->ptr + hoff[1];
 
+    if (con->request_count == 1
+        && header_len == sizeof("PRI * HTTP/2.0\r\n\r\n")-1
+        && 0 == memcmp(hdrs, CONST_STR_LEN("PRI * HTTP/2.0\r\n\r\n"))
+        && (r->http_version == HTTP_VERSION_2 /*(set if TLS ALPN "h2")*/
+            || (!con->is_ssl_sock && con->srv->srvconf.h2proto))) {
+        /* HTTP/2 connection preface (prior knowledge or TLS ALPN "h2") */
+        chunkqueue_mark_written(cq, header_len);
+        h2_init_con(r, con, NULL);
+        return 0;
+    }
+
     if (con->request_count > 1) {
         /* skip past \r\n or \n after previous POST request when keep-alive */
         if (hoff[2] - hoff[1] <= 2)
@@ -920,6 +1076,9 @@ static handler_t connection_handle_fdevent(void *context, int revents) {
 			con->close_timeout_ts = log_epoch_secs - (HTTP_LINGER_TIMEOUT+1);
 		} else if (revents & FDEVENT_HUP) {
 			connection_set_state(r, CON_STATE_ERROR);
+		} else if (con->h2) {
+			/* HTTP/2 has no half-close; (RDHUP or ERR) */
+			connection_set_state(r, CON_STATE_ERROR);
 		} else if (revents & FDEVENT_RDHUP) {
 			int events = fdevent_fdnode_interest(con->fdn);
 			events &= ~(FDEVENT_IN|FDEVENT_RDHUP);
@@ -1254,10 +1413,62 @@ static int connection_handle_request(request_st * const r) {
 }
 
 
-int connection_state_machine(connection *con) {
-	request_st * const r = &con->request;
+__attribute_cold__
+static int connection_upgrade_h2c(request_st * const h2r, connection * const con) {
+	const buffer * const http2_settings = h2_check_con_upgrade_h2c(h2r);
+	if (NULL == http2_settings) return 0;
+
+	chunkqueue_append_mem(con->write_queue,
+	  CONST_STR_LEN("HTTP/1.1 101 Switching Protocols\r\n"
+	                "Connection: Upgrade\r\n"
+	                "Upgrade: h2c\r\n"
+	                "\r\n"));
+
+	/* move HTTP/1.1 request into HTTP/2 stream 1
+	 * (connection-level queues and plugin ctx remain with con->request) */
+	request_st * const r = request_acquire(con);
+	request_st tmp;
+	memcpy(&tmp, h2r, sizeof(request_st));
+	memcpy(h2r, r, sizeof(request_st));
+	memcpy(r, &tmp, sizeof(request_st));
+
+	r->write_queue = h2r->write_queue;
+	r->read_queue = h2r->read_queue;
+	h2r->write_queue = con->write_queue;
+	h2r->read_queue = con->read_queue;
+
+	void ** const plugin_ctx = r->plugin_ctx;
+	r->plugin_ctx = h2r->plugin_ctx;
+	h2r->plugin_ctx = plugin_ctx;
+
+	if (r->server_name == &h2r->server_name_buf)
+		r->server_name = &r->server_name_buf;
+
+	h2_init_con(h2r, con, http2_settings);
+
+	h2con * const h2c = con->h2;
+	h2c->r[h2c->rused++] = r;
+	h2c->h2_cid = 1;
+	r->h2id = 1;
+	r->h2state = H2_STATE_HALF_CLOSED_REMOTE;
+	r->h2_rwin = 65535;
+	r->h2_swin = h2c->s_initial_window_size;
+	r->h2_weight = 16; /* default (RFC 7540 5.3.5) */
+	r->http_version = HTTP_VERSION_2;
+
+	/*(http2_settings points into request headers; unset after use)*/
+	http_header_request_unset(r, HTTP_HEADER_OTHER,
+	                          CONST_STR_LEN("HTTP2-Settings"));
+	http_header_request_unset(r, HTTP_HEADER_UPGRADE,
+	                          CONST_STR_LEN("Upgrade"));
+	http_header_request_unset(r, HTTP_HEADER_CONNECTION,
+	                          CONST_STR_LEN("Connection"));
+	return 1;
+}
+
+
+static void connection_state_machine_loop(request_st * const r, connection * const con) {
 	request_state_t ostate;
-	int rc;
 	const int log_state_handling = r->conf.log_state_handling;
 
 	if (log_state_handling) {
@@ -1283,10 +1494,19 @@ int connection_state_machine(connection *con) {
 			connection_set_state(r, CON_STATE_READ);
 			/* fall through */
 		case CON_STATE_READ:
-			if (!connection_handle_read_state(con)) break;
+			if (!connection_handle_read_state(con)) {
+				if (con->h2) return; /* HTTP/2 connection preface */
+				break;
+			}
 			/*if (r->state != CON_STATE_REQUEST_END) break;*/
 			/* fall through */
 		case CON_STATE_REQUEST_END: /* transient */
+			if (r->conf.high_precision_timestamps)
+				log_clock_gettime_realtime(&r->hdrs_hp);
+			if ((r->rqst_htags & HTTP_HEADER_UPGRADE)
+			    && r == &con->request
+			    && connection_upgrade_h2c(r, con))
+				return; /* HTTP/1.1 Upgrade: h2c */
 			ostate = (0 == r->reqbody_length)
 			  ? CON_STATE_HANDLE_REQUEST
 			  : CON_STATE_READ_POST;
@@ -1308,6 +1528,8 @@ int connection_state_machine(connection *con) {
 			if (r->state != CON_STATE_RESPONSE_START) break;
 			/* fall through */
 		case CON_STATE_RESPONSE_START: /* transient */
+			if (r->conf.high_precision_timestamps)
+				log_clock_gettime_realtime(&r->resp_hp);
 			if (-1 == connection_handle_write_prepare(r)) {
 				connection_set_state(r, CON_STATE_ERROR);
 				break;
@@ -1338,8 +1560,116 @@ int connection_state_machine(connection *con) {
 		log_error(r->conf.errh, __FILE__, __LINE__,
 		  "state at exit: %d %s", con->fd, connection_get_state(r->state));
 	}
+}
+
+
+static int connection_write_h2_stream(request_st * const r, connection * const con, const off_t pass_avail) {
+	/* frame response data from stream into connection write queue,
+	 * limited by flow control windows, size of connection write queue,
+	 * and stream priority (share of write queue space in this pass) */
+	h2con * const h2c = con->h2;
+	chunkqueue * const cq = con->write_queue;
+	off_t dlen = chunkqueue_length(r->write_queue);
+	if (dlen > 0) {
+		const off_t avail = MAX_WRITE_LIMIT - (cq->bytes_in - cq->bytes_out);
+		const off_t limit = h2_send_limit(r, con, pass_avail);
+		if (dlen > avail)       dlen = avail;
+		if (dlen > limit)       dlen = limit;
+		if (dlen > h2c->swin)   dlen = h2c->swin;
+		if (dlen > r->h2_swin)  dlen = r->h2_swin;
+		if (dlen <= 0) return 0;
+		h2_send_cqdata(r, con, r->write_queue, (uint32_t)dlen);
+	}
+
+	if (r->resp_body_finished && chunkqueue_is_empty(r->write_queue)) {
+		connection_set_state(r, CON_STATE_RESPONSE_END);
+		connection_handle_response_end_state(r, con);
+	}
+	return (dlen > 0);
+}
 
-	rc = 0;
+
+static void connection_state_machine_h2(request_st * const h2r, connection * const con) {
+	h2con * const h2c = con->h2;
+
+	if (con->is_readable > 0 && h2r->state != CON_STATE_ERROR) {
+		con->read_idle_ts = log_epoch_secs;
+		switch (con->network_read(con, con->read_queue, MAX_READ_LIMIT)) {
+		case -1: /* error */
+		case -2: /* remote close */
+			connection_set_state(h2r, CON_STATE_ERROR);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (h2r->state != CON_STATE_ERROR && h2c->sent_goaway <= 0
+	    && !chunkqueue_is_empty(con->read_queue))
+		h2_parse_frames(con); /*(sends GOAWAY on connection error)*/
+
+	if (h2r->state != CON_STATE_ERROR && h2c->sent_goaway <= 0) {
+		int resched;
+		do {
+			resched = 0;
+			h2_prio_order(con);
+			chunkqueue * const cq = con->write_queue;
+			const off_t avail =
+			  MAX_WRITE_LIMIT - (cq->bytes_in - cq->bytes_out);
+			for (uint32_t i = 0; i < h2c->rused; ++i) {
+				request_st * const r = h2c->r[i];
+				connection_state_machine_loop(r, con);
+				if (r->state == CON_STATE_WRITE)
+					resched |= connection_write_h2_stream(r, con, avail);
+				if (r->state == CON_STATE_RESPONSE_END
+				    || r->state == CON_STATE_ERROR) {
+					h2_send_end_stream(r, con);
+					h2_retire_stream(r, con);
+					--i;
+				}
+				else
+					h2_stream_rwin_check(r, con);
+			}
+
+			if (!chunkqueue_is_empty(con->write_queue) && con->is_writable > 0)
+				connection_handle_write(con);
+		} while (resched && h2r->state != CON_STATE_ERROR
+		         && con->is_writable > 0
+		         && chunkqueue_is_empty(con->write_queue));
+	}
+
+	if (h2r->state == CON_STATE_ERROR || h2c->sent_goaway > 0) {
+		/* abort all streams */
+		for (uint32_t i = 0; i < h2c->rused; ++i) {
+			request_st * const r = h2c->r[i];
+			connection_set_state(r, CON_STATE_ERROR);
+			connection_handle_response_end_state(r, con);
+			request_release(r);
+		}
+		h2c->rused = 0;
+
+		/* flush GOAWAY */
+		if (h2r->state != CON_STATE_ERROR
+		    && !chunkqueue_is_empty(con->write_queue) && con->is_writable > 0)
+			connection_handle_write(con);
+	}
+
+	if (h2r->state == CON_STATE_ERROR
+	    || (0 == h2c->rused
+	        && (h2c->sent_goaway || h2c->received_goaway)
+	        && chunkqueue_is_empty(con->write_queue))) {
+		h2_con_free(con);
+		connection_handle_shutdown(con);
+	}
+	else if (con->is_readable > 0) {
+		/* more data might be available to read */
+		joblist_append(con);
+	}
+}
+
+
+static void connection_set_fdevent_interest(request_st * const r, connection * const con) {
+	int rc = 0;
 	switch(r->state) {
 	case CON_STATE_READ:
 		rc = FDEVENT_IN | FDEVENT_RDHUP;
@@ -1390,17 +1720,88 @@ int connection_state_machine(connection *con) {
 			fdevent_fdnode_event_set(con->srv->ev, con->fdn, rc);
 		}
 	}
+}
 
+
+int connection_state_machine(connection *con) {
+	request_st * const r = &con->request;
+	if (NULL == con->h2)
+		connection_state_machine_loop(r, con);
+	if (NULL != con->h2) /*(HTTP/2 might have been started above)*/
+		connection_state_machine_h2(r, con);
+	connection_set_fdevent_interest(r, con);
+	if (con->fd >= 0)
+		connection_tw_schedule(con);
 	return 0;
 }
 
+static int connection_check_timeout_h2 (connection * const con, const time_t cur_ts) {
+    h2con * const h2c = con->h2;
+    int changed = 0;
+
+    if (0 == h2c->rused) {
+        if (cur_ts - con->read_idle_ts > con->keep_alive_idle) {
+            /* time - out */
+            request_st * const h2r = &con->request;
+            if (h2r->conf.log_request_handling) {
+                log_error(h2r->conf.errh, __FILE__, __LINE__,
+                          "connection closed - keep-alive timeout: %d",
+                          con->fd);
+            }
+            if (h2c->sent_goaway)
+                connection_set_state(h2r, CON_STATE_ERROR);
+            else
+                h2_send_goaway(con, H2_E_NO_ERROR);
+            changed = 1;
+        }
+        return changed;
+    }
+
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        request_st * const r = h2c->r[i];
+        if (r->state == CON_STATE_READ_POST) {
+            if (cur_ts - con->read_idle_ts > r->conf.max_read_idle) {
+                /* time - out */
+                if (r->conf.log_request_handling) {
+                    log_error(r->conf.errh, __FILE__, __LINE__,
+                              "request aborted - read timeout: %d", con->fd);
+                }
+                connection_set_state(r, CON_STATE_ERROR);
+                changed = 1;
+            }
+        }
+        else if (r->state == CON_STATE_WRITE && con->write_request_ts != 0) {
+            if (cur_ts - con->write_request_ts > r->conf.max_write_idle) {
+                /* time - out */
+                if (r->conf.log_timeouts) {
+                    log_error(r->conf.errh, __FILE__, __LINE__,
+                      "NOTE: a request from %.*s for %.*s timed out after writing "
+                      "%lld bytes. We waited %d seconds.  If this is a problem, "
+                      "increase server.max-write-idle",
+                      BUFFER_INTLEN_PTR(con->dst_addr_buf),
+                      BUFFER_INTLEN_PTR(&r->target),
+                      (long long)request_bytes_written(r),
+                      (int)r->conf.max_write_idle);
+                }
+                connection_set_state(r, CON_STATE_ERROR);
+                changed = 1;
+            }
+        }
+    }
+
+    return changed;
+}
+
 static void connection_check_timeout (connection * const con, const time_t cur_ts) {
     const int waitevents = fdevent_fdnode_interest(con->fdn);
     int changed = 0;
     int t_diff;
 
     request_st * const r = &con->request;
-    if (r->state == CON_STATE_CLOSE) {
+    if (con->h2) {
+        changed = connection_check_timeout_h2(con, cur_ts);
+    }
+    else if (r->state == CON_STATE_CLOSE) {
         if (cur_ts - con->close_timeout_ts > HTTP_LINGER_TIMEOUT) {
             changed = 1;
         }
@@ -1438,7 +1839,7 @@ static void connection_check_timeout (connection * const con, const time_t cur_t
      * to check for write interest before checking for timeout */
     /*if (waitevents & FDEVENT_OUT)*/
     if ((r->state == CON_STATE_WRITE) &&
-        (con->write_request_ts != 0)) {
+        (con->write_request_ts != 0) && NULL == con->h2) {
       #if 0
         if (cur_ts - con->write_request_ts > 60) {
             log_error(r->conf.errh, __FILE__, __LINE__,
@@ -1481,11 +1882,40 @@ static void connection_check_timeout (connection * const con, const time_t cur_t
     }
 }
 
+static void connection_tw_expire (connection ** const slot, const time_t cur_ts) {
+    /* detach slot list; connections rescheduled while processing this slot
+     * (e.g. due in a later rotation of the wheel) are linked into new list */
+    connection *head = *slot;
+    *slot = NULL;
+    if (NULL == head) return;
+    head->tw_pprev = &head;
+
+    for (connection *con; (con = head); ) {
+        connection_tw_del(con);
+        if (con->tw_ts > cur_ts) {
+            connection_tw_add(con, con->tw_ts);
+            continue;
+        }
+        con->tw_ts = 0;
+        connection_check_timeout(con, cur_ts);
+        /* reschedule (if not already rescheduled by connection_state_machine)*/
+        if (con->fd >= 0 && NULL == con->tw_pprev)
+            connection_tw_schedule(con);
+    }
+}
+
 void connection_periodic_maint (server * const srv, const time_t cur_ts) {
-    /* check all connections for timeouts */
-    connections * const conns = &srv->conns;
-    for (size_t ndx = 0; ndx < conns->used; ++ndx) {
-        connection_check_timeout(conns->ptr[ndx], cur_ts);
+    /* check connections for timeouts
+     * (visit timer wheel slots for seconds elapsed since previous call) */
+    UNUSED(srv);
+    time_t ts = connection_tw_ts;
+    if (cur_ts - ts > CONNECTION_TW_SLOTS)
+        ts = cur_ts - CONNECTION_TW_SLOTS;
+    connection_tw_ts = cur_ts;
+    while (ts < cur_ts) {
+        ++ts;
+        connection_tw_expire(connection_tw + (ts & (CONNECTION_TW_SLOTS-1)),
+                             cur_ts);
     }
 }
 
@@ -1504,6 +1934,11 @@ void connection_graceful_shutdown_maint (server *srv) {
             if (log_epoch_secs - con->close_timeout_ts > HTTP_LINGER_TIMEOUT)
                 changed = 1;
         }
+        else if (con->h2) {
+            /* send GOAWAY; close after active streams complete */
+            h2_send_goaway(con, H2_E_NO_ERROR);
+            changed = 1;
+        }
         else if (r->state == CON_STATE_READ && con->request_count > 1
                  && chunkqueue_is_empty(con->read_queue)) {
             /* close connections in keep-alive waiting for next request */
@@ -1523,5 +1958,8 @@ void connection_graceful_shutdown_maint (server *srv) {
         if (changed) {
             connection_state_machine(con);
         }
+        else if (r->state == CON_STATE_CLOSE) {
+            connection_tw_schedule(con); /*(close_timeout_ts reduced above)*/
+        }
     }
 }
@@ -26,6 +26,9 @@ handler_t connection_handle_read_post_error(request_st *r, int http_status);
 int connection_write_chunkqueue(connection *con, chunkqueue *c, off_t max_bytes);
 void connection_response_reset(request_st *r);
 
+request_st * request_acquire(connection *con);
+void request_release(request_st *r);
+
 #define joblist_append(con) connection_list_append(&(con)->srv->joblist, (con))
 void connection_list_append(connections *conns, connection *con);
 
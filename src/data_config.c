@@ -7,7 +7,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
@@ -36,9 +39,16 @@ static void data_config_free(data_unset *d) {
 	vector_config_weak_clear(&ds->children);
 
 	free(ds->string.ptr);
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+	if (ds->match_data) pcre2_match_data_free(ds->match_data);
+	if (ds->code) pcre2_code_free(ds->code);
+#elif defined(HAVE_PCRE_H)
 	if (ds->regex) pcre_free(ds->regex);
+  #ifdef PCRE_STUDY_JIT_COMPILE
+	if (ds->regex_study) pcre_free_study(ds->regex_study);
+  #else
 	if (ds->regex_study) pcre_free(ds->regex_study);
+  #endif
 #endif
 
 	free(d);
@@ -148,13 +158,55 @@ data_config *data_config_init(void) {
 }
 
 int data_config_pcre_compile(data_config *dc) {
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+    /* (use fprintf() on error, as this is called from configparser.y) */
+    int errcode;
+    PCRE2_SIZE erroff;
+    uint32_t captures;
+
+    if (dc->match_data) pcre2_match_data_free(dc->match_data);
+    if (dc->code) pcre2_code_free(dc->code);
+    dc->match_data = NULL;
+
+    dc->code = pcre2_compile((PCRE2_SPTR)CONST_BUF_LEN(&dc->string),
+                             0, &errcode, &erroff, NULL);
+    if (NULL == dc->code) {
+        PCRE2_UCHAR errbuf[256];
+        pcre2_get_error_message(errcode, errbuf, sizeof(errbuf));
+        fprintf(stderr, "parsing regex failed: %s -> %s at offset %zu\n",
+                dc->string.ptr, (char *)errbuf, (size_t)erroff);
+        return 0;
+    }
+
+    errcode = pcre2_pattern_info(dc->code, PCRE2_INFO_CAPTURECOUNT, &captures);
+    if (0 != errcode) {
+        fprintf(stderr, "getting capture count for regex failed: %s\n",
+                dc->string.ptr);
+        return 0;
+    } else if (captures > 9) {
+        fprintf(stderr, "Too many captures in regex, use (?:...) instead of (...): %s\n",
+                dc->string.ptr);
+        return 0;
+    }
+
+    /* (JIT may be unavailable on platform; pcre2_match() then interprets) */
+    pcre2_jit_compile(dc->code, PCRE2_JIT_COMPLETE);
+
+    /* (captures <= 9, so offsets fit in cond_match_t matches[]) */
+    dc->match_data = pcre2_match_data_create_from_pattern(dc->code, NULL);
+    force_assert(dc->match_data);
+    return 1;
+#elif defined(HAVE_PCRE_H)
     /* (use fprintf() on error, as this is called from configparser.y) */
     const char *errptr;
     int erroff, captures;
 
     if (dc->regex) pcre_free(dc->regex);
+  #ifdef PCRE_STUDY_JIT_COMPILE
+    if (dc->regex_study) pcre_free_study(dc->regex_study);
+  #else
     if (dc->regex_study) pcre_free(dc->regex_study);
+  #endif
 
     dc->regex = pcre_compile(dc->string.ptr, 0, &errptr, &erroff, NULL);
     if (NULL == dc->regex) {
@@ -163,7 +215,11 @@ int data_config_pcre_compile(data_config *dc) {
         return 0;
     }
 
+  #ifdef PCRE_STUDY_JIT_COMPILE
+    dc->regex_study = pcre_study(dc->regex, PCRE_STUDY_JIT_COMPILE, &errptr);
+  #else
     dc->regex_study = pcre_study(dc->regex, 0, &errptr);
+  #endif
     if (NULL == dc->regex_study && errptr != NULL) {
         fprintf(stderr, "studying regex failed: %s -> %s\n",
                 dc->string.ptr, errptr);
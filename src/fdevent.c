@@ -6,6 +6,7 @@
 #include "log.h"
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include "sys-socket.h"
 
@@ -33,6 +34,10 @@ int fdevent_config(const char **event_handler_name, log_error_st *errh) {
 		{ FDEVENT_HANDLER_LINUX_SYSEPOLL, "linux-sysepoll" },
 		{ FDEVENT_HANDLER_LINUX_SYSEPOLL, "epoll" },
 #endif
+#ifdef FDEVENT_USE_LINUX_IO_URING
+		{ FDEVENT_HANDLER_LINUX_IO_URING, "linux-io-uring" },
+		{ FDEVENT_HANDLER_LINUX_IO_URING, "io_uring" },
+#endif
 #ifdef FDEVENT_USE_SOLARIS_PORT
 		{ FDEVENT_HANDLER_SOLARIS_PORT,   "solaris-eventports" },
 #endif
@@ -114,6 +119,11 @@ const char * fdevent_show_event_handlers(void) {
 #else
       "\t- epoll (Linux)\n"
 #endif
+#ifdef FDEVENT_USE_LINUX_IO_URING
+      "\t+ io_uring (Linux)\n"
+#else
+      "\t- io_uring (Linux)\n"
+#endif
 #ifdef FDEVENT_USE_SOLARIS_DEVPOLL
       "\t+ /dev/poll (Solaris)\n"
 #else
@@ -211,6 +221,11 @@ fdevents * fdevent_init(const char *event_handler, int *max_fds, int *cur_fds, l
 		if (0 == fdevent_linux_sysepoll_init(ev)) return ev;
 		break;
 	#endif
+	#ifdef FDEVENT_USE_LINUX_IO_URING
+	case FDEVENT_HANDLER_LINUX_IO_URING:
+		if (0 == fdevent_linux_io_uring_init(ev)) return ev;
+		break;
+	#endif
 	#ifdef FDEVENT_USE_SOLARIS_DEVPOLL
 	case FDEVENT_HANDLER_SOLARIS_DEVPOLL:
 		if (0 == fdevent_solaris_devpoll_init(ev)) return ev;
@@ -610,6 +625,56 @@ int fdevent_mkstemp_append(char *path) {
 }
 
 
+#ifdef __WIN32
+# define mkdir(x,y) mkdir(x)
+#endif
+
+/* 0 on success, -1 for error */
+int fdevent_mkdir_recursive(char *dir) {
+	char *p = dir;
+
+	if (!dir || !dir[0])
+		return 0;
+
+	while ((p = strchr(p + 1, '/')) != NULL) {
+
+		*p = '\0';
+		if ((mkdir(dir, 0700) != 0) && (errno != EEXIST)) {
+			*p = '/';
+			return -1;
+		}
+
+		*p++ = '/';
+		if (!*p) return 0; /* Ignore trailing slash */
+	}
+
+	return (mkdir(dir, 0700) != 0) && (errno != EEXIST) ? -1 : 0;
+}
+
+
+/* 0 on success, -1 for error */
+int fdevent_mkdir_for_file(char *filename) {
+	char *p = filename;
+
+	if (!filename || !filename[0])
+		return -1;
+
+	while ((p = strchr(p + 1, '/')) != NULL) {
+
+		*p = '\0';
+		if ((mkdir(filename, 0700) != 0) && (errno != EEXIST)) {
+			*p = '/';
+			return -1;
+		}
+
+		*p++ = '/';
+		if (!*p) return -1; /* Unexpected trailing slash in filename */
+	}
+
+	return 0;
+}
+
+
 int fdevent_accept_listenfd(int listenfd, struct sockaddr *addr, size_t *addrlen) {
 	int fd;
 	socklen_t len = (socklen_t) *addrlen;
@@ -1075,6 +1140,18 @@ int fdevent_set_so_reuseaddr (const int fd, const int opt)
     return setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 }
 
+int fdevent_set_so_reuseport (const int fd, const int opt)
+{
+  #ifdef SO_REUSEPORT
+    return setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+  #else
+    UNUSED(fd);
+    UNUSED(opt);
+    errno = ENOPROTOOPT;
+    return -1;
+  #endif
+}
+
 
 #include <sys/stat.h>
 #include "safe_memclear.h"
@@ -82,6 +82,8 @@ int fdevent_socket_cloexec(int domain, int type, int protocol);
 int fdevent_socket_nb_cloexec(int domain, int type, int protocol);
 int fdevent_open_cloexec(const char *pathname, int symlinks, int flags, mode_t mode);
 int fdevent_mkstemp_append(char *path);
+int fdevent_mkdir_recursive(char *dir);
+int fdevent_mkdir_for_file(char *filename);
 
 struct sockaddr;
 int fdevent_accept_listenfd(int listenfd, struct sockaddr *addr, size_t *addrlen);
@@ -111,6 +113,7 @@ int fdevent_is_tcp_half_closed(int fd);
 int fdevent_set_tcp_nodelay (const int fd, const int opt);
 
 int fdevent_set_so_reuseaddr (const int fd, const int opt);
+int fdevent_set_so_reuseport (const int fd, const int opt);
 
 char * fdevent_load_file (const char * const fn, off_t *lim, log_error_st *errh, void *(malloc_fn)(size_t), void(free_fn)(void *));
 
@@ -9,6 +9,15 @@
 struct epoll_event;     /* declaration */
 #endif
 
+#if defined(HAVE_LINUX_IO_URING_H)
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+# if defined(__NR_io_uring_setup) && defined(IORING_FEAT_EXT_ARG)
+#  define FDEVENT_USE_LINUX_IO_URING
+struct fdevent_io_uring; /* declaration */
+# endif
+#endif
+
 /* MacOS 10.3.x has poll.h under /usr/include/, all other unixes
  * under /usr/include/sys/ */
 #if defined HAVE_POLL && (defined(HAVE_SYS_POLL_H) || defined(HAVE_POLL_H))
@@ -57,7 +66,8 @@ typedef enum {
     FDEVENT_HANDLER_SOLARIS_DEVPOLL,
     FDEVENT_HANDLER_SOLARIS_PORT,
     FDEVENT_HANDLER_FREEBSD_KQUEUE,
-    FDEVENT_HANDLER_LIBEV
+    FDEVENT_HANDLER_LIBEV,
+    FDEVENT_HANDLER_LINUX_IO_URING
 } fdevent_handler_t;
 
 /**
@@ -89,6 +99,9 @@ struct fdevents {
     int epoll_fd;
     struct epoll_event *epoll_events;
   #endif
+  #ifdef FDEVENT_USE_LINUX_IO_URING
+    struct fdevent_io_uring *io_uring;
+  #endif
   #ifdef FDEVENT_USE_SOLARIS_DEVPOLL
     int devpoll_fd;
     struct pollfd *devpollfds;
@@ -137,6 +150,8 @@ int fdevent_poll_init(struct fdevents *ev);
 __attribute_cold__
 int fdevent_linux_sysepoll_init(struct fdevents *ev);
 __attribute_cold__
+int fdevent_linux_io_uring_init(struct fdevents *ev);
+__attribute_cold__
 int fdevent_solaris_devpoll_init(struct fdevents *ev);
 __attribute_cold__
 int fdevent_solaris_port_init(struct fdevents *ev);
@@ -0,0 +1,305 @@
+#include "first.h"
+
+#include "fdevent_impl.h"
+#include "fdevent.h"
+#include "buffer.h"
+#include "log.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FDEVENT_USE_LINUX_IO_URING
+
+/* io_uring(7) event handler
+ *
+ * Interest changes (fdevent_fdnode_event_set()) are queued as
+ * IORING_OP_POLL_ADD / IORING_OP_POLL_REMOVE submission queue entries and
+ * are submitted to the kernel in the same io_uring_enter() call which waits
+ * for completions, instead of one epoll_ctl() syscall per interest change.
+ *
+ * io_uring poll requests are one-shot.  After an event is delivered, the
+ * poll request is re-armed with fdn->events (again queued, not a syscall),
+ * which preserves the level-triggered semantics expected by lighttpd.
+ *
+ * user_data of each poll request is (generation << 32 | fd).  The generation
+ * is incremented whenever interest for fd changes or fd is removed, so that
+ * completions for stale (removed or replaced) poll requests are discarded.
+ *
+ * (implemented directly on io_uring_setup() and io_uring_enter() syscalls;
+ *  liburing is not required)
+ */
+
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+
+#define FDEVENT_IO_URING_UDATA_IGNORE (~(uint64_t)0)
+
+struct fdevent_io_uring {
+    int ring_fd;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t cq_mask;
+    uint32_t *sq_khead;
+    uint32_t *sq_ktail;
+    uint32_t *sq_array;
+    uint32_t *cq_khead;
+    uint32_t *cq_ktail;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    uint32_t sq_tail;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_sz;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    uint32_t *gen;       /* per-fd generation (see comment at top) */
+    unsigned char *armed;/* per-fd flag: poll request pending in kernel */
+};
+
+static int fdevent_io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+static uint32_t fdevent_io_uring_sq_pending(const struct fdevent_io_uring * const u) {
+    return u->sq_tail - __atomic_load_n(u->sq_khead, __ATOMIC_ACQUIRE);
+}
+
+__attribute_noinline__
+static int fdevent_io_uring_flush(struct fdevent_io_uring * const u) {
+    /* submission queue full; submit queued entries without waiting */
+    uint32_t pending;
+    while ((pending = fdevent_io_uring_sq_pending(u)) == u->sq_entries) {
+        if (fdevent_io_uring_enter(u->ring_fd, pending, 0, 0, NULL, 0) < 0
+            && errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+static struct io_uring_sqe * fdevent_io_uring_get_sqe(struct fdevent_io_uring * const u) {
+    if (fdevent_io_uring_sq_pending(u) == u->sq_entries
+        && 0 != fdevent_io_uring_flush(u))
+        return NULL;
+    const uint32_t idx = u->sq_tail & u->sq_mask;
+    struct io_uring_sqe * const sqe = u->sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    return sqe;
+}
+
+static void fdevent_io_uring_put_sqe(struct fdevent_io_uring * const u) {
+    __atomic_store_n(u->sq_ktail, ++u->sq_tail, __ATOMIC_RELEASE);
+}
+
+static uint64_t fdevent_io_uring_udata(const struct fdevent_io_uring * const u, int fd) {
+    return ((uint64_t)u->gen[fd] << 32) | (uint32_t)fd;
+}
+
+static int fdevent_io_uring_poll_add(struct fdevent_io_uring * const u, int fd, int events) {
+    struct io_uring_sqe * const sqe = fdevent_io_uring_get_sqe(u);
+    if (NULL == sqe) return -1;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = (uint32_t)(events | FDEVENT_ERR | FDEVENT_HUP);
+    sqe->user_data = fdevent_io_uring_udata(u, fd);
+    fdevent_io_uring_put_sqe(u);
+    u->armed[fd] = 1;
+    return 0;
+}
+
+static int fdevent_io_uring_poll_remove(struct fdevent_io_uring * const u, int fd) {
+    struct io_uring_sqe * const sqe = fdevent_io_uring_get_sqe(u);
+    if (NULL == sqe) return -1;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = fdevent_io_uring_udata(u, fd);
+    sqe->user_data = FDEVENT_IO_URING_UDATA_IGNORE;
+    fdevent_io_uring_put_sqe(u);
+    u->armed[fd] = 0;
+    ++u->gen[fd]; /*(discard any completion already posted for fd)*/
+    return 0;
+}
+
+__attribute_cold__
+static void fdevent_linux_io_uring_free(fdevents *ev) {
+    struct fdevent_io_uring * const u = ev->io_uring;
+    if (NULL == u) return;
+    if (u->sqes) munmap(u->sqes, u->sqes_sz);
+    if (u->cq_ring && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_sz);
+    if (u->sq_ring) munmap(u->sq_ring, u->sq_ring_sz);
+    if (-1 != u->ring_fd) close(u->ring_fd);
+    free(u->gen);
+    free(u->armed);
+    free(u);
+    ev->io_uring = NULL;
+}
+
+static int fdevent_linux_io_uring_event_del(fdevents *ev, fdnode *fdn) {
+    struct fdevent_io_uring * const u = ev->io_uring;
+    if (!u->armed[fdn->fd]) {
+        ++u->gen[fdn->fd];
+        return 0;
+    }
+    return fdevent_io_uring_poll_remove(u, fdn->fd);
+}
+
+static int fdevent_linux_io_uring_event_set(fdevents *ev, fdnode *fdn, int events) {
+    struct fdevent_io_uring * const u = ev->io_uring;
+    const int fd = fdn->fde_ndx = fdn->fd;
+    if (u->armed[fd] && 0 != fdevent_io_uring_poll_remove(u, fd))
+        return -1;
+    return fdevent_io_uring_poll_add(u, fd, events);
+}
+
+static int fdevent_linux_io_uring_poll(fdevents * const ev, int timeout_ms) {
+    struct fdevent_io_uring * const u = ev->io_uring;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    /* submit queued interest changes and wait for events in one syscall */
+    uint32_t cq_head = *u->cq_khead;
+    if (cq_head == __atomic_load_n(u->cq_ktail, __ATOMIC_ACQUIRE)) {
+        int rc = fdevent_io_uring_enter(u->ring_fd,
+                                        fdevent_io_uring_sq_pending(u), 1,
+                                        IORING_ENTER_GETEVENTS
+                                          | IORING_ENTER_EXT_ARG,
+                                        &arg, sizeof(arg));
+        if (rc < 0) {
+            if (errno == ETIME) return 0;
+            if (errno != EBUSY) return -1;
+            /*(EBUSY: completion queue overflowed; reap completions below)*/
+        }
+    }
+
+    int n = 0;
+    for (uint32_t cq_tail; cq_head != (cq_tail = __atomic_load_n(u->cq_ktail, __ATOMIC_ACQUIRE)); ) {
+        do {
+            const struct io_uring_cqe * const cqe = u->cqes + (cq_head & u->cq_mask);
+            const uint64_t udata = cqe->user_data;
+            const int res = cqe->res;
+            /* release entry before calling handler (handler may re-enter) */
+            __atomic_store_n(u->cq_khead, ++cq_head, __ATOMIC_RELEASE);
+
+            if (udata == FDEVENT_IO_URING_UDATA_IGNORE) continue;
+            const int fd = (int)(uint32_t)udata;
+            if ((uint32_t)(udata >> 32) != u->gen[fd]) continue; /*(stale)*/
+            fdnode * const fdn = ev->fdarray[fd];
+            if (NULL == fdn || ((uintptr_t)fdn & 0x3)) continue;
+            u->armed[fd] = 0;
+            if (res == -ECANCELED) continue;
+            /*(report other errors, e.g. -EBADF, as FDEVENT_ERR to handler)*/
+            const int revents = res < 0 ? FDEVENT_ERR : res;
+            ++n;
+            if ((fdevent_handler)NULL != fdn->handler) {
+                (*fdn->handler)(fdn->ctx, revents);
+            }
+            /* re-arm one-shot poll request unless interest was changed
+             * or removed by handler, or fd was closed or replaced */
+            if (!u->armed[fd] && ev->fdarray[fd] == fdn && -1 != fdn->fde_ndx
+                && 0 != fdn->events
+                && 0 != fdevent_io_uring_poll_add(u, fd, fdn->events))
+                log_perror(ev->errh, __FILE__, __LINE__,
+                  "io_uring poll re-arm failed on fd %d", fd);
+        } while (cq_head != cq_tail);
+    }
+    return n;
+}
+
+__attribute_cold__
+static int fdevent_io_uring_setup(fdevents * const ev, struct fdevent_io_uring * const u) {
+    struct io_uring_params params;
+    uint32_t entries = 64;
+    while (entries < ev->maxfds && entries < 4096) entries <<= 1;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries << 2;
+    u->ring_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (-1 == u->ring_fd) return -1;
+
+    fdevent_setfd_cloexec(u->ring_fd);
+
+    /* required: (Linux 5.11+) */
+    if (!(params.features & IORING_FEAT_NODROP)
+        || !(params.features & IORING_FEAT_EXT_ARG)) {
+        log_error(ev->errh, __FILE__, __LINE__,
+          "io_uring: kernel lacks required features (Linux 5.11+)");
+        return -1;
+    }
+
+    u->sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    u->cq_ring_sz = params.cq_off.cqes
+                  + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_sz > u->sq_ring_sz) u->sq_ring_sz = u->cq_ring_sz;
+        u->cq_ring_sz = u->sq_ring_sz;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == u->sq_ring) { u->sq_ring = NULL; return -1; }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        u->cq_ring = u->sq_ring;
+    else {
+        u->cq_ring = mmap(NULL, u->cq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED|MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == u->cq_ring) { u->cq_ring = NULL; return -1; }
+    }
+    u->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == u->sqes) { u->sqes = NULL; return -1; }
+
+    char * const sq = u->sq_ring;
+    char * const cq = u->cq_ring;
+    u->sq_khead   = (uint32_t *)(sq + params.sq_off.head);
+    u->sq_ktail   = (uint32_t *)(sq + params.sq_off.tail);
+    u->sq_mask    = *(uint32_t *)(sq + params.sq_off.ring_mask);
+    u->sq_entries = *(uint32_t *)(sq + params.sq_off.ring_entries);
+    u->sq_array   = (uint32_t *)(sq + params.sq_off.array);
+    u->sq_tail    = *u->sq_ktail;
+    u->cq_khead   = (uint32_t *)(cq + params.cq_off.head);
+    u->cq_ktail   = (uint32_t *)(cq + params.cq_off.tail);
+    u->cq_mask    = *(uint32_t *)(cq + params.cq_off.ring_mask);
+    u->cqes       = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+__attribute_cold__
+int fdevent_linux_io_uring_init(fdevents *ev) {
+    struct fdevent_io_uring *u;
+
+    ev->type      = FDEVENT_HANDLER_LINUX_IO_URING;
+    ev->event_set = fdevent_linux_io_uring_event_set;
+    ev->event_del = fdevent_linux_io_uring_event_del;
+    ev->poll      = fdevent_linux_io_uring_poll;
+    ev->free      = fdevent_linux_io_uring_free;
+
+    u = ev->io_uring = calloc(1, sizeof(*u));
+    force_assert(NULL != u);
+    u->ring_fd = -1;
+    u->gen = calloc(ev->maxfds, sizeof(*u->gen));
+    force_assert(NULL != u->gen);
+    u->armed = calloc(ev->maxfds, sizeof(*u->armed));
+    force_assert(NULL != u->armed);
+
+    if (0 != fdevent_io_uring_setup(ev, u)) {
+        fdevent_linux_io_uring_free(ev);
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
@@ -40,11 +40,10 @@
 
 #include "status_counter.h"
 
-__attribute_noinline__
+static int *gw_stat_active_requests; /* "gw.active-requests" */
+
+__attribute_cold__
 static int * gw_status_get_counter(gw_host *host, gw_proc *proc, const char *tag, size_t tlen) {
-    /*(At the cost of some memory, could prepare strings for host and for proc
-     * so that here we would copy ready made string for proc (or if NULL,
-     * for host), and then append tag to produce key)*/
     char label[288];
     size_t llen = sizeof("gw.backend.")-1, len;
     memcpy(label, "gw.backend.", llen);
@@ -66,41 +65,54 @@ static int * gw_status_get_counter(gw_host *host, gw_proc *proc, const char *tag
     llen += tlen;
     label[llen] = '\0';
 
-    return status_counter_get_counter(label, llen);
+    return status_counter_register(label, llen);
 }
 
-static void gw_proc_tag_inc(gw_host *host, gw_proc *proc, const char *tag, size_t len) {
-    ++(*gw_status_get_counter(host, proc, tag, len));
+static void gw_proc_tag_inc(gw_proc *proc, int stat) {
+    ++(*proc->stats[stat]);
 }
 
-static void gw_proc_load_inc(gw_host *host, gw_proc *proc) {
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".load")) = ++proc->load;
+static void gw_proc_load_inc(gw_proc *proc) {
+    *proc->stats[GW_STAT_LOAD] = ++proc->load;
 
-    status_counter_inc(CONST_STR_LEN("gw.active-requests"));
+    ++(*gw_stat_active_requests);
 }
 
-static void gw_proc_load_dec(gw_host *host, gw_proc *proc) {
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".load")) = --proc->load;
+static void gw_proc_load_dec(gw_proc *proc) {
+    *proc->stats[GW_STAT_LOAD] = --proc->load;
 
-    status_counter_dec(CONST_STR_LEN("gw.active-requests"));
+    --(*gw_stat_active_requests);
 }
 
 static void gw_host_assign(gw_host *host) {
-    *gw_status_get_counter(host, NULL, CONST_STR_LEN(".load")) = ++host->load;
+    *host->stat_load = ++host->load;
 }
 
 static void gw_host_reset(gw_host *host) {
-    *gw_status_get_counter(host, NULL, CONST_STR_LEN(".load")) = --host->load;
+    *host->stat_load = --host->load;
 }
 
+__attribute_cold__
 static int gw_status_init(gw_host *host, gw_proc *proc) {
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".disabled")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".died")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".overloaded")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".connected")) = 0;
-    *gw_status_get_counter(host, proc, CONST_STR_LEN(".load")) = 0;
+    /* resolve status counters once; updated through pointers thereafter */
+    static const struct { const char *tag; uint32_t tlen; } tags[] = {
+      { CONST_STR_LEN(".disabled") }
+     ,{ CONST_STR_LEN(".died") }
+     ,{ CONST_STR_LEN(".overloaded") }
+     ,{ CONST_STR_LEN(".connected") }
+     ,{ CONST_STR_LEN(".load") }
+     ,{ CONST_STR_LEN(".pool-hit") }
+     ,{ CONST_STR_LEN(".pool-miss") }
+     ,{ CONST_STR_LEN(".pool-idle") }
+    };
+    for (int i = 0; i < GW_STAT_MAX; ++i)
+        *(proc->stats[i] =
+          gw_status_get_counter(host, proc, tags[i].tag, tags[i].tlen)) = 0;
 
-    *gw_status_get_counter(host, NULL, CONST_STR_LEN(".load")) = 0;
+    *(host->stat_load = gw_status_get_counter(host, NULL, CONST_STR_LEN(".load"))) = 0;
+
+    gw_stat_active_requests =
+      status_counter_register(CONST_STR_LEN("gw.active-requests"));
 
     return 0;
 }
@@ -108,10 +120,80 @@ static int gw_status_init(gw_host *host, gw_proc *proc) {
 
 
 
+static void gw_conn_unlink(gw_conn * const gwc) {
+    gw_proc * const proc = gwc->proc;
+    if (gwc->prev)
+        gwc->prev->next = gwc->next;
+    else
+        proc->idle_conns = gwc->next;
+    if (gwc->next)
+        gwc->next->prev = gwc->prev;
+    --proc->num_idle;
+    *proc->stats[GW_STAT_POOL_IDLE] = (int)proc->num_idle;
+}
+
+static void gw_conn_close(gw_conn * const gwc) {
+    gw_conn_unlink(gwc);
+    fdevent_fdnode_event_del(gwc->ev, gwc->fdn);
+    fdevent_sched_close(gwc->ev, gwc->fd, 1);
+    free(gwc);
+}
+
+static handler_t gw_conn_idle_fdevent(void *ctx, int revents) {
+    /* no data is expected from backend on an idle connection;
+     * backend closed connection (or sent unexpected data) */
+    UNUSED(revents);
+    gw_conn_close((gw_conn *)ctx);
+    return HANDLER_FINISHED;
+}
+
+static int gw_conn_idle_put(gw_host * const host, gw_proc * const proc, struct fdevents * const ev, fdnode * const fdn) {
+    if (proc->num_idle >= host->keepalive_max_idle) return 0;
+    if (proc->state != PROC_STATE_RUNNING) return 0;
+
+    gw_conn * const gwc = malloc(sizeof(*gwc));
+    force_assert(gwc);
+    gwc->prev = NULL;
+    gwc->next = proc->idle_conns;
+    if (gwc->next) gwc->next->prev = gwc;
+    proc->idle_conns = gwc;
+    gwc->proc = proc;
+    gwc->host = host;
+    gwc->ev = ev;
+    gwc->fdn = fdn;
+    gwc->fd = fdn->fd;
+    gwc->idle_ts = log_epoch_secs;
+
+    /* (fd remains registered with fdevent; replace handler and ctx) */
+    fdn->handler = gw_conn_idle_fdevent;
+    fdn->ctx = gwc;
+    fdevent_fdnode_event_set(ev, fdn, FDEVENT_IN | FDEVENT_RDHUP);
+
+    ++proc->num_idle;
+    *proc->stats[GW_STAT_POOL_IDLE] = (int)proc->num_idle;
+    return 1;
+}
+
+static void gw_conn_idle_expire(gw_host * const host, gw_proc * const proc) {
+    const time_t idle_ts = log_epoch_secs - host->keepalive_idle_timeout;
+    for (gw_conn *gwc = proc->idle_conns, *next; gwc; gwc = next) {
+        next = gwc->next;
+        if (gwc->idle_ts <= idle_ts) gw_conn_close(gwc);
+    }
+}
+
+static void gw_conn_idle_close_all(gw_proc * const proc) {
+    while (proc->idle_conns) gw_conn_close(proc->idle_conns);
+}
+
+
+
+
 static void gw_proc_set_state(gw_host *host, gw_proc *proc, int state) {
     if ((int)proc->state == state) return;
     if (proc->state == PROC_STATE_RUNNING) {
         --host->active_procs;
+        if (proc->idle_conns) gw_conn_idle_close_all(proc);
     } else if (state == PROC_STATE_RUNNING) {
         ++host->active_procs;
     }
@@ -138,6 +220,14 @@ static void gw_proc_free(gw_proc *f) {
 
     gw_proc_free(f->next);
 
+    for (gw_conn *gwc = f->idle_conns, *next; gwc; gwc = next) {
+        next = gwc->next;
+        fdevent_fdnode_event_del(gwc->ev, gwc->fdn);
+        fdevent_unregister(gwc->ev, gwc->fd);
+        close(gwc->fd);
+        free(gwc);
+    }
+
     buffer_free(f->unixsocket);
     buffer_free(f->connection_name);
     free(f->saddr);
@@ -218,8 +308,8 @@ static int gw_extension_insert(gw_exts *ext, const buffer *key, gw_host *fh) {
     return 0;
 }
 
-static void gw_proc_connect_success(gw_host *host, gw_proc *proc, int debug, request_st * const r) {
-    gw_proc_tag_inc(host, proc, CONST_STR_LEN(".connected"));
+static void gw_proc_connect_success(gw_proc *proc, int debug, request_st * const r) {
+    gw_proc_tag_inc(proc, GW_STAT_CONNECTED);
     proc->last_used = log_epoch_secs;
 
     if (debug) {
@@ -287,15 +377,15 @@ static void gw_proc_connect_error(request_st * const r, gw_host *host, gw_proc *
     }
 
     if (EAGAIN == errnum) {
-        gw_proc_tag_inc(host, proc, CONST_STR_LEN(".overloaded"));
+        gw_proc_tag_inc(proc, GW_STAT_OVERLOADED);
     }
     else {
-        gw_proc_tag_inc(host, proc, CONST_STR_LEN(".died"));
+        gw_proc_tag_inc(proc, GW_STAT_DIED);
     }
 }
 
-static void gw_proc_release(gw_host *host, gw_proc *proc, int debug, log_error_st *errh) {
-    gw_proc_load_dec(host, proc);
+static void gw_proc_release(gw_proc *proc, int debug, log_error_st *errh) {
+    gw_proc_load_dec(proc);
 
     if (debug) {
         log_error(errh, __FILE__, __LINE__,
@@ -644,6 +734,7 @@ static void gw_proc_spawn(gw_host * const host, log_error_st * const errh, const
     } else {
         proc = gw_proc_init();
         proc->id = host->max_id++;
+        gw_status_init(host, proc);
     }
 
     ++host->num_procs;
@@ -1280,6 +1371,12 @@ int gw_set_defaults_backend(server *srv, gw_plugin_data *p, const array *a, gw_p
      ,{ CONST_STR_LEN("tcp-fin-propagate"),
         T_CONFIG_BOOL,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("keepalive-max-idle"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("keepalive-idle-timeout"),
+        T_CONFIG_SHORT,
+        T_CONFIG_SCOPE_CONNECTION }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -1350,6 +1447,8 @@ int gw_set_defaults_backend(server *srv, gw_plugin_data *p, const array *a, gw_p
             host->listen_backlog = 1024;
             host->xsendfile_allow = 0;
             host->refcount = 0;
+            host->keepalive_max_idle = 0;
+            host->keepalive_idle_timeout = 5;
 
             config_plugin_value_t *cpv = cvlist;
             for (; -1 != cpv->k_id; ++cpv) {
@@ -1453,6 +1552,12 @@ int gw_set_defaults_backend(server *srv, gw_plugin_data *p, const array *a, gw_p
                   case 22:/* tcp-fin-propagate */
                     host->tcp_fin_propagate = (0 != cpv->v.u);
                     break;
+                  case 23:/* keepalive-max-idle */
+                    host->keepalive_max_idle = cpv->v.shrt;
+                    break;
+                  case 24:/* keepalive-idle-timeout */
+                    host->keepalive_idle_timeout = cpv->v.shrt;
+                    break;
                   default:
                     break;
                 }
@@ -1751,16 +1856,30 @@ void gw_set_transparent(gw_handler_ctx *hctx) {
 
 static void gw_backend_close(gw_handler_ctx * const hctx, request_st * const r) {
     if (hctx->fd >= 0) {
-        fdevent_fdnode_event_del(hctx->ev, hctx->fdn);
-        /*fdevent_unregister(ev, hctx->fd);*//*(handled below)*/
-        fdevent_sched_close(hctx->ev, hctx->fd, 1);
+        /* return connection to idle pool if complete response received
+         * (and complete request sent, and write side not shut down for
+         *  tcp-fin-propagate) and backend permits connection reuse */
+        if (hctx->opts.keepalive
+            && hctx->opts.framing == HTTP_RESPONSE_FRAMING_DONE
+            && hctx->wb->bytes_out == hctx->wb_reqlen
+            && !(r->conf.stream_request_body
+                 & FDEVENT_STREAM_REQUEST_BACKEND_SHUT_WR)
+            && NULL != hctx->proc
+            && gw_conn_idle_put(hctx->host, hctx->proc, hctx->ev, hctx->fdn)) {
+            hctx->opts.keepalive = 0;
+        }
+        else {
+            fdevent_fdnode_event_del(hctx->ev, hctx->fdn);
+            /*fdevent_unregister(ev, hctx->fd);*//*(handled below)*/
+            fdevent_sched_close(hctx->ev, hctx->fd, 1);
+        }
         hctx->fdn = NULL;
         hctx->fd = -1;
     }
 
     if (hctx->host) {
         if (hctx->proc) {
-            gw_proc_release(hctx->host, hctx->proc, hctx->conf.debug,
+            gw_proc_release(hctx->proc, hctx->conf.debug,
                             r->conf.errh);
             hctx->proc = NULL;
         }
@@ -1797,6 +1916,70 @@ static handler_t gw_reconnect(gw_handler_ctx * const hctx, request_st * const r)
 }
 
 
+static int gw_conn_idle_reuse(gw_handler_ctx * const hctx, request_st * const r) {
+    /* reuse idle connection to backend, if available
+     * (not if request has a body, since the request body is not preserved
+     *  for a retry if backend closes the idle connection in the interim) */
+    gw_proc * const proc = hctx->proc;
+    gw_conn * const gwc = proc->idle_conns;
+    if (NULL == gwc || 0 != r->reqbody_length) {
+        gw_proc_tag_inc(proc, GW_STAT_POOL_MISS);
+        return 0;
+    }
+
+    gw_conn_unlink(gwc);
+    hctx->fd  = gwc->fd;
+    hctx->fdn = gwc->fdn;
+    hctx->fdn->handler = gw_handle_fdevent;
+    hctx->fdn->ctx = hctx;
+    free(gwc);
+
+    hctx->conn_reused = 1;
+    if (proc->is_local) hctx->pid = proc->pid;
+    proc->last_used = log_epoch_secs;
+    gw_proc_tag_inc(proc, GW_STAT_POOL_HIT);
+    if (r->conf.high_precision_timestamps)
+        log_clock_gettime_realtime(&hctx->backend_hp);
+
+    if (hctx->conf.debug > 1) {
+        log_error(r->conf.errh, __FILE__, __LINE__,
+          "reusing idle connection: %d %s",
+          hctx->fd, proc->connection_name->ptr);
+    }
+
+    return 1;
+}
+
+int gw_conn_reused_retry(const gw_handler_ctx * const hctx, const request_st * const r) {
+    /* backend closed connection taken from idle pool before responding
+     * and request may be retried on another connection */
+    return hctx->conn_reused
+        && hctx->opts.framing != HTTP_RESPONSE_FRAMING_DONE
+        && !r->resp_body_started
+        && 0 == r->http_status
+        && hctx->reconnects < 5;
+}
+
+static int gw_conn_reused_stale(gw_handler_ctx * const hctx, request_st * const r) {
+    return gw_conn_reused_retry(hctx, r) ? (++hctx->reconnects, 1) : 0;
+}
+
+static handler_t gw_reconnect_stale(gw_handler_ctx * const hctx, request_st * const r) {
+    /* retry request on another connection
+     * (request has no body; see gw_conn_idle_reuse()) */
+    if (hctx->conf.debug) {
+        log_error(r->conf.errh, __FILE__, __LINE__,
+          "idle connection closed by backend; retrying request: %s",
+          hctx->proc->connection_name->ptr);
+    }
+    chunkqueue_reset(hctx->wb);
+    hctx->wb_reqlen = 0;
+    if (hctx->response) buffer_clear(hctx->response);
+    hctx->conn_reused = 0;
+    return gw_reconnect(hctx, r);
+}
+
+
 handler_t gw_connection_reset(request_st * const r, void *p_d) {
     gw_plugin_data *p = p_d;
     gw_handler_ctx *hctx = r->plugin_ctx[p->id];
@@ -1809,6 +1992,7 @@ handler_t gw_connection_reset(request_st * const r, void *p_d) {
 static void gw_conditional_tcp_fin(gw_handler_ctx * const hctx, request_st * const r) {
     /*assert(r->conf.stream_request_body & FDEVENT_STREAM_REQUEST_TCP_FIN);*/
     if (!chunkqueue_is_empty(hctx->wb)) return;
+    if (0 == hctx->wb->bytes_in) return; /*(connect in progress; no request)*/
     if (!hctx->host->tcp_fin_propagate) return;
     if (hctx->gw_mode == GW_AUTHORIZER) return;
     if (r->conf.stream_request_body & FDEVENT_STREAM_REQUEST_BACKEND_SHUT_WR)
@@ -1846,7 +2030,13 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
             if (proc->load < hctx->proc->load) hctx->proc = proc;
         }
 
-        gw_proc_load_inc(hctx->host, hctx->proc);
+        gw_proc_load_inc(hctx->proc);
+
+        hctx->conn_reused = 0;
+        if (hctx->host->keepalive_max_idle && gw_conn_idle_reuse(hctx, r)) {
+            gw_set_state(hctx, GW_STATE_PREPARE_WRITE);
+            return gw_write_request(hctx, r);
+        }
 
         hctx->fd = fdevent_socket_nb_cloexec(hctx->host->family,SOCK_STREAM,0);
         if (-1 == hctx->fd) {
@@ -1870,6 +2060,9 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
             hctx->pid = hctx->proc->pid;
         }
 
+        if (r->conf.high_precision_timestamps)
+            log_clock_gettime_realtime(&hctx->backend_hp);
+
         switch (gw_establish_connection(r, hctx->host, hctx->proc, hctx->pid,
                                         hctx->fd, hctx->conf.debug)) {
         case 1: /* connection is in progress */
@@ -1894,7 +2087,11 @@ static handler_t gw_write_request(gw_handler_ctx * const hctx, request_st * cons
             /* go on with preparing the request */
         }
 
-        gw_proc_connect_success(hctx->host, hctx->proc, hctx->conf.debug, r);
+        gw_proc_connect_success(hctx->proc, hctx->conf.debug, r);
+        if (r->conf.high_precision_timestamps)
+            r->backend_usec +=
+              status_histogram_add_since(STATUS_HIST_BACKEND_CONNECT,
+                                         &hctx->backend_hp, &hctx->backend_hp);
 
         gw_set_state(hctx, GW_STATE_PREPARE_WRITE);
         /* fall through */
@@ -1997,6 +2194,8 @@ __attribute_cold__
 static handler_t gw_write_error(gw_handler_ctx * const hctx, request_st * const r) {
     int status = r->http_status;
 
+    if (gw_conn_reused_stale(hctx, r)) return gw_reconnect_stale(hctx, r);
+
     if (hctx->state == GW_STATE_INIT ||
         hctx->state == GW_STATE_CONNECT_DELAYED) {
 
@@ -2132,6 +2331,13 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
     default:
         return HANDLER_GO_ON;
     case HANDLER_FINISHED:
+        if (gw_conn_reused_stale(hctx, r)) return gw_reconnect_stale(hctx, r);
+        if (r->conf.high_precision_timestamps) {
+            struct timespec ts;
+            r->backend_usec +=
+              status_histogram_add_since(STATUS_HIST_BACKEND_RESPONSE,
+                                         &hctx->backend_hp, &ts);
+        }
         if (hctx->gw_mode == GW_AUTHORIZER
             && (200 == r->http_status || 0 == r->http_status)) {
             /*
@@ -2206,6 +2412,8 @@ static handler_t gw_recv_response(gw_handler_ctx * const hctx, request_st * cons
             }
         }
 
+        if (gw_conn_reused_stale(hctx, r)) return gw_reconnect_stale(hctx, r);
+
         if (r->resp_body_started == 0) {
             /* nothing has been sent out yet, try to use another child */
 
@@ -2285,6 +2493,8 @@ static handler_t gw_handle_fdevent(void *ctx, int revents) {
             } while (rc == HANDLER_GO_ON);       /*(unless HANDLER_GO_ON)*/
             r->conf.stream_response_body = flags;
             return rc; /* HANDLER_FINISHED or HANDLER_ERROR */
+        } else if (gw_conn_reused_stale(hctx, r)) {
+            gw_reconnect_stale(hctx, r);
         } else {
             gw_proc *proc = hctx->proc;
             log_error(r->conf.errh, __FILE__, __LINE__,
@@ -2544,6 +2754,7 @@ static void gw_handle_trigger_host(gw_host * const host, log_error_st * const er
 
     for (proc = host->first; proc; proc = proc->next) {
         gw_proc_waitpid(host, proc, errh);
+        if (proc->idle_conns) gw_conn_idle_expire(host, proc);
     }
 
     gw_restart_dead_procs(host, errh, debug, 1);
@@ -2611,6 +2822,7 @@ static void gw_handle_trigger_exts_wkr(gw_exts *exts, log_error_st *errh) {
             for (gw_proc *proc = host->first; proc; proc = proc->next) {
                 if (proc->state == PROC_STATE_OVERLOADED)
                     gw_proc_check_enable(host, proc, errh);
+                if (proc->idle_conns) gw_conn_idle_expire(host, proc);
             }
         }
     }
@@ -4,6 +4,7 @@
 #include "first.h"
 
 #include <sys/types.h>
+#include <time.h>       /* (struct timespec) */
 #include "sys-socket.h"
 
 #include "array.h"
@@ -16,6 +17,32 @@ typedef struct {
     uint32_t used;
 } char_array;
 
+struct fdevents;        /* declaration */
+struct gw_host;         /* declaration */
+
+typedef struct gw_conn {
+    struct gw_conn *prev, *next;
+    struct gw_proc *proc;
+    struct gw_host *host;
+    struct fdevents *ev;
+    struct fdnode_st *fdn;
+    int fd;
+    time_t idle_ts; /* time connection was returned to idle pool */
+} gw_conn;
+
+/* per-proc status counters (plugin_stats), resolved in gw_status_init() */
+enum {
+    GW_STAT_DISABLED,
+    GW_STAT_DIED,
+    GW_STAT_OVERLOADED,
+    GW_STAT_CONNECTED,
+    GW_STAT_LOAD,
+    GW_STAT_POOL_HIT,
+    GW_STAT_POOL_MISS,
+    GW_STAT_POOL_IDLE,
+    GW_STAT_MAX
+};
+
 typedef struct gw_proc {
     uint32_t id; /* id will be between 1 and max_procs */
     unsigned short port;  /* config.port + pno */
@@ -35,6 +62,9 @@ typedef struct gw_proc {
     time_t last_used; /* see idle_timeout */
     time_t disabled_until; /* proc disabled until given time */
 
+    gw_conn *idle_conns; /* idle (keep-alive) connections; most recent first */
+    uint32_t num_idle;
+
     int is_local;
 
     enum {
@@ -44,9 +74,11 @@ typedef struct gw_proc {
         PROC_STATE_DIED,       /* marked as dead, should be restarted */
         PROC_STATE_KILLED      /* killed (signal sent to proc) */
     } state;
+
+    int *stats[GW_STAT_MAX]; /* "gw.backend.<id>.<n>.<tag>" status counters */
 } gw_proc;
 
-typedef struct {
+typedef struct gw_host {
     /* the key that is used to reference this value */
     const buffer *id;
 
@@ -95,6 +127,16 @@ typedef struct {
 
     unsigned short disable_time;
 
+    /*
+     * keep up to keepalive_max_idle idle connections to each proc open for
+     * reuse by later requests (if supported by the backend protocol module)
+     * and close idle connections after keepalive_idle_timeout seconds
+     *
+     */
+
+    unsigned short keepalive_max_idle;
+    unsigned short keepalive_idle_timeout;
+
     /*
      * some gw processes get a little bit larger
      * than wanted. max_requests_per_proc kills a
@@ -196,6 +238,7 @@ typedef struct {
     const array *xsendfile_docroot;
 
     int32_t load;
+    int *stat_load; /* "gw.backend.<id>.load" status counter */
 
     uint32_t max_id; /* corresponds most of the time to num_procs */
 
@@ -285,8 +328,6 @@ typedef enum {
     GW_STATE_READ
 } gw_connection_state_t;
 
-struct fdevents;        /* declaration */
-
 #define GW_RESPONDER  1
 #define GW_AUTHORIZER 2
 #define GW_FILTER     3  /*(not implemented)*/
@@ -300,6 +341,8 @@ typedef struct gw_handler_ctx {
 
     gw_connection_state_t state;
     time_t   state_timestamp;
+    struct timespec backend_hp; /* connect start, then request start;
+                                 * (if r->conf.high_precision_timestamps) */
 
     chunkqueue *rb; /* read queue */
     chunkqueue *wb; /* write queue */
@@ -313,6 +356,7 @@ typedef struct gw_handler_ctx {
 
     pid_t     pid;
     int       reconnects; /* number of reconnect attempts */
+    int       conn_reused; /* fd taken from proc idle connection pool */
 
     int       request_id;
     int       send_content_body;
@@ -355,4 +399,7 @@ handler_t gw_handle_waitpid_cb(server *srv, void *p_d, pid_t pid, int status);
 
 void gw_set_transparent(gw_handler_ctx *hctx);
 
+__attribute_pure__
+int gw_conn_reused_retry(const gw_handler_ctx *hctx, const request_st *r);
+
 #endif
@@ -0,0 +1,1005 @@
+/*
+ * h2 - HTTP/2 protocol layer (RFC 7540)
+ *
+ * License: BSD 3-clause (same as lighttpd)
+ */
+#include "first.h"
+
+#include "h2.h"
+#include "base.h"
+#include "base64.h"
+#include "buffer.h"
+#include "chunk.h"
+#include "connections.h"
+#include "fdevent.h"    /* FDEVENT_STREAM_REQUEST_POLLIN */
+#include "http_header.h"
+#include "log.h"
+#include "plugin_config.h" /* COMP_* */
+#include "request.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* frame size limits; lighttpd does not advertise SETTINGS_MAX_FRAME_SIZE,
+ * so peer frames are limited to the protocol default */
+#define H2_FRAME_SIZE_DEFAULT  16384
+#define H2_FRAME_SIZE_SEND_MAX 65536
+
+/* receive windows */
+#define H2_CON_RWIN    262144
+#define H2_STREAM_RWIN 65535
+
+static const char h2_client_preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+
+static uint32_t h2_u16 (const uint8_t * const s)
+{
+    return ((uint32_t)s[0] << 8) | s[1];
+}
+
+
+static uint32_t h2_u24 (const uint8_t * const s)
+{
+    return ((uint32_t)s[0] << 16) | ((uint32_t)s[1] << 8) | s[2];
+}
+
+
+static uint32_t h2_u32 (const uint8_t * const s)
+{
+    return ((uint32_t)s[0] << 24) | ((uint32_t)s[1] << 16)
+         | ((uint32_t)s[2] <<  8) | s[3];
+}
+
+
+static uint32_t h2_u31 (const uint8_t * const s)
+{
+    return h2_u32(s) & 0x7fffffffu;
+}
+
+
+static void h2_frame_hdr (uint8_t * const s, const uint32_t len, const uint8_t type, const uint8_t flags, const uint32_t sid)
+{
+    s[0] = (uint8_t)(len >> 16);
+    s[1] = (uint8_t)(len >> 8);
+    s[2] = (uint8_t)(len);
+    s[3] = type;
+    s[4] = flags;
+    s[5] = (uint8_t)((sid >> 24) & 0x7f);
+    s[6] = (uint8_t)(sid >> 16);
+    s[7] = (uint8_t)(sid >> 8);
+    s[8] = (uint8_t)(sid);
+}
+
+
+static void h2_set_u32 (uint8_t * const s, const uint32_t v)
+{
+    s[0] = (uint8_t)(v >> 24);
+    s[1] = (uint8_t)(v >> 16);
+    s[2] = (uint8_t)(v >> 8);
+    s[3] = (uint8_t)(v);
+}
+
+
+static request_st * h2_get_stream_req (const h2con * const h2c, const uint32_t sid)
+{
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        if (h2c->r[i]->h2id == sid) return h2c->r[i];
+    }
+    return NULL;
+}
+
+
+static void h2_apply_priority (h2con * const h2c, request_st * const r, const uint8_t * const s)
+{
+    /* stream dependency and weight (RFC 7540 5.3)
+     * (priority is tracked only for active streams; a dependency on an idle
+     *  or closed stream is treated as a dependency on the root stream) */
+    const uint32_t dep = h2_u31(s);
+    request_st * const d = h2_get_stream_req(h2c, dep);
+    if (NULL != d) {
+        /* dependency on a descendant: descendant is first moved to depend
+         * on the previous parent of r (RFC 7540 5.3.3) */
+        const request_st *a = d;
+        for (uint32_t n = 0; a && n < h2c->rused; ++n) {
+            if (a == r) {
+                d->h2_dep = r->h2_dep;
+                break;
+            }
+            a = h2_get_stream_req(h2c, a->h2_dep);
+        }
+    }
+    r->h2_dep = (NULL != d) ? dep : 0;
+    r->h2_weight = (uint32_t)s[4] + 1;
+    if (s[0] & 0x80) { /* exclusive */
+        for (uint32_t i = 0; i < h2c->rused; ++i) {
+            request_st * const x = h2c->r[i];
+            if (x != r && x->h2_dep == r->h2_dep)
+                x->h2_dep = r->h2id;
+        }
+    }
+    h2c->prio_order = 1;
+}
+
+
+static void h2_send_frame_u32 (connection * const con, const uint8_t type, const uint8_t flags, const uint32_t sid, const uint32_t v)
+{
+    uint8_t s[13];
+    h2_frame_hdr(s, 4, type, flags, sid);
+    h2_set_u32(s+9, v);
+    chunkqueue_append_mem(con->write_queue, (const char *)s, sizeof(s));
+}
+
+
+static void h2_send_window_update (connection * const con, const uint32_t sid, const uint32_t incr)
+{
+    h2_send_frame_u32(con, H2_FTYPE_WINDOW_UPDATE, 0, sid, incr);
+}
+
+
+__attribute_cold__
+static void h2_send_rst_stream_id (const uint32_t sid, connection * const con, const request_h2error_t e)
+{
+    h2_send_frame_u32(con, H2_FTYPE_RST_STREAM, 0, sid, (uint32_t)e);
+}
+
+
+__attribute_cold__
+static void h2_send_rst_stream (request_st * const r, connection * const con, const request_h2error_t e)
+{
+    r->h2state = H2_STATE_CLOSED;
+    h2_send_rst_stream_id(r->h2id, con, e);
+}
+
+
+__attribute_cold__
+static void h2_stream_error (request_st * const r, connection * const con, const request_h2error_t e)
+{
+    h2_send_rst_stream(r, con, e);
+    r->state = CON_STATE_ERROR;
+}
+
+
+void h2_send_goaway (connection * const con, const request_h2error_t e)
+{
+    h2con * const h2c = con->h2;
+    if (h2c->sent_goaway && (h2c->sent_goaway > 0 || e == H2_E_NO_ERROR))
+        return;
+    h2c->sent_goaway = (e == H2_E_NO_ERROR) ? -1 : (int32_t)e;
+
+    uint8_t s[17];
+    h2_frame_hdr(s, 8, H2_FTYPE_GOAWAY, 0, 0);
+    h2_set_u32(s+9, h2c->h2_cid);
+    h2_set_u32(s+13, (uint32_t)e);
+    chunkqueue_append_mem(con->write_queue, (const char *)s, sizeof(s));
+}
+
+
+__attribute_cold__
+static int h2_send_goaway_e (connection * const con, const request_h2error_t e)
+{
+    h2_send_goaway(con, e);
+    return -1;
+}
+
+
+static void h2_end_stream_local (request_st * const r)
+{
+    r->h2state = (r->h2state == H2_STATE_HALF_CLOSED_REMOTE)
+      ? H2_STATE_CLOSED
+      : H2_STATE_HALF_CLOSED_LOCAL;
+}
+
+
+static void h2_recv_end_stream (request_st * const r, connection * const con)
+{
+    r->h2state = (r->h2state == H2_STATE_OPEN)
+      ? H2_STATE_HALF_CLOSED_REMOTE
+      : H2_STATE_CLOSED;
+
+    if (r->state == CON_STATE_ERROR || 0 == r->reqbody_length) return;
+    if (-1 == r->reqbody_length) /*(length unknown until END_STREAM)*/
+        r->reqbody_length = r->read_queue->bytes_in;
+    else if (r->reqbody_length != r->read_queue->bytes_in)
+        h2_stream_error(r, con, H2_E_PROTOCOL_ERROR);/*Content-Length mismatch*/
+}
+
+
+static int h2_parse_settings (connection * const con, const uint8_t *s, uint32_t len)
+{
+    /* caller must check (0 == len % 6) */
+    h2con * const h2c = con->h2;
+    for (; len >= 6; s += 6, len -= 6) {
+        const uint32_t v = h2_u32(s+2);
+        switch (h2_u16(s)) {
+          case H2_SETTINGS_HEADER_TABLE_SIZE:
+            /*(response headers are not added to HPACK dynamic table)*/
+            h2c->s_header_table_size = v;
+            break;
+          case H2_SETTINGS_ENABLE_PUSH:
+            if (v > 1)
+                return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+            h2c->s_enable_push = v;
+            break;
+          case H2_SETTINGS_MAX_CONCURRENT_STREAMS:
+            h2c->s_max_concurrent_streams = v;
+            break;
+          case H2_SETTINGS_INITIAL_WINDOW_SIZE:
+            if (v > INT32_MAX)
+                return h2_send_goaway_e(con, H2_E_FLOW_CONTROL_ERROR);
+            else {
+                /* adjust send window of all active streams (RFC 7540 6.9.2)*/
+                const int64_t diff = (int64_t)v - h2c->s_initial_window_size;
+                for (uint32_t i = 0; i < h2c->rused; ++i) {
+                    request_st * const r = h2c->r[i];
+                    if (r->h2_swin + diff > INT32_MAX)
+                        return h2_send_goaway_e(con, H2_E_FLOW_CONTROL_ERROR);
+                    r->h2_swin += (int32_t)diff;
+                }
+                h2c->s_initial_window_size = (int32_t)v;
+            }
+            break;
+          case H2_SETTINGS_MAX_FRAME_SIZE:
+            if (v < 16384 || v > 16777215)
+                return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+            h2c->s_max_frame_size = v;
+            break;
+          case H2_SETTINGS_MAX_HEADER_LIST_SIZE:
+            h2c->s_max_header_list_size = v;
+            break;
+          default: /* ignore unknown or unsupported settings */
+            break;
+        }
+    }
+    return 0;
+}
+
+
+static int h2_recv_settings (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    if (0 != h2_u31(s+5))
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+    if (s[4] & H2_FLAG_ACK)
+        return (0 == flen) ? 0 : h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+    if (0 != flen % 6)
+        return h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+
+    if (0 != h2_parse_settings(con, s+9, flen))
+        return -1;
+
+    uint8_t ack[9];
+    h2_frame_hdr(ack, 0, H2_FTYPE_SETTINGS, H2_FLAG_ACK, 0);
+    chunkqueue_append_mem(con->write_queue, (const char *)ack, sizeof(ack));
+    return 0;
+}
+
+
+__attribute_cold__
+static void h2_log_request_header (request_st * const r, const h2con * const h2c)
+{
+    buffer * const tb = r->tmp_buf;
+    buffer_clear(tb);
+    const char * const b = h2c->dbuf.ptr;
+    for (uint32_t i = 0; i < h2c->fields.used; ++i) {
+        const hpack_field * const f = h2c->fields.ptr+i;
+        buffer_append_string_len(tb, b+f->k, f->klen);
+        buffer_append_string_len(tb, CONST_STR_LEN(": "));
+        buffer_append_string_len(tb, b+f->v, f->vlen);
+        buffer_append_string_len(tb, CONST_STR_LEN("\n"));
+    }
+    log_error(r->conf.errh, __FILE__, __LINE__,
+              "fd:%d id:%u request-header:\n%.*s",
+              r->con->fd, r->h2id, BUFFER_INTLEN_PTR(tb));
+}
+
+
+static int h2_recv_header_block (connection * const con, const uint32_t sid, const uint8_t flags, const uint8_t * const prio, const uint8_t * const hb, const uint32_t hblen)
+{
+    h2con * const h2c = con->h2;
+    request_st * const h2r = &con->request;
+
+    /* always decode header block to keep HPACK dynamic table in sync */
+    const int rc = hpack_decode(&h2c->decoder, hb, hblen, &h2c->dbuf,
+                                &h2c->fields,
+                                h2r->conf.max_request_field_size);
+    if (rc < 0)
+        return h2_send_goaway_e(con, H2_E_COMPRESSION_ERROR);
+
+    request_st *r = h2_get_stream_req(h2c, sid);
+    if (NULL != r) {
+        if (prio) h2_apply_priority(h2c, r, prio);
+        /* trailers (ignored) */
+        if (r->h2state != H2_STATE_OPEN
+            && r->h2state != H2_STATE_HALF_CLOSED_LOCAL)
+            h2_stream_error(r, con, H2_E_STREAM_CLOSED);
+        else if (!(flags & H2_FLAG_END_STREAM))
+            h2_stream_error(r, con, H2_E_PROTOCOL_ERROR);
+        else
+            h2_recv_end_stream(r, con);
+        return 0;
+    }
+
+    if (sid <= h2c->h2_cid) /* stream already closed (RFC 7540 5.1.1) */
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+    h2c->h2_cid = sid;
+
+    if (h2c->sent_goaway)
+        return 0; /* ignore new streams after GOAWAY (RFC 7540 6.8) */
+
+    if (h2c->rused == h2c->rmax) {
+        h2_send_rst_stream_id(sid, con, H2_E_REFUSED_STREAM);
+        return 0;
+    }
+
+    r = request_acquire(con);
+    h2c->r[h2c->rused++] = r;
+    r->h2id = sid;
+    r->h2state = (flags & H2_FLAG_END_STREAM)
+      ? H2_STATE_HALF_CLOSED_REMOTE
+      : H2_STATE_OPEN;
+    r->h2_rwin = H2_STREAM_RWIN;
+    r->h2_swin = h2c->s_initial_window_size;
+    r->h2_weight = 16; /* default (RFC 7540 5.3.5) */
+    if (prio) h2_apply_priority(h2c, r, prio);
+    r->http_version = HTTP_VERSION_2;
+    r->rqst_header_len = hblen;
+
+    r->start_ts = log_epoch_secs;
+    if (r->conf.high_precision_timestamps)
+        log_clock_gettime_realtime(&r->start_hp);
+    ++con->request_count;
+
+    if (r->conf.log_request_header)
+        h2_log_request_header(r, h2c);
+
+    if (0 == rc)
+        r->http_status =
+          http_request_parse_h2(r, h2c->dbuf.ptr, h2c->fields.ptr,
+                                h2c->fields.used, con->proto_default_port);
+    else {
+        log_error(r->conf.errh, __FILE__, __LINE__, "%s",
+                  "oversized request-header -> sending Status 431");
+        r->http_status = 431; /* Request Header Fields Too Large */
+    }
+
+    if (0 == r->http_status) {
+        r->conditional_is_valid = (1 << COMP_SERVER_SOCKET)
+                                | (1 << COMP_HTTP_SCHEME)
+                                | (1 << COMP_HTTP_HOST)
+                                | (1 << COMP_HTTP_REMOTE_IP)
+                                | (1 << COMP_HTTP_REQUEST_METHOD)
+                                | (1 << COMP_HTTP_URL)
+                                | (1 << COMP_HTTP_QUERY_STRING)
+                                | (1 << COMP_HTTP_REQUEST_HEADER);
+        if (!(flags & H2_FLAG_END_STREAM)) {
+            /* request body length, if not Content-Length, is determined
+             * by END_STREAM flag on final DATA frame */
+            if (0 == r->reqbody_length) r->reqbody_length = -1;
+        }
+        else if (r->reqbody_length > 0) {
+            log_error(r->conf.errh, __FILE__, __LINE__, "%s",
+                      "Content-Length with empty request body -> 400");
+            r->http_status = 400;
+            r->reqbody_length = 0;
+        }
+    }
+    else {
+        r->conditional_is_valid = (1 << COMP_SERVER_SOCKET)
+                                | (1 << COMP_HTTP_REMOTE_IP);
+        r->reqbody_length = 0;
+    }
+
+    r->state = CON_STATE_REQUEST_END;
+
+    if (con->request_count >= h2r->conf.max_keep_alive_requests)
+        h2_send_goaway(con, H2_E_NO_ERROR);
+
+    return 0;
+}
+
+
+static int h2_recv_headers (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t sid = h2_u31(s+5);
+    const uint8_t flags = s[4];
+    const uint8_t *p = s + 9;
+    uint32_t len = flen;
+
+    if (0 == sid || !(sid & 1)) /*(client-initiated streams are odd)*/
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+
+    if (flags & H2_FLAG_PADDED) {
+        if (0 == len || p[0] >= len)
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        len -= 1 + p[0];
+        ++p;
+    }
+    const uint8_t *prio = NULL;
+    if (flags & H2_FLAG_PRIORITY) {
+        /* stream dependency and weight */
+        if (len < 5)
+            return h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+        if (h2_u31(p) == sid) /* stream must not depend on itself */
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        prio = p;
+        p += 5;
+        len -= 5;
+    }
+
+    if (!(flags & H2_FLAG_END_HEADERS)) {
+        /* collect header block fragments from CONTINUATION frames */
+        h2c->hsid = sid;
+        h2c->hflags = flags;
+        if (prio) memcpy(h2c->hprio, prio, sizeof(h2c->hprio));
+        buffer_copy_string_len(&h2c->hbuf, (const char *)p, len);
+        return 0;
+    }
+
+    return h2_recv_header_block(con, sid, flags, prio, p, len);
+}
+
+
+static int h2_recv_continuation (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t sid = h2_u31(s+5);
+    if (0 == h2c->hsid || sid != h2c->hsid)
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+
+    buffer_append_string_len(&h2c->hbuf, (const char *)s+9, flen);
+    /* limit size of compressed header block (decoded size limited later) */
+    const uint32_t blen = buffer_string_length(&h2c->hbuf);
+    if (blen > con->request.conf.max_request_field_size + H2_FRAME_SIZE_DEFAULT)
+        return h2_send_goaway_e(con, H2_E_ENHANCE_YOUR_CALM);
+
+    if (!(s[4] & H2_FLAG_END_HEADERS)) return 0;
+
+    h2c->hsid = 0;
+    const int rc = h2_recv_header_block(con, sid, (uint8_t)h2c->hflags,
+                                        (h2c->hflags & H2_FLAG_PRIORITY)
+                                          ? h2c->hprio
+                                          : NULL,
+                                        (const uint8_t *)h2c->hbuf.ptr, blen);
+    buffer_clear(&h2c->hbuf);
+    return rc;
+}
+
+
+static int h2_recv_data (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t sid = h2_u31(s+5);
+    if (0 == sid || sid > h2c->h2_cid) /*(idle stream)*/
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+
+    /* connection flow control (padding is included in flow control) */
+    if ((int32_t)flen > h2c->rwin)
+        return h2_send_goaway_e(con, H2_E_FLOW_CONTROL_ERROR);
+    h2c->rwin -= (int32_t)flen;
+    if (h2c->rwin < H2_CON_RWIN/2) {
+        h2_send_window_update(con, 0, (uint32_t)(H2_CON_RWIN - h2c->rwin));
+        h2c->rwin = H2_CON_RWIN;
+    }
+
+    request_st * const r = h2_get_stream_req(h2c, sid);
+    if (NULL == r) return 0; /* stream closed; discard */
+
+    if (r->h2state != H2_STATE_OPEN && r->h2state != H2_STATE_HALF_CLOSED_LOCAL) {
+        if (r->h2state != H2_STATE_CLOSED)
+            h2_stream_error(r, con, H2_E_STREAM_CLOSED);
+        return 0;
+    }
+
+    const uint8_t *p = s + 9;
+    uint32_t len = flen;
+    if (s[4] & H2_FLAG_PADDED) {
+        if (0 == len || p[0] >= len)
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        len -= 1 + p[0];
+        ++p;
+    }
+
+    /* stream flow control */
+    if ((int32_t)flen > r->h2_rwin) {
+        h2_stream_error(r, con, H2_E_FLOW_CONTROL_ERROR);
+        return 0;
+    }
+    r->h2_rwin -= (int32_t)flen;
+
+    if (r->state == CON_STATE_ERROR || 0 == r->reqbody_length)
+        return 0; /* request body not expected or not wanted; discard */
+
+    if (r->reqbody_length > 0
+        && r->read_queue->bytes_in + (off_t)len > r->reqbody_length) {
+        h2_stream_error(r, con, H2_E_PROTOCOL_ERROR);/*exceeds Content-Length*/
+        return 0;
+    }
+
+    if (len) chunkqueue_append_mem(r->read_queue, (const char *)p, len);
+
+    if (s[4] & H2_FLAG_END_STREAM)
+        h2_recv_end_stream(r, con);
+
+    return 0;
+}
+
+
+static int h2_recv_window_update (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t sid = h2_u31(s+5);
+    if (4 != flen)
+        return h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+    const uint32_t incr = h2_u31(s+9);
+
+    if (0 == sid) {
+        if (0 == incr || (int64_t)h2c->swin + incr > INT32_MAX)
+            return h2_send_goaway_e(con, 0 == incr
+                                         ? H2_E_PROTOCOL_ERROR
+                                         : H2_E_FLOW_CONTROL_ERROR);
+        h2c->swin += (int32_t)incr;
+        return 0;
+    }
+
+    request_st * const r = h2_get_stream_req(h2c, sid);
+    if (NULL == r) {
+        if (sid > h2c->h2_cid) /*(idle stream)*/
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        return 0;
+    }
+    if (0 == incr)
+        h2_stream_error(r, con, H2_E_PROTOCOL_ERROR);
+    else if ((int64_t)r->h2_swin + incr > INT32_MAX)
+        h2_stream_error(r, con, H2_E_FLOW_CONTROL_ERROR);
+    else
+        r->h2_swin += (int32_t)incr;
+    return 0;
+}
+
+
+static int h2_recv_frame (connection * const con, const uint8_t * const s, const uint32_t flen)
+{
+    h2con * const h2c = con->h2;
+    const uint8_t type = s[3];
+    const uint32_t sid = h2_u31(s+5);
+
+    /* header block must be contiguous sequence of frames (RFC 7540 4.3) */
+    if (h2c->hsid && type != H2_FTYPE_CONTINUATION)
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+
+    /* client connection preface ends with SETTINGS frame (RFC 7540 3.5) */
+    if (!h2c->csettings) {
+        if (type != H2_FTYPE_SETTINGS || (s[4] & H2_FLAG_ACK))
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        h2c->csettings = 1;
+    }
+
+    switch (type) {
+      case H2_FTYPE_DATA:
+        return h2_recv_data(con, s, flen);
+      case H2_FTYPE_HEADERS:
+        return h2_recv_headers(con, s, flen);
+      case H2_FTYPE_PRIORITY:
+        if (0 == sid)
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        if (5 != flen)
+            h2_send_rst_stream_id(sid, con, H2_E_FRAME_SIZE_ERROR);
+        else {
+            request_st * const r = h2_get_stream_req(h2c, sid);
+            if (h2_u31(s+9) == sid) { /* stream must not depend on itself */
+                if (NULL != r)
+                    h2_stream_error(r, con, H2_E_PROTOCOL_ERROR);
+                else
+                    h2_send_rst_stream_id(sid, con, H2_E_PROTOCOL_ERROR);
+            }
+            else if (NULL != r)
+                h2_apply_priority(h2c, r, s+9);
+        }
+        return 0;
+      case H2_FTYPE_RST_STREAM:
+        if (0 == sid || sid > h2c->h2_cid)
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        if (4 != flen)
+            return h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+        else {
+            request_st * const r = h2_get_stream_req(h2c, sid);
+            if (NULL != r) {
+                r->h2state = H2_STATE_CLOSED;
+                r->state = CON_STATE_ERROR;
+            }
+        }
+        return 0;
+      case H2_FTYPE_SETTINGS:
+        return h2_recv_settings(con, s, flen);
+      case H2_FTYPE_PUSH_PROMISE: /* clients must not send PUSH_PROMISE */
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+      case H2_FTYPE_PING:
+        if (0 != sid)
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        if (8 != flen)
+            return h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+        if (!(s[4] & H2_FLAG_ACK)) {
+            uint8_t pong[17];
+            h2_frame_hdr(pong, 8, H2_FTYPE_PING, H2_FLAG_ACK, 0);
+            memcpy(pong+9, s+9, 8);
+            chunkqueue_append_mem(con->write_queue, (const char *)pong,
+                                  sizeof(pong));
+        }
+        return 0;
+      case H2_FTYPE_GOAWAY:
+        if (0 != sid)
+            return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+        if (flen < 8)
+            return h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+        /* (server push is not used; last-stream-id is not relevant) */
+        h2c->received_goaway = 1;
+        return 0;
+      case H2_FTYPE_WINDOW_UPDATE:
+        return h2_recv_window_update(con, s, flen);
+      case H2_FTYPE_CONTINUATION:
+        return h2_recv_continuation(con, s, flen);
+      default: /* ignore unknown frame types (RFC 7540 4.1) */
+        return 0;
+    }
+}
+
+
+static int h2_recv_client_preface (connection * const con, chunkqueue * const cq)
+{
+    h2con * const h2c = con->h2;
+    const uint32_t n = h2c->preface;
+    if (chunkqueue_length(cq) < (off_t)n) return 0;
+    chunk *c = cq->first;
+    if (buffer_string_length(c->mem) - c->offset < n) {
+        chunkqueue_compact_mem(cq, n);
+        c = cq->first;
+    }
+    if (0 != memcmp(c->mem->ptr + c->offset,
+                    h2_client_preface + sizeof(h2_client_preface)-1 - n, n))
+        return h2_send_goaway_e(con, H2_E_PROTOCOL_ERROR);
+    chunkqueue_mark_written(cq, n);
+    h2c->preface = 0;
+    return 1;
+}
+
+
+int h2_parse_frames (connection * const con)
+{
+    /* process complete frames in con->read_queue
+     * returns 0 on success, or -1 on connection error (GOAWAY queued) */
+    h2con * const h2c = con->h2;
+    chunkqueue * const cq = con->read_queue;
+
+    if (h2c->preface) {
+        const int rc = h2_recv_client_preface(con, cq);
+        if (rc <= 0) return rc;
+    }
+
+    for (off_t cqlen; (cqlen = chunkqueue_length(cq)) >= 9; ) {
+        chunk *c = cq->first;
+        uint32_t clen = buffer_string_length(c->mem) - c->offset;
+        if (clen < 9) {
+            chunkqueue_compact_mem(cq, 9);
+            c = cq->first;
+            clen = buffer_string_length(c->mem) - c->offset;
+        }
+        const uint8_t *s = (const uint8_t *)c->mem->ptr + c->offset;
+        const uint32_t flen = h2_u24(s);
+        if (flen > H2_FRAME_SIZE_DEFAULT)
+            return h2_send_goaway_e(con, H2_E_FRAME_SIZE_ERROR);
+        if (cqlen < (off_t)(9 + flen)) break; /* incomplete frame */
+        if (clen < 9 + flen) {
+            chunkqueue_compact_mem(cq, 9 + flen);
+            c = cq->first;
+            s = (const uint8_t *)c->mem->ptr + c->offset;
+        }
+        if (0 != h2_recv_frame(con, s, flen))
+            return -1;
+        chunkqueue_mark_written(cq, 9 + flen);
+    }
+
+    return 0;
+}
+
+
+int h2_send_headers (request_st * const r, connection * const con, const char *hdrs, uint32_t hlen)
+{
+    /* send HEADERS frame followed by CONTINUATION frames, as needed */
+    const uint8_t end_stream =
+      (r->resp_body_finished && chunkqueue_is_empty(r->write_queue))
+        ? H2_FLAG_END_STREAM
+        : 0;
+    const uint32_t nframes = hlen / H2_FRAME_SIZE_DEFAULT + 1;
+    buffer * const b =
+      chunkqueue_append_buffer_open_sz(con->write_queue, hlen + 9*nframes + 1);
+    uint8_t type = H2_FTYPE_HEADERS;
+    uint8_t flags = end_stream;
+    do {
+        const uint32_t len =
+          hlen > H2_FRAME_SIZE_DEFAULT ? H2_FRAME_SIZE_DEFAULT : hlen;
+        hlen -= len;
+        if (0 == hlen) flags |= H2_FLAG_END_HEADERS;
+        uint8_t * const s = (uint8_t *)buffer_string_prepare_append(b, 9);
+        h2_frame_hdr(s, len, type, flags, r->h2id);
+        buffer_commit(b, 9);
+        buffer_append_string_len(b, hdrs, len);
+        hdrs += len;
+        type = H2_FTYPE_CONTINUATION;
+        flags = 0;
+    } while (hlen);
+    chunkqueue_append_buffer_commit(con->write_queue);
+
+    if (end_stream) h2_end_stream_local(r);
+    return 0;
+}
+
+
+void h2_send_cqdata (request_st * const r, connection * const con, chunkqueue * const cq, uint32_t dlen)
+{
+    /* send DATA frames; caller must limit dlen by flow control windows */
+    h2con * const h2c = con->h2;
+    const uint32_t fsz = h2c->s_max_frame_size < H2_FRAME_SIZE_SEND_MAX
+      ? h2c->s_max_frame_size
+      : H2_FRAME_SIZE_SEND_MAX;
+    const int end_stream =
+      r->resp_body_finished && (off_t)dlen == chunkqueue_length(cq);
+    h2c->swin -= (int32_t)dlen;
+    r->h2_swin -= (int32_t)dlen;
+    do {
+        const uint32_t len = dlen > fsz ? fsz : dlen;
+        dlen -= len;
+        uint8_t s[9];
+        h2_frame_hdr(s, len, H2_FTYPE_DATA,
+                     (end_stream && 0 == dlen) ? H2_FLAG_END_STREAM : 0,
+                     r->h2id);
+        chunkqueue_append_mem(con->write_queue, (const char *)s, sizeof(s));
+        chunkqueue_steal(con->write_queue, cq, (off_t)len);
+    } while (dlen);
+
+    if (end_stream) h2_end_stream_local(r);
+}
+
+
+void h2_send_end_stream (request_st * const r, connection * const con)
+{
+    if (r->state == CON_STATE_ERROR) {
+        if (r->h2state != H2_STATE_CLOSED)
+            h2_send_rst_stream(r, con, H2_E_INTERNAL_ERROR);
+    }
+    else if (r->h2state == H2_STATE_OPEN
+             || r->h2state == H2_STATE_HALF_CLOSED_REMOTE) {
+        /* empty DATA frame with END_STREAM */
+        uint8_t s[9];
+        h2_frame_hdr(s, 0, H2_FTYPE_DATA, H2_FLAG_END_STREAM, r->h2id);
+        chunkqueue_append_mem(con->write_queue, (const char *)s, sizeof(s));
+        h2_end_stream_local(r);
+    }
+}
+
+
+void h2_retire_stream (request_st * const r, connection * const con)
+{
+    h2con * const h2c = con->h2;
+
+    /* response is complete; client has not finished sending request body */
+    if (r->h2state == H2_STATE_HALF_CLOSED_LOCAL)
+        h2_send_rst_stream(r, con, H2_E_NO_ERROR);
+
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        if (h2c->r[i] != r) continue;
+        if (i != --h2c->rused)
+            memmove(h2c->r+i, h2c->r+i+1, (h2c->rused - i) * sizeof(*h2c->r));
+        break;
+    }
+
+    /* dependent streams now depend on parent of retired stream
+     * (RFC 7540 5.3.4) */
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        if (h2c->r[i]->h2_dep == r->h2id) {
+            h2c->r[i]->h2_dep = r->h2_dep;
+            h2c->prio_order = 1;
+        }
+    }
+
+    request_release(r);
+}
+
+
+void h2_prio_order (connection * const con)
+{
+    /* order active streams for DATA scheduling after priorities changed:
+     * streams precede their dependents, and streams at the same depth in
+     * the dependency tree are ordered by weight (descending), then stream id
+     * (stable insertion sort; number of streams is small) */
+    h2con * const h2c = con->h2;
+    if (!h2c->prio_order) return;
+    h2c->prio_order = 0;
+
+    uint32_t depth[256]; /*(server.h2-max-concurrent-streams <= 256)*/
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        const request_st *a = h2c->r[i];
+        uint32_t n = 0;
+        while (a->h2_dep && n < h2c->rused
+               && NULL != (a = h2_get_stream_req(h2c, a->h2_dep)))
+            ++n;
+        depth[i] = n;
+    }
+
+    for (uint32_t i = 1; i < h2c->rused; ++i) {
+        request_st * const r = h2c->r[i];
+        const uint32_t d = depth[i];
+        uint32_t j = i;
+        for (; j > 0; --j) {
+            const request_st * const x = h2c->r[j-1];
+            if (depth[j-1] < d
+                || (depth[j-1] == d
+                    && (x->h2_weight > r->h2_weight
+                        || (x->h2_weight == r->h2_weight
+                            && x->h2id < r->h2id))))
+                break;
+            h2c->r[j] = h2c->r[j-1];
+            depth[j] = depth[j-1];
+        }
+        h2c->r[j] = r;
+        depth[j] = d;
+    }
+}
+
+
+static int h2_stream_send_ready (const request_st * const r)
+{
+    return r->state == CON_STATE_WRITE
+        && r->h2_swin > 0
+        && !chunkqueue_is_empty(r->write_queue);
+}
+
+
+off_t h2_send_limit (const request_st * const r, const connection * const con, const off_t avail)
+{
+    /* limit DATA sent for stream in a scheduling pass (RFC 7540 5.3):
+     * - nothing while a stream on which it depends is ready to send DATA
+     * - share of avail proportional to weight among siblings ready to send */
+    const h2con * const h2c = con->h2;
+    const request_st *a = r;
+    for (uint32_t n = 0; a->h2_dep && n < h2c->rused; ++n) {
+        a = h2_get_stream_req(h2c, a->h2_dep);
+        if (NULL == a) break;
+        if (h2_stream_send_ready(a)) return 0;
+    }
+
+    uint32_t wsum = 0;
+    for (uint32_t i = 0; i < h2c->rused; ++i) {
+        const request_st * const x = h2c->r[i];
+        if (x->h2_dep == r->h2_dep && (x == r || h2_stream_send_ready(x)))
+            wsum += x->h2_weight;
+    }
+    const off_t share = avail / wsum * r->h2_weight;
+    return share > H2_FRAME_SIZE_DEFAULT ? share : H2_FRAME_SIZE_DEFAULT;
+}
+
+
+void h2_stream_rwin_check (request_st * const r, connection * const con)
+{
+    /* replenish stream receive window once request body data is consumed */
+    if (r->h2_rwin >= H2_STREAM_RWIN/2) return;
+    if (r->h2state != H2_STATE_OPEN && r->h2state != H2_STATE_HALF_CLOSED_LOCAL)
+        return;
+    if (r->state == CON_STATE_ERROR || 0 == r->reqbody_length) return;
+    off_t buffered = chunkqueue_length(r->read_queue);
+    if (r->conf.stream_request_body & FDEVENT_STREAM_REQUEST_BUFMIN)
+        buffered += chunkqueue_length(r->reqbody_queue);
+    if (buffered >= H2_STREAM_RWIN) return;
+    h2_send_window_update(con, r->h2id, (uint32_t)(H2_STREAM_RWIN - r->h2_rwin));
+    r->h2_rwin = H2_STREAM_RWIN;
+}
+
+
+const buffer * h2_check_con_upgrade_h2c (request_st * const r)
+{
+    /* check for "Upgrade: h2c" (cleartext) and HTTP2-Settings
+     * (RFC 7540 3.2 Starting HTTP/2 for "http" URIs)
+     * (upgrade is supported only for requests without request body) */
+    if (r->http_version != HTTP_VERSION_1_1 || 0 != r->http_status
+        || 0 != r->reqbody_length)
+        return NULL;
+    connection * const con = r->con;
+    if (con->is_ssl_sock || !con->srv->srvconf.h2proto)
+        return NULL;
+
+    const buffer * const upgrade =
+      http_header_request_get(r, HTTP_HEADER_UPGRADE, CONST_STR_LEN("Upgrade"));
+    if (NULL == upgrade || !buffer_eq_slen(upgrade, CONST_STR_LEN("h2c")))
+        return NULL;
+    const buffer * const http2_settings =
+      http_header_request_get(r, HTTP_HEADER_OTHER,
+                              CONST_STR_LEN("HTTP2-Settings"));
+    if (NULL == http2_settings)
+        return NULL;
+    const buffer * const connection_hdr =
+      http_header_request_get(r, HTTP_HEADER_CONNECTION,
+                              CONST_STR_LEN("Connection"));
+    if (NULL == connection_hdr
+        || !http_header_str_contains_token(CONST_BUF_LEN(connection_hdr),
+                                           CONST_STR_LEN("HTTP2-Settings")))
+        return NULL;
+
+    return http2_settings;
+}
+
+
+void h2_init_con (request_st * const h2r, connection * const con, const buffer * const http2_settings)
+{
+    const uint32_t rmax = con->srv->srvconf.h2_max_concurrent_streams;
+    h2con * const h2c = calloc(1, sizeof(h2con) + rmax * sizeof(request_st *));
+    force_assert(h2c);
+    con->h2 = h2c;
+
+    h2c->rmax = rmax;
+    h2c->rwin = H2_CON_RWIN;
+    h2c->swin = 65535;
+    h2c->s_header_table_size = HPACK_DEFAULT_TABLE_SIZE;
+    h2c->s_enable_push = 1;
+    h2c->s_max_concurrent_streams = ~(uint32_t)0;
+    h2c->s_initial_window_size = 65535;
+    h2c->s_max_frame_size = H2_FRAME_SIZE_DEFAULT;
+    h2c->s_max_header_list_size = ~(uint32_t)0;
+    hpack_dtable_init(&h2c->decoder, HPACK_DEFAULT_TABLE_SIZE);
+
+    /* client connection preface: the initial "PRI * HTTP/2.0\r\n\r\n" is
+     * consumed by HTTP/1.x request header parsing (prior knowledge or ALPN)
+     * whereas the entire preface follows an "Upgrade: h2c" request */
+    h2c->preface = (NULL != http2_settings)
+      ? sizeof(h2_client_preface)-1
+      : sizeof(h2_client_preface)-1 - (sizeof("PRI * HTTP/2.0\r\n\r\n")-1);
+
+    /* server connection preface: SETTINGS frame and WINDOW_UPDATE frame */
+    const uint8_t server_preface[] = {
+      /* SETTINGS */
+      0x00, 0x00, 0x06, H2_FTYPE_SETTINGS, 0x00, 0x00, 0x00, 0x00, 0x00
+     ,0x00, H2_SETTINGS_MAX_CONCURRENT_STREAMS
+     ,0x00, 0x00, (uint8_t)(rmax >> 8), (uint8_t)rmax
+      /* WINDOW_UPDATE (connection receive window: 65535 -> H2_CON_RWIN) */
+     ,0x00, 0x00, 0x04, H2_FTYPE_WINDOW_UPDATE, 0x00, 0x00, 0x00, 0x00, 0x00
+     ,(uint8_t)((H2_CON_RWIN - 65535) >> 24)
+     ,(uint8_t)((H2_CON_RWIN - 65535) >> 16)
+     ,(uint8_t)((H2_CON_RWIN - 65535) >> 8)
+     ,(uint8_t)((H2_CON_RWIN - 65535))
+    };
+    chunkqueue_append_mem(con->write_queue, (const char *)server_preface,
+                          sizeof(server_preface));
+
+    if (NULL != http2_settings) {
+        /* HTTP2-Settings is base64url-encoded SETTINGS frame payload;
+         * 101 Switching Protocols serves as implicit acknowledgement */
+        buffer * const tb = h2r->tmp_buf;
+        buffer_clear(tb);
+        if (NULL == buffer_append_base64_decode(tb,CONST_BUF_LEN(http2_settings),
+                                                BASE64_URL)
+            || 0 != buffer_string_length(tb) % 6)
+            h2_send_goaway(con, H2_E_PROTOCOL_ERROR);
+        else
+            h2_parse_settings(con, (uint8_t *)tb->ptr, buffer_string_length(tb));
+    }
+
+    h2r->http_version = HTTP_VERSION_2;
+    h2r->keep_alive = 1;
+    h2r->state = CON_STATE_WRITE;
+    h2r->conf.stream_request_body |= FDEVENT_STREAM_REQUEST_POLLIN;
+    con->keep_alive_idle = h2r->conf.max_keep_alive_idle;
+}
+
+
+void h2_con_free (connection * const con)
+{
+    h2con * const h2c = con->h2;
+    if (NULL == h2c) return;
+    for (uint32_t i = 0; i < h2c->rused; ++i)
+        request_release(h2c->r[i]);
+    hpack_dtable_free(&h2c->decoder);
+    hpack_fields_free(&h2c->fields);
+    free(h2c->dbuf.ptr);
+    free(h2c->hbuf.ptr);
+    free(h2c);
+    con->h2 = NULL;
+}
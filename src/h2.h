@@ -0,0 +1,121 @@
+#ifndef INCLUDED_H2_H
+#define INCLUDED_H2_H
+#include "first.h"
+
+#include "base_decls.h"
+#include "buffer.h"
+#include "hpack.h"
+
+/* HTTP/2 (RFC 7540) */
+
+struct chunkqueue;      /* declaration */
+
+typedef enum {
+    H2_FTYPE_DATA          = 0x00,
+    H2_FTYPE_HEADERS       = 0x01,
+    H2_FTYPE_PRIORITY      = 0x02,
+    H2_FTYPE_RST_STREAM    = 0x03,
+    H2_FTYPE_SETTINGS      = 0x04,
+    H2_FTYPE_PUSH_PROMISE  = 0x05,
+    H2_FTYPE_PING          = 0x06,
+    H2_FTYPE_GOAWAY        = 0x07,
+    H2_FTYPE_WINDOW_UPDATE = 0x08,
+    H2_FTYPE_CONTINUATION  = 0x09
+} request_h2_ftype_t;
+
+typedef enum {
+    H2_FLAG_END_STREAM     = 0x01, /* DATA HEADERS */
+    H2_FLAG_ACK            = 0x01, /* SETTINGS PING */
+    H2_FLAG_END_HEADERS    = 0x04, /* HEADERS PUSH_PROMISE CONTINUATION */
+    H2_FLAG_PADDED         = 0x08, /* DATA HEADERS PUSH_PROMISE */
+    H2_FLAG_PRIORITY       = 0x20  /* HEADERS */
+} request_h2_flag_t;
+
+typedef enum {
+    H2_SETTINGS_HEADER_TABLE_SIZE      = 0x01,
+    H2_SETTINGS_ENABLE_PUSH            = 0x02,
+    H2_SETTINGS_MAX_CONCURRENT_STREAMS = 0x03,
+    H2_SETTINGS_INITIAL_WINDOW_SIZE    = 0x04,
+    H2_SETTINGS_MAX_FRAME_SIZE         = 0x05,
+    H2_SETTINGS_MAX_HEADER_LIST_SIZE   = 0x06
+} request_h2_settings_t;
+
+typedef enum {
+    H2_E_NO_ERROR            = 0x00,
+    H2_E_PROTOCOL_ERROR      = 0x01,
+    H2_E_INTERNAL_ERROR      = 0x02,
+    H2_E_FLOW_CONTROL_ERROR  = 0x03,
+    H2_E_SETTINGS_TIMEOUT    = 0x04,
+    H2_E_STREAM_CLOSED       = 0x05,
+    H2_E_FRAME_SIZE_ERROR    = 0x06,
+    H2_E_REFUSED_STREAM      = 0x07,
+    H2_E_CANCEL              = 0x08,
+    H2_E_COMPRESSION_ERROR   = 0x09,
+    H2_E_CONNECT_ERROR       = 0x0a,
+    H2_E_ENHANCE_YOUR_CALM   = 0x0b,
+    H2_E_INADEQUATE_SECURITY = 0x0c,
+    H2_E_HTTP_1_1_REQUIRED   = 0x0d
+} request_h2error_t;
+
+typedef struct h2con {
+    uint32_t rused;
+    uint32_t rmax;           /* server.h2-max-concurrent-streams */
+    uint32_t prio_order;     /* stream priorities changed; reorder r[] */
+    uint32_t csettings;      /* client SETTINGS frame received */
+
+    uint32_t h2_cid;         /* highest client stream id seen */
+    int32_t sent_goaway;     /* -1 graceful (NO_ERROR), >0 error code sent */
+    int32_t received_goaway;
+    int32_t rwin;            /* connection receive window */
+    int32_t swin;            /* connection send window */
+
+    /* peer SETTINGS */
+    uint32_t s_header_table_size;
+    uint32_t s_enable_push;
+    uint32_t s_max_concurrent_streams;
+    int32_t  s_initial_window_size;
+    uint32_t s_max_frame_size;
+    uint32_t s_max_header_list_size;
+
+    uint32_t preface;        /* client connection preface octets pending */
+    uint32_t hsid;           /* stream id of header block awaiting CONTINUATION*/
+    uint32_t hflags;         /* flags from HEADERS frame awaiting CONTINUATION */
+    buffer hbuf;             /* header block fragments awaiting CONTINUATION */
+
+    hpack_dtable decoder;
+    hpack_fields fields;
+    buffer dbuf;             /* decoded header fields */
+    uint8_t hprio[5];        /* HEADERS priority awaiting CONTINUATION */
+
+    request_st *r[];         /* active streams, in order for DATA scheduling */
+} h2con;
+
+__attribute_cold__
+const buffer * h2_check_con_upgrade_h2c (request_st *r);
+
+__attribute_cold__
+void h2_init_con (request_st *h2r, connection *con, const buffer *http2_settings);
+
+int h2_parse_frames (connection *con);
+
+int h2_send_headers (request_st *r, connection *con, const char *hdrs, uint32_t hlen);
+
+void h2_send_cqdata (request_st *r, connection *con, struct chunkqueue *cq, uint32_t dlen);
+
+void h2_send_end_stream (request_st *r, connection *con);
+
+void h2_retire_stream (request_st *r, connection *con);
+
+void h2_stream_rwin_check (request_st *r, connection *con);
+
+void h2_prio_order (connection *con);
+
+off_t h2_send_limit (const request_st *r, const connection *con, off_t avail);
+
+__attribute_cold__
+void h2_send_goaway (connection *con, request_h2error_t e);
+
+__attribute_cold__
+void h2_con_free (connection *con);
+
+#endif
@@ -0,0 +1,587 @@
+/*
+ * hpack - HTTP/2 header compression (RFC 7541)
+ *
+ * License: BSD 3-clause (same as lighttpd)
+ */
+#include "first.h"
+#include "hpack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+
+/* RFC 7541 Appendix A Static Table */
+typedef struct {
+    const char *k;
+    uint32_t klen;
+    const char *v;
+    uint32_t vlen;
+} hpack_sentry;
+
+#define HPACK_SENTRY(k,v) { k, sizeof(k)-1, v, sizeof(v)-1 }
+
+static const hpack_sentry hpack_static_table[] = {
+  HPACK_SENTRY(":authority", "")
+ ,HPACK_SENTRY(":method", "GET")
+ ,HPACK_SENTRY(":method", "POST")
+ ,HPACK_SENTRY(":path", "/")
+ ,HPACK_SENTRY(":path", "/index.html")
+ ,HPACK_SENTRY(":scheme", "http")
+ ,HPACK_SENTRY(":scheme", "https")
+ ,HPACK_SENTRY(":status", "200")
+ ,HPACK_SENTRY(":status", "204")
+ ,HPACK_SENTRY(":status", "206")
+ ,HPACK_SENTRY(":status", "304")
+ ,HPACK_SENTRY(":status", "400")
+ ,HPACK_SENTRY(":status", "404")
+ ,HPACK_SENTRY(":status", "500")
+ ,HPACK_SENTRY("accept-charset", "")
+ ,HPACK_SENTRY("accept-encoding", "gzip, deflate")
+ ,HPACK_SENTRY("accept-language", "")
+ ,HPACK_SENTRY("accept-ranges", "")
+ ,HPACK_SENTRY("accept", "")
+ ,HPACK_SENTRY("access-control-allow-origin", "")
+ ,HPACK_SENTRY("age", "")
+ ,HPACK_SENTRY("allow", "")
+ ,HPACK_SENTRY("authorization", "")
+ ,HPACK_SENTRY("cache-control", "")
+ ,HPACK_SENTRY("content-disposition", "")
+ ,HPACK_SENTRY("content-encoding", "")
+ ,HPACK_SENTRY("content-language", "")
+ ,HPACK_SENTRY("content-length", "")
+ ,HPACK_SENTRY("content-location", "")
+ ,HPACK_SENTRY("content-range", "")
+ ,HPACK_SENTRY("content-type", "")
+ ,HPACK_SENTRY("cookie", "")
+ ,HPACK_SENTRY("date", "")
+ ,HPACK_SENTRY("etag", "")
+ ,HPACK_SENTRY("expect", "")
+ ,HPACK_SENTRY("expires", "")
+ ,HPACK_SENTRY("from", "")
+ ,HPACK_SENTRY("host", "")
+ ,HPACK_SENTRY("if-match", "")
+ ,HPACK_SENTRY("if-modified-since", "")
+ ,HPACK_SENTRY("if-none-match", "")
+ ,HPACK_SENTRY("if-range", "")
+ ,HPACK_SENTRY("if-unmodified-since", "")
+ ,HPACK_SENTRY("last-modified", "")
+ ,HPACK_SENTRY("link", "")
+ ,HPACK_SENTRY("location", "")
+ ,HPACK_SENTRY("max-forwards", "")
+ ,HPACK_SENTRY("proxy-authenticate", "")
+ ,HPACK_SENTRY("proxy-authorization", "")
+ ,HPACK_SENTRY("range", "")
+ ,HPACK_SENTRY("referer", "")
+ ,HPACK_SENTRY("refresh", "")
+ ,HPACK_SENTRY("retry-after", "")
+ ,HPACK_SENTRY("server", "")
+ ,HPACK_SENTRY("set-cookie", "")
+ ,HPACK_SENTRY("strict-transport-security", "")
+ ,HPACK_SENTRY("transfer-encoding", "")
+ ,HPACK_SENTRY("user-agent", "")
+ ,HPACK_SENTRY("vary", "")
+ ,HPACK_SENTRY("via", "")
+ ,HPACK_SENTRY("www-authenticate", "")
+};
+
+#define HPACK_STATIC_TABLE_LEN \
+  (sizeof(hpack_static_table)/sizeof(*hpack_static_table))
+
+
+/* RFC 7541 Appendix B Huffman Code
+ * (code lengths are canonical; codes of equal length are consecutive and
+ *  ordered by symbol, permitting decoding with count and sym tables) */
+static const uint32_t hpack_huff_code[257] = {
+  0x00001ff8, 0x007fffd8, 0x0fffffe2, 0x0fffffe3, 0x0fffffe4, 0x0fffffe5,
+  0x0fffffe6, 0x0fffffe7, 0x0fffffe8, 0x00ffffea, 0x3ffffffc, 0x0fffffe9,
+  0x0fffffea, 0x3ffffffd, 0x0fffffeb, 0x0fffffec, 0x0fffffed, 0x0fffffee,
+  0x0fffffef, 0x0ffffff0, 0x0ffffff1, 0x0ffffff2, 0x3ffffffe, 0x0ffffff3,
+  0x0ffffff4, 0x0ffffff5, 0x0ffffff6, 0x0ffffff7, 0x0ffffff8, 0x0ffffff9,
+  0x0ffffffa, 0x0ffffffb, 0x00000014, 0x000003f8, 0x000003f9, 0x00000ffa,
+  0x00001ff9, 0x00000015, 0x000000f8, 0x000007fa, 0x000003fa, 0x000003fb,
+  0x000000f9, 0x000007fb, 0x000000fa, 0x00000016, 0x00000017, 0x00000018,
+  0x00000000, 0x00000001, 0x00000002, 0x00000019, 0x0000001a, 0x0000001b,
+  0x0000001c, 0x0000001d, 0x0000001e, 0x0000001f, 0x0000005c, 0x000000fb,
+  0x00007ffc, 0x00000020, 0x00000ffb, 0x000003fc, 0x00001ffa, 0x00000021,
+  0x0000005d, 0x0000005e, 0x0000005f, 0x00000060, 0x00000061, 0x00000062,
+  0x00000063, 0x00000064, 0x00000065, 0x00000066, 0x00000067, 0x00000068,
+  0x00000069, 0x0000006a, 0x0000006b, 0x0000006c, 0x0000006d, 0x0000006e,
+  0x0000006f, 0x00000070, 0x00000071, 0x00000072, 0x000000fc, 0x00000073,
+  0x000000fd, 0x00001ffb, 0x0007fff0, 0x00001ffc, 0x00003ffc, 0x00000022,
+  0x00007ffd, 0x00000003, 0x00000023, 0x00000004, 0x00000024, 0x00000005,
+  0x00000025, 0x00000026, 0x00000027, 0x00000006, 0x00000074, 0x00000075,
+  0x00000028, 0x00000029, 0x0000002a, 0x00000007, 0x0000002b, 0x00000076,
+  0x0000002c, 0x00000008, 0x00000009, 0x0000002d, 0x00000077, 0x00000078,
+  0x00000079, 0x0000007a, 0x0000007b, 0x00007ffe, 0x000007fc, 0x00003ffd,
+  0x00001ffd, 0x0ffffffc, 0x000fffe6, 0x003fffd2, 0x000fffe7, 0x000fffe8,
+  0x003fffd3, 0x003fffd4, 0x003fffd5, 0x007fffd9, 0x003fffd6, 0x007fffda,
+  0x007fffdb, 0x007fffdc, 0x007fffdd, 0x007fffde, 0x00ffffeb, 0x007fffdf,
+  0x00ffffec, 0x00ffffed, 0x003fffd7, 0x007fffe0, 0x00ffffee, 0x007fffe1,
+  0x007fffe2, 0x007fffe3, 0x007fffe4, 0x001fffdc, 0x003fffd8, 0x007fffe5,
+  0x003fffd9, 0x007fffe6, 0x007fffe7, 0x00ffffef, 0x003fffda, 0x001fffdd,
+  0x000fffe9, 0x003fffdb, 0x003fffdc, 0x007fffe8, 0x007fffe9, 0x001fffde,
+  0x007fffea, 0x003fffdd, 0x003fffde, 0x00fffff0, 0x001fffdf, 0x003fffdf,
+  0x007fffeb, 0x007fffec, 0x001fffe0, 0x001fffe1, 0x003fffe0, 0x001fffe2,
+  0x007fffed, 0x003fffe1, 0x007fffee, 0x007fffef, 0x000fffea, 0x003fffe2,
+  0x003fffe3, 0x003fffe4, 0x007ffff0, 0x003fffe5, 0x003fffe6, 0x007ffff1,
+  0x03ffffe0, 0x03ffffe1, 0x000fffeb, 0x0007fff1, 0x003fffe7, 0x007ffff2,
+  0x003fffe8, 0x01ffffec, 0x03ffffe2, 0x03ffffe3, 0x03ffffe4, 0x07ffffde,
+  0x07ffffdf, 0x03ffffe5, 0x00fffff1, 0x01ffffed, 0x0007fff2, 0x001fffe3,
+  0x03ffffe6, 0x07ffffe0, 0x07ffffe1, 0x03ffffe7, 0x07ffffe2, 0x00fffff2,
+  0x001fffe4, 0x001fffe5, 0x03ffffe8, 0x03ffffe9, 0x0ffffffd, 0x07ffffe3,
+  0x07ffffe4, 0x07ffffe5, 0x000fffec, 0x00fffff3, 0x000fffed, 0x001fffe6,
+  0x003fffe9, 0x001fffe7, 0x001fffe8, 0x007ffff3, 0x003fffea, 0x003fffeb,
+  0x01ffffee, 0x01ffffef, 0x00fffff4, 0x00fffff5, 0x03ffffea, 0x007ffff4,
+  0x03ffffeb, 0x07ffffe6, 0x03ffffec, 0x03ffffed, 0x07ffffe7, 0x07ffffe8,
+  0x07ffffe9, 0x07ffffea, 0x07ffffeb, 0x0ffffffe, 0x07ffffec, 0x07ffffed,
+  0x07ffffee, 0x07ffffef, 0x07fffff0, 0x03ffffee, 0x3fffffff
+};
+
+static const uint8_t hpack_huff_len[257] = {
+  13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+  28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+   6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+   5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+  13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+   7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+  15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+   6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+  20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+  24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+  22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+  21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+  26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+  19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+  20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+  26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+  30
+};
+
+static const uint16_t hpack_huff_count[31] = {
+    0,   0,   0,   0,   0,  10,  26,  32,   6,   0,   5,   3,   2,   6,   2,   3,
+    0,   0,   0,   3,   8,  13,  26,  29,  12,   4,  15,  19,  29,   0,   4
+};
+
+static const uint16_t hpack_huff_sym[257] = {
+   48,  49,  50,  97,  99, 101, 105, 111, 115, 116,  32,  37,
+   45,  46,  47,  51,  52,  53,  54,  55,  56,  57,  61,  65,
+   95,  98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+   58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+   77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  89,
+  106, 107, 113, 118, 119, 120, 121, 122,  38,  42,  44,  59,
+   88,  90,  33,  34,  40,  41,  63,  39,  43, 124,  35,  62,
+    0,  36,  64,  91,  93, 126,  94, 125,  60,  96, 123,  92,
+  195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+  167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+  132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+  173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+  233,   1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+  151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+  183, 188, 191, 197, 231, 239,   9, 142, 144, 145, 148, 159,
+  171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+  200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+  255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+  246, 247, 248, 250, 251, 252, 253, 254,   2,   3,   4,   5,
+    6,   7,   8,  11,  12,  14,  15,  16,  17,  18,  19,  20,
+   21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220,
+  249,  10,  13,  22, 256
+};
+
+
+/* dynamic table entry; name followed by value */
+struct hpack_dentry {
+    uint32_t klen;
+    uint32_t vlen;
+    char s[];
+};
+
+/* entry size (RFC 7541 Section 4.1) */
+#define HPACK_ENTRY_OVERHEAD 32
+
+
+void hpack_dtable_init (hpack_dtable *dt, uint32_t limit)
+{
+    memset(dt, 0, sizeof(*dt));
+    dt->max_size = limit;
+    dt->limit = limit;
+}
+
+
+void hpack_dtable_free (hpack_dtable *dt)
+{
+    for (uint32_t i = 0; i < dt->used; ++i)
+        free(dt->ring[(dt->head + dt->cap - i) % dt->cap]);
+    free(dt->ring);
+    memset(dt, 0, sizeof(*dt));
+}
+
+
+static void hpack_dtable_evict (hpack_dtable * const dt, const uint32_t size)
+{
+    /* evict oldest entries until table size + size <= max_size */
+    while (dt->used && dt->size + size > dt->max_size) {
+        const uint32_t i = (dt->head + dt->cap - --dt->used) % dt->cap;
+        struct hpack_dentry * const e = dt->ring[i];
+        dt->size -= e->klen + e->vlen + HPACK_ENTRY_OVERHEAD;
+        free(e);
+        dt->ring[i] = NULL;
+    }
+}
+
+
+static void hpack_dtable_insert (hpack_dtable * const dt, const char * const k, const uint32_t klen, const char * const v, const uint32_t vlen)
+{
+    const uint32_t esize = klen + vlen + HPACK_ENTRY_OVERHEAD;
+    if (esize > dt->max_size) { /*(not an error; table is emptied)*/
+        hpack_dtable_evict(dt, dt->max_size + 1);
+        return;
+    }
+    hpack_dtable_evict(dt, esize);
+
+    if (dt->used == dt->cap) {
+        /* grow ring; relocate entries oldest to newest to slots 0..used-1 */
+        const uint32_t cap = dt->cap ? dt->cap << 1 : 16;
+        struct hpack_dentry ** const ring = malloc(cap * sizeof(*ring));
+        force_assert(NULL != ring);
+        for (uint32_t i = 0; i < dt->used; ++i)
+            ring[dt->used-1-i] = dt->ring[(dt->head + dt->cap - i) % dt->cap];
+        free(dt->ring);
+        dt->ring = ring;
+        dt->cap = cap;
+        dt->head = dt->used ? dt->used - 1 : cap - 1;
+    }
+
+    struct hpack_dentry * const e = malloc(sizeof(*e) + klen + vlen);
+    force_assert(NULL != e);
+    e->klen = klen;
+    e->vlen = vlen;
+    memcpy(e->s, k, klen);
+    memcpy(e->s+klen, v, vlen);
+    dt->head = (dt->head + 1) % dt->cap;
+    dt->ring[dt->head] = e;
+    dt->used++;
+    dt->size += esize;
+}
+
+
+static int hpack_lookup (const hpack_dtable * const dt, uint32_t idx, const char ** const k, uint32_t * const klen, const char ** const v, uint32_t * const vlen)
+{
+    if (0 == idx) return -1;
+    if (idx <= HPACK_STATIC_TABLE_LEN) {
+        const hpack_sentry * const se = hpack_static_table + idx - 1;
+        *k = se->k;
+        *klen = se->klen;
+        *v = se->v;
+        *vlen = se->vlen;
+        return 0;
+    }
+    idx -= HPACK_STATIC_TABLE_LEN + 1;
+    if (idx >= dt->used) return -1;
+    const struct hpack_dentry * const e =
+      dt->ring[(dt->head + dt->cap - idx) % dt->cap];
+    *k = e->s;
+    *klen = e->klen;
+    *v = e->s + e->klen;
+    *vlen = e->vlen;
+    return 0;
+}
+
+
+static int hpack_decode_int (const unsigned char ** const sp, const unsigned char * const end, const uint32_t prefix_bits, uint32_t * const n)
+{
+    const unsigned char *s = *sp;
+    const uint32_t mask = (1u << prefix_bits) - 1;
+    uint32_t v = *s++ & mask;
+    if (v == mask) {
+        /* limit continuation to 4 octets (values < 2^28 + mask) */
+        uint32_t m = 0;
+        unsigned char c;
+        do {
+            if (s == end || m > 21) return -1;
+            c = *s++;
+            v += (uint32_t)(c & 0x7f) << m;
+            m += 7;
+        } while (c & 0x80);
+    }
+    *sp = s;
+    *n = v;
+    return 0;
+}
+
+
+static int hpack_huff_decode (buffer * const b, const unsigned char *s, const unsigned char * const end)
+{
+    /* shortest code is 5 bits; decoded string is at most len*8/5 octets */
+    const size_t len = (size_t)(end - s);
+    char * const out = buffer_string_prepare_append(b, len * 8 / 5 + 1);
+    char *d = out;
+    uint32_t code = 0, first = 0, index = 0, bits = 0, acc = 0;
+    for (; s < end; ++s) {
+        for (int i = 7; i >= 0; --i) {
+            const uint32_t bit = (*s >> i) & 1;
+            code |= bit;
+            acc = (acc << 1) | bit;
+            const uint32_t count = hpack_huff_count[++bits];
+            if (code - first < count) {
+                const uint32_t sym = hpack_huff_sym[index + (code - first)];
+                if (sym == 256) return -1; /* EOS MUST be treated as error */
+                *d++ = (char)sym;
+                code = first = index = bits = acc = 0;
+                continue;
+            }
+            if (bits == 30) return -1;
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+    }
+    /* padding must be < 8 bits and must be msb of EOS (all 1 bits) */
+    if (bits > 7 || acc != (1u << bits) - 1) return -1;
+    buffer_commit(b, (size_t)(d - out));
+    return 0;
+}
+
+
+static int hpack_decode_str (const unsigned char ** const sp, const unsigned char * const end, buffer * const b)
+{
+    const unsigned char *s = *sp;
+    const int huff = (*s & 0x80);
+    uint32_t len;
+    if (0 != hpack_decode_int(&s, end, 7, &len)) return -1;
+    if (len > (uint32_t)(end - s)) return -1;
+    if (huff) {
+        if (0 != hpack_huff_decode(b, s, s+len)) return -1;
+    }
+    else
+        buffer_append_string_len(b, (const char *)s, len);
+    *sp = s + len;
+    return 0;
+}
+
+
+static void hpack_fields_append (hpack_fields * const f, const uint32_t k, const uint32_t klen, const uint32_t v, const uint32_t vlen)
+{
+    if (f->used == f->size) {
+        f->size = f->size ? f->size << 1 : 16;
+        f->ptr = realloc(f->ptr, f->size * sizeof(*f->ptr));
+        force_assert(NULL != f->ptr);
+    }
+    hpack_field * const hf = f->ptr + f->used++;
+    hf->k = k;
+    hf->klen = klen;
+    hf->v = v;
+    hf->vlen = vlen;
+}
+
+
+void hpack_fields_free (hpack_fields *f)
+{
+    free(f->ptr);
+    f->ptr = NULL;
+    f->used = f->size = 0;
+}
+
+
+int hpack_decode (hpack_dtable * const restrict dt, const unsigned char *s, const uint32_t len, buffer * const restrict b, hpack_fields * const restrict f, const uint32_t max)
+{
+    const unsigned char * const end = s + len;
+    uint32_t total = 0;
+    int rc = 0;
+    int fields = 0;
+    f->used = 0;
+    buffer_copy_string_len(b, CONST_STR_LEN(""));
+
+    while (s < end) {
+        const uint32_t bused = buffer_string_length(b);
+        const char *k, *v;
+        uint32_t idx, klen, vlen;
+        const unsigned char c = *s;
+        if (c & 0x80) {                 /* Indexed Header Field */
+            if (0 != hpack_decode_int(&s, end, 7, &idx)) return -1;
+            if (0 != hpack_lookup(dt, idx, &k, &klen, &v, &vlen)) return -1;
+            fields = 1;
+            total += klen + vlen + HPACK_ENTRY_OVERHEAD;
+            if (total > max) rc = 1;
+            if (rc) continue; /*(omit copy when header list exceeds max)*/
+            buffer_append_string_len(b, k, klen);
+            buffer_append_string_len(b, v, vlen);
+            hpack_fields_append(f, bused, klen, bused+klen, vlen);
+            continue;
+        }
+        else if ((c & 0xe0) == 0x20) {  /* Dynamic Table Size Update */
+            /* MUST occur at beginning of header block */
+            if (fields) return -1;
+            if (0 != hpack_decode_int(&s, end, 5, &idx)) return -1;
+            if (idx > dt->limit) return -1;
+            dt->max_size = idx;
+            hpack_dtable_evict(dt, 0);
+            continue;
+        }
+        else {                          /* Literal Header Field */
+            /* 01xxxxxx with Incremental Indexing
+             * 0000xxxx without Indexing
+             * 0001xxxx Never Indexed */
+            const int incr = ((c & 0xc0) == 0x40);
+            if (0 != hpack_decode_int(&s, end, incr ? 6 : 4, &idx)) return -1;
+            fields = 1;
+            if (idx) {
+                if (0 != hpack_lookup(dt, idx, &k, &klen, &v, &vlen))
+                    return -1;
+                buffer_append_string_len(b, k, klen);
+            }
+            else {
+                if (s == end) return -1;
+                if (0 != hpack_decode_str(&s, end, b)) return -1;
+                klen = buffer_string_length(b) - bused;
+            }
+            if (s == end) return -1;
+            if (0 != hpack_decode_str(&s, end, b)) return -1;
+            vlen = buffer_string_length(b) - bused - klen;
+            if (incr)
+                hpack_dtable_insert(dt, b->ptr+bused, klen,
+                                        b->ptr+bused+klen, vlen);
+            total += klen + vlen + HPACK_ENTRY_OVERHEAD;
+            if (total > max) rc = 1;
+            if (rc)
+                buffer_string_set_length(b, bused);
+            else
+                hpack_fields_append(f, bused, klen, bused+klen, vlen);
+        }
+    }
+
+    return rc;
+}
+
+
+static void hpack_encode_int (buffer * const b, const uint32_t prefix_bits, const unsigned char flags, uint32_t n)
+{
+    /* (5 octets is sufficient for 32-bit value with any prefix) */
+    unsigned char * const s =
+      (unsigned char *)buffer_string_prepare_append(b, 6);
+    const uint32_t mask = (1u << prefix_bits) - 1;
+    uint32_t i = 0;
+    if (n < mask)
+        s[i++] = flags | (unsigned char)n;
+    else {
+        s[i++] = flags | (unsigned char)mask;
+        for (n -= mask; n >= 0x80; n >>= 7)
+            s[i++] = (unsigned char)(0x80 | (n & 0x7f));
+        s[i++] = (unsigned char)n;
+    }
+    buffer_commit(b, i);
+}
+
+
+static void hpack_encode_str (buffer * const b, const unsigned char * const s, const uint32_t len, const int lc)
+{
+    /* use Huffman encoding if shorter than raw string */
+    uint64_t nbits = 0;
+    for (uint32_t i = 0; i < len; ++i) {
+        unsigned char c = s[i];
+        if (lc && (uint32_t)(c - 'A') < 26) c |= 0x20;
+        nbits += hpack_huff_len[c];
+    }
+    const uint32_t hlen = (uint32_t)((nbits + 7) >> 3);
+    if (hlen < len) {
+        hpack_encode_int(b, 7, 0x80, hlen);
+        unsigned char *d =
+          (unsigned char *)buffer_string_prepare_append(b, hlen);
+        uint64_t acc = 0;
+        uint32_t bits = 0;
+        for (uint32_t i = 0; i < len; ++i) {
+            unsigned char c = s[i];
+            if (lc && (uint32_t)(c - 'A') < 26) c |= 0x20;
+            acc = (acc << hpack_huff_len[c]) | hpack_huff_code[c];
+            for (bits += hpack_huff_len[c]; bits >= 8; bits -= 8)
+                *d++ = (unsigned char)(acc >> (bits - 8));
+        }
+        if (bits) /* pad with msb of EOS (all 1 bits) */
+            *d++ = (unsigned char)((acc << (8 - bits)) | (0xffu >> bits));
+        buffer_commit(b, hlen);
+    }
+    else {
+        hpack_encode_int(b, 7, 0, len);
+        char * const d = buffer_string_prepare_append(b, len);
+        if (lc) {
+            for (uint32_t i = 0; i < len; ++i)
+                d[i] = (uint32_t)(s[i] - 'A') < 26 ? (char)(s[i] | 0x20) : (char)s[i];
+        }
+        else
+            memcpy(d, s, len);
+        buffer_commit(b, len);
+    }
+}
+
+
+static uint32_t hpack_static_name_index (const char * const k, const uint32_t klen)
+{
+    /* (skip pseudo-headers at beginning of static table) */
+    for (uint32_t i = 14; i < HPACK_STATIC_TABLE_LEN; ++i) {
+        const hpack_sentry * const se = hpack_static_table + i;
+        if (se->klen == klen && buffer_eq_icase_ssn(se->k, k, klen))
+            return i + 1;
+    }
+    return 0;
+}
+
+
+void hpack_encode_field (buffer * const restrict b, const char * const restrict k, const uint32_t klen, const char * const restrict v, const uint32_t vlen)
+{
+    /* Literal Header Field without Indexing (no dynamic table is used) */
+    const uint32_t idx = hpack_static_name_index(k, klen);
+    if (idx)
+        hpack_encode_int(b, 4, 0, idx);
+    else {
+        buffer_append_string_len(b, CONST_STR_LEN("\0"));
+        hpack_encode_str(b, (const unsigned char *)k, klen, 1);
+    }
+    hpack_encode_str(b, (const unsigned char *)v, vlen, 0);
+}
+
+
+
+void hpack_encode_field_multi (buffer * const restrict b, const char * const restrict k, const uint32_t klen, const char * restrict v, uint32_t vlen)
+{
+    /* repeated response header values are joined as "v1\r\nKey: v2"
+     * (see http_header_response_insert()); CR and LF are not valid in
+     * HTTP/2 field values, so encode a separate field for each value */
+    for (const char *n; (n = memchr(v, '\r', vlen)); ) {
+        const uint32_t len = (uint32_t)(n - v);
+        if (vlen - len < 2 || n[1] != '\n') break; /*(not expected)*/
+        hpack_encode_field(b, k, klen, v, len);
+        v = n + 2;
+        vlen -= len + 2;
+        if (vlen >= klen + 2 && buffer_eq_icase_ssn(v, k, klen)
+            && v[klen] == ':' && v[klen+1] == ' ') {
+            v += klen + 2;
+            vlen -= klen + 2;
+        }
+    }
+    hpack_encode_field(b, k, klen, v, vlen);
+}
+
+void hpack_encode_status (buffer * const b, const int status)
+{
+    uint32_t idx;
+    switch (status) {
+      case 200: idx = 8;  break;
+      case 204: idx = 9;  break;
+      case 206: idx = 10; break;
+      case 304: idx = 11; break;
+      case 400: idx = 12; break;
+      case 404: idx = 13; break;
+      case 500: idx = 14; break;
+      default:  idx = 0;  break;
+    }
+    if (idx) { /* Indexed Header Field */
+        hpack_encode_int(b, 7, 0x80, idx);
+        return;
+    }
+    char s[3] = { (char)('0' + (status / 100) % 10),
+                  (char)('0' + (status / 10) % 10),
+                  (char)('0' + status % 10) };
+    hpack_encode_int(b, 4, 0, 8); /* name :status (static index 8) */
+    hpack_encode_str(b, (const unsigned char *)s, 3, 0);
+}
@@ -0,0 +1,60 @@
+#ifndef INCLUDED_HPACK_H
+#define INCLUDED_HPACK_H
+#include "first.h"
+
+#include "buffer.h"
+
+/* HPACK: Header Compression for HTTP/2 (RFC 7541) */
+
+/* decoded header field; k and v are offsets into decoder output buffer */
+typedef struct hpack_field {
+    uint32_t k;
+    uint32_t klen;
+    uint32_t v;
+    uint32_t vlen;
+} hpack_field;
+
+typedef struct {
+    hpack_field *ptr;
+    uint32_t used;
+    uint32_t size;
+} hpack_fields;
+
+struct hpack_dentry;     /* declaration */
+
+/* HPACK dynamic table (decoder) */
+typedef struct {
+    struct hpack_dentry **ring;
+    uint32_t head;       /* ring slot of most recently inserted entry */
+    uint32_t used;       /* number of entries in table */
+    uint32_t cap;        /* number of ring slots allocated */
+    uint32_t size;       /* current table size (RFC 7541 Section 4.1) */
+    uint32_t max_size;   /* current max size (dynamic table size update) */
+    uint32_t limit;      /* SETTINGS_HEADER_TABLE_SIZE sent to peer */
+} hpack_dtable;
+
+#define HPACK_DEFAULT_TABLE_SIZE 4096
+
+void hpack_dtable_init (hpack_dtable *dt, uint32_t limit);
+void hpack_dtable_free (hpack_dtable *dt);
+
+/* decode header block into b and f
+ * returns 0 on success,
+ *        -1 on decoding error (HTTP/2 COMPRESSION_ERROR),
+ *         1 if decoded header list exceeds max (fields omitted from f;
+ *           dynamic table is still updated and remains consistent) */
+int hpack_decode (hpack_dtable * restrict dt, const unsigned char *s, uint32_t len, buffer * restrict b, hpack_fields * restrict f, uint32_t max);
+
+void hpack_fields_free (hpack_fields *f);
+
+/* encode header field as literal without indexing (name is lowercased) */
+void hpack_encode_field (buffer * restrict b, const char * restrict k, uint32_t klen, const char * restrict v, uint32_t vlen);
+
+/* encode header field (as above) once per value in v, where repeated values
+ * are joined as "v1\r\nKey: v2" (see http_header_response_insert()) */
+void hpack_encode_field_multi (buffer * restrict b, const char * restrict k, uint32_t klen, const char * restrict v, uint32_t vlen);
+
+/* encode :status pseudo-header */
+void hpack_encode_status (buffer *b, int status);
+
+#endif
@@ -441,7 +441,7 @@ static int http_response_parse_range(request_st * const r, buffer * const path,
 }
 
 
-void http_response_send_file (request_st * const r, buffer * const path) {
+void http_response_send_file (request_st * const r, buffer * const path, const off_t mem_cache_max_sz) {
 	stat_cache_entry * const sce = stat_cache_get_entry(path);
 	const buffer *mtime = NULL;
 	const buffer *vb;
@@ -477,12 +477,16 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 		return;
 	}
 
-	/*(Note: O_NOFOLLOW affects only the final path segment,
-	 * the target file, not any intermediate symlinks along path)*/
-	const int fd = (0 != sce->st.st_size)
-	  ? fdevent_open_cloexec(path->ptr, r->conf.follow_symlink, O_RDONLY, 0)
+	/* small files might be cached in memory (mem_cache_max_sz) */
+	const int use_mem_cache =
+	  (0 != sce->st.st_size && sce->st.st_size <= mem_cache_max_sz);
+	const buffer *body = use_mem_cache ? stat_cache_body_get(sce) : NULL;
+
+	/*(fd might be cached in sce; if fd == sce->fd, must not close(fd))*/
+	const int fd = (0 != sce->st.st_size && NULL == body)
+	  ? stat_cache_entry_open(sce, r->conf.follow_symlink)
 	  : -1;
-	if (fd < 0 && 0 != sce->st.st_size) {
+	if (fd < 0 && 0 != sce->st.st_size && NULL == body) {
 		r->http_status = (errno == ENOENT) ? 404 : 403;
 		if (r->conf.log_request_handling) {
 			log_perror(r->conf.errh, __FILE__, __LINE__,
@@ -536,12 +540,12 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 		}
 
 		if (HANDLER_FINISHED == http_response_handle_cachable(r, mtime)) {
-			if (fd >= 0) close(fd);
+			if (fd >= 0 && fd != sce->fd) close(fd);
 			return;
 		}
 	}
 
-	if (fd < 0) { /* 0-length file */
+	if (0 == sce->st.st_size) {
 		r->http_status = 200;
 		r->resp_body_finished = 1;
 		return;
@@ -588,7 +592,7 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 			if (0 == http_response_parse_range(r, path, sce, range->ptr+6)) {
 				r->http_status = 206;
 			}
-			close(fd);
+			if (fd >= 0 && fd != sce->fd) close(fd);
 			return;
 		}
 	}
@@ -599,7 +603,17 @@ void http_response_send_file (request_st * const r, buffer * const path) {
 	 * the HEAD request will drop it afterwards again
 	 */
 
-	if (0 == http_chunk_append_file_fd(r, path, fd, sce->st.st_size)) {
+	if (use_mem_cache && NULL == body) {
+		body = stat_cache_body_load(sce, fd);
+		if (NULL != body && fd != sce->fd) close(fd);
+	}
+
+	const int rc = (NULL != body)
+	  ? http_chunk_append_mem(r, CONST_BUF_LEN(body))
+	  : (fd == sce->fd)
+	  ? http_chunk_append_file_ref(r, sce)
+	  : http_chunk_append_file_fd(r, path, fd, sce->st.st_size);
+	if (0 == rc) {
 		r->http_status = 200;
 		r->resp_body_finished = 1;
 	}
@@ -661,7 +675,7 @@ static void http_response_xsendfile (request_st * const r, buffer * const path,
 		}
 	}
 
-	if (valid) http_response_send_file(r, path);
+	if (valid) http_response_send_file(r, path, 0);
 
 	if (r->http_status >= 400 && status < 300) {
 		r->handler_module = NULL;
@@ -931,6 +945,18 @@ static handler_t http_response_process_local_redir(request_st * const r, size_t
 }
 
 
+/* (internal states for http_response_opts framing; see response.h) */
+enum {
+  HTTP_RESPONSE_FRAMING_LENGTH = HTTP_RESPONSE_FRAMING_DONE + 1,
+  HTTP_RESPONSE_FRAMING_CHUNK_SIZE0,
+  HTTP_RESPONSE_FRAMING_CHUNK_SIZE,
+  HTTP_RESPONSE_FRAMING_CHUNK_EXT,
+  HTTP_RESPONSE_FRAMING_CHUNK_DATA,
+  HTTP_RESPONSE_FRAMING_CHUNK_CRLF,
+  HTTP_RESPONSE_FRAMING_TRAILER,
+  HTTP_RESPONSE_FRAMING_TRAILER_LINE
+};
+
 static int http_response_process_headers(request_st * const r, http_response_opts * const opts, buffer * const hdrs) {
     char *ns;
     const char *s;
@@ -956,6 +982,7 @@ static int http_response_process_headers(request_st * const r, http_response_opt
                     r->resp_htags |= HTTP_HEADER_STATUS;
                     r->http_status = status;
                 } /* else we expected 3 digits and didn't get them */
+                if (opts->framing) opts->keepalive = (s[7] == '1');
             }
 
             if (0 == r->http_status) {
@@ -1025,7 +1052,13 @@ static int http_response_process_headers(request_st * const r, http_response_opt
             }
             break;
           case HTTP_HEADER_CONNECTION:
-            if (opts->backend == BACKEND_PROXY) continue;
+            if (opts->backend == BACKEND_PROXY) {
+                if (opts->framing
+                    && http_header_str_contains_token(value, strlen(value),
+                                                      CONST_STR_LEN("close")))
+                    opts->keepalive = 0;
+                continue;
+            }
             /*(should parse for tokens and do case-insensitive match for "close"
              * but this is an imperfect though simplistic attempt to honor
              * backend request to close)*/
@@ -1036,6 +1069,16 @@ static int http_response_process_headers(request_st * const r, http_response_opt
             if (*value == '+') ++value;
             break;
           case HTTP_HEADER_TRANSFER_ENCODING:
+            if (opts->framing) {
+                /* decode chunked response from backend in order to detect
+                 * end of response; (re-encoded to client later, if needed) */
+                if (buffer_eq_icase_ss(value, strlen(value),
+                                       CONST_STR_LEN("chunked"))) {
+                    opts->framing = HTTP_RESPONSE_FRAMING_CHUNK_SIZE0;
+                    continue;
+                }
+                opts->keepalive = 0; /*(response body ends at EOF)*/
+            }
             break;
           default:
             break;
@@ -1054,6 +1097,135 @@ static int http_response_process_headers(request_st * const r, http_response_opt
 }
 
 
+static void http_response_framing_init(request_st * const r, http_response_opts * const opts) {
+    if (r->http_status < 200) {
+        /* 101 Switching Protocols; connection is not reusable
+         * (other 1xx not expected since Expect: 100-continue not forwarded)*/
+        opts->framing = HTTP_RESPONSE_FRAMING_NONE;
+        opts->keepalive = 0;
+    }
+    else if (r->http_status == 204 || r->http_status == 304
+             || r->http_method == HTTP_METHOD_HEAD) {
+        opts->framing = HTTP_RESPONSE_FRAMING_DONE; /* no response body */
+    }
+    else if (opts->framing != HTTP_RESPONSE_FRAMING_TRACK) {
+        /* Transfer-Encoding: chunked overrides Content-Length */
+        if (r->resp_htags & HTTP_HEADER_CONTENT_LENGTH) {
+            http_header_response_unset(r, HTTP_HEADER_CONTENT_LENGTH,
+                                       CONST_STR_LEN("Content-Length"));
+            r->content_length = -1;
+        }
+        opts->framing_rem = 0;
+    }
+    else if (r->resp_htags & HTTP_HEADER_CONTENT_LENGTH) {
+        opts->framing_rem = r->content_length;
+        opts->framing = (r->content_length > 0)
+          ? HTTP_RESPONSE_FRAMING_LENGTH
+          : HTTP_RESPONSE_FRAMING_DONE;
+    }
+    else {
+        opts->framing = HTTP_RESPONSE_FRAMING_NONE; /* body ends at EOF */
+        opts->keepalive = 0;
+    }
+}
+
+
+static int http_response_append_framed(request_st * const r, http_response_opts * const opts, const char *s, const size_t len) {
+    /* track end of response body (Content-Length or Transfer-Encoding: chunked)
+     * and decode chunked encoding from backend (any trailers are discarded) */
+    const char * const end = s + len;
+    while (s < end) {
+        switch (opts->framing) {
+          case HTTP_RESPONSE_FRAMING_LENGTH:
+          case HTTP_RESPONSE_FRAMING_CHUNK_DATA:
+           {
+            size_t n = (size_t)(end - s);
+            if ((off_t)n > opts->framing_rem) n = (size_t)opts->framing_rem;
+            if (0 != http_chunk_append_mem(r, s, n)) return -1;
+            s += n;
+            opts->framing_rem -= (off_t)n;
+            if (0 == opts->framing_rem)
+                opts->framing = (opts->framing == HTTP_RESPONSE_FRAMING_LENGTH)
+                  ? HTTP_RESPONSE_FRAMING_DONE
+                  : HTTP_RESPONSE_FRAMING_CHUNK_CRLF;
+            continue;
+           }
+          case HTTP_RESPONSE_FRAMING_CHUNK_SIZE0:
+          case HTTP_RESPONSE_FRAMING_CHUNK_SIZE:
+           {
+            const unsigned char c = (unsigned char)*s++;
+            const unsigned char u = (unsigned char)hex2int(c);
+            if (u != 0xFF) {
+                if (opts->framing_rem > (off_t)(1uLL<<(8*sizeof(off_t)-5))-1)
+                    break; /*(chunk size too large; error below)*/
+                opts->framing_rem <<= 4;
+                opts->framing_rem |= u;
+                opts->framing = HTTP_RESPONSE_FRAMING_CHUNK_SIZE;
+                continue;
+            }
+            if (opts->framing == HTTP_RESPONSE_FRAMING_CHUNK_SIZE) {
+                if (c == '\n') {
+                    opts->framing = (0 == opts->framing_rem)
+                      ? HTTP_RESPONSE_FRAMING_TRAILER
+                      : HTTP_RESPONSE_FRAMING_CHUNK_DATA;
+                    continue;
+                }
+                if (c == '\r' || c == ';' || c == ' ' || c == '\t') {
+                    opts->framing = HTTP_RESPONSE_FRAMING_CHUNK_EXT;
+                    continue;
+                }
+            }
+            break; /*(invalid chunk-size; error below)*/
+           }
+          case HTTP_RESPONSE_FRAMING_CHUNK_EXT:
+            /* skip chunk-ext */
+            do {
+                if (*s++ == '\n') {
+                    opts->framing = (0 == opts->framing_rem)
+                      ? HTTP_RESPONSE_FRAMING_TRAILER
+                      : HTTP_RESPONSE_FRAMING_CHUNK_DATA;
+                    break;
+                }
+            } while (s < end);
+            continue;
+          case HTTP_RESPONSE_FRAMING_CHUNK_CRLF:
+            if (*s == '\r') { ++s; continue; }
+            if (*s++ != '\n') break; /*(invalid; error below)*/
+            opts->framing = HTTP_RESPONSE_FRAMING_CHUNK_SIZE0;
+            continue;
+          case HTTP_RESPONSE_FRAMING_TRAILER:
+            if (*s == '\r') { ++s; continue; }
+            opts->framing = (*s++ == '\n')
+              ? HTTP_RESPONSE_FRAMING_DONE
+              : HTTP_RESPONSE_FRAMING_TRAILER_LINE;
+            continue;
+          case HTTP_RESPONSE_FRAMING_TRAILER_LINE:
+            do {
+                if (*s++ == '\n') {
+                    opts->framing = HTTP_RESPONSE_FRAMING_TRAILER;
+                    break;
+                }
+            } while (s < end);
+            continue;
+          case HTTP_RESPONSE_FRAMING_DONE:
+          default:
+            /* excess data received after end of response; not reusable */
+            opts->keepalive = 0;
+            return 0;
+        }
+
+        /*(break from switch() on invalid chunked encoding)*/
+        log_error(r->conf.errh, __FILE__, __LINE__,
+          "invalid chunked encoding in response from backend for %s",
+          r->uri.path.ptr);
+        opts->framing = HTTP_RESPONSE_FRAMING_NONE;
+        opts->keepalive = 0;
+        return -1;
+    }
+    return 0;
+}
+
+
 handler_t http_response_parse_headers(request_st * const r, http_response_opts * const opts, buffer * const b) {
     /**
      * possible formats of response headers:
@@ -1156,6 +1328,8 @@ handler_t http_response_parse_headers(request_st * const r, http_response_opts *
         return HANDLER_ERROR;
     }
 
+    if (opts->framing) http_response_framing_init(r, opts);
+
     r->resp_body_started = 1;
 
     if (opts->authorizer
@@ -1199,7 +1373,9 @@ handler_t http_response_parse_headers(request_st * const r, http_response_opts *
     }
 
     if (blen > 0) {
-        if (0 != http_chunk_append_mem(r, bstart, blen)) {
+        if (0 != (opts->framing
+                  ? http_response_append_framed(r, opts, bstart, blen)
+                  : http_chunk_append_mem(r, bstart, blen))) {
             return HANDLER_ERROR;
         }
     }
@@ -1209,6 +1385,31 @@ handler_t http_response_parse_headers(request_st * const r, http_response_opts *
 }
 
 
+#ifdef HAVE_SPLICE
+__attribute_pure__
+static int http_response_splice_ok(const request_st * const r, const http_response_opts * const opts) {
+    /* response body from backend is sent to client unmodified:
+     * response headers have been prepared (r->state == CON_STATE_WRITE) and
+     * response filters (e.g. mod_deflate) have declined (body not finished),
+     * no Transfer-Encoding: chunked to client, no HTTP/2 framing, no TLS;
+     * use at most one pipe: splice only if write queue is empty or if the
+     * last chunk is PIPE_CHUNK (otherwise data is read() into memory) */
+    const chunk * const c = r->write_queue->last;
+    return r->state == CON_STATE_WRITE
+        && (NULL == c || c->type == PIPE_CHUNK)
+        && NULL == opts->parse
+        && !opts->authorizer
+        && (opts->framing == HTTP_RESPONSE_FRAMING_NONE
+            || opts->framing == HTTP_RESPONSE_FRAMING_LENGTH)
+        && !r->resp_send_chunked
+        && !r->resp_body_finished
+        && r->http_status >= 200
+        && r->http_version != HTTP_VERSION_2
+        && !r->con->is_ssl_sock;
+}
+#endif
+
+
 handler_t http_response_read(request_st * const r, http_response_opts * const opts, buffer * const b, fdnode * const fdn) {
     const int fd = fdn->fd;
     while (1) {
@@ -1265,6 +1466,31 @@ handler_t http_response_read(request_st * const r, http_response_opts * const op
             }
         }
 
+      #ifdef HAVE_SPLICE
+        if (toread && r->resp_body_started && http_response_splice_ok(r,opts)) {
+            /* move data from backend to client via pipe; no userspace copy */
+            size_t len = toread;
+            if (opts->framing == HTTP_RESPONSE_FRAMING_LENGTH
+                && (off_t)len > opts->framing_rem)
+                len = (size_t)opts->framing_rem;
+            n = chunkqueue_append_splice(r->write_queue, fd, len);
+            if (n > 0) {
+                if (opts->framing == HTTP_RESPONSE_FRAMING_LENGTH
+                    && 0 == (opts->framing_rem -= n)) {
+                    opts->framing = HTTP_RESPONSE_FRAMING_DONE;
+                    return HANDLER_FINISHED; /* complete response received */
+                }
+                if ((size_t)n < len)
+                    break; /* emptied kernel read buffer or partial read */
+                continue;
+            }
+            else if (0 == n)
+                return HANDLER_FINISHED; /* read finished */
+            /* else pipe full (EAGAIN), or error; read() into memory below
+             * (read() reports EOF even if pipe is full, and reports errors) */
+        }
+      #endif
+
         if (avail < toread) {
             /*(add avail+toread to reduce allocations when ioctl EOPNOTSUPP)*/
             avail = avail ? avail - 1 + toread : toread;
@@ -1311,6 +1537,10 @@ handler_t http_response_read(request_st * const r, http_response_opts * const op
             if (rc != HANDLER_GO_ON) return rc;
             /* accumulate response in b until headers completed (or error) */
             if (r->resp_body_started) buffer_clear(b);
+        } else if (opts->framing) {
+            int rc = http_response_append_framed(r, opts, CONST_BUF_LEN(b));
+            buffer_clear(b);
+            if (0 != rc) return HANDLER_ERROR;
         } else {
             if (0 != http_chunk_append_buffer(r, b)) {
                 /* error writing to tempfile;
@@ -1320,6 +1550,9 @@ handler_t http_response_read(request_st * const r, http_response_opts * const op
             buffer_clear(b);
         }
 
+        if (opts->framing == HTTP_RESPONSE_FRAMING_DONE)
+            return HANDLER_FINISHED; /* complete response received */
+
         if (r->conf.stream_response_body & FDEVENT_STREAM_RESPONSE_BUFMIN) {
             if (chunkqueue_length(r->write_queue) > 65536 - 4096) {
                 /*(defer removal of FDEVENT_IN interest since
@@ -145,6 +145,32 @@ int http_chunk_append_file_fd(request_st * const r, const buffer * const fn, con
     return rc;
 }
 
+int http_chunk_append_file_ref(request_st * const r, stat_cache_entry * const sce) {
+    /* sce->fd is owned by sce; take reference instead of closing fd */
+    const off_t sz = sce->st.st_size;
+    if (sz > 32768) {
+        chunkqueue * const cq = r->write_queue;
+
+        if (r->resp_send_chunked)
+            http_chunk_len_append(cq, (uintmax_t)sz);
+
+        chunkqueue_append_file_fd_ref(cq, &sce->name, sce->fd, 0, sz,
+                                      stat_cache_entry_refchg, sce);
+
+        if (r->resp_send_chunked)
+            chunkqueue_append_mem(cq, CONST_STR_LEN("\r\n"));
+
+        return 0;
+    }
+
+    /*(read small files into memory)*/
+    return (0 != sz)
+      ? (-1 != lseek(sce->fd, 0, SEEK_SET))
+          ? http_chunk_append_read_fd_range(r, &sce->name, sce->fd, 0, sz)
+          : -1
+      : 0;
+}
+
 static int http_chunk_append_to_tempfile(request_st * const r, const char * const mem, const size_t len) {
     chunkqueue * const cq = r->write_queue;
     log_error_st * const errh = r->conf.errh;
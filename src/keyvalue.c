@@ -15,18 +15,326 @@
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
+#define PCRE_KEYVALUE_LITERAL_MAX 32
+
 typedef struct pcre_keyvalue {
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+	pcre2_code *code;
+	pcre2_match_data *match_data; /* preallocated (sized for pattern) */
+#elif defined(HAVE_PCRE_H)
 	pcre *key;
 	pcre_extra *key_extra;
 #endif
 	buffer value;
+	int32_t pnext;  /* next rule with same literal prefix (or -1) */
+	uint32_t slen;  /* length of literal suffix (0 if none) */
+	char suffix[PCRE_KEYVALUE_LITERAL_MAX];
 } pcre_keyvalue;
 
+#ifdef HAVE_PCRE2_H
+typedef PCRE2_SIZE pcre_keyvalue_off_t; /* match offsets (ovector) */
+#elif defined(HAVE_PCRE_H)
+typedef int pcre_keyvalue_off_t;        /* match offsets (ovector) */
+#endif
+
+/* literal prefilter for rule lists
+ *
+ * Each pattern is (conservatively) scanned at config time for a required
+ * literal prefix (pattern anchored with leading '^') and required literal
+ * suffix (pattern anchored with trailing '$').  Prefixes are inserted into a
+ * radix tree, so that a single walk of the input through the tree marks every
+ * rule whose prefix matches.  Marked rules and rules without a literal prefix
+ * are then tried in config order, checking the literal suffix before running
+ * the regex.  First-match-wins is preserved; rules which can not match are
+ * skipped without a regex execution. */
+
+typedef struct {
+	uint32_t child;   /* first child (0 if none; root is never a child) */
+	uint32_t sibling; /* next sibling (0 if none) */
+	int32_t rule;     /* first rule with prefix ending at node (or -1) */
+	uint32_t off;     /* edge label (from parent) in labels */
+	uint32_t len;
+} pcre_keyvalue_trie_node;
+
+typedef struct pcre_keyvalue_prefilter {
+	pcre_keyvalue_trie_node *nodes;
+	uint32_t nused;
+	uint32_t nsize;
+	buffer labels;
+	uint32_t words;   /* uint64_t words in always[] and bits[] */
+	uint64_t *always; /* rules without literal prefix */
+	uint64_t *bits;   /* candidate rules for current input (scratch) */
+} pcre_keyvalue_prefilter;
+
+#if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
+
+static void pcre_keyvalue_literals(const char * const s, const uint32_t len, char * const pfx, uint32_t * const plen, char * const sfx, uint32_t * const slen) {
+	/* Extract literal prefix (of pattern anchored with leading '^') and
+	 * literal suffix (of pattern anchored with trailing '$').  Anything
+	 * not understood ends the current literal run, so results may be
+	 * shorter than possible, but never wrong.  Patterns using syntax which
+	 * changes the meaning of text following it (inline options, verbs,
+	 * \Q...\E, \c) or with top-level alternation get neither. */
+	char run[PCRE_KEYVALUE_LITERAL_MAX];
+	uint32_t n = 0;
+	int depth = 0;
+	int pdone = !(len && s[0] == '^');
+	*plen = 0;
+	*slen = 0;
+	for (uint32_t i = !pdone; i < len; ++i) {
+		int c = (unsigned char)s[i];
+		switch (c) {
+		  case '\\':
+			if (++i == len) return;
+			c = (unsigned char)s[i];
+			if (c == 'Q' || c == 'c') { *plen = 0; return; }
+			if (light_isalnum(c)) {
+				/* escape sequence, class, or backreference; skip
+				 * trailing digits/letters and {...} <...> '...' arg */
+				while (i+1 < len && light_isalnum(s[i+1])) ++i;
+				if (i+1 < len
+				    && (s[i+1] == '{' || s[i+1] == '<' || s[i+1] == '\'')) {
+					const int e = s[i+1] == '{' ? '}'
+					            : s[i+1] == '<' ? '>' : '\'';
+					for (i += 2; i < len && s[i] != e; ++i) ;
+				}
+				c = -1;
+			}
+			break;
+		  case '[': /* character class */
+			if (i+1 < len && s[i+1] == '^') ++i;
+			if (i+1 < len && s[i+1] == ']') ++i;
+			for (++i; i < len && s[i] != ']'; ++i) {
+				if (s[i] == '\\') {
+					if (i+1 < len && (s[i+1] == 'Q' || s[i+1] == 'c')) {
+						*plen = 0;
+						return;
+					}
+					++i;
+				}
+				else if (s[i] == '[' && i+1 < len
+				         && (s[i+1] == ':' || s[i+1] == '.' || s[i+1] == '=')) {
+					/* POSIX [:name:] */
+					const char e = s[i+1];
+					for (i += 2; i+1 < len && !(s[i] == e && s[i+1] == ']'); ++i) ;
+					++i;
+				}
+			}
+			c = -1;
+			break;
+		  case '(':
+			if (i+1 < len
+			    && (s[i+1] == '*'
+			        || (s[i+1] == '?' && (i+2 == len || s[i+2] != ':')))) {
+				*plen = 0;
+				return;
+			}
+			++depth;
+			c = -1;
+			break;
+		  case ')':
+			--depth;
+			c = -1;
+			break;
+		  case '|':
+			if (0 == depth) { *plen = 0; return; }
+			c = -1;
+			break;
+		  case '?':
+		  case '*':
+		  case '{':
+			/* quantifier; preceding atom is optional */
+			if (!pdone && *plen) --*plen;
+			pdone = 1;
+			c = -1;
+			break;
+		  case '$':
+			if (i+1 == len && 0 == depth) {
+				memcpy(sfx, run, n);
+				*slen = n;
+				return;
+			}
+			c = -1;
+			break;
+		  case '^':
+		  case '.':
+		  case '+':
+		  case ']':
+		  case '}':
+			c = -1;
+			break;
+		  default:
+			break;
+		}
+
+		if (c < 0) {
+			pdone = 1;
+			n = 0;
+			continue;
+		}
+
+		if (!pdone) {
+			if (*plen < PCRE_KEYVALUE_LITERAL_MAX)
+				pfx[(*plen)++] = (char)c;
+			else
+				pdone = 1;
+		}
+		if (n == PCRE_KEYVALUE_LITERAL_MAX)
+			memmove(run, run+1, --n);
+		run[n++] = (char)c;
+	}
+}
+
+static uint32_t pcre_keyvalue_prefilter_node(pcre_keyvalue_prefilter * const pf, const uint32_t off, const uint32_t len) {
+	if (pf->nused == pf->nsize) {
+		pf->nsize <<= 1;
+		pf->nodes = realloc(pf->nodes, pf->nsize * sizeof(*pf->nodes));
+		force_assert(pf->nodes);
+	}
+	pcre_keyvalue_trie_node * const t = pf->nodes + pf->nused;
+	t->child = 0;
+	t->sibling = 0;
+	t->rule = -1;
+	t->off = off;
+	t->len = len;
+	return pf->nused++;
+}
+
+static void pcre_keyvalue_prefilter_insert(pcre_keyvalue_buffer * const kvb, const char * const pfx, const uint32_t plen) {
+	pcre_keyvalue_prefilter *pf = kvb->pf;
+	const int32_t rule = (int32_t)kvb->used - 1;
+	if (NULL == pf) {
+		pf = kvb->pf = calloc(1, sizeof(*pf));
+		force_assert(pf);
+		pf->nsize = 16;
+		pf->nodes = malloc(pf->nsize * sizeof(*pf->nodes));
+		force_assert(pf->nodes);
+		pcre_keyvalue_prefilter_node(pf, 0, 0); /* root */
+	}
+	if (pf->words << 6 < kvb->used) {
+		const uint32_t words = pf->words + 1;
+		pf->always = realloc(pf->always, words * sizeof(uint64_t));
+		pf->bits = realloc(pf->bits, words * sizeof(uint64_t));
+		force_assert(pf->always && pf->bits);
+		pf->always[pf->words] = 0;
+		pf->words = words;
+	}
+
+	kvb->kv[rule].pnext = -1;
+	if (0 == plen) {
+		pf->always[rule >> 6] |= (uint64_t)1 << (rule & 63);
+		return;
+	}
+
+	uint32_t n = 0;
+	for (uint32_t pos = 0; pos < plen; ) {
+		uint32_t prev = 0, x = pf->nodes[n].child;
+		while (x && pf->labels.ptr[pf->nodes[x].off] != pfx[pos]) {
+			prev = x;
+			x = pf->nodes[x].sibling;
+		}
+		if (0 == x) { /* new leaf with remainder of prefix */
+			const uint32_t off = buffer_string_length(&pf->labels);
+			buffer_append_string_len(&pf->labels, pfx+pos, plen-pos);
+			x = pcre_keyvalue_prefilter_node(pf, off, plen-pos);
+			pf->nodes[x].sibling = pf->nodes[n].child;
+			pf->nodes[n].child = x;
+			n = x;
+			break;
+		}
+		const char * const label = pf->labels.ptr + pf->nodes[x].off;
+		const uint32_t len = pf->nodes[x].len;
+		uint32_t k = 1;
+		while (k < len && pos+k < plen && label[k] == pfx[pos+k]) ++k;
+		if (k < len) { /* split edge; new interior node y takes x's place */
+			const uint32_t y =
+			  pcre_keyvalue_prefilter_node(pf, pf->nodes[x].off, k);
+			pf->nodes[y].child = x;
+			pf->nodes[y].sibling = pf->nodes[x].sibling;
+			pf->nodes[x].sibling = 0;
+			pf->nodes[x].off += k;
+			pf->nodes[x].len -= k;
+			if (prev)
+				pf->nodes[prev].sibling = y;
+			else
+				pf->nodes[n].child = y;
+			x = y;
+		}
+		n = x;
+		pos += k;
+	}
+
+	/* chain rules with identical prefix in config order */
+	int32_t *r = &pf->nodes[n].rule;
+	while (*r >= 0) r = &kvb->kv[*r].pnext;
+	*r = rule;
+}
+
+static void pcre_keyvalue_prefilter_free(pcre_keyvalue_prefilter * const pf) {
+	if (NULL == pf) return;
+	free(pf->nodes);
+	free(pf->labels.ptr);
+	free(pf->always);
+	free(pf->bits);
+	free(pf);
+}
+
+static int pcre_keyvalue_suffix_match(const pcre_keyvalue * const kv, const buffer * const input) {
+	const uint32_t slen = kv->slen;
+	const uint32_t len = buffer_string_length(input);
+	if (0 == slen) return 1;
+	/* (PCRE '$' matches at end of subject or before final newline) */
+	return (len >= slen
+	        && 0 == memcmp(input->ptr+len-slen, kv->suffix, slen))
+	    || (len > slen && input->ptr[len-1] == '\n'
+	        && 0 == memcmp(input->ptr+len-1-slen, kv->suffix, slen));
+}
+
+static int pcre_keyvalue_prefilter_next(const pcre_keyvalue_buffer * const kvb, const buffer * const input, const int i) {
+	/* next candidate rule after i (or -1) */
+	const uint64_t * const bits = kvb->pf->bits;
+	for (uint32_t r = (uint32_t)(i + 1), used = kvb->used; r < used; ++r) {
+		uint64_t w = bits[r >> 6] >> (r & 63);
+		if (0 == w) { r |= 63; continue; } /*(skip to next word)*/
+		for (; !(w & 1); w >>= 1) ++r;
+		if (pcre_keyvalue_suffix_match(kvb->kv+r, input)) return (int)r;
+	}
+	return -1;
+}
+
+static int pcre_keyvalue_prefilter_first(const pcre_keyvalue_buffer * const kvb, const buffer * const input) {
+	/* mark candidate rules for input and return first candidate (or -1) */
+	const pcre_keyvalue_prefilter * const pf = kvb->pf;
+	if (NULL == pf) return -1;
+	uint64_t * const bits = pf->bits;
+	memcpy(bits, pf->always, pf->words * sizeof(uint64_t));
+	const pcre_keyvalue_trie_node * const nodes = pf->nodes;
+	const char * const labels = pf->labels.ptr;
+	const char * const s = input->ptr;
+	for (uint32_t pos = 0, len = buffer_string_length(input), n = 0; pos < len; ) {
+		uint32_t x = nodes[n].child;
+		while (x && labels[nodes[x].off] != s[pos]) x = nodes[x].sibling;
+		if (0 == x) break;
+		const uint32_t elen = nodes[x].len;
+		if (len - pos < elen
+		    || 0 != memcmp(labels+nodes[x].off+1, s+pos+1, elen-1)) break;
+		pos += elen;
+		n = x;
+		for (int32_t r = nodes[n].rule; r >= 0; r = kvb->kv[r].pnext)
+			bits[r >> 6] |= (uint64_t)1 << (r & 63);
+	}
+	return pcre_keyvalue_prefilter_next(kvb, input, -1);
+}
+
+#endif
+
 pcre_keyvalue_buffer *pcre_keyvalue_buffer_init(void) {
 	pcre_keyvalue_buffer *kvb;
 
@@ -37,7 +345,44 @@ pcre_keyvalue_buffer *pcre_keyvalue_buffer_init(void) {
 }
 
 int pcre_keyvalue_buffer_append(log_error_st *errh, pcre_keyvalue_buffer *kvb, const buffer *key, const buffer *value) {
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+	int errcode;
+	PCRE2_SIZE erroff;
+	pcre_keyvalue *kv;
+
+	if (0 == (kvb->used & 3)) { /*(allocate in groups of 4)*/
+		kvb->kv = realloc(kvb->kv, (kvb->used + 4) * sizeof(*kvb->kv));
+		force_assert(NULL != kvb->kv);
+	}
+
+	kv = kvb->kv + kvb->used++;
+	kv->match_data = NULL;
+
+	char pfx[PCRE_KEYVALUE_LITERAL_MAX];
+	uint32_t plen;
+	pcre_keyvalue_literals(CONST_BUF_LEN(key), pfx, &plen, kv->suffix, &kv->slen);
+	pcre_keyvalue_prefilter_insert(kvb, pfx, plen);
+
+        /* copy persistent config data, and elide free() in free_data below */
+	memcpy(&kv->value, value, sizeof(buffer));
+	/*buffer_copy_buffer(&kv->value, value);*/
+
+	if (NULL == (kv->code = pcre2_compile((PCRE2_SPTR)CONST_BUF_LEN(key),
+					      0, &errcode, &erroff, NULL))) {
+		PCRE2_UCHAR errbuf[256];
+		pcre2_get_error_message(errcode, errbuf, sizeof(errbuf));
+		log_error(errh, __FILE__, __LINE__,
+		  "rexexp compilation error at offset %zu: %s (%s)",
+		  (size_t)erroff, (char *)errbuf, key->ptr);
+		return 0;
+	}
+
+	/* (JIT may be unavailable on platform; pcre2_match() then interprets) */
+	pcre2_jit_compile(kv->code, PCRE2_JIT_COMPLETE);
+
+	kv->match_data = pcre2_match_data_create_from_pattern(kv->code, NULL);
+	force_assert(kv->match_data);
+#elif defined(HAVE_PCRE_H)
 	const char *errptr;
 	int erroff;
 	pcre_keyvalue *kv;
@@ -50,6 +395,11 @@ int pcre_keyvalue_buffer_append(log_error_st *errh, pcre_keyvalue_buffer *kvb, c
 	kv = kvb->kv + kvb->used++;
 	kv->key_extra = NULL;
 
+	char pfx[PCRE_KEYVALUE_LITERAL_MAX];
+	uint32_t plen;
+	pcre_keyvalue_literals(CONST_BUF_LEN(key), pfx, &plen, kv->suffix, &kv->slen);
+	pcre_keyvalue_prefilter_insert(kvb, pfx, plen);
+
         /* copy persistent config data, and elide free() in free_data below */
 	memcpy(&kv->value, value, sizeof(buffer));
 	/*buffer_copy_buffer(&kv->value, value);*/
@@ -62,8 +412,12 @@ int pcre_keyvalue_buffer_append(log_error_st *errh, pcre_keyvalue_buffer *kvb, c
 		return 0;
 	}
 
-	if (NULL == (kv->key_extra = pcre_study(kv->key, 0, &errptr)) &&
-			errptr != NULL) {
+      #ifdef PCRE_STUDY_JIT_COMPILE
+	kv->key_extra = pcre_study(kv->key, PCRE_STUDY_JIT_COMPILE, &errptr);
+      #else
+	kv->key_extra = pcre_study(kv->key, 0, &errptr);
+      #endif
+	if (NULL == kv->key_extra && errptr != NULL) {
 		return 0;
 	}
 #else
@@ -81,23 +435,42 @@ int pcre_keyvalue_buffer_append(log_error_st *errh, pcre_keyvalue_buffer *kvb, c
 }
 
 void pcre_keyvalue_buffer_free(pcre_keyvalue_buffer *kvb) {
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+	for (uint32_t i = 0; i < kvb->used; ++i) {
+		pcre_keyvalue * const kv = kvb->kv+i;
+		if (kv->match_data) pcre2_match_data_free(kv->match_data);
+		if (kv->code) pcre2_code_free(kv->code);
+		/*free (kv->value.ptr);*//*(see pcre_keyvalue_buffer_append)*/
+	}
+
+	if (kvb->kv) free(kvb->kv);
+	pcre_keyvalue_prefilter_free(kvb->pf);
+#elif defined(HAVE_PCRE_H)
 	for (uint32_t i = 0; i < kvb->used; ++i) {
 		pcre_keyvalue * const kv = kvb->kv+i;
 		if (kv->key) pcre_free(kv->key);
+	      #ifdef PCRE_STUDY_JIT_COMPILE
+		if (kv->key_extra) pcre_free_study(kv->key_extra);
+	      #else
 		if (kv->key_extra) pcre_free(kv->key_extra);
+	      #endif
 		/*free (kv->value.ptr);*//*(see pcre_keyvalue_buffer_append)*/
 	}
 
 	if (kvb->kv) free(kvb->kv);
+	pcre_keyvalue_prefilter_free(kvb->pf);
 #endif
 	free(kvb);
 }
 
-#ifdef HAVE_PCRE_H
-static void pcre_keyvalue_buffer_append_match(buffer *b, const char **list, int n, unsigned int num, int flags) {
+#if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
+static void pcre_keyvalue_buffer_append_match(buffer *b, const char *s, const pcre_keyvalue_off_t *ovec, int n, unsigned int num, int flags) {
+    /* substitute from subject string using match offsets
+     * (no allocation of substring list) */
     if (num < (unsigned int)n) { /* n is always > 0 */
-        burl_append(b, list[num], strlen(list[num]), flags);
+        const pcre_keyvalue_off_t off = ovec[(num <<= 1)]; /*(num *= 2)*/
+        if (off != (pcre_keyvalue_off_t)-1) /*(skip unset capture group)*/
+            burl_append(b, s + off, (size_t)(ovec[num+1] - off), flags);
     }
 }
 
@@ -111,7 +484,7 @@ static void pcre_keyvalue_buffer_append_ctxmatch(buffer *b, pcre_keyvalue_ctx *c
     }
 }
 
-static int pcre_keyvalue_buffer_subst_ext(buffer *b, const char *pattern, const char **list, int n, pcre_keyvalue_ctx *ctx) {
+static int pcre_keyvalue_buffer_subst_ext(buffer *b, const char *pattern, const char *s, const pcre_keyvalue_off_t *ovec, int n, pcre_keyvalue_ctx *ctx) {
     const unsigned char *p = (unsigned char *)pattern+2;/* +2 past ${} or %{} */
     int flags = 0;
     while (!light_isdigit(*p) && *p != '}' && *p != '\0') {
@@ -243,13 +616,13 @@ static int pcre_keyvalue_buffer_subst_ext(buffer *b, const char *pattern, const
         }
         if (0 == flags) flags = BURL_ENCODE_PSNDE; /* default */
         pattern[0] == '$' /*(else '%')*/
-          ? pcre_keyvalue_buffer_append_match(b, list, n, num, flags)
+          ? pcre_keyvalue_buffer_append_match(b, s, ovec, n, num, flags)
           : pcre_keyvalue_buffer_append_ctxmatch(b, ctx, num, flags);
     }
     return (int)(p + 1 - (unsigned char *)pattern - 2);
 }
 
-static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const char **list, int n, pcre_keyvalue_ctx *ctx) {
+static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const char *s, const pcre_keyvalue_off_t *ovec, int n, pcre_keyvalue_ctx *ctx) {
 	const char *pattern = patternb->ptr;
 	const size_t pattern_len = buffer_string_length(patternb);
 	size_t start = 0;
@@ -264,13 +637,13 @@ static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const
 			buffer_append_string_len(b, pattern + start, k - start);
 
 			if (pattern[k + 1] == '{') {
-				int num = pcre_keyvalue_buffer_subst_ext(b, pattern+k, list, n, ctx);
+				int num = pcre_keyvalue_buffer_subst_ext(b, pattern+k, s, ovec, n, ctx);
 				if (num < 0) return; /* error; truncate result */
 				k += (size_t)num;
 			} else if (light_isdigit(((unsigned char *)pattern)[k + 1])) {
 				unsigned int num = (unsigned int)pattern[k + 1] - '0';
 				pattern[k] == '$' /*(else '%')*/
-				  ? pcre_keyvalue_buffer_append_match(b, list, n, num, 0)
+				  ? pcre_keyvalue_buffer_append_match(b, s, ovec, n, num, 0)
 				  : pcre_keyvalue_buffer_append_ctxmatch(b, ctx, num, 0);
 			} else {
 				/* enable escape: "%%" => "%", "%a" => "%a", "$$" => "$" */
@@ -285,8 +658,43 @@ static void pcre_keyvalue_buffer_subst(buffer *b, const buffer *patternb, const
 	buffer_append_string_len(b, pattern + start, pattern_len - start);
 }
 
+#endif
+
+#ifdef HAVE_PCRE2_H
+handler_t pcre_keyvalue_buffer_process(const pcre_keyvalue_buffer *kvb, pcre_keyvalue_ctx *ctx, const buffer *input, buffer *result) {
+    /* rules ruled out by literal prefilter are skipped (never match) */
+    for (int i = pcre_keyvalue_prefilter_first(kvb, input); i >= 0;
+         i = pcre_keyvalue_prefilter_next(kvb, input, i)) {
+        const pcre_keyvalue * const kv = kvb->kv+i;
+        int n = pcre2_match(kv->code, (PCRE2_SPTR)CONST_BUF_LEN(input),
+                            0, 0, kv->match_data, NULL);
+        if (n < 0) {
+            if (n != PCRE2_ERROR_NOMATCH) {
+                return HANDLER_ERROR;
+            }
+        }
+        else if (buffer_string_is_empty(&kv->value)) {
+            /* short-circuit if blank replacement pattern
+             * (do not attempt to match against remaining kvb rules) */
+            ctx->m = i;
+            return HANDLER_GO_ON;
+        }
+        else { /* it matched */
+            ctx->m = i;
+            pcre_keyvalue_buffer_subst(result, &kv->value, input->ptr,
+                                       pcre2_get_ovector_pointer(kv->match_data),
+                                       n, ctx);
+            return HANDLER_FINISHED;
+        }
+    }
+
+    return HANDLER_GO_ON;
+}
+#elif defined(HAVE_PCRE_H)
 handler_t pcre_keyvalue_buffer_process(const pcre_keyvalue_buffer *kvb, pcre_keyvalue_ctx *ctx, const buffer *input, buffer *result) {
-    for (int i = 0, used = (int)kvb->used; i < used; ++i) {
+    /* rules ruled out by literal prefilter are skipped (never match) */
+    for (int i = pcre_keyvalue_prefilter_first(kvb, input); i >= 0;
+         i = pcre_keyvalue_prefilter_next(kvb, input, i)) {
         const pcre_keyvalue * const kv = kvb->kv+i;
         #define N 20
         int ovec[N * 3];
@@ -305,11 +713,8 @@ handler_t pcre_keyvalue_buffer_process(const pcre_keyvalue_buffer *kvb, pcre_key
             return HANDLER_GO_ON;
         }
         else { /* it matched */
-            const char **list;
             ctx->m = i;
-            pcre_get_substring_list(input->ptr, ovec, n, &list);
-            pcre_keyvalue_buffer_subst(result, &kv->value, list, n, ctx);
-            pcre_free(list);
+            pcre_keyvalue_buffer_subst(result, &kv->value, input->ptr, ovec, n, ctx);
             return HANDLER_FINISHED;
         }
     }
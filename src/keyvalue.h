@@ -8,6 +8,7 @@
 struct burl_parts_t;    /* declaration */
 struct cond_match_t;    /* declaration */
 struct pcre_keyvalue;   /* declaration */
+struct pcre_keyvalue_prefilter; /* declaration */
 
 typedef struct pcre_keyvalue_ctx {
   struct cond_match_t *cache;
@@ -18,6 +19,7 @@ typedef struct pcre_keyvalue_ctx {
 
 typedef struct {
 	struct pcre_keyvalue *kv;
+	struct pcre_keyvalue_prefilter *pf;
 	uint32_t used;
 	uint16_t x0;
 	uint16_t x1;
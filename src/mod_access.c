@@ -11,8 +11,8 @@
 #include <string.h>
 
 typedef struct {
-    const array *access_allow;
-    const array *access_deny;
+    const array_trie *access_allow;
+    const array_trie *access_deny;
 } plugin_config;
 
 typedef struct {
@@ -25,13 +25,35 @@ INIT_FUNC(mod_access_init) {
     return calloc(1, sizeof(plugin_data));
 }
 
+FREE_FUNC(mod_access_free) {
+    plugin_data * const p = p_d;
+    if (NULL == p->cvlist) return;
+    /* (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            if (cpv->vtype != T_CONFIG_LOCAL || NULL == cpv->v.v) continue;
+            switch (cpv->k_id) {
+              case 0: /* url.access-deny */
+              case 1: /* url.access-allow */
+                array_trie_free(cpv->v.v);
+                break;
+              default:
+                break;
+            }
+        }
+    }
+}
+
 static void mod_access_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* url.access-deny */
-        pconf->access_deny = cpv->v.a;
+        if (cpv->vtype == T_CONFIG_LOCAL)
+            pconf->access_deny = cpv->v.v;
         break;
       case 1: /* url.access-allow */
-        pconf->access_allow = cpv->v.a;
+        if (cpv->vtype == T_CONFIG_LOCAL)
+            pconf->access_allow = cpv->v.v;
         break;
       default:/* should not happen */
         return;
@@ -45,12 +67,15 @@ static void mod_access_merge_config(plugin_config * const pconf, const config_pl
 }
 
 static void mod_access_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_access_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_access_set_defaults) {
@@ -70,6 +95,25 @@ SETDEFAULTS_FUNC(mod_access_set_defaults) {
     if (!config_plugin_values_init(srv, p, cpk, "mod_access"))
         return HANDLER_ERROR;
 
+    /* process and validate config directives
+     * (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            switch (cpv->k_id) {
+              case 0: /* url.access-deny */
+              case 1: /* url.access-allow */
+                cpv->v.v = array_trie_init(cpv->v.a, ARRAY_TRIE_VALUE
+                                                    |ARRAY_TRIE_SUFFIX
+                                                    |ARRAY_TRIE_NOCASE);
+                cpv->vtype = T_CONFIG_LOCAL;
+                break;
+              default:/* should not happen */
+                break;
+            }
+        }
+    }
+
     /* initialize p->defaults from global config context */
     if (p->nconfig > 0 && p->cvlist->v.u2[1]) {
         const config_plugin_value_t *cpv = p->cvlist + p->cvlist->v.u2[0];
@@ -83,7 +127,7 @@ SETDEFAULTS_FUNC(mod_access_set_defaults) {
 __attribute_cold__
 static handler_t mod_access_reject (request_st * const r, plugin_data * const p) {
     if (r->conf.log_request_handling) {
-        if (p->conf.access_allow && p->conf.access_allow->used)
+        if (p->conf.access_allow && p->conf.access_allow->a->used)
             log_error(r->conf.errh, __FILE__, __LINE__,
               "url denied as failed to match any from access_allow %s",
               r->uri.path.ptr);
@@ -98,20 +142,18 @@ static handler_t mod_access_reject (request_st * const r, plugin_data * const p)
     return HANDLER_FINISHED;
 }
 
-static int mod_access_check (const array *allow, const array *deny, const buffer *urlpath, const int lc) {
+static int mod_access_check (const array_trie *allow, const array_trie *deny, const buffer *urlpath, const int lc) {
 
-    if (allow && allow->used) {
-        const buffer *match = (!lc)
-          ? array_match_value_suffix(allow, urlpath)
-          : array_match_value_suffix_nc(allow, urlpath);
-        return (match != NULL); /* allowed if match; denied if none matched */
+    if (allow && allow->a->used) {
+        const int32_t match =
+          array_trie_match(allow, CONST_BUF_LEN(urlpath), lc);
+        return (match >= 0); /* allowed if match; denied if none matched */
     }
 
-    if (deny && deny->used) {
-        const buffer *match = (!lc)
-          ? array_match_value_suffix(deny, urlpath)
-          : array_match_value_suffix_nc(deny, urlpath);
-        return (match == NULL); /* deny if match; allow if none matched */
+    if (deny && deny->a->used) {
+        const int32_t match =
+          array_trie_match(deny, CONST_BUF_LEN(urlpath), lc);
+        return (match < 0); /* deny if match; allow if none matched */
     }
 
     return 1; /* allowed (not denied) */
@@ -154,6 +196,7 @@ int mod_access_plugin_init(plugin *p) {
 
 	p->init        = mod_access_init;
 	p->set_defaults = mod_access_set_defaults;
+	p->cleanup     = mod_access_free;
 	p->handle_uri_clean = mod_access_uri_handler;
 	p->handle_subrequest_start  = mod_access_uri_handler;
 
@@ -6,12 +6,15 @@
 #include "buffer.h"
 #include "http_header.h"
 #include "sock_addr.h"
+#include "status_counter.h"
 
 #include "plugin.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>    /* writev() */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
@@ -145,6 +148,38 @@ typedef struct {
   #endif
 } format_fields;
 
+/*
+ * Access log entries are accumulated in a per-log buffer and written in
+ * batches, when the buffer reaches accesslog.flush-size, or every
+ * accesslog.flush-interval seconds.  (Piped loggers are written after each
+ * request since the pipes are closed before plugins are freed at shutdown.)
+ *
+ * Logs written to a pipe or socket (including piped loggers) are written
+ * with non-blocking writev(), so that a stalled reader never blocks the
+ * server.  Data not accepted by the pipe is held in a pending buffer which
+ * is flushed when the fd becomes writable (FDEVENT_OUT).  While the pending
+ * buffer exceeds accesslog.buffer-max (if not 0), new log entries are
+ * dropped and counted instead of growing memory use without bound.
+ *
+ * Logs written to regular files are written with blocking write_all(),
+ * since O_NONBLOCK has no effect on regular files; a slow log disk still
+ * stalls the server while a batch is written.  (documented limitation;
+ * see doc/outdated/accesslog.txt.  Use a piped logger for slow disks.)
+ */
+
+typedef struct {
+    int log_access_fd;
+    char piped_logger;
+    char nonblock;    /* log_access_fd is non-blocking pipe or socket */
+    const buffer *access_logfile;
+    buffer access_logbuffer; /* each logfile has a separate buffer */
+    buffer pending;   /* (nonblock) data written but not accepted by fd */
+    fdnode *fdn;      /* (nonblock) registered for FDEVENT_OUT if pending */
+    fdevents *ev;
+    uint64_t dropped; /* entries dropped while pending exceeds buffer-max */
+    uint64_t blocked; /* writes which left data pending */
+} accesslog_st;
+
 typedef struct {
 	int    log_access_fd;
 	char use_syslog; /* syslog has global buffer */
@@ -152,17 +187,11 @@ typedef struct {
 	unsigned short syslog_level;
 	buffer *access_logbuffer; /* each logfile has a separate buffer */
 	const buffer *access_logfile;
+	accesslog_st *accesslog;
 
 	format_fields *parsed_format;
 } plugin_config;
 
-typedef struct {
-    int log_access_fd;
-    char piped_logger;
-    const buffer *access_logfile;
-    buffer access_logbuffer; /* each logfile has a separate buffer */
-} accesslog_st;
-
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
@@ -171,6 +200,11 @@ typedef struct {
     buffer syslog_logbuffer; /* syslog has global buffer. no caching, always written directly */
     log_error_st *errh; /* copy of srv->errh */
     format_fields *default_format;/* allocated if default format */
+
+    uint32_t flush_size;     /* accesslog.flush-size */
+    uint32_t flush_interval; /* accesslog.flush-interval */
+    uint32_t buffer_max;     /* accesslog.buffer-max */
+    int nonblock_used;
 } plugin_data;
 
 INIT_FUNC(mod_accesslog_init) {
@@ -183,6 +217,111 @@ static int accesslog_write_all(const int fd, buffer * const b) {
     return (-1 != wr);
 }
 
+static handler_t accesslog_handle_fdevent(void *ctx, int revents);
+
+static void accesslog_fdnode_del(accesslog_st * const x) {
+    if (NULL == x->fdn) return;
+    fdevent_fdnode_event_del(x->ev, x->fdn);
+    fdevent_unregister(x->ev, x->log_access_fd);
+    x->fdn = NULL;
+}
+
+static int accesslog_write_nonblock(accesslog_st * const x, buffer * const b) {
+    /* write pending data and then b in single writev() without blocking;
+     * keep unwritten data in x->pending and wait for FDEVENT_OUT */
+    struct iovec iov[2];
+    int n = 0;
+    const size_t plen = buffer_string_length(&x->pending);
+    const size_t blen = b ? buffer_string_length(b) : 0;
+    if (plen) {
+        iov[n].iov_base = x->pending.ptr;
+        iov[n].iov_len  = plen;
+        ++n;
+    }
+    if (blen) {
+        iov[n].iov_base = b->ptr;
+        iov[n].iov_len  = blen;
+        ++n;
+    }
+    if (0 == n) {
+        accesslog_fdnode_del(x);
+        return 1;
+    }
+
+    ssize_t wr;
+    do { wr = writev(x->log_access_fd, iov, n); } while (-1 == wr && errno == EINTR);
+    if (-1 == wr) {
+        if (errno != EAGAIN
+           #if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+            && errno != EWOULDBLOCK
+           #endif
+           ) {
+            buffer_clear(&x->pending);
+            if (b) buffer_clear(b);
+            accesslog_fdnode_del(x);
+            return 0;
+        }
+        wr = 0;
+    }
+
+    size_t off = (size_t)wr;
+    if (off < plen) {
+        memmove(x->pending.ptr, x->pending.ptr + off, plen - off);
+        buffer_string_set_length(&x->pending, plen - off);
+        off = 0;
+    }
+    else {
+        buffer_clear(&x->pending);
+        off -= plen;
+    }
+    if (off < blen)
+        buffer_append_string_len(&x->pending, b->ptr + off, blen - off);
+    if (b) buffer_clear(b);
+
+    if (!buffer_string_is_empty(&x->pending)) {
+        ++x->blocked;
+        if (NULL == x->fdn && NULL != x->ev)
+            x->fdn = fdevent_register(x->ev, x->log_access_fd,
+                                      accesslog_handle_fdevent, x);
+        if (NULL != x->fdn)
+            fdevent_fdnode_event_set(x->ev, x->fdn, FDEVENT_OUT);
+    }
+    else
+        accesslog_fdnode_del(x);
+
+    return 1;
+}
+
+static handler_t accesslog_handle_fdevent(void *ctx, int revents) {
+    accesslog_st * const x = ctx;
+    if (revents & (FDEVENT_HUP|FDEVENT_ERR)) {
+        /* reader went away (e.g. piped logger exited); stop polling fd,
+         * which would otherwise report HUP/ERR continuously.  Pending data
+         * is retried on next log write (piped logger might be restarted) */
+        accesslog_fdnode_del(x);
+    }
+    else if (revents & FDEVENT_OUT)
+        accesslog_write_nonblock(x, NULL);
+    return HANDLER_FINISHED;
+}
+
+static int accesslog_write(accesslog_st * const x, buffer * const b) {
+    return (x->nonblock)
+      ? accesslog_write_nonblock(x, b)
+      : accesslog_write_all(x->log_access_fd, b);
+}
+
+static void accesslog_set_nonblock(accesslog_st * const x) {
+    /* write to pipes and sockets (e.g. piped loggers) without blocking
+     * (regular files remain blocking; O_NONBLOCK has no effect on them) */
+    struct stat st;
+    x->nonblock = (0 == fstat(x->log_access_fd, &st)
+                   && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode))
+                   && 0 == fcntl(x->log_access_fd, F_SETFL,
+                                 fcntl(x->log_access_fd, F_GETFL, 0)
+                                 | O_NONBLOCK));
+}
+
 static void accesslog_append_escaped_str(buffer * const dest, const char * const str, const size_t len) {
 	const char *ptr, *start, *end;
 
@@ -432,6 +571,20 @@ static format_fields * accesslog_parse_format(const char * const format, const s
 }
 
 static void mod_accesslog_free_accesslog(accesslog_st * const x, plugin_data *p) {
+    /*(piped loggers have already been closed in config_log_error_close())*/
+    if (NULL != x->fdn) {
+        if (!x->piped_logger) fdevent_fdnode_event_del(x->ev, x->fdn);
+        fdevent_unregister(x->ev, x->log_access_fd);
+        x->fdn = NULL;
+    }
+    if (x->nonblock && !x->piped_logger && -1 != x->log_access_fd)
+        accesslog_write_nonblock(x, &x->access_logbuffer);
+    if (!buffer_string_is_empty(&x->pending)) {
+        /* do not block at shutdown waiting for slow reader */
+        log_error(p->errh, __FILE__, __LINE__,
+          "access log entries lost (%u bytes): %s",
+          buffer_string_length(&x->pending), x->access_logfile->ptr);
+    }
     /*(piped loggers are closed in fdevent_close_logger_pipes())*/
     if (!x->piped_logger && -1 != x->log_access_fd) {
         if (!accesslog_write_all(x->log_access_fd, &x->access_logbuffer)) {
@@ -441,6 +594,7 @@ static void mod_accesslog_free_accesslog(accesslog_st * const x, plugin_data *p)
         close(x->log_access_fd);
     }
     free(x->access_logbuffer.ptr);
+    free(x->pending.ptr);
 }
 
 static void mod_accesslog_free_format_fields(format_fields * const ff) {
@@ -486,6 +640,7 @@ static void mod_accesslog_merge_config_cpv(plugin_config * const pconf, const co
         pconf->piped_logger     = x->piped_logger;
         pconf->access_logfile   = x->access_logfile;
         pconf->access_logbuffer = &x->access_logbuffer;
+        pconf->accesslog        = x;
         break;
       }
       case 1:{/* accesslog.format */
@@ -499,6 +654,10 @@ static void mod_accesslog_merge_config_cpv(plugin_config * const pconf, const co
       case 3: /* accesslog.syslog-level */
         pconf->syslog_level = cpv->v.shrt;
         break;
+      case 4: /* accesslog.flush-size */
+      case 5: /* accesslog.flush-interval */
+      case 6: /* accesslog.buffer-max */
+        break;
       default:/* should not happen */
         return;
     }
@@ -511,11 +670,14 @@ static void mod_accesslog_merge_config(plugin_config * const pconf, const config
 }
 
 static void mod_accesslog_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_accesslog_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 static format_fields * mod_accesslog_process_format(const char * const format, const size_t flen, server * const srv);
@@ -534,6 +696,15 @@ SETDEFAULTS_FUNC(mod_accesslog_set_defaults) {
      ,{ CONST_STR_LEN("accesslog.syslog-level"),
         T_CONFIG_SHORT,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("accesslog.flush-size"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("accesslog.flush-interval"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
+     ,{ CONST_STR_LEN("accesslog.buffer-max"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -544,6 +715,10 @@ SETDEFAULTS_FUNC(mod_accesslog_set_defaults) {
     if (!config_plugin_values_init(srv, p, cpk, "mod_accesslog"))
         return HANDLER_ERROR;
 
+    p->flush_size = 8192;
+    p->flush_interval = 4;
+    p->buffer_max = 1024 * 1024;
+
     /* process and validate config directives
      * (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
@@ -595,6 +770,15 @@ SETDEFAULTS_FUNC(mod_accesslog_set_defaults) {
                 break;
               case 3: /* accesslog.syslog-level */
                 break;
+              case 4: /* accesslog.flush-size */
+                p->flush_size = cpv->v.u;
+                break;
+              case 5: /* accesslog.flush-interval */
+                p->flush_interval = cpv->v.u ? cpv->v.u : 1;
+                break;
+              case 6: /* accesslog.buffer-max */
+                p->buffer_max = cpv->v.u;
+                break;
               default:/* should not happen */
                 break;
             }
@@ -611,6 +795,8 @@ SETDEFAULTS_FUNC(mod_accesslog_set_defaults) {
               "opening log '%s' failed", x->access_logfile->ptr);
             return HANDLER_ERROR;
         }
+        accesslog_set_nonblock(x);
+        p->nonblock_used |= x->nonblock;
     }
 
     p->defaults.log_access_fd = -1;
@@ -739,9 +925,9 @@ static void log_access_flush(plugin_data * const p) {
               case 0: /* accesslog.filename */
                 if (cpv->vtype == T_CONFIG_LOCAL && NULL != cpv->v.v) {
                     accesslog_st * const x = cpv->v.v;
-                    if (buffer_string_is_empty(&x->access_logbuffer)) continue;
-                    if (!accesslog_write_all(x->log_access_fd,
-                                             &x->access_logbuffer)) {
+                    if (buffer_string_is_empty(&x->access_logbuffer)
+                        && buffer_string_is_empty(&x->pending)) continue;
+                    if (!accesslog_write(x, &x->access_logbuffer)) {
                         log_perror(p->errh, __FILE__, __LINE__,
                           "writing access log entry failed: %s",
                           x->access_logfile->ptr);
@@ -755,9 +941,30 @@ static void log_access_flush(plugin_data * const p) {
     }
 }
 
+static void log_access_counters(plugin_data * const p) {
+    uint64_t dropped = 0, blocked = 0, pending = 0;
+    /* (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            if (cpv->vtype != T_CONFIG_LOCAL || NULL == cpv->v.v) continue;
+            if (0 != cpv->k_id) continue; /* accesslog.filename */
+            const accesslog_st * const x = cpv->v.v;
+            dropped += x->dropped;
+            blocked += x->blocked;
+            pending += buffer_string_length(&x->pending);
+        }
+    }
+    status_counter_set(CONST_STR_LEN("accesslog.dropped"), (int)dropped);
+    status_counter_set(CONST_STR_LEN("accesslog.blocked"), (int)blocked);
+    status_counter_set(CONST_STR_LEN("accesslog.pending-bytes"), (int)pending);
+}
+
 TRIGGER_FUNC(log_access_periodic_flush) {
-    /* flush buffered access logs every 4 seconds */
-    if (0 == (log_epoch_secs & 3)) log_access_flush((plugin_data *)p_d);
+    /* flush buffered access logs every accesslog.flush-interval seconds */
+    plugin_data * const p = p_d;
+    if (0 == (log_epoch_secs % p->flush_interval)) log_access_flush(p);
+    if (p->nonblock_used) log_access_counters(p);
     UNUSED(srv);
     return HANDLER_GO_ON;
 }
@@ -779,11 +986,14 @@ SIGHUP_FUNC(log_access_cycle) {
                 accesslog_st * const x = cpv->v.v;
                 if (x->piped_logger) continue;
                 if (buffer_string_is_empty(x->access_logfile)) continue;
+                accesslog_fdnode_del(x);
                 if (-1 == fdevent_cycle_logger(x->access_logfile->ptr,
                                                &x->log_access_fd)) {
                     log_perror(srv->errh, __FILE__, __LINE__,
                       "cycling access log failed: %s", x->access_logfile->ptr);
                 }
+                accesslog_set_nonblock(x);
+                p->nonblock_used |= x->nonblock;
                 break;
               }
               default:
@@ -981,8 +1191,8 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 				break;
 
 			case FORMAT_BYTES_OUT_NO_HEADER:
-				if (con->bytes_written > 0) {
-					off_t bytes = con->bytes_written - (off_t)r->resp_header_len;
+				if (request_bytes_written(r) > 0) {
+					off_t bytes = request_bytes_written(r) - (off_t)r->resp_header_len;
 					buffer_append_int(b, bytes > 0 ? bytes : 0);
 				} else {
 					buffer_append_string_len(b, CONST_STR_LEN("-"));
@@ -1018,15 +1228,15 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 				}
 				break;
 			case FORMAT_BYTES_OUT:
-				if (con->bytes_written > 0) {
-					buffer_append_int(b, con->bytes_written);
+				if (request_bytes_written(r) > 0) {
+					buffer_append_int(b, request_bytes_written(r));
 				} else {
 					buffer_append_string_len(b, CONST_STR_LEN("-"));
 				}
 				break;
 			case FORMAT_BYTES_IN:
-				if (con->bytes_read > 0) {
-					buffer_append_int(b, con->bytes_read);
+				if (request_bytes_read(r) > 0) {
+					buffer_append_int(b, request_bytes_read(r));
 				} else {
 					buffer_append_string_len(b, CONST_STR_LEN("-"));
 				}
@@ -1046,8 +1256,7 @@ static int log_access_record (const request_st * const r, buffer * const b, form
 				}
 				break;
 			case FORMAT_REQUEST_PROTOCOL:
-				buffer_append_string_len(b,
-					r->http_version == HTTP_VERSION_1_1 ? "HTTP/1.1" : "HTTP/1.0", 8);
+				buffer_append_string(b, get_http_version_name(r->http_version));
 				break;
 			case FORMAT_REQUEST_METHOD:
 				http_method_append(b, r->http_method);
@@ -1162,6 +1371,17 @@ REQUESTDONE_FUNC(log_access_write) {
 	  ? &p->syslog_logbuffer
 	  : p->conf.access_logbuffer;
 
+	accesslog_st * const x = p->conf.accesslog;
+	if (!p->conf.use_syslog && x->nonblock) {
+		/* drop log entry if reader is not keeping up with log */
+		if (p->buffer_max
+		    && buffer_string_length(&x->pending) >= p->buffer_max) {
+			++x->dropped;
+			return HANDLER_GO_ON;
+		}
+		if (NULL == x->ev) x->ev = r->con->srv->ev;
+	}
+
 	const int flush = p->conf.piped_logger
 	                | log_access_record(r, b, p->conf.parsed_format);
 
@@ -1177,8 +1397,8 @@ REQUESTDONE_FUNC(log_access_write) {
 	else {
 		buffer_append_string_len(b, CONST_STR_LEN("\n"));
 
-		if (flush || buffer_string_length(b) >= 8192) {
-			if (!accesslog_write_all(p->conf.log_access_fd, b)) {
+		if (flush || buffer_string_length(b) >= p->flush_size) {
+			if (!accesslog_write(x, b)) {
 				log_perror(r->conf.errh, __FILE__, __LINE__,
 				  "writing access log entry failed: %s",
 				  p->conf.access_logfile->ptr);
@@ -11,7 +11,7 @@
 #include <string.h>
 
 typedef struct {
-    const array *alias;
+    const array_trie *alias;
 } plugin_config;
 
 typedef struct {
@@ -24,10 +24,30 @@ INIT_FUNC(mod_alias_init) {
     return calloc(1, sizeof(plugin_data));
 }
 
+FREE_FUNC(mod_alias_free) {
+    plugin_data * const p = p_d;
+    if (NULL == p->cvlist) return;
+    /* (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            if (cpv->vtype != T_CONFIG_LOCAL || NULL == cpv->v.v) continue;
+            switch (cpv->k_id) {
+              case 0: /* alias.url */
+                array_trie_free(cpv->v.v);
+                break;
+              default:
+                break;
+            }
+        }
+    }
+}
+
 static void mod_alias_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* alias.url */
-        pconf->alias = cpv->v.a;
+        if (cpv->vtype == T_CONFIG_LOCAL)
+            pconf->alias = cpv->v.v;
         break;
       default:/* should not happen */
         return;
@@ -41,12 +61,15 @@ static void mod_alias_merge_config(plugin_config * const pconf, const config_plu
 }
 
 static void mod_alias_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_alias_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 static int mod_alias_check_order(server * const srv, const array * const a) {
@@ -94,12 +117,16 @@ SETDEFAULTS_FUNC(mod_alias_set_defaults) {
     /* process and validate config directives
      * (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
-        const config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
         for (; -1 != cpv->k_id; ++cpv) {
             switch (cpv->k_id) {
               case 0: /* alias.url */
                 if (cpv->v.a->used >= 2 && !mod_alias_check_order(srv,cpv->v.a))
                     return HANDLER_ERROR;
+                cpv->v.v = array_trie_init(cpv->v.a,
+                                           ARRAY_TRIE_KEY | ARRAY_TRIE_PREFIX
+                                           | ARRAY_TRIE_NOCASE);
+                cpv->vtype = T_CONFIG_LOCAL;
                 break;
               default:/* should not happen */
                 break;
@@ -136,8 +163,8 @@ PHYSICALPATH_FUNC(mod_alias_physical_handler) {
 	uri_ptr = r->physical.path.ptr + basedir_len;
 
 	ds = (!r->conf.force_lowercase_filenames)
-	   ? (data_string *)array_match_key_prefix_klen(p->conf.alias, uri_ptr, uri_len)
-	   : (data_string *)array_match_key_prefix_nc_klen(p->conf.alias, uri_ptr, uri_len);
+	   ? (data_string *)array_trie_match_key(p->conf.alias, uri_ptr, uri_len, 0)
+	   : (data_string *)array_trie_match_key(p->conf.alias, uri_ptr, uri_len, 1);
 	if (NULL == ds) { return HANDLER_GO_ON; }
 
 			/* matched */
@@ -176,6 +203,7 @@ int mod_alias_plugin_init(plugin *p) {
 	p->init           = mod_alias_init;
 	p->handle_physical= mod_alias_physical_handler;
 	p->set_defaults   = mod_alias_set_defaults;
+	p->cleanup        = mod_alias_free;
 
 	return 0;
 }
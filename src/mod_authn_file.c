@@ -22,10 +22,14 @@
 #include "plugin.h"
 #include "http_auth.h"
 #include "log.h"
+#include "splaytree.h"  /* djbhash() */
+#include "stat_cache.h"
 
 #include "base64.h"
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -37,11 +41,37 @@
  * htdigest, htpasswd, plain auth backends
  */
 
+/*
+ * user file is parsed into an in-memory hash index (open addressing) keyed by
+ * "user" (htpasswd, plain) or "user:realm" (htdigest), and is reloaded when
+ * stat_cache reports that the file has changed
+ */
+
+typedef struct {
+    const char *k;  /* key (start of line in db->data); NULL if slot empty */
+    uint32_t klen;
+    uint32_t vlen;  /* hashed password follows key and ':' separator */
+    uint32_t hash;
+} authn_file_rec;
+
+typedef struct {
+    const buffer *fn;
+    int htdigest;   /* key is "user:realm" */
+    authn_file_rec *recs;
+    uint32_t mask;
+    char *data;     /* file contents */
+    size_t dlen;
+    time_t mtime;
+    time_t ctime;
+    off_t size;
+    ino_t ino;
+} authn_file_db;
+
 typedef struct {
     const buffer *auth_plain_groupfile;
-    const buffer *auth_plain_userfile;
-    const buffer *auth_htdigest_userfile;
-    const buffer *auth_htpasswd_userfile;
+    authn_file_db *auth_plain_userfile;
+    authn_file_db *auth_htdigest_userfile;
+    authn_file_db *auth_htpasswd_userfile;
 } plugin_config;
 
 typedef struct {
@@ -80,19 +110,68 @@ INIT_FUNC(mod_authn_file_init) {
     return p;
 }
 
+static authn_file_db * mod_authn_file_db_init(const buffer *fn, int htdigest) {
+    authn_file_db * const db = calloc(1, sizeof(*db));
+    force_assert(db);
+    db->fn = fn;
+    db->htdigest = htdigest;
+    return db;
+}
+
+static void mod_authn_file_db_clear(authn_file_db * const db) {
+    if (db->data) {
+        safe_memclear(db->data, db->dlen);
+        free(db->data);
+        db->data = NULL;
+        db->dlen = 0;
+    }
+    free(db->recs);
+    db->recs = NULL;
+    db->mask = 0;
+}
+
+static void mod_authn_file_db_free(authn_file_db * const db) {
+    mod_authn_file_db_clear(db);
+    free(db);
+}
+
+FREE_FUNC(mod_authn_file_free) {
+    plugin_data * const p = p_d;
+    if (NULL == p->cvlist) return;
+    /* (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            if (cpv->vtype != T_CONFIG_LOCAL || NULL == cpv->v.v) continue;
+            switch (cpv->k_id) {
+              case 1: /* auth.backend.plain.userfile */
+              case 2: /* auth.backend.htdigest.userfile */
+              case 3: /* auth.backend.htpasswd.userfile */
+                mod_authn_file_db_free(cpv->v.v);
+                break;
+              default:
+                break;
+            }
+        }
+    }
+}
+
 static void mod_authn_file_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* auth.backend.plain.groupfile */
         pconf->auth_plain_groupfile = cpv->v.b;
         break;
       case 1: /* auth.backend.plain.userfile */
-        pconf->auth_plain_userfile = cpv->v.b;
+        pconf->auth_plain_userfile =
+          (cpv->vtype == T_CONFIG_LOCAL) ? cpv->v.v : NULL;
         break;
       case 2: /* auth.backend.htdigest.userfile */
-        pconf->auth_htdigest_userfile = cpv->v.b;
+        pconf->auth_htdigest_userfile =
+          (cpv->vtype == T_CONFIG_LOCAL) ? cpv->v.v : NULL;
         break;
       case 3: /* auth.backend.htpasswd.userfile */
-        pconf->auth_htpasswd_userfile = cpv->v.b;
+        pconf->auth_htpasswd_userfile =
+          (cpv->vtype == T_CONFIG_LOCAL) ? cpv->v.v : NULL;
         break;
       default:/* should not happen */
         return;
@@ -106,6 +185,8 @@ static void mod_authn_file_merge_config(plugin_config * const pconf, const confi
 }
 
 static void mod_authn_file_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
@@ -113,6 +194,7 @@ static void mod_authn_file_patch_config(request_st * const r, plugin_data * cons
             mod_authn_file_merge_config(&p->conf,
                                         p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_authn_file_set_defaults) {
@@ -138,6 +220,28 @@ SETDEFAULTS_FUNC(mod_authn_file_set_defaults) {
     if (!config_plugin_values_init(srv, p, cpk, "mod_authn_file"))
         return HANDLER_ERROR;
 
+    /* process and validate config directives
+     * (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            switch (cpv->k_id) {
+              case 0: /* auth.backend.plain.groupfile */
+                break;
+              case 1: /* auth.backend.plain.userfile */
+              case 2: /* auth.backend.htdigest.userfile */
+              case 3: /* auth.backend.htpasswd.userfile */
+                if (!buffer_string_is_empty(cpv->v.b)) {
+                    cpv->v.v = mod_authn_file_db_init(cpv->v.b, 2==cpv->k_id);
+                    cpv->vtype = T_CONFIG_LOCAL;
+                }
+                break;
+              default:/* should not happen */
+                break;
+            }
+        }
+    }
+
     /* initialize p->defaults from global config context */
     if (p->nconfig > 0 && p->cvlist->v.u2[1]) {
         const config_plugin_value_t *cpv = p->cvlist + p->cvlist->v.u2[0];
@@ -207,73 +311,181 @@ static void mod_authn_file_digest(http_auth_info_t *ai, const char *pw, size_t p
 
 
 
-static int mod_authn_file_htdigest_get_loop(FILE *fp, const buffer *auth_fn, http_auth_info_t *ai, log_error_st *errh) {
-    char f_user[1024];
+static uint32_t mod_authn_file_db_hash(const char *user, size_t ulen, const char *realm, size_t rlen) {
+    /* (djbhash() chained over "user:realm" for htdigest; "user" otherwise) */
+    uint32_t h = djbhash(user, ulen, DJBHASH_INIT);
+    if (realm) {
+        h = djbhash(":", 1, h);
+        h = djbhash(realm, rlen, h);
+    }
+    return h;
+}
 
-    while (NULL != fgets(f_user, sizeof(f_user), fp)) {
-        char *f_pwd, *f_realm;
-        size_t u_len, r_len;
+static void mod_authn_file_db_insert(authn_file_db * const db, const char *k, uint32_t klen, uint32_t vlen, uint32_t hash) {
+    /* (table sized in mod_authn_file_db_load(); never full) */
+    /* (duplicate keys are kept, in file order, and probed in order) */
+    uint32_t i = hash & db->mask;
+    while (NULL != db->recs[i].k) i = (i + 1) & db->mask;
+    db->recs[i].k = k;
+    db->recs[i].klen = klen;
+    db->recs[i].vlen = vlen;
+    db->recs[i].hash = hash;
+}
+
+static int mod_authn_file_db_load(authn_file_db * const db, const struct stat * const sst, log_error_st * const errh) {
+    struct stat st;
+    const int fd = stat_cache_open_rdonly_fstat(db->fn, &st, 1);
+    if (fd < 0) return -1;
+
+    mod_authn_file_db_clear(db);
+
+    /* (st.st_size of user file expected to be reasonably small) */
+    char * const data = malloc((size_t)st.st_size + 1);
+    force_assert(data);
+    size_t dlen = 0;
+    while (dlen < (size_t)st.st_size) {
+        ssize_t rd = read(fd, data+dlen, (size_t)st.st_size - dlen);
+        if (rd > 0)
+            dlen += (size_t)rd;
+        else if (0 == rd)
+            break;
+        else if (errno != EINTR) {
+            log_perror(errh, __FILE__, __LINE__, "reading %s", db->fn->ptr);
+            close(fd);
+            safe_memclear(data, dlen);
+            free(data);
+            return -1;
+        }
+    }
+    close(fd);
+    data[dlen] = '\0';
+    db->data = data;
+    db->dlen = dlen;
+
+    uint32_t lines = 1;
+    for (const char *s = data; (s = memchr(s, '\n', dlen-(size_t)(s-data)));++s)
+        ++lines;
+    uint32_t sz = 16;
+    while (sz < (lines << 1)) sz <<= 1;
+    db->recs = calloc(sz, sizeof(authn_file_rec));
+    force_assert(db->recs);
+    db->mask = sz - 1;
+
+    for (char *b = data, *e; b < data+dlen; b = e+1) {
+        e = memchr(b, '\n', dlen-(size_t)(b-data));
+        if (NULL == e) e = data+dlen;
+        *e = '\0';
 
         /* skip blank lines and comment lines (beginning '#') */
-        if (f_user[0] == '#' || f_user[0] == '\n' || f_user[0] == '\0') continue;
+        if (b[0] == '#' || b[0] == '\0') continue;
 
         /*
+         * htpasswd format
+         *
+         * user:crypted passwd
+         *
          * htdigest format
          *
          * user:realm:md5(user:realm:password)
          */
 
-        if (NULL == (f_realm = strchr(f_user, ':'))
-            || NULL == (f_pwd = strchr(f_realm + 1, ':'))) {
-            log_error(errh, __FILE__, __LINE__,
-              "parsed error in %s expected 'username:realm:hashed password'",
-              auth_fn->ptr);
+        char *f_pwd = strchr(b, ':');
+        if (NULL == f_pwd) {
+            if (db->htdigest)
+                log_error(errh, __FILE__, __LINE__,
+                  "parsed error in %s expected 'username:realm:hashed password'",
+                  db->fn->ptr);
+            else
+                log_error(errh, __FILE__, __LINE__,
+                  "parsed error in %s expected 'username:hashed password'",
+                  db->fn->ptr);
             continue; /* skip bad lines */
         }
+        uint32_t hash;
+        if (db->htdigest) {
+            char * const f_realm = f_pwd + 1;
+            if (NULL == (f_pwd = strchr(f_realm, ':'))) {
+                log_error(errh, __FILE__, __LINE__,
+                  "parsed error in %s expected 'username:realm:hashed password'",
+                  db->fn->ptr);
+                continue; /* skip bad lines */
+            }
+            hash = mod_authn_file_db_hash(b, (size_t)(f_realm - 1 - b),
+                                          f_realm, (size_t)(f_pwd - f_realm));
+        }
+        else
+            hash = mod_authn_file_db_hash(b, (size_t)(f_pwd - b), NULL, 0);
 
-        /* get pointers to the fields */
-        u_len = f_realm - f_user;
-        f_realm++;
-        r_len = f_pwd - f_realm;
-        f_pwd++;
-
-        if (ai->ulen == u_len && ai->rlen == r_len
-            && 0 == memcmp(ai->username, f_user, u_len)
-            && 0 == memcmp(ai->realm, f_realm, r_len)) {
-            /* found */
+        mod_authn_file_db_insert(db, b, (uint32_t)(f_pwd - b),
+                                 (uint32_t)(e - f_pwd - 1), hash);
+    }
 
-            size_t pwd_len = strlen(f_pwd);
-            if (f_pwd[pwd_len-1] == '\n') --pwd_len;
+    /* (record the stat_cache view of the file; see mod_authn_file_db_get()) */
+    db->mtime = sst->st_mtime;
+    db->ctime = sst->st_ctime;
+    db->size  = sst->st_size;
+    db->ino   = sst->st_ino;
+    return 0;
+}
 
-            if (pwd_len != (ai->dlen << 1)) continue;
-            return http_auth_digest_hex2bin(f_pwd, pwd_len,
-                                            ai->digest, sizeof(ai->digest));
+static authn_file_db * mod_authn_file_db_get(authn_file_db * const db, log_error_st * const errh) {
+    if (NULL == db) return NULL;
+    const stat_cache_entry * const sce = stat_cache_get_entry(db->fn);
+    if (NULL == sce) {
+        log_perror(errh, __FILE__, __LINE__,
+          "opening %s %s", db->htdigest ? "digest-userfile" : "userfile",
+          db->fn->ptr);
+        mod_authn_file_db_clear(db);
+        return NULL;
+    }
+    const struct stat * const st = &sce->st;
+    if (NULL == db->recs
+        || db->mtime != st->st_mtime || db->ctime != st->st_ctime
+        || db->size  != st->st_size  || db->ino   != st->st_ino) {
+        if (0 != mod_authn_file_db_load(db, st, errh)) {
+            log_perror(errh, __FILE__, __LINE__,
+              "opening %s %s", db->htdigest ? "digest-userfile" : "userfile",
+              db->fn->ptr);
+            return NULL;
         }
     }
+    return db;
+}
 
-    return -1;
+static const authn_file_rec * mod_authn_file_db_find(const authn_file_db * const db, const authn_file_rec *prev, const char *user, size_t ulen, const char *realm, size_t rlen) {
+    const size_t klen = realm ? ulen + 1 + rlen : ulen;
+    const uint32_t hash = mod_authn_file_db_hash(user, ulen, realm, rlen);
+    uint32_t i = prev ? ((uint32_t)(prev - db->recs) + 1) & db->mask
+                      : hash & db->mask;
+    for (const authn_file_rec *rec; NULL != (rec = db->recs+i)->k;
+         i = (i + 1) & db->mask) {
+        if (rec->hash == hash && rec->klen == klen
+            && 0 == memcmp(rec->k, user, ulen)
+            && (NULL == realm
+                || (rec->k[ulen] == ':'
+                    && 0 == memcmp(rec->k+ulen+1, realm, rlen))))
+            return rec;
+    }
+    return NULL;
 }
 
 static int mod_authn_file_htdigest_get(request_st * const r, void *p_d, http_auth_info_t * const ai) {
     plugin_data *p = (plugin_data *)p_d;
-    const buffer *auth_fn;
-    FILE *fp;
+    const authn_file_db *db;
 
     mod_authn_file_patch_config(r, p);
-    auth_fn = p->conf.auth_htdigest_userfile;
-    if (buffer_string_is_empty(auth_fn)) return -1;
-
-    fp = fopen(auth_fn->ptr, "r");
-    if (NULL != fp) {
-        int rc = mod_authn_file_htdigest_get_loop(fp,auth_fn,ai,r->conf.errh);
-        fclose(fp);
-        return rc;
-    }
-    else {
-        log_perror(r->conf.errh, __FILE__, __LINE__,
-          "opening digest-userfile %s", auth_fn->ptr);
-        return -1;
+    db = mod_authn_file_db_get(p->conf.auth_htdigest_userfile, r->conf.errh);
+    if (NULL == db) return -1;
+
+    for (const authn_file_rec *rec = NULL;
+         NULL != (rec = mod_authn_file_db_find(db, rec, ai->username, ai->ulen,
+                                               ai->realm, ai->rlen)); ) {
+        if (rec->vlen != (ai->dlen << 1)) continue;
+        return http_auth_digest_hex2bin(rec->k+rec->klen+1, rec->vlen,
+                                        ai->digest, sizeof(ai->digest));
     }
+
+    return -1;
 }
 
 static handler_t mod_authn_file_htdigest_digest(request_st * const r, void *p_d, http_auth_info_t * const ai) {
@@ -310,60 +522,18 @@ static handler_t mod_authn_file_htdigest_basic(request_st * const r, void *p_d,
 
 
 
-static int mod_authn_file_htpasswd_get(const buffer *auth_fn, const char *username, size_t userlen, buffer *password, log_error_st *errh) {
-    FILE *fp;
-    char f_user[1024];
-
+static int mod_authn_file_htpasswd_get(authn_file_db *db, const char *username, size_t userlen, buffer *password, log_error_st *errh) {
     if (NULL == username) return -1;
 
-    if (buffer_string_is_empty(auth_fn)) return -1;
-    fp = fopen(auth_fn->ptr, "r");
-    if (NULL == fp) {
-        log_perror(errh, __FILE__, __LINE__,
-                "opening plain-userfile %s", auth_fn->ptr);
+    db = mod_authn_file_db_get(db, errh);
+    if (NULL == db) return -1;
 
-        return -1;
-    }
-
-    while (NULL != fgets(f_user, sizeof(f_user), fp)) {
-        char *f_pwd;
-        size_t u_len;
-
-        /* skip blank lines and comment lines (beginning '#') */
-        if (f_user[0] == '#' || f_user[0] == '\n' || f_user[0] == '\0') continue;
+    const authn_file_rec * const rec =
+      mod_authn_file_db_find(db, NULL, username, userlen, NULL, 0);
+    if (NULL == rec) return -1;
 
-        /*
-         * htpasswd format
-         *
-         * user:crypted passwd
-         */
-
-        if (NULL == (f_pwd = strchr(f_user, ':'))) {
-            log_error(errh, __FILE__, __LINE__,
-              "parsed error in %s expected 'username:hashed password'",
-              auth_fn->ptr);
-            continue; /* skip bad lines */
-        }
-
-        /* get pointers to the fields */
-        u_len = f_pwd - f_user;
-        f_pwd++;
-
-        if (userlen == u_len && 0 == memcmp(username, f_user, u_len)) {
-            /* found */
-
-            size_t pwd_len = strlen(f_pwd);
-            if (f_pwd[pwd_len-1] == '\n') --pwd_len;
-
-            buffer_copy_string_len(password, f_pwd, pwd_len);
-
-            fclose(fp);
-            return 0;
-        }
-    }
-
-    fclose(fp);
-    return -1;
+    buffer_copy_string_len(password, rec->k+rec->klen+1, rec->vlen);
+    return 0;
 }
 
 static handler_t mod_authn_file_plain_digest(request_st * const r, void *p_d, http_auth_info_t * const ai) {
@@ -715,6 +885,7 @@ int mod_authn_file_plugin_init(plugin *p) {
     p->name        = "authn_file";
     p->init        = mod_authn_file_init;
     p->set_defaults= mod_authn_file_set_defaults;
+    p->cleanup     = mod_authn_file_free;
 
     return 0;
 }
@@ -90,6 +90,8 @@ static void mod_authn_gssapi_merge_config(plugin_config * const pconf, const con
 }
 
 static void mod_authn_gssapi_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
@@ -97,6 +99,7 @@ static void mod_authn_gssapi_patch_config(request_st * const r, plugin_data * co
             mod_authn_gssapi_merge_config(&p->conf,
                                         p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_authn_gssapi_set_defaults) {
@@ -198,12 +198,15 @@ static void mod_authn_mysql_merge_config(plugin_config * const pconf, const conf
 }
 
 static void mod_authn_mysql_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_authn_mysql_merge_config(&p->conf,
                                         p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_authn_mysql_set_defaults) {
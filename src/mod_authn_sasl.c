@@ -94,6 +94,8 @@ static void mod_authn_sasl_merge_config(plugin_config * const pconf, const confi
 }
 
 static void mod_authn_sasl_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
@@ -101,6 +103,7 @@ static void mod_authn_sasl_patch_config(request_st * const r, plugin_data * cons
             mod_authn_sasl_merge_config(&p->conf,
                                         p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 static plugin_config * mod_authn_sasl_parse_opts(server *srv, const array * const opts) {
@@ -180,12 +180,15 @@ static void mod_cgi_merge_config(plugin_config * const pconf, const config_plugi
 }
 
 static void mod_cgi_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_cgi_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_cgi_set_defaults) {
@@ -679,6 +682,12 @@ static int cgi_write_request(handler_ctx *hctx, int fd) {
 				chunkqueue_mark_written(cq, wr);
 			}
 			break;
+
+		case PIPE_CHUNK: /*(not used in request body)*/
+		default:
+			log_error(r->conf.errh, __FILE__, __LINE__,
+			  "%d type not known", c->type);
+			break;
 		}
 
 		if (0 == wr) break; /*(might block)*/
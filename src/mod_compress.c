@@ -61,10 +61,6 @@ static void sigbus_handler(int sig) {
 #define HTTP_ACCEPT_ENCODING_X_GZIP   BV(5)
 #define HTTP_ACCEPT_ENCODING_X_BZIP2  BV(6)
 
-#ifdef __WIN32
-# define mkdir(x,y) mkdir(x)
-#endif
-
 typedef struct {
     const array *compress;
     const buffer *compress_cache_dir;
@@ -95,50 +91,6 @@ FREE_FUNC(mod_compress_free) {
     buffer_free(p->b);
 }
 
-/* 0 on success, -1 for error */
-static int mkdir_recursive(char *dir) {
-	char *p = dir;
-
-	if (!dir || !dir[0])
-		return 0;
-
-	while ((p = strchr(p + 1, '/')) != NULL) {
-
-		*p = '\0';
-		if ((mkdir(dir, 0700) != 0) && (errno != EEXIST)) {
-			*p = '/';
-			return -1;
-		}
-
-		*p++ = '/';
-		if (!*p) return 0; /* Ignore trailing slash */
-	}
-
-	return (mkdir(dir, 0700) != 0) && (errno != EEXIST) ? -1 : 0;
-}
-
-/* 0 on success, -1 for error */
-static int mkdir_for_file(char *filename) {
-	char *p = filename;
-
-	if (!filename || !filename[0])
-		return -1;
-
-	while ((p = strchr(p + 1, '/')) != NULL) {
-
-		*p = '\0';
-		if ((mkdir(filename, 0700) != 0) && (errno != EEXIST)) {
-			*p = '/';
-			return -1;
-		}
-
-		*p++ = '/';
-		if (!*p) return -1; /* Unexpected trailing slash in filename */
-	}
-
-	return 0;
-}
-
 static void mod_compress_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* compress.filetype */
@@ -168,11 +120,14 @@ static void mod_compress_merge_config(plugin_config * const pconf, const config_
 }
 
 static void mod_compress_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_compress_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 static short mod_compress_encodings_to_flags(const array *encodings) {
@@ -262,7 +217,7 @@ SETDEFAULTS_FUNC(mod_compress_set_defaults) {
               case 2: /* compress.cache-dir */
                 if (!buffer_string_is_empty(cpv->v.b)) {
                     struct stat st;
-                    mkdir_recursive(cpv->v.b->ptr);
+                    fdevent_mkdir_recursive(cpv->v.b->ptr);
                     if (0 != stat(cpv->v.b->ptr, &st)) {
                         log_perror(srv->errh, __FILE__, __LINE__,
                           "can't stat %s %s", cpk[cpv->k_id].k, cpv->v.b->ptr);
@@ -539,7 +494,7 @@ static int deflate_file_to_file(request_st * const r, plugin_data *p, int ifd, b
 		return -1;
 	}
 
-	if (-1 == mkdir_for_file(p->ofn->ptr)) {
+	if (-1 == fdevent_mkdir_for_file(p->ofn->ptr)) {
 		log_error(r->conf.errh, __FILE__, __LINE__,
 		  "couldn't create directory for file %s", p->ofn->ptr);
 		return -1;
@@ -76,6 +76,25 @@
  * - deflate.max-compress-size new directive (in kb like compress.max_filesize)
  * - deflate.mem-level removed (too many knobs for little benefit)
  * - deflate.window-size removed (too many knobs for little benefit)
+ * - deflate.cache-dir new directive (like compress.cache-dir)
+ *     compressed responses for static files are saved to the cache dir,
+ *     named by path, encoding and ETag, and are sent from the cache dir
+ *     on subsequent requests.  Stale files in cache dir are not removed
+ *     by lighttpd; use an external job to prune old files.
+ * - deflate.precompressed new directive (default "disable")
+ *     if enabled, send precompressed sibling of static file (file.br,
+ *     file.zst, file.gz or file.bz2), if present and not older than file,
+ *     instead of compressing response
+ * - brotli ("br") and zstd ("zstd") encodings (if built with libbrotlienc
+ *   and libzstd, respectively) may be listed in deflate.allowed-encodings
+ * - deflate.params new directive for encoder-specific parameters, e.g.
+ *     deflate.params = ( "BROTLI_PARAM_QUALITY" => 5,
+ *                        "BROTLI_PARAM_LGWIN" => 22,
+ *                        "BROTLI_PARAM_MODE" => 1,
+ *                        "ZSTD_c_compressionLevel" => 3,
+ *                        "ZSTD_c_strategy" => 1,
+ *                        "ZSTD_c_windowLog" => 23 )
+ *     (deflate.compression-level continues to apply to gzip, deflate, bzip2)
  *
  * Future:
  * - config directives may be changed, renamed, or removed
@@ -86,7 +105,6 @@
  *   to avoid compressing, even if a broader deflate.mimetypes matched,
  *   e.g. to compress all "text/" except "text/special".
  * - mod_compress and mod_deflate might merge overlapping feature sets
- *     (mod_compress.cache-dir does not yet have an equivalent in mod_deflate)
  *
  * Implementation notes:
  * - http_chunk_append_mem() used instead of http_chunk_append_buffer()
@@ -105,6 +123,7 @@
 #include "sys-mmap.h"
 
 #include <fcntl.h>
+#include <stdio.h>      /* rename() */
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -119,6 +138,7 @@
 #include "http_chunk.h"
 #include "http_header.h"
 #include "response.h"
+#include "stat_cache.h"
 
 #include "plugin.h"
 
@@ -140,6 +160,16 @@
 # include <bzlib.h>
 #endif
 
+#if defined HAVE_BROTLI_ENCODE_H && defined HAVE_BROTLI
+# define USE_BROTLI
+# include <brotli/encode.h>
+#endif
+
+#if defined HAVE_ZSTD_H && defined HAVE_ZSTD
+# define USE_ZSTD
+# include <zstd.h>
+#endif
+
 #if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP && defined ENABLE_MMAP
 #define USE_MMAP
 
@@ -165,11 +195,31 @@ static void sigbus_handler(int sig) {
 #define HTTP_ACCEPT_ENCODING_BZIP2    BV(4)
 #define HTTP_ACCEPT_ENCODING_X_GZIP   BV(5)
 #define HTTP_ACCEPT_ENCODING_X_BZIP2  BV(6)
+#define HTTP_ACCEPT_ENCODING_BR       BV(7)
+#define HTTP_ACCEPT_ENCODING_ZSTD     BV(8)
 
 #define KByte * 1024
 #define MByte * 1024 KByte
 #define GByte * 1024 MByte
 
+typedef struct {
+	short	brotli_quality; /* BROTLI_PARAM_QUALITY */
+	short	brotli_window;  /* BROTLI_PARAM_LGWIN (0: library default) */
+	short	brotli_mode;    /* BROTLI_PARAM_MODE */
+	short	zstd_level;     /* ZSTD_c_compressionLevel (0: library default) */
+	short	zstd_strategy;  /* ZSTD_c_strategy (0: library default) */
+	short	zstd_window;    /* ZSTD_c_windowLog (0: library default) */
+} encparms;
+
+static const encparms encparms_default = {
+	5,  /* brotli quality; (library default 11 is too slow for on-the-fly) */
+	0,
+	0,  /* BROTLI_MODE_GENERIC */
+	0,
+	0,
+	0
+};
+
 typedef struct {
 	const array	*mimetypes;
 	unsigned int	max_compress_size;
@@ -179,6 +229,9 @@ typedef struct {
 	unsigned short	sync_flush;
 	short		compression_level;
 	short		allowed_encodings;
+	unsigned short	precompressed;
+	const buffer	*cache_dir;
+	const encparms	*params;
 	double		max_loadavg;
 } plugin_config;
 
@@ -197,6 +250,12 @@ typedef struct {
 	      #endif
 	      #ifdef USE_BZ2LIB
 		bz_stream bz;
+	      #endif
+	      #ifdef USE_BROTLI
+		BrotliEncoderState *br;
+	      #endif
+	      #ifdef USE_ZSTD
+		ZSTD_CStream *cctx;
 	      #endif
 		int dummy;
 	} u;
@@ -206,6 +265,8 @@ typedef struct {
 	buffer *output;
 	plugin_data *plugin_data;
 	int compression_type;
+	int cache_fd;
+	buffer *cache_fn;
 	log_error_st *errh;
 } handler_ctx;
 
@@ -214,16 +275,20 @@ static handler_ctx *handler_ctx_init() {
 
 	hctx = calloc(1, sizeof(*hctx));
 	hctx->in_queue = chunkqueue_init();
+	hctx->cache_fd = -1;
 
 	return hctx;
 }
 
+static void mod_deflate_cache_file_reset(handler_ctx *hctx);
+
 static void handler_ctx_free(handler_ctx *hctx) {
       #if 0
 	if (hctx->output != &p->tmp_buf) {
 		buffer_free(hctx->output);
 	}
       #endif
+	if (hctx->cache_fn) mod_deflate_cache_file_reset(hctx);
 	chunkqueue_free(hctx->in_queue);
 	free(hctx);
 }
@@ -237,6 +302,22 @@ INIT_FUNC(mod_deflate_init) {
 FREE_FUNC(mod_deflate_free) {
     plugin_data *p = p_d;
     free(p->tmp_buf.ptr);
+
+    if (NULL == p->cvlist) return;
+    /* (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            if (cpv->vtype != T_CONFIG_LOCAL || NULL == cpv->v.v) continue;
+            switch (cpv->k_id) {
+              case 10:/* deflate.params */
+                free(cpv->v.v);
+                break;
+              default:
+                break;
+            }
+        }
+    }
 }
 
 static void mod_deflate_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
@@ -265,6 +346,16 @@ static void mod_deflate_merge_config_cpv(plugin_config * const pconf, const conf
       case 7: /* deflate.max-loadavg */
         pconf->max_loadavg = cpv->v.d;
         break;
+      case 8: /* deflate.cache-dir */
+        pconf->cache_dir = cpv->v.b;
+        break;
+      case 9: /* deflate.precompressed */
+        pconf->precompressed = cpv->v.u;
+        break;
+      case 10:/* deflate.params */
+        if (cpv->vtype == T_CONFIG_LOCAL)
+            pconf->params = cpv->v.v;
+        break;
       default:/* should not happen */
         return;
     }
@@ -277,18 +368,69 @@ static void mod_deflate_merge_config(plugin_config * const pconf, const config_p
 }
 
 static void mod_deflate_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_deflate_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
+}
+
+static encparms * mod_deflate_parse_params(server * const srv, const array * const a) {
+    encparms * const params = malloc(sizeof(encparms));
+    force_assert(params);
+    *params = encparms_default;
+    for (uint32_t i = 0; i < a->used; ++i) {
+        const data_unset * const du = a->data[i];
+        int v;
+        if (du->type == TYPE_INTEGER)
+            v = ((const data_integer *)du)->value;
+        else if (du->type == TYPE_STRING) {
+            const buffer * const b = &((const data_string *)du)->value;
+            char *e;
+            v = (int)strtol(b->ptr, &e, 10);
+            if (buffer_string_is_empty(b) || *e != '\0') v = -1;
+        }
+        else
+            v = -1;
+        if (v < 0 || v > 32767) {
+            log_error(srv->errh, __FILE__, __LINE__,
+              "invalid value for deflate.params: %s", du->key.ptr);
+            free(params);
+            return NULL;
+        }
+
+        if (buffer_eq_slen(&du->key, CONST_STR_LEN("BROTLI_PARAM_QUALITY")))
+            params->brotli_quality = (short)v;
+        else if (buffer_eq_slen(&du->key, CONST_STR_LEN("BROTLI_PARAM_LGWIN")))
+            params->brotli_window = (short)v;
+        else if (buffer_eq_slen(&du->key, CONST_STR_LEN("BROTLI_PARAM_MODE")))
+            params->brotli_mode = (short)v;
+        else if (buffer_eq_slen(&du->key,
+                                CONST_STR_LEN("ZSTD_c_compressionLevel")))
+            params->zstd_level = (short)v;
+        else if (buffer_eq_slen(&du->key, CONST_STR_LEN("ZSTD_c_strategy")))
+            params->zstd_strategy = (short)v;
+        else if (buffer_eq_slen(&du->key, CONST_STR_LEN("ZSTD_c_windowLog")))
+            params->zstd_window = (short)v;
+        else {
+            log_error(srv->errh, __FILE__, __LINE__,
+              "unrecognized key for deflate.params: %s", du->key.ptr);
+            free(params);
+            return NULL;
+        }
+    }
+    return params;
 }
 
 static short mod_deflate_encodings_to_flags(const array *encodings) {
     short allowed_encodings = 0;
     if (encodings->used) {
         for (uint32_t j = 0; j < encodings->used; ++j) {
-          #if defined(USE_ZLIB) || defined(USE_BZ2LIB)
+          #if defined(USE_ZLIB) || defined(USE_BZ2LIB) \
+           || defined(USE_BROTLI) || defined(USE_ZSTD)
             data_string *ds = (data_string *)encodings->data[j];
           #endif
           #ifdef USE_ZLIB
@@ -311,6 +453,14 @@ static short mod_deflate_encodings_to_flags(const array *encodings) {
             if (NULL != strstr(ds->value.ptr, "x-bzip2"))
                 allowed_encodings |= HTTP_ACCEPT_ENCODING_X_BZIP2;
           #endif
+          #ifdef USE_BROTLI
+            if (0 == strcmp(ds->value.ptr, "br"))
+                allowed_encodings |= HTTP_ACCEPT_ENCODING_BR;
+          #endif
+          #ifdef USE_ZSTD
+            if (NULL != strstr(ds->value.ptr, "zstd"))
+                allowed_encodings |= HTTP_ACCEPT_ENCODING_ZSTD;
+          #endif
         }
     }
     else {
@@ -324,6 +474,12 @@ static short mod_deflate_encodings_to_flags(const array *encodings) {
         allowed_encodings |= HTTP_ACCEPT_ENCODING_BZIP2
                           |  HTTP_ACCEPT_ENCODING_X_BZIP2;
       #endif
+      #ifdef USE_BROTLI
+        allowed_encodings |= HTTP_ACCEPT_ENCODING_BR;
+      #endif
+      #ifdef USE_ZSTD
+        allowed_encodings |= HTTP_ACCEPT_ENCODING_ZSTD;
+      #endif
     }
     return allowed_encodings;
 }
@@ -354,6 +510,15 @@ SETDEFAULTS_FUNC(mod_deflate_set_defaults) {
      ,{ CONST_STR_LEN("deflate.max-loadavg"),
         T_CONFIG_STRING,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("deflate.cache-dir"),
+        T_CONFIG_STRING,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("deflate.precompressed"),
+        T_CONFIG_BOOL,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("deflate.params"),
+        T_CONFIG_ARRAY_KVANY,
+        T_CONFIG_SCOPE_CONNECTION }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -406,6 +571,33 @@ SETDEFAULTS_FUNC(mod_deflate_set_defaults) {
                   ? strtod(cpv->v.b->ptr, NULL)
                   : 0.0;
                 break;
+              case 8: /* deflate.cache-dir */
+                if (!buffer_string_is_empty(cpv->v.b)) {
+                    buffer *b;
+                    *(const buffer **)&b = cpv->v.b;
+                    const uint32_t len = buffer_string_length(b);
+                    if (len > 0 && '/' == b->ptr[len-1])
+                        buffer_string_set_length(b, len-1); /*remove end slash*/
+                    struct stat st;
+                    fdevent_mkdir_recursive(b->ptr);
+                    if (0 != stat(b->ptr, &st)) {
+                        log_perror(srv->errh, __FILE__, __LINE__,
+                          "can't stat %s %s", cpk[cpv->k_id].k, b->ptr);
+                        return HANDLER_ERROR;
+                    }
+                }
+                else
+                    cpv->v.b = NULL;
+                break;
+              case 9: /* deflate.precompressed */
+                break;
+              case 10:/* deflate.params */
+                if (cpv->v.a->used) {
+                    cpv->v.v = mod_deflate_parse_params(srv, cpv->v.a);
+                    if (NULL == cpv->v.v) return HANDLER_ERROR;
+                    cpv->vtype = T_CONFIG_LOCAL;
+                }
+                break;
               default:/* should not happen */
                 break;
             }
@@ -420,6 +612,9 @@ SETDEFAULTS_FUNC(mod_deflate_set_defaults) {
     p->defaults.work_block_size = 2048;
     p->defaults.max_loadavg = 0.0;
     p->defaults.sync_flush = 0;
+    p->defaults.precompressed = 0;
+    p->defaults.cache_dir = NULL;
+    p->defaults.params = &encparms_default;
 
     /* initialize p->defaults from global config context */
     if (p->nconfig > 0 && p->cvlist->v.u2[1]) {
@@ -432,9 +627,70 @@ SETDEFAULTS_FUNC(mod_deflate_set_defaults) {
 }
 
 
-#if defined(USE_ZLIB) || defined(USE_BZ2LIB)
-static int stream_http_chunk_append_mem(request_st * const r, const handler_ctx * const hctx, size_t len) {
-	/* future: might also write stream to hctx temporary file in compressed file cache */
+static void mod_deflate_cache_file_reset(handler_ctx * const hctx) {
+	/* remove incomplete temporary cache file */
+	if (-1 != hctx->cache_fd) {
+		close(hctx->cache_fd);
+		hctx->cache_fd = -1;
+		unlink(hctx->cache_fn->ptr);
+	}
+	buffer_free(hctx->cache_fn);
+	hctx->cache_fn = NULL;
+}
+
+static void mod_deflate_cache_file_open(request_st * const r, handler_ctx * const hctx, const buffer * const fn) {
+	/* write compressed output to temporary file in cache dir,
+	 * and rename to fn when complete (see mod_deflate_cache_file_finish()) */
+	hctx->cache_fn = buffer_init_buffer(fn);
+	if (0 != fdevent_mkdir_for_file(hctx->cache_fn->ptr)) {
+		log_error(r->conf.errh, __FILE__, __LINE__,
+		  "couldn't create directory for file %s", fn->ptr);
+		buffer_free(hctx->cache_fn);
+		hctx->cache_fn = NULL;
+		return;
+	}
+	buffer_append_string_len(hctx->cache_fn, CONST_STR_LEN(".XXXXXX"));
+	hctx->cache_fd = fdevent_mkstemp_append(hctx->cache_fn->ptr);
+	if (-1 == hctx->cache_fd) {
+		log_perror(r->conf.errh, __FILE__, __LINE__,
+		  "creating cachefile %s failed", hctx->cache_fn->ptr);
+		buffer_free(hctx->cache_fn);
+		hctx->cache_fn = NULL;
+	}
+}
+
+static void mod_deflate_cache_file_finish(request_st * const r, handler_ctx * const hctx) {
+	if (-1 == hctx->cache_fd) return;
+	const int rc = close(hctx->cache_fd);
+	hctx->cache_fd = -1;
+	const uint32_t len = buffer_string_length(hctx->cache_fn);
+	char * const tmpfn = hctx->cache_fn->ptr;
+	if (0 == rc) {
+		/* rename temporary file "fn.XXXXXX" to "fn" */
+		buffer * const fn = r->tmp_buf;
+		buffer_copy_string_len(fn, tmpfn, len - (sizeof(".XXXXXX")-1));
+		if (0 == rename(tmpfn, fn->ptr)) {
+			buffer_free(hctx->cache_fn);
+			hctx->cache_fn = NULL;
+			return;
+		}
+	}
+	log_perror(r->conf.errh, __FILE__, __LINE__,
+	  "writing cachefile %s failed", tmpfn);
+	unlink(tmpfn);
+	buffer_free(hctx->cache_fn);
+	hctx->cache_fn = NULL;
+}
+
+#if defined(USE_ZLIB) || defined(USE_BZ2LIB) \
+ || defined(USE_BROTLI) || defined(USE_ZSTD)
+static int stream_http_chunk_append_mem(request_st * const r, handler_ctx * const hctx, size_t len) {
+	if (-1 != hctx->cache_fd
+	    && (ssize_t)len != write_all(hctx->cache_fd, hctx->output->ptr, len)) {
+		log_perror(r->conf.errh, __FILE__, __LINE__,
+		  "writing cachefile %s failed", hctx->cache_fn->ptr);
+		mod_deflate_cache_file_reset(hctx);
+	}
 	return http_chunk_append_mem(r, hctx->output->ptr, len);
 }
 #endif
@@ -652,6 +908,141 @@ static int stream_bzip2_end(handler_ctx *hctx) {
 
 #endif
 
+#ifdef USE_BROTLI
+
+static int stream_br_init(handler_ctx *hctx) {
+	const encparms * const params = hctx->plugin_data->conf.params;
+	BrotliEncoderState * const br = hctx->u.br =
+	  BrotliEncoderCreateInstance(NULL, NULL, NULL);
+	if (NULL == br) return -1;
+
+	/*(note: BROTLI_PARAM_SIZE_HINT might be set from response length)*/
+	BrotliEncoderSetParameter(br, BROTLI_PARAM_QUALITY,
+	                          (uint32_t)params->brotli_quality);
+	if (params->brotli_window)
+		BrotliEncoderSetParameter(br, BROTLI_PARAM_LGWIN,
+		                          (uint32_t)params->brotli_window);
+	if (params->brotli_mode)
+		BrotliEncoderSetParameter(br, BROTLI_PARAM_MODE,
+		                          (uint32_t)params->brotli_mode);
+
+	return 0;
+}
+
+static int stream_br_process(request_st * const r, handler_ctx * const hctx, BrotliEncoderOperation op, const uint8_t *in, size_t insz) {
+	BrotliEncoderState * const br = hctx->u.br;
+	size_t len;
+
+	/* compress data */
+	do {
+		uint8_t *out = (uint8_t *)hctx->output->ptr;
+		size_t outsz = hctx->output->size;
+		if (!BrotliEncoderCompressStream(br, op, &insz, &in,
+		                                 &outsz, &out, NULL))
+			return -1;
+
+		len = hctx->output->size - outsz;
+		if (len > 0) {
+			hctx->bytes_out += len;
+			stream_http_chunk_append_mem(r, hctx, len);
+		}
+	} while (insz > 0 || BrotliEncoderHasMoreOutput(br)
+	         || (op == BROTLI_OPERATION_FINISH
+	             && !BrotliEncoderIsFinished(br)));
+
+	return 0;
+}
+
+static int stream_br_compress(request_st * const r, handler_ctx * const hctx, unsigned char * const start, off_t st_size) {
+	hctx->bytes_in += st_size;
+	return stream_br_process(r, hctx, BROTLI_OPERATION_PROCESS,
+	                         start, (size_t)st_size);
+}
+
+static int stream_br_flush(request_st * const r, handler_ctx * const hctx, int end) {
+	const plugin_data *p = hctx->plugin_data;
+	if (end)
+		return stream_br_process(r, hctx, BROTLI_OPERATION_FINISH, NULL, 0);
+	else if (p->conf.sync_flush)
+		return stream_br_process(r, hctx, BROTLI_OPERATION_FLUSH, NULL, 0);
+	else
+		return 0;
+}
+
+static int stream_br_end(handler_ctx *hctx) {
+	BrotliEncoderDestroyInstance(hctx->u.br);
+	hctx->u.br = NULL;
+	return 0;
+}
+
+#endif
+
+
+#ifdef USE_ZSTD
+
+static int stream_zstd_init(handler_ctx *hctx) {
+	const encparms * const params = hctx->plugin_data->conf.params;
+	ZSTD_CStream * const cctx = hctx->u.cctx = ZSTD_createCStream();
+	if (NULL == cctx) return -1;
+
+	if (params->zstd_level)
+		ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+		                       params->zstd_level);
+	if (params->zstd_strategy)
+		ZSTD_CCtx_setParameter(cctx, ZSTD_c_strategy,
+		                       params->zstd_strategy);
+	if (params->zstd_window)
+		ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog,
+		                       params->zstd_window);
+
+	return 0;
+}
+
+static int stream_zstd_process(request_st * const r, handler_ctx * const hctx, ZSTD_EndDirective op, const void *start, size_t insz) {
+	ZSTD_inBuffer in = { start, insz, 0 };
+	size_t rc;
+
+	/* compress data */
+	do {
+		ZSTD_outBuffer out = { hctx->output->ptr, hctx->output->size, 0 };
+		rc = ZSTD_compressStream2(hctx->u.cctx, &out, &in, op);
+		if (ZSTD_isError(rc)) return -1;
+
+		if (out.pos > 0) {
+			hctx->bytes_out += out.pos;
+			stream_http_chunk_append_mem(r, hctx, out.pos);
+		}
+		/*(rc is number of bytes remaining to flush for ZSTD_e_flush and
+		 * ZSTD_e_end; ZSTD_e_continue returns when input consumed)*/
+	} while (in.pos < in.size || (op != ZSTD_e_continue && 0 != rc));
+
+	return 0;
+}
+
+static int stream_zstd_compress(request_st * const r, handler_ctx * const hctx, unsigned char * const start, off_t st_size) {
+	hctx->bytes_in += st_size;
+	return stream_zstd_process(r, hctx, ZSTD_e_continue,
+	                           start, (size_t)st_size);
+}
+
+static int stream_zstd_flush(request_st * const r, handler_ctx * const hctx, int end) {
+	const plugin_data *p = hctx->plugin_data;
+	if (end)
+		return stream_zstd_process(r, hctx, ZSTD_e_end, NULL, 0);
+	else if (p->conf.sync_flush)
+		return stream_zstd_process(r, hctx, ZSTD_e_flush, NULL, 0);
+	else
+		return 0;
+}
+
+static int stream_zstd_end(handler_ctx *hctx) {
+	ZSTD_freeCStream(hctx->u.cctx);
+	hctx->u.cctx = NULL;
+	return 0;
+}
+
+#endif
+
 
 static int mod_deflate_stream_init(handler_ctx *hctx) {
 	switch(hctx->compression_type) {
@@ -663,6 +1054,14 @@ static int mod_deflate_stream_init(handler_ctx *hctx) {
 #ifdef USE_BZ2LIB
 	case HTTP_ACCEPT_ENCODING_BZIP2:
 		return stream_bzip2_init(hctx);
+#endif
+#ifdef USE_BROTLI
+	case HTTP_ACCEPT_ENCODING_BR:
+		return stream_br_init(hctx);
+#endif
+#ifdef USE_ZSTD
+	case HTTP_ACCEPT_ENCODING_ZSTD:
+		return stream_zstd_init(hctx);
 #endif
 	default:
 		return -1;
@@ -680,6 +1079,14 @@ static int mod_deflate_compress(request_st * const r, handler_ctx * const hctx,
 #ifdef USE_BZ2LIB
 	case HTTP_ACCEPT_ENCODING_BZIP2:
 		return stream_bzip2_compress(r, hctx, start, st_size);
+#endif
+#ifdef USE_BROTLI
+	case HTTP_ACCEPT_ENCODING_BR:
+		return stream_br_compress(r, hctx, start, st_size);
+#endif
+#ifdef USE_ZSTD
+	case HTTP_ACCEPT_ENCODING_ZSTD:
+		return stream_zstd_compress(r, hctx, start, st_size);
 #endif
 	default:
 		UNUSED(r);
@@ -699,6 +1106,14 @@ static int mod_deflate_stream_flush(request_st * const r, handler_ctx * const hc
 #ifdef USE_BZ2LIB
 	case HTTP_ACCEPT_ENCODING_BZIP2:
 		return stream_bzip2_flush(r, hctx, end);
+#endif
+#ifdef USE_BROTLI
+	case HTTP_ACCEPT_ENCODING_BR:
+		return stream_br_flush(r, hctx, end);
+#endif
+#ifdef USE_ZSTD
+	case HTTP_ACCEPT_ENCODING_ZSTD:
+		return stream_zstd_flush(r, hctx, end);
 #endif
 	default:
 		UNUSED(r);
@@ -707,15 +1122,15 @@ static int mod_deflate_stream_flush(request_st * const r, handler_ctx * const hc
 	}
 }
 
-static void mod_deflate_note_ratio(request_st * const r, handler_ctx * const hctx) {
+static void mod_deflate_note_ratio(request_st * const r, const off_t bytes_out, const off_t bytes_in) {
     /* store compression ratio in environment
      * for possible logging by mod_accesslog
      * (late in response handling, so not seen by most other modules) */
     /*(should be called only at end of successful response compression)*/
     char ratio[LI_ITOSTRING_LENGTH];
-    if (0 == hctx->bytes_in) return;
+    if (0 == bytes_in) return;
     size_t len =
-      li_itostrn(ratio, sizeof(ratio), hctx->bytes_out * 100 / hctx->bytes_in);
+      li_itostrn(ratio, sizeof(ratio), bytes_out * 100 / bytes_in);
     http_header_env_set(r, CONST_STR_LEN("ratio"), ratio, len);
 }
 
@@ -729,6 +1144,14 @@ static int mod_deflate_stream_end(handler_ctx *hctx) {
 #ifdef USE_BZ2LIB
 	case HTTP_ACCEPT_ENCODING_BZIP2:
 		return stream_bzip2_end(hctx);
+#endif
+#ifdef USE_BROTLI
+	case HTTP_ACCEPT_ENCODING_BR:
+		return stream_br_end(hctx);
+#endif
+#ifdef USE_ZSTD
+	case HTTP_ACCEPT_ENCODING_ZSTD:
+		return stream_zstd_end(hctx);
 #endif
 	default:
 		return -1;
@@ -975,7 +1398,8 @@ static handler_t deflate_compress_response(request_st * const r, handler_ctx * c
 static int mod_deflate_choose_encoding (const char *value, plugin_data *p, const char **label) {
 	/* get client side support encodings */
 	int accept_encoding = 0;
-      #if !defined(USE_ZLIB) && !defined(USE_BZ2LIB)
+      #if !defined(USE_ZLIB) && !defined(USE_BZ2LIB) \
+       && !defined(USE_BROTLI) && !defined(USE_ZSTD)
 	UNUSED(value);
       #else
         for (; *value; ++value) {
@@ -985,10 +1409,20 @@ static int mod_deflate_choose_encoding (const char *value, plugin_data *p, const
             while (*value!=' ' && *value!=',' && *value!=';' && *value!='\0')
                 ++value;
             switch (value - v) {
+              case 2:
+               #ifdef USE_BROTLI
+                if (0 == memcmp(v, "br", 2))
+                    accept_encoding |= HTTP_ACCEPT_ENCODING_BR;
+               #endif
+                break;
               case 4:
                #ifdef USE_ZLIB
                 if (0 == memcmp(v, "gzip", 4))
                     accept_encoding |= HTTP_ACCEPT_ENCODING_GZIP;
+               #endif
+               #ifdef USE_ZSTD
+                if (0 == memcmp(v, "zstd", 4))
+                    accept_encoding |= HTTP_ACCEPT_ENCODING_ZSTD;
                #endif
                 break;
               case 5:
@@ -1035,6 +1469,18 @@ static int mod_deflate_choose_encoding (const char *value, plugin_data *p, const
 	accept_encoding &= p->conf.allowed_encodings;
 
 	/* select best matching encoding */
+#ifdef USE_BROTLI
+	if (accept_encoding & HTTP_ACCEPT_ENCODING_BR) {
+		*label = "br";
+		return HTTP_ACCEPT_ENCODING_BR;
+	} else
+#endif
+#ifdef USE_ZSTD
+	if (accept_encoding & HTTP_ACCEPT_ENCODING_ZSTD) {
+		*label = "zstd";
+		return HTTP_ACCEPT_ENCODING_ZSTD;
+	} else
+#endif
 #ifdef USE_BZ2LIB
 	if (accept_encoding & HTTP_ACCEPT_ENCODING_BZIP2) {
 		*label = "bzip2";
@@ -1063,6 +1509,82 @@ static int mod_deflate_choose_encoding (const char *value, plugin_data *p, const
 	}
 }
 
+static const buffer * mod_deflate_cache_file_name(request_st * const r, const buffer * const cache_dir, const buffer * const etag, const char * const label) {
+	/* cache file name is cache_dir + path (relative to document root)
+	 * + "-" + ETag (without quotes) + "-" + label of encoding
+	 * (label is NULL if ETag has already been modified to include label) */
+	buffer * const tb = r->tmp_buf;
+	buffer_copy_buffer(tb, cache_dir);
+	const uint32_t dlen = buffer_string_length(&r->physical.doc_root);
+	if (0 == strncmp(r->physical.path.ptr, r->physical.doc_root.ptr, dlen))
+		buffer_append_path_len(tb, r->physical.path.ptr + dlen,
+		                       buffer_string_length(&r->physical.path) - dlen);
+	else
+		buffer_append_path_len(tb, CONST_BUF_LEN(&r->uri.path));
+	buffer_append_string_len(tb, CONST_STR_LEN("-"));
+	buffer_append_string_len(tb, etag->ptr+1, buffer_string_length(etag)-2);
+	if (label) {
+		buffer_append_string_len(tb, CONST_STR_LEN("-"));
+		buffer_append_string(tb, label);
+	}
+	return tb;
+}
+
+static int mod_deflate_send_file(request_st * const r, stat_cache_entry * const sce, const off_t len) {
+	/* replace response with contents of (compressed) file */
+	/*(fd might be cached in sce; if fd == sce->fd, must not close(fd))*/
+	const int fd = stat_cache_entry_open(sce, 1);
+	if (fd < 0) return -1;
+	chunkqueue_reset(r->write_queue);
+	if (0 != (fd == sce->fd
+	          ? http_chunk_append_file_ref(r, sce)
+	          : http_chunk_append_file_fd(r, &sce->name, fd, sce->st.st_size)))
+		return -1;
+	if (r->resp_htags & HTTP_HEADER_CONTENT_LENGTH) {
+		http_header_response_unset(r, HTTP_HEADER_CONTENT_LENGTH, CONST_STR_LEN("Content-Length"));
+	}
+	mod_deflate_note_ratio(r, sce->st.st_size, len);
+	return 0;
+}
+
+static stat_cache_entry * mod_deflate_precompressed(request_st * const r, const stat_cache_entry * const sce, const int compression_type) {
+	/* check for precompressed sibling of static file, e.g. file.gz,
+	 * which is not older than the file */
+	const char *ext;
+	size_t extlen;
+	switch (compression_type) {
+	case HTTP_ACCEPT_ENCODING_BR:
+		ext = ".br";
+		extlen = sizeof(".br")-1;
+		break;
+	case HTTP_ACCEPT_ENCODING_ZSTD:
+		ext = ".zst";
+		extlen = sizeof(".zst")-1;
+		break;
+	case HTTP_ACCEPT_ENCODING_GZIP:
+		ext = ".gz";
+		extlen = sizeof(".gz")-1;
+		break;
+	case HTTP_ACCEPT_ENCODING_BZIP2:
+		ext = ".bz2";
+		extlen = sizeof(".bz2")-1;
+		break;
+	default:
+		return NULL;
+	}
+	buffer * const tb = r->tmp_buf;
+	buffer_copy_buffer(tb, &r->physical.path);
+	buffer_append_string_len(tb, ext, extlen);
+	stat_cache_entry * const sce_pre = stat_cache_get_entry(tb);
+	return (NULL != sce_pre
+	        && S_ISREG(sce_pre->st.st_mode)
+	        && sce_pre->st.st_mtime >= sce->st.st_mtime
+	        && (r->conf.follow_symlink
+	            || 0 == stat_cache_path_contains_symlink(tb, r->conf.errh)))
+	  ? sce_pre
+	  : NULL;
+}
+
 REQUEST_FUNC(mod_deflate_handle_response_start) {
 	plugin_data *p = p_d;
 	const buffer *vbro;
@@ -1073,6 +1595,7 @@ REQUEST_FUNC(mod_deflate_handle_response_start) {
 	size_t etaglen = 0;
 	int compression_type;
 	handler_t rc;
+	stat_cache_entry *sce = NULL;
 
 	/*(current implementation requires response be complete)*/
 	if (!r->resp_body_finished) return HANDLER_GO_ON;
@@ -1141,6 +1664,19 @@ REQUEST_FUNC(mod_deflate_handle_response_start) {
 	/* check ETag as is done in http_response_handle_cachable()
 	 * (slightly imperfect (close enough?) match of ETag "000000" to "000000-gzip") */
 	vb = http_header_response_get(r, HTTP_HEADER_ETAG, CONST_STR_LEN("ETag"));
+
+	/* check if response is static file r->physical.path (ETag set from file
+	 * and whole file in response) for deflate.cache-dir and precompressed */
+	if ((p->conf.precompressed || NULL != p->conf.cache_dir)
+	    && NULL != vb
+	    && 200 == r->http_status
+	    && buffer_string_length(vb) > 2
+	    && buffer_is_equal(vb, &r->physical.etag)
+	    && NULL != (sce = stat_cache_get_entry(&r->physical.path))
+	    && (!S_ISREG(sce->st.st_mode) || sce->st.st_size != len)) {
+		sce = NULL;
+	}
+
 	if (NULL != vb && (r->rqst_htags & HTTP_HEADER_IF_NONE_MATCH)) {
 		const buffer *if_none_match = http_header_response_get(r, HTTP_HEADER_IF_NONE_MATCH, CONST_STR_LEN("If-None-Match"));
 		etaglen = buffer_string_length(vb);
@@ -1201,8 +1737,27 @@ REQUEST_FUNC(mod_deflate_handle_response_start) {
 		return HANDLER_GO_ON;
 	}
 
-	/* future: might use ETag to check if compressed content is in compressed file cache */
-	/*if (etaglen) { ... } *//* return if in file cache after updating r->write_queue */
+	/* send precompressed sibling or compressed file in cache dir, if present */
+	const buffer *cache_fn = NULL;
+	if (NULL != sce) {
+		stat_cache_entry *sce_z = p->conf.precompressed
+		  ? mod_deflate_precompressed(r, sce, compression_type)
+		  : NULL;
+		if (NULL == sce_z && NULL != p->conf.cache_dir) {
+			cache_fn = mod_deflate_cache_file_name(r, p->conf.cache_dir, vb,
+			                                       etaglen ? NULL : label);
+			sce_z = stat_cache_get_entry(cache_fn);
+		}
+		if (NULL != sce_z) {
+			if (0 == mod_deflate_send_file(r, sce_z, len)) return HANDLER_GO_ON;
+			log_perror(r->conf.errh, __FILE__, __LINE__,
+			  "open failed %s", sce_z->name.ptr);
+			return HANDLER_ERROR;
+		}
+		if (0.0 < p->conf.max_loadavg && p->conf.max_loadavg < r->con->srv->loadavg[0]) {
+			cache_fn = NULL;
+		}
+	}
 
 	/* enable compression */
 	p->conf.sync_flush =
@@ -1233,10 +1788,14 @@ REQUEST_FUNC(mod_deflate_handle_response_start) {
 	}
 	r->plugin_ctx[p->id] = hctx;
 
+	/* save compressed output to cache dir */
+	if (NULL != cache_fn) mod_deflate_cache_file_open(r, hctx, cache_fn);
+
 	rc = deflate_compress_response(r, hctx);
 	if (HANDLER_GO_ON != rc) {
 		if (HANDLER_FINISHED == rc) {
-			mod_deflate_note_ratio(r, hctx);
+			mod_deflate_note_ratio(r, hctx->bytes_out, hctx->bytes_in);
+			mod_deflate_cache_file_finish(r, hctx);
 		}
 		deflate_compress_cleanup(r, hctx);
 		if (HANDLER_ERROR == rc) return HANDLER_ERROR;
@@ -17,7 +17,10 @@
 #include <unistd.h>
 #include <time.h>
 
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 #include <pcre.h>
 #endif
 
@@ -34,7 +37,9 @@ typedef struct {
 	char encode_header;
 	char auto_layout;
 
-      #ifdef HAVE_PCRE_H
+      #ifdef HAVE_PCRE2_H
+	pcre2_code **excludes;
+      #elif defined(HAVE_PCRE_H)
 	pcre **excludes;
       #else
 	void *excludes;
@@ -54,9 +59,54 @@ typedef struct {
 	plugin_config conf;
 
 	buffer tmp_buf;
+      #ifdef HAVE_PCRE2_H
+	pcre2_match_data *match_data; /*(only match/no-match is needed)*/
+      #endif
 } plugin_data;
 
-#ifdef HAVE_PCRE_H
+#ifdef HAVE_PCRE2_H
+
+static pcre2_code ** mod_dirlisting_parse_excludes(server *srv, const array *a) {
+    pcre2_code **regexes = calloc(a->used + 1, sizeof(pcre2_code *));
+    force_assert(regexes);
+    for (uint32_t j = 0; j < a->used; ++j) {
+        const data_string *ds = (const data_string *)a->data[j];
+        int errcode;
+        PCRE2_SIZE erroff;
+        regexes[j] = pcre2_compile((PCRE2_SPTR)ds->value.ptr,
+                                   PCRE2_ZERO_TERMINATED, 0,
+                                   &errcode, &erroff, NULL);
+        if (NULL == regexes[j]) {
+            log_error(srv->errh, __FILE__, __LINE__,
+              "pcre2_compile failed for: %s", ds->value.ptr);
+            for (pcre2_code **regex = regexes; *regex; ++regex)
+                pcre2_code_free(*regex);
+            free(regexes);
+            return NULL;
+        }
+        (void)pcre2_jit_compile(regexes[j], PCRE2_JIT_COMPLETE);
+    }
+    return regexes;
+}
+
+static int mod_dirlisting_exclude(log_error_st *errh, const plugin_data *p, const char *name, size_t len) {
+    for (pcre2_code **regex = p->conf.excludes; *regex; ++regex) {
+        /* match_data has room for one pair; rc 0 (ovector too small) is a match */
+        int n = pcre2_match(*regex, (PCRE2_SPTR)name, len, 0, 0,
+                            p->match_data, NULL);
+        if (n < 0) {
+            if (n == PCRE2_ERROR_NOMATCH) continue;
+
+            log_error(errh, __FILE__, __LINE__,
+              "execution error while matching: %d", n);
+            /* skip (to not leak names that break pcre matching) */
+        }
+        return 1;
+    }
+    return 0; /* no match */
+}
+
+#elif defined(HAVE_PCRE_H)
 
 static pcre ** mod_dirlisting_parse_excludes(server *srv, const array *a) {
     pcre **regexes = calloc(a->used + 1, sizeof(pcre *));
@@ -77,8 +127,8 @@ static pcre ** mod_dirlisting_parse_excludes(server *srv, const array *a) {
     return regexes;
 }
 
-static int mod_dirlisting_exclude(log_error_st *errh, pcre **regex, const char *name, size_t len) {
-    for(; *regex; ++regex) {
+static int mod_dirlisting_exclude(log_error_st *errh, const plugin_data *p, const char *name, size_t len) {
+    for (pcre **regex = p->conf.excludes; *regex; ++regex) {
         #define N 10
         int ovec[N * 3];
         int n;
@@ -111,13 +161,23 @@ INIT_FUNC(mod_dirlisting_init) {
 FREE_FUNC(mod_dirlisting_free) {
     plugin_data * const p = p_d;
     free(p->tmp_buf.ptr);
+  #ifdef HAVE_PCRE2_H
+    if (p->match_data) pcre2_match_data_free(p->match_data);
+  #endif
     if (NULL == p->cvlist) return;
     /* (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
         config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
         for (; -1 != cpv->k_id; ++cpv) {
             switch (cpv->k_id) {
-             #ifdef HAVE_PCRE_H
+             #ifdef HAVE_PCRE2_H
+              case 2: /* dir-listing.exclude */
+                if (cpv->vtype != T_CONFIG_LOCAL) continue;
+                for (pcre2_code **regex = cpv->v.v; *regex; ++regex)
+                    pcre2_code_free(*regex);
+                free(cpv->v.v);
+                break;
+             #elif defined(HAVE_PCRE_H)
               case 2: /* dir-listing.exclude */
                 if (cpv->vtype != T_CONFIG_LOCAL) continue;
                 for (pcre **regex = cpv->v.v; *regex; ++regex)
@@ -190,11 +250,14 @@ static void mod_dirlisting_merge_config(plugin_config * const pconf, const confi
 }
 
 static void mod_dirlisting_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_dirlisting_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_dirlisting_set_defaults) {
@@ -263,7 +326,7 @@ SETDEFAULTS_FUNC(mod_dirlisting_set_defaults) {
               case 1: /* server.dir-listing *//*(historical)*/
                 break;
               case 2: /* dir-listing.exclude */
-               #ifndef HAVE_PCRE_H
+               #if !defined(HAVE_PCRE_H) && !defined(HAVE_PCRE2_H)
                 if (cpv->v.a->used > 0) {
                     log_error(srv->errh, __FILE__, __LINE__,
                       "pcre support is missing for: %s, "
@@ -279,6 +342,12 @@ SETDEFAULTS_FUNC(mod_dirlisting_set_defaults) {
                     return HANDLER_ERROR;
                 }
                 cpv->vtype = T_CONFIG_LOCAL;
+               #ifdef HAVE_PCRE2_H
+                if (NULL == p->match_data) {
+                    p->match_data = pcre2_match_data_create(1, NULL);
+                    force_assert(p->match_data);
+                }
+               #endif
                #endif
                 break;
               case 3: /* dir-listing.hide-dotfiles */
@@ -894,7 +963,7 @@ static int http_list_directory(request_st * const r, plugin_data * const p, buff
 		 * elements, skipping any that match.
 		 */
 		if (p->conf.excludes
-		    && mod_dirlisting_exclude(errh, p->conf.excludes, dent->d_name, i))
+		    && mod_dirlisting_exclude(errh, p, dent->d_name, i))
 			continue;
 
 		/* NOTE: the manual says, d_name is never more than NAME_MAX
@@ -5,6 +5,7 @@
 #include "buffer.h"
 #include "http_header.h"
 #include "sock_addr.h"
+#include "splaytree.h"  /* djbhash() */
 
 #include "plugin.h"
 
@@ -17,6 +18,7 @@
  * we indent to implement all features the mod_evasive from apache has
  *
  * - limit of connections per IP
+ * - limit of request rate per IP (token bucket)
  * - provide a list of block-listed ip/networks (no access)
  * - provide a white-list of ips/network which is not affected by the limit
  *   (hmm, conditionals might be enough)
@@ -30,18 +32,155 @@ typedef struct {
     unsigned short max_conns;
     unsigned short silent;
     const buffer *location;
+    uint32_t max_rps;
+    uint32_t max_burst;
 } plugin_config;
 
+/* per-IP state, in hash table keyed on addr; entry exists while connections
+ * from addr are open (or until token bucket for request rate is full again)*/
+typedef struct mod_evasive_ip {
+    struct mod_evasive_ip *next;
+    uint32_t hash;
+    uint32_t conns;      /* connections open from addr */
+    uint32_t active;     /* requests from addr being handled */
+    uint32_t tokens;     /* request rate token bucket */
+    time_t ts;           /* time of most recent token bucket refill */
+    time_t full_ts;      /* time at which token bucket is full again */
+    sock_addr addr;
+} mod_evasive_ip;
+
+typedef struct {
+    mod_evasive_ip **ptr;
+    uint32_t size;       /* power of 2 */
+    uint32_t used;
+} mod_evasive_ip_table;
+
+/* per-connection state in con->request.plugin_ctx[p->id] */
+typedef struct {
+    mod_evasive_ip *ip;  /* entry for con->dst_addr (holds ip->conns ref) */
+    uint32_t active;     /* requests on con counted in ip->active */
+    int con_req;         /* con->request counted (HTTP/1.x) */
+} handler_ctx;
+
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
     plugin_config conf;
+    mod_evasive_ip_table iptab;
 } plugin_data;
 
+
+__attribute_pure__
+static uint32_t mod_evasive_addr_hash (const sock_addr * const addr) {
+    switch (sock_addr_get_family(addr)) {
+      case AF_INET:
+        return djbhash((const char *)&addr->ipv4.sin_addr,
+                       sizeof(addr->ipv4.sin_addr), DJBHASH_INIT);
+     #ifdef HAVE_IPV6
+      case AF_INET6:
+        return djbhash((const char *)&addr->ipv6.sin6_addr,
+                       sizeof(addr->ipv6.sin6_addr), DJBHASH_INIT);
+     #endif
+     #ifdef HAVE_SYS_UN_H
+      case AF_UNIX:
+        return djbhash(addr->un.sun_path, strlen(addr->un.sun_path),
+                       DJBHASH_INIT);
+     #endif
+      default:
+        return DJBHASH_INIT;
+    }
+}
+
+__attribute_cold__
+static void mod_evasive_ip_table_grow (mod_evasive_ip_table * const iptab) {
+    const uint32_t sz = iptab->size ? iptab->size << 1 : 64;
+    mod_evasive_ip ** const ptr = calloc(sz, sizeof(*ptr));
+    force_assert(ptr);
+    for (uint32_t i = 0; i < iptab->size; ++i) {
+        for (mod_evasive_ip *ip = iptab->ptr[i], *next; ip; ip = next) {
+            next = ip->next;
+            mod_evasive_ip ** const b = ptr + (ip->hash & (sz - 1));
+            ip->next = *b;
+            *b = ip;
+        }
+    }
+    free(iptab->ptr);
+    iptab->ptr = ptr;
+    iptab->size = sz;
+}
+
+static mod_evasive_ip * mod_evasive_ip_get (mod_evasive_ip_table * const iptab, const sock_addr * const addr) {
+    const uint32_t hash = mod_evasive_addr_hash(addr);
+    if (iptab->size) {
+        mod_evasive_ip *ip = iptab->ptr[hash & (iptab->size - 1)];
+        for (; ip; ip = ip->next) {
+            if (ip->hash == hash && sock_addr_is_addr_eq(&ip->addr, addr))
+                return ip;
+        }
+    }
+
+    if (iptab->used >= iptab->size)
+        mod_evasive_ip_table_grow(iptab);
+    mod_evasive_ip * const ip = calloc(1, sizeof(*ip));
+    force_assert(ip);
+    ip->hash = hash;
+    ip->addr = *addr;
+    mod_evasive_ip ** const b = iptab->ptr + (hash & (iptab->size - 1));
+    ip->next = *b;
+    *b = ip;
+    ++iptab->used;
+    return ip;
+}
+
+static void mod_evasive_ip_del (mod_evasive_ip_table * const iptab, mod_evasive_ip * const ip) {
+    mod_evasive_ip **b = iptab->ptr + (ip->hash & (iptab->size - 1));
+    while (*b != ip) b = &(*b)->next;
+    *b = ip->next;
+    --iptab->used;
+    free(ip);
+}
+
+static void mod_evasive_ip_release (mod_evasive_ip_table * const iptab, mod_evasive_ip * const ip) {
+    /* keep entry while token bucket refills; see mod_evasive_trigger() */
+    if (0 == --ip->conns && ip->full_ts <= log_epoch_secs)
+        mod_evasive_ip_del(iptab, ip);
+}
+
+static int mod_evasive_ip_token (mod_evasive_ip * const ip, const uint32_t rate, uint32_t burst) {
+    /* token bucket: refill rate tokens per second, up to burst tokens */
+    const time_t cur_ts = log_epoch_secs;
+    if (0 == burst) burst = rate;
+    if (cur_ts > ip->ts) {
+        const uint64_t tokens =
+          (uint64_t)ip->tokens + (uint64_t)(cur_ts - ip->ts) * rate;
+        ip->tokens = tokens < burst ? (uint32_t)tokens : burst;
+        ip->ts = cur_ts;
+    }
+    if (0 == ip->tokens) return 0;
+    --ip->tokens;
+    ip->full_ts = ip->tokens < burst
+      ? cur_ts + (time_t)((burst - ip->tokens + rate - 1) / rate)
+      : cur_ts;
+    return 1;
+}
+
+
 INIT_FUNC(mod_evasive_init) {
     return calloc(1, sizeof(plugin_data));
 }
 
+FREE_FUNC(mod_evasive_free) {
+    plugin_data * const p = p_d;
+    mod_evasive_ip_table * const iptab = &p->iptab;
+    for (uint32_t i = 0; i < iptab->size; ++i) {
+        for (mod_evasive_ip *ip = iptab->ptr[i], *next; ip; ip = next) {
+            next = ip->next;
+            free(ip);
+        }
+    }
+    free(iptab->ptr);
+}
+
 static void mod_evasive_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* evasive.max-conns-per-ip */
@@ -53,6 +192,12 @@ static void mod_evasive_merge_config_cpv(plugin_config * const pconf, const conf
       case 2: /* evasive.location */
         pconf->location = cpv->v.b;
         break;
+      case 3: /* evasive.max-requests-per-sec */
+        pconf->max_rps = cpv->v.u;
+        break;
+      case 4: /* evasive.max-requests-burst */
+        pconf->max_burst = cpv->v.u;
+        break;
       default:/* should not happen */
         return;
     }
@@ -65,12 +210,15 @@ static void mod_evasive_merge_config(plugin_config * const pconf, const config_p
 }
 
 static void mod_evasive_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_evasive_merge_config(&p->conf,p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_evasive_set_defaults) {
@@ -84,6 +232,12 @@ SETDEFAULTS_FUNC(mod_evasive_set_defaults) {
      ,{ CONST_STR_LEN("evasive.location"),
         T_CONFIG_STRING,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("evasive.max-requests-per-sec"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("evasive.max-requests-burst"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_CONNECTION }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -103,45 +257,132 @@ SETDEFAULTS_FUNC(mod_evasive_set_defaults) {
     return HANDLER_GO_ON;
 }
 
+CONNECTION_FUNC(mod_evasive_handle_con_accept) {
+    plugin_data * const p = p_d;
+    handler_ctx * const hctx = calloc(1, sizeof(*hctx));
+    force_assert(hctx);
+    hctx->ip = mod_evasive_ip_get(&p->iptab, &con->dst_addr);
+    ++hctx->ip->conns;
+    con->request.plugin_ctx[p->id] = hctx;
+    return HANDLER_GO_ON;
+}
+
+CONNECTION_FUNC(mod_evasive_handle_con_close) {
+    plugin_data * const p = p_d;
+    handler_ctx * const hctx = con->request.plugin_ctx[p->id];
+    if (NULL != hctx) {
+        con->request.plugin_ctx[p->id] = NULL;
+        hctx->ip->active -= hctx->active;
+        mod_evasive_ip_release(&p->iptab, hctx->ip);
+        free(hctx);
+    }
+    return HANDLER_GO_ON;
+}
+
+REQUEST_FUNC(mod_evasive_request_reset) {
+    plugin_data * const p = p_d;
+    handler_ctx * const hctx = r->con->request.plugin_ctx[p->id];
+    if (r != &r->con->request) { /* HTTP/2 stream */
+        if (NULL == r->plugin_ctx[p->id]) return HANDLER_GO_ON;
+        r->plugin_ctx[p->id] = NULL;
+        if (NULL == hctx) return HANDLER_GO_ON;
+    }
+    else if (NULL == hctx || !hctx->con_req)
+        return HANDLER_GO_ON;
+    else
+        hctx->con_req = 0;
+    --hctx->active;
+    --hctx->ip->active;
+    return HANDLER_GO_ON;
+}
+
+TRIGGER_FUNC(mod_evasive_trigger) {
+    plugin_data * const p = p_d;
+    const time_t cur_ts = log_epoch_secs;
+    if (cur_ts & 0x7) return HANDLER_GO_ON; /*(continue once each 8 sec)*/
+    UNUSED(srv);
+
+    /* remove entries without connections once token bucket is full again */
+    mod_evasive_ip_table * const iptab = &p->iptab;
+    for (uint32_t i = 0; i < iptab->size; ++i) {
+        for (mod_evasive_ip **b = iptab->ptr + i, *ip; (ip = *b); ) {
+            if (0 == ip->conns && ip->full_ts <= cur_ts) {
+                *b = ip->next;
+                --iptab->used;
+                free(ip);
+            }
+            else
+                b = &ip->next;
+        }
+    }
+
+    return HANDLER_GO_ON;
+}
+
+__attribute_cold__
+static handler_t mod_evasive_deny (request_st * const r, const plugin_data * const p, const int status, const char * const reason) {
+	if (!p->conf.silent) {
+		log_error(r->conf.errh, __FILE__, __LINE__,
+		  "%s turned away. %s", r->con->dst_addr_buf->ptr, reason);
+	}
+
+	if (!buffer_is_empty(p->conf.location)) {
+		http_header_response_set(r, HTTP_HEADER_LOCATION, CONST_STR_LEN("Location"), CONST_BUF_LEN(p->conf.location));
+		r->http_status = 302;
+		r->resp_body_finished = 1;
+	} else {
+		r->http_status = status;
+	}
+	r->handler_module = NULL;
+	return HANDLER_FINISHED;
+}
+
 URIHANDLER_FUNC(mod_evasive_uri_handler) {
 	plugin_data *p = p_d;
 
 	mod_evasive_patch_config(r, p);
 
-	/* no limit set, nothing to block */
-	if (p->conf.max_conns == 0) return HANDLER_GO_ON;
-
-	sock_addr * const dst_addr = &r->con->dst_addr;
-	const connections * const conns = &r->con->srv->conns;
-	for (uint32_t i = 0, conns_by_ip = 0; i < conns->used; ++i) {
-		connection *c = conns->ptr[i];
-
-		/* check if other connections are already actively serving data for the same IP
-		 * we can only ban connections which are already behind the 'read request' state
-		 * */
-		if (c->request.state <= CON_STATE_REQUEST_END) continue;
-
-		if (!sock_addr_is_addr_eq(&c->dst_addr, dst_addr)) continue;
-		conns_by_ip++;
-
-		if (conns_by_ip > p->conf.max_conns) {
-			if (!p->conf.silent) {
-				log_error(r->conf.errh, __FILE__, __LINE__,
-				  "%s turned away. Too many connections.",
-				  r->con->dst_addr_buf->ptr);
-			}
-
-			if (!buffer_is_empty(p->conf.location)) {
-				http_header_response_set(r, HTTP_HEADER_LOCATION, CONST_STR_LEN("Location"), CONST_BUF_LEN(p->conf.location));
-				r->http_status = 302;
-				r->resp_body_finished = 1;
-			} else {
-				r->http_status = 403;
-			}
-			r->handler_module = NULL;
-			return HANDLER_FINISHED;
+	connection * const con = r->con;
+	handler_ctx * const hctx = con->request.plugin_ctx[p->id];
+	if (NULL == hctx) return HANDLER_GO_ON;
+
+	mod_evasive_ip *ip = hctx->ip;
+	if (!sock_addr_is_addr_eq(&ip->addr, &con->dst_addr)) {
+		/* con->dst_addr changed (e.g. by mod_extforward); move counts */
+		hctx->ip = mod_evasive_ip_get(&p->iptab, &con->dst_addr);
+		++hctx->ip->conns;
+		hctx->ip->active += hctx->active;
+		ip->active -= hctx->active;
+		mod_evasive_ip_release(&p->iptab, ip);
+		ip = hctx->ip;
+	}
+
+	/* count request as active until request reset
+	 * (r->plugin_ctx[p->id] marks HTTP/2 stream as counted) */
+	if (r != &con->request) {
+		if (NULL == r->plugin_ctx[p->id]) {
+			r->plugin_ctx[p->id] = hctx;
+			++hctx->active;
+			++ip->active;
 		}
 	}
+	else if (!hctx->con_req) {
+		hctx->con_req = 1;
+		++hctx->active;
+		++ip->active;
+	}
+
+	/* no limit set, nothing to block */
+	if (p->conf.max_conns == 0 && p->conf.max_rps == 0) return HANDLER_GO_ON;
+
+	/* check if other connections are already actively serving data for the same IP
+	 * (requests which have not yet reached this point are not counted) */
+	if (p->conf.max_conns && ip->active > p->conf.max_conns)
+		return mod_evasive_deny(r, p, 403, "Too many connections.");
+
+	if (p->conf.max_rps
+	    && !mod_evasive_ip_token(ip, p->conf.max_rps, p->conf.max_burst))
+		return mod_evasive_deny(r, p, 429, "Too many requests.");
 
 	return HANDLER_GO_ON;
 }
@@ -153,8 +394,13 @@ int mod_evasive_plugin_init(plugin *p) {
 	p->name        = "evasive";
 
 	p->init        = mod_evasive_init;
+	p->cleanup     = mod_evasive_free;
 	p->set_defaults = mod_evasive_set_defaults;
 	p->handle_uri_clean  = mod_evasive_uri_handler;
+	p->handle_connection_accept = mod_evasive_handle_con_accept;
+	p->handle_connection_close  = mod_evasive_handle_con_close;
+	p->connection_reset = mod_evasive_request_reset;
+	p->handle_trigger = mod_evasive_trigger;
 
 	return 0;
 }
@@ -18,8 +18,8 @@
  */
 
 typedef struct {
-    const array *expire_url;
-    const array *expire_mimetypes;
+    const array_trie *expire_url;
+    const array_trie *expire_mimetypes;
 } plugin_config;
 
 typedef struct {
@@ -37,6 +37,22 @@ INIT_FUNC(mod_expire_init) {
 FREE_FUNC(mod_expire_free) {
     plugin_data * const p = p_d;
     free(p->toffsets);
+    if (NULL == p->cvlist) return;
+    /* (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            if (cpv->vtype != T_CONFIG_LOCAL || NULL == cpv->v.v) continue;
+            switch (cpv->k_id) {
+              case 0: /* expire.url */
+              case 1: /* expire.mimetypes */
+                array_trie_free(cpv->v.v);
+                break;
+              default:
+                break;
+            }
+        }
+    }
 }
 
 static time_t mod_expire_get_offset(log_error_st *errh, const buffer *expire, time_t *offset) {
@@ -168,10 +184,12 @@ static time_t mod_expire_get_offset(log_error_st *errh, const buffer *expire, ti
 static void mod_expire_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* expire.url */
-        pconf->expire_url = cpv->v.a;
+        if (cpv->vtype == T_CONFIG_LOCAL)
+            pconf->expire_url = cpv->v.v;
         break;
       case 1: /* expire.mimetypes */
-        pconf->expire_mimetypes = cpv->v.a;
+        if (cpv->vtype == T_CONFIG_LOCAL)
+            pconf->expire_mimetypes = cpv->v.v;
         break;
       default:/* should not happen */
         return;
@@ -185,12 +203,15 @@ static void mod_expire_merge_config(plugin_config * const pconf, const config_pl
 }
 
 static void mod_expire_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_expire_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_expire_set_defaults) {
@@ -213,7 +234,7 @@ SETDEFAULTS_FUNC(mod_expire_set_defaults) {
     /* process and validate config directives
      * (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
-        const config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
         for (; -1 != cpv->k_id; ++cpv) {
             const array *a = NULL;
             switch (cpv->k_id) {
@@ -255,6 +276,12 @@ SETDEFAULTS_FUNC(mod_expire_set_defaults) {
                     v->used = (uint32_t)p->tused;
                 }
             }
+
+            if (NULL != a) {
+                /* compile prefix matcher (after keys adjusted above) */
+                cpv->v.v = array_trie_init(a, ARRAY_TRIE_KEY|ARRAY_TRIE_PREFIX);
+                cpv->vtype = T_CONFIG_LOCAL;
+            }
         }
     }
 
@@ -285,15 +312,18 @@ REQUEST_FUNC(mod_expire_handler) {
 
 	/* check expire.url */
 	ds = p->conf.expire_url
-	  ? (const data_string *)array_match_key_prefix(p->conf.expire_url, &r->uri.path)
+	  ? (const data_string *)
+	    array_trie_match_key(p->conf.expire_url, CONST_BUF_LEN(&r->uri.path), 0)
 	  : NULL;
 	/* check expire.mimetypes (if no match with expire.url) */
 	if (NULL == ds) {
 		if (NULL == p->conf.expire_mimetypes) return HANDLER_GO_ON;
 		vb = http_header_response_get(r, HTTP_HEADER_CONTENT_TYPE, CONST_STR_LEN("Content-Type"));
 		ds = (NULL != vb)
-		   ? (const data_string *)array_match_key_prefix(p->conf.expire_mimetypes, vb)
-		   : (const data_string *)array_get_element_klen(p->conf.expire_mimetypes, CONST_STR_LEN(""));
+		   ? (const data_string *)
+		     array_trie_match_key(p->conf.expire_mimetypes, CONST_BUF_LEN(vb), 0)
+		   : (const data_string *)
+		     array_get_element_klen(p->conf.expire_mimetypes->a, CONST_STR_LEN(""));
 		if (NULL == ds) return HANDLER_GO_ON;
 	}
 
@@ -36,6 +36,8 @@ typedef gw_handler_ctx   handler_ctx;
 #error "mismatched defines: (GW_FILTER != FCGI_FILTER)"
 #endif
 
+static int *fastcgi_stat_requests; /* "fastcgi.requests" */
+
 static void mod_fastcgi_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* fastcgi.server */
@@ -68,11 +70,14 @@ static void mod_fastcgi_merge_config(plugin_config * const pconf, const config_p
 }
 
 static void mod_fastcgi_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_fastcgi_merge_config(&p->conf,p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_fastcgi_set_defaults) {
@@ -138,6 +143,8 @@ SETDEFAULTS_FUNC(mod_fastcgi_set_defaults) {
             mod_fastcgi_merge_config(&p->defaults, cpv);
     }
 
+    fastcgi_stat_requests = status_counter_register(CONST_STR_LEN("fastcgi.requests"));
+
     return HANDLER_GO_ON;
 }
 
@@ -278,7 +285,9 @@ static handler_t fcgi_create_env(handler_ctx *hctx) {
 	/* send FCGI_BEGIN_REQUEST */
 
 	if (hctx->request_id == 0) {
-		hctx->request_id = 1; /* always use id 1 as we don't use multiplexing */
+		/* always use id 1 as we don't use multiplexing
+		 * (one request at a time, even on a kept connection) */
+		hctx->request_id = 1;
 	} else {
 		log_error(r->conf.errh, __FILE__, __LINE__,
 		  "fcgi-request is already in use: %d", hctx->request_id);
@@ -288,10 +297,14 @@ static handler_t fcgi_create_env(handler_ctx *hctx) {
 	fcgi_header(&(beginRecord.header), FCGI_BEGIN_REQUEST, request_id, sizeof(beginRecord.body), 0);
 	beginRecord.body.roleB0 = hctx->gw_mode;
 	beginRecord.body.roleB1 = 0;
-	beginRecord.body.flags = 0;
+	/* ask backend to keep connection open if keep-alive pool enabled */
+	beginRecord.body.flags = host->keepalive_max_idle ? FCGI_KEEP_CONN : 0;
 	memset(beginRecord.body.reserved, 0, sizeof(beginRecord.body.reserved));
 
 	buffer_copy_string_len(b, (const char *)&beginRecord, sizeof(beginRecord));
+	/* (end of response is FCGI_END_REQUEST; see fcgi_recv_parse()) */
+	hctx->opts.framing = HTTP_RESPONSE_FRAMING_NONE;
+	hctx->opts.keepalive = 0;
 	fcgi_header(&header, FCGI_PARAMS, request_id, 0, 0); /*(set aside space to fill in later)*/
 	buffer_append_string_len(b, (const char *)&header, sizeof(header));
 
@@ -324,7 +337,7 @@ static handler_t fcgi_create_env(handler_ctx *hctx) {
 	}
 	fcgi_stdin_append(hctx);
 
-	status_counter_inc(CONST_STR_LEN("fastcgi.requests"));
+	++(*fastcgi_stat_requests);
 	return HANDLER_GO_ON;
 }
 
@@ -406,6 +419,9 @@ static handler_t fcgi_recv_parse(request_st * const r, struct http_response_opts
 		if (!(fdevent_fdnode_interest(hctx->fdn) & FDEVENT_IN)
 		    && !(r->conf.stream_response_body & FDEVENT_STREAM_RESPONSE_POLLRDHUP))
 			return HANDLER_GO_ON;
+		if (gw_conn_reused_retry(hctx, r))
+			return HANDLER_ERROR; /*(kept connection closed by backend;
+			                       * gw_backend retries request)*/
 		log_error(r->conf.errh, __FILE__, __LINE__,
 		  "unexpected end-of-file (perhaps the fastcgi process died):"
 		  "pid: %d socket: %s",
@@ -479,6 +495,23 @@ static handler_t fcgi_recv_parse(request_st * const r, struct http_response_opts
 			}
 			break;
 		case FCGI_END_REQUEST:
+			if (hctx->host->keepalive_max_idle
+			    && packet.request_id == hctx->request_id
+			    && packet.len - packet.padding
+			       == sizeof(FCGI_EndRequestBody)) {
+				buffer * const tb = r->tmp_buf;
+				buffer_clear(tb);
+				fastcgi_get_packet_body(tb, hctx, &packet);
+				/* backend keeps connection open (FCGI_KEEP_CONN)
+				 * and it may be reused if request completed and
+				 * no other data was received */
+				if (((FCGI_EndRequestBody *)(void *)tb->ptr)->protocolStatus
+				      == FCGI_REQUEST_COMPLETE
+				    && chunkqueue_is_empty(hctx->rb)) {
+					opts->framing = HTTP_RESPONSE_FRAMING_DONE;
+					opts->keepalive = 1;
+				}
+			}
 			hctx->request_id = -1; /*(flag request ended)*/
 			fin = 1;
 			break;
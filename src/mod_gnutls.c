@@ -2281,6 +2281,9 @@ load_next_chunk (request_st * const r, chunkqueue * const cq, off_t max_bytes,
             *data_len = toSend;
         }
         return 0;
+    case PIPE_CHUNK: /*(not used with TLS; see http_response_splice_ok())*/
+    default:
+        break;
     }
 
     return -1;
@@ -2437,14 +2437,13 @@ mod_openssl_alpn_select_cb (SSL *ssl, const unsigned char **out, unsigned char *
         n = in[i++];
         if (i+n > inlen || 0 == n) break;
         switch (n) {
-         #if 0
           case 2:  /* "h2" */
-            if (in[i] == 'h' && in[i+1] == '2') {
+            if (in[i] == 'h' && in[i+1] == '2'
+                && hctx->con->srv->srvconf.h2proto) {
                 proto = MOD_OPENSSL_ALPN_H2;
                 break;
             }
             continue;
-         #endif
           case 8:  /* "http/1.1" "http/1.0" */
             if (0 == memcmp(in+i, "http/1.", 7)) {
                 if (in[i+7] == '1') {
@@ -2691,6 +2690,11 @@ network_init_ssl (server *srv, plugin_config_socket *s, plugin_data *p)
         long ssloptions = SSL_OP_ALL
                         | SSL_OP_NO_SESSION_RESUMPTION_ON_RENEGOTIATION
                         | SSL_OP_NO_COMPRESSION;
+      #ifdef SSL_OP_ENABLE_KTLS /* openssl 3.0 */
+        /* kernel TLS offload, if supported by kernel (e.g. Linux tls.ko)
+         * (disable with ssl.openssl.ssl-conf-cmd = ("Options" => "-KTLS")) */
+        ssloptions |= SSL_OP_ENABLE_KTLS;
+      #endif
 
       #if OPENSSL_VERSION_NUMBER >= 0x10100000L \
        || defined(WOLFSSL_VERSION)
@@ -3601,6 +3605,9 @@ load_next_chunk (request_st * const r, chunkqueue * const cq, off_t max_bytes,
             *data_len = toSend;
         }
         return 0;
+    case PIPE_CHUNK: /*(not used with TLS; see http_response_splice_ok())*/
+    default:
+        break;
     }
 
     return -1;
@@ -3611,6 +3618,85 @@ static int
 mod_openssl_close_notify(handler_ctx *hctx);
 
 
+__attribute_cold__
+static int
+mod_openssl_write_err (SSL * const ssl, int wr, connection * const con, log_error_st * const errh)
+{
+    int ssl_r;
+    unsigned long err;
+
+    switch ((ssl_r = SSL_get_error(ssl, wr))) {
+    case SSL_ERROR_WANT_READ:
+        con->is_readable = -1;
+        return 0; /* try again later */
+    case SSL_ERROR_WANT_WRITE:
+        con->is_writable = -1;
+        return 0; /* try again later */
+    case SSL_ERROR_SYSCALL:
+        /* perhaps we have error waiting in our error-queue */
+        if (0 != (err = ERR_get_error())) {
+            do {
+                log_error(errh, __FILE__, __LINE__,
+                  "SSL: %d %d %s",ssl_r,wr,ERR_error_string(err,NULL));
+            } while((err = ERR_get_error()));
+        } else if (wr == -1) {
+            /* no, but we have errno */
+            switch(errno) {
+            case EPIPE:
+            case ECONNRESET:
+                return -2;
+            default:
+                log_perror(errh, __FILE__, __LINE__,
+                  "SSL: %d %d", ssl_r, wr);
+                break;
+            }
+        } else {
+            /* neither error-queue nor errno ? */
+            log_perror(errh, __FILE__, __LINE__,
+              "SSL (error): %d %d", ssl_r, wr);
+        }
+        break;
+
+    case SSL_ERROR_ZERO_RETURN:
+        /* clean shutdown on the remote side */
+
+        if (wr == 0) return -2;
+
+        /* fall through */
+    default:
+        while((err = ERR_get_error())) {
+            log_error(errh, __FILE__, __LINE__,
+              "SSL: %d %d %s", ssl_r, wr, ERR_error_string(err, NULL));
+        }
+        break;
+    }
+    return -1;
+}
+
+
+#ifdef SSL_OP_ENABLE_KTLS
+static int
+connection_write_cq_ssl_ktls (connection * const con, chunkqueue * const cq, off_t max_bytes, SSL * const ssl)
+{
+    /* kernel TLS (kTLS) encrypts; send FILE_CHUNK without userspace copy */
+    request_st * const r = &con->request;
+    chunk * const c = cq->first;
+    if (0 != chunkqueue_open_file_chunk(cq, r->conf.errh)) return -1;
+
+    const off_t offset = c->file.start + c->offset;
+    off_t toSend = c->file.length - c->offset;
+    if (toSend > max_bytes) toSend = max_bytes;
+
+    ERR_clear_error();
+    ossl_ssize_t wr = SSL_sendfile(ssl, c->file.fd, offset, (size_t)toSend, 0);
+    if (wr < 0) return mod_openssl_write_err(ssl, (int)wr, con, r->conf.errh);
+
+    chunkqueue_mark_written(cq, wr);
+    return (wr < toSend) ? 1 : 0; /* 1: try again later */
+}
+#endif
+
+
 static int
 connection_write_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
 {
@@ -3622,11 +3708,28 @@ connection_write_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
 
     chunkqueue_remove_finished_chunks(cq);
 
+  #ifdef SSL_OP_ENABLE_KTLS
+    /* (kTLS is enabled after handshake, if kernel accepted TLS keys) */
+    const int ktls = BIO_get_ktls_send(SSL_get_wbio(ssl));
+  #endif
+
     while (max_bytes > 0 && NULL != cq->first) {
         const char *data;
         size_t data_len;
         int wr;
 
+      #ifdef SSL_OP_ENABLE_KTLS
+        if (ktls && cq->first->type == FILE_CHUNK) {
+            const off_t written = cq->bytes_out;
+            wr = connection_write_cq_ssl_ktls(con, cq, max_bytes, ssl);
+            if (wr < 0) return wr;
+            max_bytes -= cq->bytes_out - written;
+            if (wr) break; /* try again later */
+            if (written == cq->bytes_out) return 0; /* (WANT_READ/WANT_WRITE)*/
+            continue;
+        }
+      #endif
+
         if (0 != load_next_chunk(r, cq, max_bytes, &data, &data_len)) return -1;
 
         /**
@@ -3648,57 +3751,7 @@ connection_write_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
             return -1;
         }
 
-        if (wr <= 0) {
-            int ssl_r;
-            unsigned long err;
-
-            switch ((ssl_r = SSL_get_error(ssl, wr))) {
-            case SSL_ERROR_WANT_READ:
-                con->is_readable = -1;
-                return 0; /* try again later */
-            case SSL_ERROR_WANT_WRITE:
-                con->is_writable = -1;
-                return 0; /* try again later */
-            case SSL_ERROR_SYSCALL:
-                /* perhaps we have error waiting in our error-queue */
-                if (0 != (err = ERR_get_error())) {
-                    do {
-                        log_error(r->conf.errh, __FILE__, __LINE__,
-                          "SSL: %d %d %s",ssl_r,wr,ERR_error_string(err,NULL));
-                    } while((err = ERR_get_error()));
-                } else if (wr == -1) {
-                    /* no, but we have errno */
-                    switch(errno) {
-                    case EPIPE:
-                    case ECONNRESET:
-                        return -2;
-                    default:
-                        log_perror(r->conf.errh, __FILE__, __LINE__,
-                          "SSL: %d %d", ssl_r, wr);
-                        break;
-                    }
-                } else {
-                    /* neither error-queue nor errno ? */
-                    log_perror(r->conf.errh, __FILE__, __LINE__,
-                      "SSL (error): %d %d", ssl_r, wr);
-                }
-                break;
-
-            case SSL_ERROR_ZERO_RETURN:
-                /* clean shutdown on the remote side */
-
-                if (wr == 0) return -2;
-
-                /* fall through */
-            default:
-                while((err = ERR_get_error())) {
-                    log_error(r->conf.errh, __FILE__, __LINE__,
-                      "SSL: %d %d %s", ssl_r, wr, ERR_error_string(err, NULL));
-                }
-                break;
-            }
-            return -1;
-        }
+        if (wr <= 0) return mod_openssl_write_err(ssl, wr, con, r->conf.errh);
 
         chunkqueue_mark_written(cq, wr);
         max_bytes -= wr;
@@ -3756,6 +3809,8 @@ connection_read_cq_ssl (connection *con, chunkqueue *cq, off_t max_bytes)
                 len = -1;
                 break;
             }
+            if (hctx->alpn == MOD_OPENSSL_ALPN_H2)
+                hctx->r->http_version = HTTP_VERSION_2;
             hctx->alpn = 0;
         }
       #endif
@@ -4217,10 +4272,13 @@ http_cgi_ssl_env (request_st * const r, handler_ctx * const hctx)
 REQUEST_FUNC(mod_openssl_handle_request_env)
 {
     plugin_data *p = p_d;
-    handler_ctx *hctx = r->plugin_ctx[p->id];
+    /* (r->con->request is used since HTTP/2 streams are separate requests) */
+    handler_ctx *hctx = r->con->request.plugin_ctx[p->id];
     if (NULL == hctx) return HANDLER_GO_ON;
-    if (hctx->request_env_patched) return HANDLER_GO_ON;
-    hctx->request_env_patched = 1;
+    if (r == &r->con->request) {
+        if (hctx->request_env_patched) return HANDLER_GO_ON;
+        hctx->request_env_patched = 1;
+    }
 
     http_cgi_ssl_env(r, hctx);
     if (hctx->conf.ssl_verifyclient) {
@@ -4241,7 +4299,7 @@ REQUEST_FUNC(mod_openssl_handle_uri_raw)
      * is enabled with extforward.hap-PROXY = "enable", in which case the
      * reverse is true: mod_extforward must be loaded after mod_openssl */
     plugin_data *p = p_d;
-    handler_ctx *hctx = r->plugin_ctx[p->id];
+    handler_ctx *hctx = r->con->request.plugin_ctx[p->id];
     if (NULL == hctx) return HANDLER_GO_ON;
 
     mod_openssl_patch_config(r, &hctx->conf);
@@ -4257,7 +4315,7 @@ REQUEST_FUNC(mod_openssl_handle_request_reset)
 {
     plugin_data *p = p_d;
     handler_ctx *hctx = r->plugin_ctx[p->id];
-    if (NULL == hctx) return HANDLER_GO_ON;
+    if (NULL == hctx) return HANDLER_GO_ON; /*(NULL for HTTP/2 streams)*/
 
     hctx->request_env_patched = 0;
     return HANDLER_GO_ON;
@@ -18,8 +18,8 @@
  *
  * HTTP reverse proxy
  *
- * TODO:      - HTTP/1.1
- *            - HTTP/1.1 persistent connection with upstream servers
+ * HTTP/1.1 persistent connections with upstream servers are used if
+ * "keepalive-max-idle" is set for the backend host in proxy.server
  */
 
 /* (future: might split struct and move part to http-header-glue.c) */
@@ -60,6 +60,7 @@ typedef struct {
 } plugin_data;
 
 static int proxy_check_extforward;
+static int *proxy_stat_requests; /* "proxy.requests" */
 
 typedef struct {
 	gw_handler_ctx gw;
@@ -146,11 +147,14 @@ static void mod_proxy_merge_config(plugin_config * const pconf, const config_plu
 
 static void mod_proxy_patch_config(request_st * const r, plugin_data * const p)
 {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_proxy_merge_config(&p->conf, p->cvlist+p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 
@@ -379,6 +383,8 @@ SETDEFAULTS_FUNC(mod_proxy_set_defaults)
             mod_proxy_merge_config(&p->defaults, cpv);
     }
 
+    proxy_stat_requests = status_counter_register(CONST_STR_LEN("proxy.requests"));
+
     /* special-case behavior if mod_extforward is loaded */
     for (uint32_t i = 0; i < srv->srvconf.modules->used; ++i) {
         buffer *m = &((data_string *)srv->srvconf.modules->data[i])->value;
@@ -857,6 +863,8 @@ static handler_t proxy_create_env(gw_handler_ctx *gwhctx) {
 				   || NULL != hctx->conf.header.hosts_request);
 	const int upgrade = hctx->conf.header.upgrade
 	    && (NULL != http_header_request_get(r, HTTP_HEADER_UPGRADE, CONST_STR_LEN("Upgrade")));
+	/* reuse connection to backend (HTTP/1.1) if keep-alive pool enabled */
+	const int keepalive = hctx->gw.host->keepalive_max_idle && !upgrade;
 	size_t rsz = (size_t)(r->read_queue->bytes_out - hctx->gw.wb->bytes_in);
 	buffer * const b = chunkqueue_prepend_buffer_open_sz(hctx->gw.wb, rsz < 65536 ? rsz : r->rqst_header_len);
 
@@ -876,7 +884,7 @@ static handler_t proxy_create_env(gw_handler_ctx *gwhctx) {
 		stream_chunked = 1;
 		hctx->gw.stdin_append = proxy_stdin_append;
 	}
-	if (!stream_chunked && !upgrade)
+	if (!stream_chunked && !upgrade && !keepalive)
 		buffer_append_string_len(b, CONST_STR_LEN(" HTTP/1.0\r\n"));
 	else
 		buffer_append_string_len(b, CONST_STR_LEN(" HTTP/1.1\r\n"));
@@ -928,6 +936,11 @@ static handler_t proxy_create_env(gw_handler_ctx *gwhctx) {
 		case 4:
 			if (buffer_is_equal_caseless_string(&ds->key, CONST_STR_LEN("Host"))) continue; /*(handled further above)*/
 			break;
+		case 6:
+			/* do not forward Expect: 100-continue on HTTP/1.1 keep-alive
+			 * connection to backend (request body has been received) */
+			if (keepalive && buffer_is_equal_caseless_string(&ds->key, CONST_STR_LEN("Expect"))) continue;
+			break;
 		case 10:
 			if (buffer_is_equal_caseless_string(&ds->key, CONST_STR_LEN("Connection"))) continue;
 			if (buffer_is_equal_caseless_string(&ds->key, CONST_STR_LEN("Set-Cookie"))) continue; /*(response header only; avoid accidental reflection)*/
@@ -987,10 +1000,18 @@ static handler_t proxy_create_env(gw_handler_ctx *gwhctx) {
 		http_header_remap_uri(b, buffer_string_length(b) - vlen - 2, &hctx->conf.header, 1);
 	}
 
-	if (!upgrade)
-		buffer_append_string_len(b, CONST_STR_LEN("Connection: close\r\n\r\n"));
-	else
+	if (upgrade)
 		buffer_append_string_len(b, CONST_STR_LEN("Connection: close, upgrade\r\n\r\n"));
+	else if (keepalive)
+		buffer_append_string_len(b, CONST_STR_LEN("Connection: keep-alive\r\n\r\n"));
+	else
+		buffer_append_string_len(b, CONST_STR_LEN("Connection: close\r\n\r\n"));
+
+	/* track end of response from backend to permit connection reuse */
+	hctx->gw.opts.framing = keepalive
+	  ? HTTP_RESPONSE_FRAMING_TRACK
+	  : HTTP_RESPONSE_FRAMING_NONE;
+	hctx->gw.opts.keepalive = 0;
 
 	hctx->gw.wb_reqlen = buffer_string_length(b);
 	chunkqueue_prepend_buffer_commit(hctx->gw.wb);
@@ -1003,7 +1024,7 @@ static handler_t proxy_create_env(gw_handler_ctx *gwhctx) {
 			hctx->gw.wb_reqlen = -hctx->gw.wb_reqlen;
 	}
 
-	status_counter_inc(CONST_STR_LEN("proxy.requests"));
+	++(*proxy_stat_requests);
 	return HANDLER_GO_ON;
 }
 
@@ -1016,7 +1037,7 @@ static handler_t proxy_create_env_connect(gw_handler_ctx *gwhctx) {
 	gw_set_transparent(&hctx->gw);
 	http_response_upgrade_read_body_unknown(r);
 
-	status_counter_inc(CONST_STR_LEN("proxy.requests"));
+	++(*proxy_stat_requests);
 	return HANDLER_GO_ON;
 }
 
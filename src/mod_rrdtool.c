@@ -152,12 +152,15 @@ static void mod_rrd_merge_config(plugin_config * const pconf, const config_plugi
 }
 
 static void mod_rrd_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_rrd_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_rrd_set_defaults) {
@@ -424,8 +427,8 @@ REQUESTDONE_FUNC(mod_rrd_account) {
     rrd_config * const rrd = p->conf.rrd;
     if (NULL == rrd) return HANDLER_GO_ON;
     ++rrd->requests;
-    rrd->bytes_written += r->con->bytes_written;
-    rrd->bytes_read    += r->con->bytes_read;
+    rrd->bytes_written += request_bytes_written(r);
+    rrd->bytes_read    += request_bytes_read(r);
 
     return HANDLER_GO_ON;
 }
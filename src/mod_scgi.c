@@ -19,6 +19,8 @@ typedef gw_handler_ctx   handler_ctx;
 
 enum { LI_PROTOCOL_SCGI, LI_PROTOCOL_UWSGI };
 
+static int *scgi_stat_requests; /* "scgi.requests" */
+
 static void mod_scgi_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* scgi.server */
@@ -55,11 +57,14 @@ static void mod_scgi_merge_config(plugin_config * const pconf, const config_plug
 }
 
 static void mod_scgi_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_scgi_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_scgi_set_defaults) {
@@ -141,6 +146,8 @@ SETDEFAULTS_FUNC(mod_scgi_set_defaults) {
             mod_scgi_merge_config(&p->defaults, cpv);
     }
 
+    scgi_stat_requests = status_counter_register(CONST_STR_LEN("scgi.requests"));
+
     return HANDLER_GO_ON;
 }
 
@@ -274,7 +281,7 @@ static handler_t scgi_create_env(handler_ctx *hctx) {
 			hctx->wb_reqlen = -hctx->wb_reqlen;
 	}
 
-	status_counter_inc(CONST_STR_LEN("scgi.requests"));
+	++(*scgi_stat_requests);
 	return HANDLER_GO_ON;
 }
 
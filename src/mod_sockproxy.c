@@ -26,6 +26,8 @@ typedef gw_handler_ctx   handler_ctx;
  *
  */
 
+static int *sockproxy_stat_requests; /* "sockproxy.requests" */
+
 static void mod_sockproxy_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* sockproxy.server */
@@ -55,11 +57,14 @@ static void mod_sockproxy_merge_config(plugin_config * const pconf, const config
 }
 
 static void mod_sockproxy_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_sockproxy_merge_config(&p->conf,p->cvlist+p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_sockproxy_set_defaults) {
@@ -126,6 +131,8 @@ SETDEFAULTS_FUNC(mod_sockproxy_set_defaults) {
             mod_sockproxy_merge_config(&p->defaults, cpv);
     }
 
+    sockproxy_stat_requests = status_counter_register(CONST_STR_LEN("sockproxy.requests"));
+
     return HANDLER_GO_ON;
 }
 
@@ -136,7 +143,7 @@ static handler_t sockproxy_create_env_connect(handler_ctx *hctx) {
 	gw_set_transparent(hctx);
 	http_response_upgrade_read_body_unknown(r);
 
-	status_counter_inc(CONST_STR_LEN("sockproxy.requests"));
+	++(*sockproxy_stat_requests);
 	return HANDLER_GO_ON;
 }
 
@@ -7,6 +7,8 @@
 #include "plugin.h"
 
 #include "response.h"
+#include "stat_cache.h"
+#include "status_counter.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -21,12 +23,14 @@ typedef struct {
 	const array *exclude_ext;
 	unsigned short etags_used;
 	unsigned short disable_pathinfo;
+	uint32_t mem_cache_max_sz;
 } plugin_config;
 
 typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
     plugin_config conf;
+    int mem_cache_used;
 } plugin_data;
 
 INIT_FUNC(mod_staticfile_init) {
@@ -44,6 +48,11 @@ static void mod_staticfile_merge_config_cpv(plugin_config * const pconf, const c
       case 2: /* static-file.disable-pathinfo */
         pconf->disable_pathinfo = cpv->v.u;
         break;
+      case 3: /* static-file.memory-cache-max-size */
+        pconf->mem_cache_max_sz = cpv->v.u;
+        break;
+      case 4: /* static-file.memory-cache-max-total */
+        break;
       default:/* should not happen */
         return;
     }
@@ -56,6 +65,8 @@ static void mod_staticfile_merge_config(plugin_config * const pconf, const confi
 }
 
 static void mod_staticfile_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
@@ -63,6 +74,7 @@ static void mod_staticfile_patch_config(request_st * const r, plugin_data * cons
             mod_staticfile_merge_config(&p->conf,
                                         p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_staticfile_set_defaults) {
@@ -76,6 +88,12 @@ SETDEFAULTS_FUNC(mod_staticfile_set_defaults) {
      ,{ CONST_STR_LEN("static-file.disable-pathinfo"),
         T_CONFIG_BOOL,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("static-file.memory-cache-max-size"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("static-file.memory-cache-max-total"),
+        T_CONFIG_INT,
+        T_CONFIG_SCOPE_SERVER }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -85,6 +103,26 @@ SETDEFAULTS_FUNC(mod_staticfile_set_defaults) {
     if (!config_plugin_values_init(srv, p, cpk, "mod_staticfile"))
         return HANDLER_ERROR;
 
+    /* process and validate config directives
+     * (init i to 0 if global context; to 1 to skip empty global context) */
+    uint32_t mem_cache_max_total = 16 * 1024 * 1024; /* 16 MB */
+    for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
+        const config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            switch (cpv->k_id) {
+              case 3: /* static-file.memory-cache-max-size */
+                if (cpv->v.u) p->mem_cache_used = 1;
+                break;
+              case 4: /* static-file.memory-cache-max-total */
+                mem_cache_max_total = cpv->v.u;
+                break;
+              default:
+                break;
+            }
+        }
+    }
+    stat_cache_body_max_total(mem_cache_max_total);
+
     /* initialize p->defaults from global config context */
     p->defaults.etags_used = 1; /* etags enabled */
     if (p->nconfig > 0 && p->cvlist->v.u2[1]) {
@@ -127,11 +165,29 @@ URIHANDLER_FUNC(mod_staticfile_subrequest) {
     }
 
     if (!p->conf.etags_used) r->conf.etag_flags = 0;
-    http_response_send_file(r, &r->physical.path);
+    http_response_send_file(r, &r->physical.path, p->conf.mem_cache_max_sz);
 
     return HANDLER_FINISHED;
 }
 
+TRIGGER_FUNC(mod_staticfile_trigger) {
+    UNUSED(srv);
+    plugin_data * const p = p_d;
+    if (!p->mem_cache_used) return HANDLER_GO_ON;
+
+    /* publish memory cache stats for mod_status */
+    const stat_cache_body_stats * const st = stat_cache_body_stats_get();
+    status_counter_set(CONST_STR_LEN("staticfile.memory-cache.hits"),
+                       (int)st->hits);
+    status_counter_set(CONST_STR_LEN("staticfile.memory-cache.misses"),
+                       (int)st->misses);
+    status_counter_set(CONST_STR_LEN("staticfile.memory-cache.entries"),
+                       (int)st->entries);
+    status_counter_set(CONST_STR_LEN("staticfile.memory-cache.bytes"),
+                       (int)st->bytes);
+    return HANDLER_GO_ON;
+}
+
 
 int mod_staticfile_plugin_init(plugin *p);
 int mod_staticfile_plugin_init(plugin *p) {
@@ -141,6 +197,7 @@ int mod_staticfile_plugin_init(plugin *p) {
 	p->init        = mod_staticfile_init;
 	p->handle_subrequest_start = mod_staticfile_subrequest;
 	p->set_defaults  = mod_staticfile_set_defaults;
+	p->handle_trigger = mod_staticfile_trigger;
 
 	return 0;
 }
@@ -7,6 +7,8 @@
 #include "log.h"
 
 #include "plugin.h"
+#include "splaytree.h"  /* djbhash() */
+#include "status_counter.h"
 
 #include <sys/types.h>
 
@@ -20,15 +22,43 @@ typedef struct {
     const buffer *config_url;
     const buffer *status_url;
     const buffer *statistics_url;
+    const buffer *metrics_url;
 
     int sort;
 } plugin_config;
 
+/* per-vhost request phase histograms
+ * (vhosts are keyed by configured server name (server.name, or as set by
+ *  vhost modules for configured vhosts), not by client-provided Host;
+ *  requests without server name, and requests to any vhosts beyond the
+ *  bounded number of vhosts, are aggregated in a final "*" entry) */
+#define MOD_STATUS_VHOSTS_MAX 64
+#define MOD_STATUS_VHOST_SLOTS 128 /*(power of 2; > MOD_STATUS_VHOSTS_MAX)*/
+
+enum {
+	MOD_STATUS_VPHASE_TOTAL,
+	MOD_STATUS_VPHASE_READ_HEADER,
+	MOD_STATUS_VPHASE_HANDLE,
+	MOD_STATUS_VPHASE_BACKEND,
+	MOD_STATUS_VPHASE_WRITE,
+	MOD_STATUS_VPHASES
+};
+
+typedef struct {
+	buffer host;
+	uint32_t hash;
+	status_histogram h[MOD_STATUS_VPHASES];
+} mod_status_vhost;
+
 typedef struct {
 	PLUGIN_DATA;
 	plugin_config defaults;
 	plugin_config conf;
 
+	mod_status_vhost *vhosts; /* [MOD_STATUS_VHOSTS_MAX+1] */
+	uint32_t nvhosts;
+	uint8_t vhost_slots[MOD_STATUS_VHOST_SLOTS]; /* vhosts index + 1 */
+
 	double traffic_out;
 	double requests;
 
@@ -49,6 +79,14 @@ INIT_FUNC(mod_status_init) {
     return calloc(1, sizeof(plugin_data));
 }
 
+FREE_FUNC(mod_status_free) {
+    plugin_data * const p = p_d;
+    if (NULL == p->vhosts) return;
+    for (uint32_t i = 0; i <= MOD_STATUS_VHOSTS_MAX; ++i)
+        free(p->vhosts[i].host.ptr);
+    free(p->vhosts);
+}
+
 static void mod_status_merge_config_cpv(plugin_config * const pconf, const config_plugin_value_t * const cpv) {
     switch (cpv->k_id) { /* index into static config_plugin_keys_t cpk[] */
       case 0: /* status.status-url */
@@ -63,6 +101,9 @@ static void mod_status_merge_config_cpv(plugin_config * const pconf, const confi
       case 3: /* status.enable-sort */
         pconf->sort = (int)cpv->v.u;
         break;
+      case 4: /* status.metrics-url */
+        pconf->metrics_url = cpv->v.b;
+        break;
       default:/* should not happen */
         return;
     }
@@ -75,12 +116,15 @@ static void mod_status_merge_config(plugin_config * const pconf, const config_pl
 }
 
 static void mod_status_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_status_merge_config(&p->conf, p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_status_set_defaults) {
@@ -97,6 +141,9 @@ SETDEFAULTS_FUNC(mod_status_set_defaults) {
      ,{ CONST_STR_LEN("status.enable-sort"),
         T_CONFIG_BOOL,
         T_CONFIG_SCOPE_CONNECTION }
+     ,{ CONST_STR_LEN("status.metrics-url"),
+        T_CONFIG_STRING,
+        T_CONFIG_SCOPE_CONNECTION }
      ,{ NULL, 0,
         T_CONFIG_UNSET,
         T_CONFIG_SCOPE_UNSET }
@@ -106,6 +153,32 @@ SETDEFAULTS_FUNC(mod_status_set_defaults) {
     if (!config_plugin_values_init(srv, p, cpk, "mod_status"))
         return HANDLER_ERROR;
 
+    /* process and validate config directives
+     * (init i to 0 if global context; to 1 to skip empty global context) */
+    for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
+        const config_plugin_value_t *cpv = p->cvlist + p->cvlist[i].v.u2[0];
+        for (; -1 != cpv->k_id; ++cpv) {
+            switch (cpv->k_id) {
+              case 0: /* status.status-url */
+              case 1: /* status.config-url */
+              case 2: /* status.statistics-url */
+              case 3: /* status.enable-sort */
+                break;
+              case 4: /* status.metrics-url */
+                /* latency histograms require request start time recorded
+                 * with sub-second precision.  Enabled server-wide (for all
+                 * requests) even if set in a conditional; status.metrics-url
+                 * is typically restricted, e.g. with $HTTP["remoteip"], while
+                 * histograms sample every request */
+                if (!buffer_string_is_empty(cpv->v.b))
+                    srv->srvconf.high_precision_timestamps = 1;
+                break;
+              default:/* should not happen */
+                break;
+            }
+        }
+    }
+
     p->defaults.sort = 1;
 
     /* initialize p->defaults from global config context */
@@ -711,11 +784,23 @@ static handler_t mod_status_handle_server_status_json(server *srv, request_st *
 }
 
 
+static void mod_status_publish_chunk_pool_stats(void) {
+	const chunk_pool_stats * const cps = chunkqueue_chunk_pool_stats();
+	status_counter_set(CONST_STR_LEN("chunkqueue.pool.hits"), (int)cps->hits);
+	status_counter_set(CONST_STR_LEN("chunkqueue.pool.misses"), (int)cps->misses);
+	status_counter_set(CONST_STR_LEN("chunkqueue.pool.entries"), (int)cps->entries);
+	status_counter_set(CONST_STR_LEN("chunkqueue.pool.bytes"), (int)cps->bytes);
+}
+
+
 static handler_t mod_status_handle_server_statistics(request_st * const r) {
 	buffer *b;
 	size_t i;
 	array *st = &plugin_stats;
 
+	/* publish chunk pool stats */
+	mod_status_publish_chunk_pool_stats();
+
 	if (0 == st->used) {
 		/* we have nothing to send */
 		r->http_status = 204;
@@ -742,6 +827,338 @@ static handler_t mod_status_handle_server_statistics(request_st * const r) {
 }
 
 
+/* OpenMetrics text exposition format
+ * https://github.com/OpenObservability/OpenMetrics/blob/main/specification/OpenMetrics.md
+ * (also accepted by Prometheus scrapers) */
+
+static void mod_status_om_type(buffer * const b, const char * const name, const size_t nlen, const char * const type, const size_t tlen) {
+	buffer_append_string_len(b, CONST_STR_LEN("# TYPE "));
+	buffer_append_string_len(b, name, nlen);
+	buffer_append_string_len(b, CONST_STR_LEN(" "));
+	buffer_append_string_len(b, type, tlen);
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+}
+
+static void mod_status_om_label_value(buffer * const b, const char * const s, const size_t len) {
+	/* escape label value: backslash, double-quote, and line feed */
+	for (size_t i = 0, j = 0; i <= len; ++i) {
+		const char *esc;
+		if (i == len)         esc = NULL;
+		else if (s[i] == '\\') esc = "\\\\";
+		else if (s[i] == '"') esc = "\\\"";
+		else if (s[i] == '\n') esc = "\\n";
+		else continue;
+		buffer_append_string_len(b, s+j, i-j);
+		if (NULL == esc) break;
+		buffer_append_string_len(b, esc, 2);
+		j = i+1;
+	}
+}
+
+static void mod_status_om_usec(buffer * const b, const uint64_t usec) {
+	/* append usec as (decimal) seconds */
+	char frac[7];
+	uint64_t n = usec % 1000000;
+	for (int i = 6; i > 0; --i, n /= 10) frac[i] = '0' + (char)(n % 10);
+	frac[0] = '.';
+	buffer_append_int(b, (intmax_t)(usec / 1000000));
+	buffer_append_string_len(b, frac, sizeof(frac));
+}
+
+static void mod_status_om_histogram_type(buffer * const b, const char * const name, const size_t nlen) {
+	mod_status_om_type(b, name, nlen, CONST_STR_LEN("histogram"));
+	buffer_append_string_len(b, CONST_STR_LEN("# UNIT "));
+	buffer_append_string_len(b, name, nlen);
+	buffer_append_string_len(b, CONST_STR_LEN(" seconds\n"));
+}
+
+static void mod_status_om_histogram(buffer * const b, const char * const name, const size_t nlen, const buffer * const labels, const status_histogram * const h) {
+	/* labels, if not empty, must be followed by ',' */
+	const size_t llen = labels ? buffer_string_length(labels) : 0;
+	uint64_t cumulative = 0;
+	for (int i = 0; i < STATUS_HIST_BUCKETS; ++i) {
+		cumulative += h->bucket[i];
+		buffer_append_string_len(b, name, nlen);
+		buffer_append_string_len(b, CONST_STR_LEN("_bucket{"));
+		if (llen) buffer_append_string_len(b, labels->ptr, llen);
+		buffer_append_string_len(b, CONST_STR_LEN("le=\""));
+		if (i < STATUS_HIST_BUCKETS-1)
+			mod_status_om_usec(b, (uint64_t)1 << (i+6));
+		else
+			buffer_append_string_len(b, CONST_STR_LEN("+Inf"));
+		buffer_append_string_len(b, CONST_STR_LEN("\"} "));
+		buffer_append_int(b, (intmax_t)cumulative);
+		buffer_append_string_len(b, CONST_STR_LEN("\n"));
+	}
+	buffer_append_string_len(b, name, nlen);
+	buffer_append_string_len(b, CONST_STR_LEN("_count"));
+	if (llen) {
+		buffer_append_string_len(b, CONST_STR_LEN("{"));
+		buffer_append_string_len(b, labels->ptr, llen-1);
+		buffer_append_string_len(b, CONST_STR_LEN("}"));
+	}
+	buffer_append_string_len(b, CONST_STR_LEN(" "));
+	buffer_append_int(b, (intmax_t)h->count);
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+	buffer_append_string_len(b, name, nlen);
+	buffer_append_string_len(b, CONST_STR_LEN("_sum"));
+	if (llen) {
+		buffer_append_string_len(b, CONST_STR_LEN("{"));
+		buffer_append_string_len(b, labels->ptr, llen-1);
+		buffer_append_string_len(b, CONST_STR_LEN("}"));
+	}
+	buffer_append_string_len(b, CONST_STR_LEN(" "));
+	mod_status_om_usec(b, h->sum);
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+}
+
+static const struct {
+	const char *name;
+	uint32_t nlen;
+} mod_status_vphase_names[] = {
+  { CONST_STR_LEN("total") }
+ ,{ CONST_STR_LEN("read_header") }
+ ,{ CONST_STR_LEN("handle") }
+ ,{ CONST_STR_LEN("backend") }
+ ,{ CONST_STR_LEN("write") }
+};
+
+static void mod_status_om_phases(buffer * const b, const plugin_data * const p, buffer * const labels) {
+	static const status_histogram_id ids[] = {
+	  STATUS_HIST_REQUEST
+	 ,STATUS_HIST_PHASE_READ_HEADER
+	 ,STATUS_HIST_PHASE_HANDLE
+	 ,STATUS_HIST_PHASE_BACKEND
+	 ,STATUS_HIST_PHASE_WRITE
+	};
+
+	/* server-wide */
+	mod_status_om_histogram_type(b,
+	  CONST_STR_LEN("lighttpd_request_phase_seconds"));
+	for (int i = 1; i < MOD_STATUS_VPHASES; ++i) {
+		buffer_copy_string_len(labels, CONST_STR_LEN("phase=\""));
+		buffer_append_string_len(labels, mod_status_vphase_names[i].name,
+		                                 mod_status_vphase_names[i].nlen);
+		buffer_append_string_len(labels, CONST_STR_LEN("\","));
+		mod_status_om_histogram(b,
+		  CONST_STR_LEN("lighttpd_request_phase_seconds"),
+		  labels, status_histograms+ids[i]);
+	}
+
+	/* per-vhost */
+	if (NULL == p->vhosts) return;
+	mod_status_om_histogram_type(b,
+	  CONST_STR_LEN("lighttpd_vhost_request_phase_seconds"));
+	for (uint32_t v = 0; v <= MOD_STATUS_VHOSTS_MAX; ++v) {
+		const mod_status_vhost * const vh = p->vhosts+v;
+		if (0 == vh->h[MOD_STATUS_VPHASE_TOTAL].count) continue;
+		for (int i = 0; i < MOD_STATUS_VPHASES; ++i) {
+			if (0 == vh->h[i].count) continue;
+			buffer_copy_string_len(labels, CONST_STR_LEN("vhost=\""));
+			if (v < MOD_STATUS_VHOSTS_MAX)
+				mod_status_om_label_value(labels, CONST_BUF_LEN(&vh->host));
+			else
+				buffer_append_string_len(labels, CONST_STR_LEN("*"));
+			buffer_append_string_len(labels, CONST_STR_LEN("\",phase=\""));
+			buffer_append_string_len(labels, mod_status_vphase_names[i].name,
+			                                 mod_status_vphase_names[i].nlen);
+			buffer_append_string_len(labels, CONST_STR_LEN("\","));
+			mod_status_om_histogram(b,
+			  CONST_STR_LEN("lighttpd_vhost_request_phase_seconds"),
+			  labels, vh->h+i);
+		}
+	}
+}
+
+static void mod_status_om_backend_stats(buffer * const b, const array * const st) {
+	/* gw_backend status counters
+	 *   "gw.backend.<id>.<proc>.<tag>" and "gw.backend.<id>.load"
+	 * exported as lighttpd_backend_<tag>{backend="<id>"[,proc="<proc>"]}
+	 * (plugin_stats is sorted by key length, then key, so keys for each tag
+	 *  are not contiguous; make one pass per metric family) */
+	static const struct {
+		const char *tag;
+		uint32_t tlen;
+		const char *name;
+		uint32_t nlen;
+		const char *type;
+		uint32_t ylen;
+	} m[] = {
+	  { CONST_STR_LEN(".load"),
+	    CONST_STR_LEN("lighttpd_backend_load"), CONST_STR_LEN("gauge") }
+	 ,{ CONST_STR_LEN(".pool-idle"),
+	    CONST_STR_LEN("lighttpd_backend_pool_idle"), CONST_STR_LEN("gauge") }
+	 ,{ CONST_STR_LEN(".disabled"),
+	    CONST_STR_LEN("lighttpd_backend_disabled"), CONST_STR_LEN("gauge") }
+	 ,{ CONST_STR_LEN(".connected"),
+	    CONST_STR_LEN("lighttpd_backend_connected"), CONST_STR_LEN("counter") }
+	 ,{ CONST_STR_LEN(".died"),
+	    CONST_STR_LEN("lighttpd_backend_died"), CONST_STR_LEN("counter") }
+	 ,{ CONST_STR_LEN(".overloaded"),
+	    CONST_STR_LEN("lighttpd_backend_overloaded"), CONST_STR_LEN("counter") }
+	 ,{ CONST_STR_LEN(".pool-hit"),
+	    CONST_STR_LEN("lighttpd_backend_pool_hit"), CONST_STR_LEN("counter") }
+	 ,{ CONST_STR_LEN(".pool-miss"),
+	    CONST_STR_LEN("lighttpd_backend_pool_miss"), CONST_STR_LEN("counter") }
+	};
+
+	for (uint32_t x = 0; x < sizeof(m)/sizeof(*m); ++x) {
+		const int counter = (m[x].type[0] == 'c');
+		int seen = 0;
+		for (uint32_t i = 0; i < st->used; ++i) {
+			const buffer * const k = &st->sorted[i]->key;
+			const size_t klen = buffer_string_length(k);
+			if (klen < sizeof("gw.backend.")-1 + m[x].tlen
+			    || 0 != memcmp(k->ptr, CONST_STR_LEN("gw.backend."))
+			    || 0 != memcmp(k->ptr+klen-m[x].tlen, m[x].tag, m[x].tlen))
+				continue;
+
+			/* split "<id>.<proc>" or "<id>" (host .load) */
+			const char * const id = k->ptr + sizeof("gw.backend.")-1;
+			size_t idlen = (size_t)(k->ptr + klen - m[x].tlen - id);
+			const char *proc = NULL;
+			size_t plen = 0;
+			for (size_t j = idlen; j > 0; --j) {
+				if (id[j-1] == '.') {
+					proc = id+j;
+					plen = idlen - j;
+					break;
+				}
+				if (!light_isdigit(id[j-1])) break;
+			}
+			if (NULL != proc && 0 != plen)
+				idlen -= plen + 1;
+			else if (x != 0) /* (only .load is per-host) */
+				continue;
+			else
+				proc = NULL;
+
+			if (!seen) {
+				seen = 1;
+				mod_status_om_type(b, m[x].name, m[x].nlen,
+				                   m[x].type, m[x].ylen);
+			}
+			buffer_append_string_len(b, m[x].name, m[x].nlen);
+			if (counter)
+				buffer_append_string_len(b, CONST_STR_LEN("_total"));
+			buffer_append_string_len(b, CONST_STR_LEN("{backend=\""));
+			mod_status_om_label_value(b, id, idlen);
+			if (proc) {
+				buffer_append_string_len(b, CONST_STR_LEN("\",proc=\""));
+				buffer_append_string_len(b, proc, plen);
+			}
+			buffer_append_string_len(b, CONST_STR_LEN("\"} "));
+			buffer_append_int(b, ((data_integer *)st->sorted[i])->value);
+			buffer_append_string_len(b, CONST_STR_LEN("\n"));
+		}
+	}
+}
+
+static handler_t mod_status_handle_server_metrics(request_st * const r, plugin_data * const p) {
+	server * const srv = r->con->srv;
+	buffer * const b = chunkqueue_append_buffer_open(r->write_queue);
+
+	mod_status_om_type(b, CONST_STR_LEN("lighttpd_requests"),
+	                      CONST_STR_LEN("counter"));
+	buffer_append_string_len(b, CONST_STR_LEN("lighttpd_requests_total "));
+	buffer_append_int(b, (intmax_t)p->abs_requests);
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+
+	mod_status_om_type(b, CONST_STR_LEN("lighttpd_response_bytes"),
+	                      CONST_STR_LEN("counter"));
+	buffer_append_string_len(b, CONST_STR_LEN(
+	  "# UNIT lighttpd_response_bytes bytes\n"
+	  "lighttpd_response_bytes_total "));
+	buffer_append_int(b, (intmax_t)p->abs_traffic_out);
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+
+	mod_status_om_type(b, CONST_STR_LEN("lighttpd_uptime_seconds"),
+	                      CONST_STR_LEN("gauge"));
+	buffer_append_string_len(b, CONST_STR_LEN(
+	  "# UNIT lighttpd_uptime_seconds seconds\n"
+	  "lighttpd_uptime_seconds "));
+	buffer_append_int(b, log_epoch_secs - srv->startup_ts);
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+
+	uint32_t states[CON_STATE_CLOSE+1];
+	memset(states, 0, sizeof(states));
+	for (uint32_t i = 0; i < srv->conns.used; ++i)
+		++states[srv->conns.ptr[i]->request.state];
+	mod_status_om_type(b, CONST_STR_LEN("lighttpd_connections"),
+	                      CONST_STR_LEN("gauge"));
+	for (uint32_t i = 0; i <= CON_STATE_CLOSE; ++i) {
+		const char * const state = connection_get_state((request_state_t)i);
+		buffer_append_string_len(b, CONST_STR_LEN(
+		  "lighttpd_connections{state=\""));
+		buffer_append_string_len(b, state, strlen(state));
+		buffer_append_string_len(b, CONST_STR_LEN("\"} "));
+		buffer_append_int(b, states[i]);
+		buffer_append_string_len(b, CONST_STR_LEN("\n"));
+	}
+	mod_status_om_type(b, CONST_STR_LEN("lighttpd_connections_max"),
+	                      CONST_STR_LEN("gauge"));
+	buffer_append_string_len(b, CONST_STR_LEN("lighttpd_connections_max "));
+	buffer_append_int(b, srv->max_conns);
+	buffer_append_string_len(b, CONST_STR_LEN("\n"));
+
+	static const struct {
+		const char *name;
+		uint32_t nlen;
+		status_histogram_id id;
+	} hists[] = {
+	  { CONST_STR_LEN("lighttpd_request_duration_seconds"),
+	    STATUS_HIST_REQUEST }
+	 ,{ CONST_STR_LEN("lighttpd_response_first_byte_seconds"),
+	    STATUS_HIST_TTFB }
+	 ,{ CONST_STR_LEN("lighttpd_backend_connect_seconds"),
+	    STATUS_HIST_BACKEND_CONNECT }
+	 ,{ CONST_STR_LEN("lighttpd_backend_response_seconds"),
+	    STATUS_HIST_BACKEND_RESPONSE }
+	};
+	for (uint32_t i = 0; i < sizeof(hists)/sizeof(*hists); ++i) {
+		mod_status_om_histogram_type(b, hists[i].name, hists[i].nlen);
+		mod_status_om_histogram(b, hists[i].name, hists[i].nlen, NULL,
+		                        status_histograms+hists[i].id);
+	}
+	mod_status_om_phases(b, p, r->tmp_buf);
+
+	/* plugin_stats */
+	mod_status_publish_chunk_pool_stats();
+	const array * const st = &plugin_stats;
+	mod_status_om_backend_stats(b, st);
+	int seen = 0;
+	for (uint32_t i = 0; i < st->used; ++i) {
+		const buffer * const k = &st->sorted[i]->key;
+		if (buffer_string_length(k) >= sizeof("gw.backend.")-1
+		    && 0 == memcmp(k->ptr, CONST_STR_LEN("gw.backend.")))
+			continue;
+		if (!seen) {
+			seen = 1;
+			/* (arbitrary counters and gauges set by modules, e.g. by
+			 *  mod_magnet scripts; type is not known) */
+			mod_status_om_type(b, CONST_STR_LEN("lighttpd_plugin_stat"),
+			                      CONST_STR_LEN("unknown"));
+		}
+		buffer_append_string_len(b, CONST_STR_LEN(
+		  "lighttpd_plugin_stat{name=\""));
+		mod_status_om_label_value(b, CONST_BUF_LEN(k));
+		buffer_append_string_len(b, CONST_STR_LEN("\"} "));
+		buffer_append_int(b, ((data_integer *)st->sorted[i])->value);
+		buffer_append_string_len(b, CONST_STR_LEN("\n"));
+	}
+
+	buffer_append_string_len(b, CONST_STR_LEN("# EOF\n"));
+	chunkqueue_append_buffer_commit(r->write_queue);
+
+	http_header_response_set(r, HTTP_HEADER_CONTENT_TYPE, CONST_STR_LEN("Content-Type"), CONST_STR_LEN("application/openmetrics-text; version=1.0.0; charset=utf-8"));
+
+	r->http_status = 200;
+	r->resp_body_finished = 1;
+
+	return HANDLER_FINISHED;
+}
+
+
 static handler_t mod_status_handle_server_status(request_st * const r, plugin_data * const p) {
 	server * const srv = r->con->srv;
 	if (buffer_is_equal_string(&r->uri.query, CONST_STR_LEN("auto"))) {
@@ -780,7 +1197,7 @@ static handler_t mod_status_handle_server_config(request_st * const r) {
 			   "  <table summary=\"status\" border=\"1\">\n"));
 
 	mod_status_header_append(b, "Server-Features");
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
 	mod_status_row_append(b, "RegEx Conditionals", "enabled");
 #else
 	mod_status_row_append(b, "RegEx Conditionals", "disabled - pcre missing");
@@ -835,6 +1252,9 @@ static handler_t mod_status_handler(request_st * const r, void *p_d) {
 	} else if (!buffer_string_is_empty(p->conf.statistics_url) &&
 	    buffer_is_equal(p->conf.statistics_url, &r->uri.path)) {
 		return mod_status_handle_server_statistics(r);
+	} else if (!buffer_string_is_empty(p->conf.metrics_url) &&
+	    buffer_is_equal(p->conf.metrics_url, &r->uri.path)) {
+		return mod_status_handle_server_metrics(r, p);
 	}
 
 	return HANDLER_GO_ON;
@@ -868,6 +1288,80 @@ TRIGGER_FUNC(mod_status_trigger) {
 	return HANDLER_GO_ON;
 }
 
+static mod_status_vhost * mod_status_vhost_aggregate(plugin_data * const p) {
+	if (NULL == p->vhosts) {
+		p->vhosts = calloc(MOD_STATUS_VHOSTS_MAX+1, sizeof(*p->vhosts));
+		force_assert(p->vhosts);
+	}
+	return p->vhosts+MOD_STATUS_VHOSTS_MAX; /* aggregate "*" */
+}
+
+__attribute_cold__
+__attribute_noinline__
+static mod_status_vhost * mod_status_vhost_insert(plugin_data * const p, const buffer * const host, const uint32_t hash, const uint32_t slot) {
+	mod_status_vhost * const agg = mod_status_vhost_aggregate(p);
+	if (p->nvhosts == MOD_STATUS_VHOSTS_MAX)
+		return agg;
+	mod_status_vhost * const vh = p->vhosts + p->nvhosts;
+	buffer_copy_buffer(&vh->host, host);
+	vh->hash = hash;
+	p->vhost_slots[slot] = (uint8_t)++p->nvhosts;
+	return vh;
+}
+
+static mod_status_vhost * mod_status_vhost_get(plugin_data * const p, const buffer * const host) {
+	const uint32_t hlen = buffer_string_length(host);
+	const uint32_t hash = djbhash(host->ptr, hlen, DJBHASH_INIT);
+	uint32_t slot = hash & (MOD_STATUS_VHOST_SLOTS-1);
+	for (uint32_t n; (n = p->vhost_slots[slot]);
+	     slot = (slot+1) & (MOD_STATUS_VHOST_SLOTS-1)) {
+		mod_status_vhost * const vh = p->vhosts+n-1;
+		if (vh->hash == hash && buffer_is_equal_string(&vh->host, host->ptr, hlen))
+			return vh;
+	}
+	return mod_status_vhost_insert(p, host, hash, slot);
+}
+
+static void mod_status_account_phases(plugin_data * const p, request_st * const r) {
+	/* record request duration and request phase timings
+	 * (server-wide and per-vhost) */
+	struct timespec now;
+	const uint64_t total =
+	  status_histogram_add_since(STATUS_HIST_REQUEST, &r->start_hp, &now);
+	/* vhost is server name set by vhost module for a configured vhost,
+	 * else configured server.name; not client-provided Host
+	 * (r->server_name is &r->uri.authority if no server name configured) */
+	const buffer * const vhost = (r->server_name == &r->server_name_buf)
+	  ? r->server_name
+	  : r->conf.server_name;
+	mod_status_vhost * const vh = !buffer_string_is_empty(vhost)
+	  ? mod_status_vhost_get(p, vhost)
+	  : mod_status_vhost_aggregate(p);
+	status_histogram_add(vh->h+MOD_STATUS_VPHASE_TOTAL, total);
+
+	/*(phase timestamps are 0 if phase not reached, e.g. on error)*/
+	uint64_t usec;
+	if (r->hdrs_hp.tv_sec) {
+		usec = status_histogram_elapsed(&r->start_hp, &r->hdrs_hp);
+		status_histogram_add(status_histograms+STATUS_HIST_PHASE_READ_HEADER, usec);
+		status_histogram_add(vh->h+MOD_STATUS_VPHASE_READ_HEADER, usec);
+		if (r->resp_hp.tv_sec) {
+			usec = status_histogram_elapsed(&r->hdrs_hp, &r->resp_hp);
+			status_histogram_add(status_histograms+STATUS_HIST_PHASE_HANDLE, usec);
+			status_histogram_add(vh->h+MOD_STATUS_VPHASE_HANDLE, usec);
+		}
+	}
+	if (r->resp_hp.tv_sec) {
+		usec = status_histogram_elapsed(&r->resp_hp, &now);
+		status_histogram_add(status_histograms+STATUS_HIST_PHASE_WRITE, usec);
+		status_histogram_add(vh->h+MOD_STATUS_VPHASE_WRITE, usec);
+	}
+	if (r->backend_usec) {
+		status_histogram_add(status_histograms+STATUS_HIST_PHASE_BACKEND, r->backend_usec);
+		status_histogram_add(vh->h+MOD_STATUS_VPHASE_BACKEND, r->backend_usec);
+	}
+}
+
 REQUESTDONE_FUNC(mod_status_account) {
 	plugin_data *p = p_d;
 
@@ -877,6 +1371,9 @@ REQUESTDONE_FUNC(mod_status_account) {
 
 	p->bytes_written += r->con->bytes_written_cur_second;
 
+	if (r->conf.high_precision_timestamps)
+		mod_status_account_phases(p, r);
+
 	return HANDLER_GO_ON;
 }
 
@@ -887,6 +1384,7 @@ int mod_status_plugin_init(plugin *p) {
 	p->name        = "status";
 
 	p->init        = mod_status_init;
+	p->cleanup     = mod_status_free;
 	p->set_defaults= mod_status_set_defaults;
 
 	p->handle_uri_clean    = mod_status_handler;
@@ -3,7 +3,7 @@
 #include "plugin.h"
 
 
-#if defined(HAVE_PCRE_H)                /* do nothing if PCRE not available */
+#if defined(HAVE_PCRE_H) || defined(HAVE_PCRE2_H) /* do nothing if PCRE not available */
 #if defined(HAVE_GDBM_H) || defined(USE_MEMCACHED) /* at least one required */
 
 
@@ -21,7 +21,10 @@
 # include <gdbm.h>
 #endif
 
-#if defined(HAVE_PCRE_H)
+#if defined(HAVE_PCRE2_H)
+# define PCRE2_CODE_UNIT_WIDTH 8
+# include <pcre2.h>
+#elif defined(HAVE_PCRE_H)
 # include <pcre.h>
 #endif
 
@@ -36,8 +39,13 @@
 
 typedef struct {
     const buffer *deny_url;
+  #if defined(HAVE_PCRE2_H)
+    pcre2_code *trigger_regex;
+    pcre2_code *download_regex;
+  #else
     pcre *trigger_regex;
     pcre *download_regex;
+  #endif
   #if defined(HAVE_GDBM_H)
     GDBM_FILE db;
   #endif
@@ -53,14 +61,28 @@ typedef struct {
     PLUGIN_DATA;
     plugin_config defaults;
     plugin_config conf;
+  #if defined(HAVE_PCRE2_H)
+    pcre2_match_data *match_data; /*(only match/no-match is needed)*/
+  #endif
 } plugin_data;
 
+#if defined(HAVE_PCRE2_H)
+#define mod_trigger_b4_dl_regex_free(re) pcre2_code_free(re)
+#define MOD_TRIGGER_B4_DL_NOMATCH PCRE2_ERROR_NOMATCH
+#else
+#define mod_trigger_b4_dl_regex_free(re) pcre_free(re)
+#define MOD_TRIGGER_B4_DL_NOMATCH PCRE_ERROR_NOMATCH
+#endif
+
 INIT_FUNC(mod_trigger_b4_dl_init) {
     return calloc(1, sizeof(plugin_data));
 }
 
 FREE_FUNC(mod_trigger_b4_dl_free) {
     plugin_data *p = p_d;
+  #if defined(HAVE_PCRE2_H)
+    if (p->match_data) pcre2_match_data_free(p->match_data);
+  #endif
     if (NULL == p->cvlist) return;
     /* (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1], used = p->nconfig; i < used; ++i) {
@@ -74,10 +96,10 @@ FREE_FUNC(mod_trigger_b4_dl_free) {
                 break;
              #endif
               case 1: /* trigger-before-download.trigger-url */
-                pcre_free(cpv->v.v);
+                mod_trigger_b4_dl_regex_free(cpv->v.v);
                 break;
               case 2: /* trigger-before-download.download-url */
-                pcre_free(cpv->v.v);
+                mod_trigger_b4_dl_regex_free(cpv->v.v);
                 break;
              #if defined(USE_MEMCACHED)
               case 5: /* trigger-before-download.memcache-hosts */
@@ -168,9 +190,18 @@ static int mod_trigger_b4_dl_init_regex(server * const srv, config_plugin_value_
         return 1;
     }
 
+  #if defined(HAVE_PCRE2_H)
+    int errcode;
+    PCRE2_SIZE erroff;
+    cpv->v.v = pcre2_compile((PCRE2_SPTR)b->ptr, buffer_string_length(b), 0,
+                             &errcode, &erroff, NULL);
+    if (cpv->v.v)
+        (void)pcre2_jit_compile(cpv->v.v, PCRE2_JIT_COMPLETE);
+  #else
     const char *errptr;
     int erroff;
     cpv->v.v = pcre_compile(b->ptr, 0, &errptr, &erroff, NULL);
+  #endif
 
     if (cpv->v.v) {
         cpv->vtype = T_CONFIG_LOCAL;
@@ -179,7 +210,7 @@ static int mod_trigger_b4_dl_init_regex(server * const srv, config_plugin_value_
     else {
         log_error(srv->errh, __FILE__, __LINE__,
           "compiling regex for %s failed: %s pos: %d",
-          str, b->ptr, erroff);
+          str, b->ptr, (int)erroff);
         return 0;
     }
 }
@@ -232,12 +263,15 @@ static void mod_trigger_b4_dl_merge_config(plugin_config * const pconf, const co
 }
 
 static void mod_trigger_b4_dl_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     memcpy(&p->conf, &p->defaults, sizeof(plugin_config));
     for (int i = 1, used = p->nconfig; i < used; ++i) {
         if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
             mod_trigger_b4_dl_merge_config(&p->conf,
                                            p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_trigger_b4_dl_set_defaults) {
@@ -275,6 +309,11 @@ SETDEFAULTS_FUNC(mod_trigger_b4_dl_set_defaults) {
     if (!config_plugin_values_init(srv, p, cpk, "mod_trigger_b4_dl"))
         return HANDLER_ERROR;
 
+  #if defined(HAVE_PCRE2_H)
+    p->match_data = pcre2_match_data_create(1, NULL);
+    force_assert(p->match_data);
+  #endif
+
     /* process and validate config directives
      * (init i to 0 if global context; to 1 to skip empty global context) */
     for (int i = !p->cvlist[0].v.u2[1]; i < p->nconfig; ++i) {
@@ -349,12 +388,24 @@ static handler_t mod_trigger_b4_dl_deny(request_st * const r, const plugin_data
     return HANDLER_FINISHED;
 }
 
+#if defined(HAVE_PCRE2_H)
+static int mod_trigger_b4_dl_regex_match(const plugin_data * const p, const pcre2_code * const re, const buffer * const b) {
+    /* match_data has room for one pair; rc 0 (ovector too small) is a match */
+    return pcre2_match(re, (PCRE2_SPTR)b->ptr, buffer_string_length(b), 0, 0,
+                       p->match_data, NULL);
+}
+#else
+static int mod_trigger_b4_dl_regex_match(const plugin_data * const p, const pcre * const re, const buffer * const b) {
+    int ovec[3];
+    UNUSED(p);
+    return pcre_exec(re, NULL, CONST_BUF_LEN(b), 0, 0, ovec, 3);
+}
+#endif
+
 URIHANDLER_FUNC(mod_trigger_b4_dl_uri_handler) {
 	plugin_data *p = p_d;
 
 	int n;
-# define N 10
-	int ovec[N * 3];
 
 	if (NULL != r->handler_module) return HANDLER_GO_ON;
 
@@ -392,8 +443,8 @@ URIHANDLER_FUNC(mod_trigger_b4_dl_uri_handler) {
 	const time_t cur_ts = log_epoch_secs;
 
 	/* check if URL is a trigger -> insert IP into DB */
-	if ((n = pcre_exec(p->conf.trigger_regex, NULL, CONST_BUF_LEN(&r->uri.path), 0, 0, ovec, 3 * N)) < 0) {
-		if (n != PCRE_ERROR_NOMATCH) {
+	if ((n = mod_trigger_b4_dl_regex_match(p, p->conf.trigger_regex, &r->uri.path)) < 0) {
+		if (n != MOD_TRIGGER_B4_DL_NOMATCH) {
 			log_error(r->conf.errh, __FILE__, __LINE__,
 			  "execution error while matching: %d", n);
 
@@ -436,8 +487,8 @@ URIHANDLER_FUNC(mod_trigger_b4_dl_uri_handler) {
 	}
 
 	/* check if URL is a download -> check IP in DB, update timestamp */
-	if ((n = pcre_exec(p->conf.download_regex, NULL, CONST_BUF_LEN(&r->uri.path), 0, 0, ovec, 3 * N)) < 0) {
-		if (n != PCRE_ERROR_NOMATCH) {
+	if ((n = mod_trigger_b4_dl_regex_match(p, p->conf.download_regex, &r->uri.path)) < 0) {
+		if (n != MOD_TRIGGER_B4_DL_NOMATCH) {
 			log_error(r->conf.errh, __FILE__, __LINE__,
 			  "execution error while matching: %d", n);
 			return HANDLER_ERROR;
@@ -594,7 +645,7 @@ int mod_trigger_b4_dl_plugin_init(plugin *p) {
 	p->version     = LIGHTTPD_VERSION_ID;
 	p->name        = "trigger_b4_dl";
 
-#if defined(HAVE_PCRE_H)                /* do nothing if PCRE not available */
+#if defined(HAVE_PCRE_H) || defined(HAVE_PCRE2_H) /* do nothing if PCRE not available */
 #if defined(HAVE_GDBM_H) || defined(USE_MEMCACHED) /* at least one required */
 
 	p->init        = mod_trigger_b4_dl_init;
@@ -145,6 +145,8 @@ static void mod_uploadprogress_merge_config(plugin_config * const pconf, const c
 }
 
 static void mod_uploadprogress_patch_config(request_st * const r, plugin_data * const p) {
+    if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+        return;
     p->conf = p->defaults; /* copy small struct instead of memcpy() */
     /*memcpy(&p->conf, &p->defaults, sizeof(plugin_config));*/
     for (int i = 1, used = p->nconfig; i < used; ++i) {
@@ -152,6 +154,7 @@ static void mod_uploadprogress_patch_config(request_st * const r, plugin_data *
             mod_uploadprogress_merge_config(&p->conf,
                                             p->cvlist + p->cvlist[i].v.u2[0]);
     }
+    config_plugin_snapshot_save(p, &p->conf);
 }
 
 SETDEFAULTS_FUNC(mod_uploadprogress_set_defaults) {
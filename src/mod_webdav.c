@@ -4186,6 +4186,10 @@ mod_webdav_write_cq_first_chunk (request_st * const r, chunkqueue * const cq,
                        buffer_string_length(c->mem) - c->offset);
         } while (-1 == wr && errno == EINTR);
         break;
+    case PIPE_CHUNK: /*(not used in request body)*/
+    default:
+        errno = EINVAL;
+        break;
     }
 
     if (wr > 0) {
@@ -189,6 +189,71 @@ static void network_merge_config(network_socket_config * const pconf, const conf
     } while ((++cpv)->k_id != -1);
 }
 
+static int network_server_socket_reuseport(server *srv, server_socket *srv_socket, network_socket_config *s, int family, socklen_t addr_len, int set_v6only) {
+	/* additional listen socket bound to same addr (SO_REUSEPORT);
+	 * each server.max-worker process accepts on its own listen socket */
+	int fd = fdevent_socket_nb_cloexec(family, SOCK_STREAM, IPPROTO_TCP);
+	if (-1 == fd) {
+		log_perror(srv->errh, __FILE__, __LINE__, "socket");
+		return -1;
+	}
+
+	do {
+#ifdef HAVE_IPV6
+		if (set_v6only) {
+			int val = 1;
+			if (-1 == setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &val, sizeof(val))) {
+				log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(IPV6_V6ONLY)");
+				break;
+			}
+		}
+#else
+		UNUSED(set_v6only);
+#endif
+
+		if (fdevent_set_so_reuseaddr(fd, 1) < 0) {
+			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(SO_REUSEADDR)");
+			break;
+		}
+
+		if (fdevent_set_so_reuseport(fd, 1) < 0) {
+			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(SO_REUSEPORT)");
+			break;
+		}
+
+		if (fdevent_set_tcp_nodelay(fd, 1) < 0) {
+			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(TCP_NODELAY)");
+			break;
+		}
+
+		if (0 != bind(fd, (struct sockaddr *) &(srv_socket->addr), addr_len)) {
+			log_perror(srv->errh, __FILE__, __LINE__,
+			  "can't bind to socket: %s", srv_socket->srv_token->ptr);
+			break;
+		}
+
+		if (-1 == listen(fd, s->listen_backlog)) {
+			log_perror(srv->errh, __FILE__, __LINE__, "listen");
+			break;
+		}
+
+#ifdef TCP_DEFER_ACCEPT
+		if (!s->ssl_enabled && s->defer_accept) {
+			int v = s->defer_accept;
+			if (-1 == setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &v, sizeof(v))) {
+				log_perror(srv->errh, __FILE__, __LINE__, "can't set TCP_DEFER_ACCEPT");
+			}
+		}
+#endif
+
+		srv->cur_fds = fd;
+		return fd;
+	} while (0);
+
+	close(fd);
+	return -1;
+}
+
 static int network_server_init(server *srv, network_socket_config *s, buffer *host_token, size_t sidx, int stdin_fd) {
 	server_socket *srv_socket;
 	const char *host;
@@ -350,6 +415,17 @@ static int network_server_init(server *srv, network_socket_config *s, buffer *ho
 		return -1;
 	}
 
+	/* server.reuseport: separate listen socket for each server.max-worker
+	 * (not applicable to unix domain sockets or to inherited sockets) */
+	const int reuseport = srv->srvconf.reuseport
+	                   && srv->srvconf.max_worker > 1
+	                   && family != AF_UNIX
+	                   && -1 == stdin_fd;
+	if (reuseport && fdevent_set_so_reuseport(srv_socket->fd, 1) < 0) {
+		log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(SO_REUSEPORT)");
+		return -1;
+	}
+
 	if (family != AF_UNIX) {
 		if (fdevent_set_tcp_nodelay(srv_socket->fd, 1) < 0) {
 			log_perror(srv->errh, __FILE__, __LINE__, "setsockopt(TCP_NODELAY)");
@@ -412,9 +488,43 @@ static int network_server_init(server *srv, network_socket_config *s, buffer *ho
 #endif
 	}
 
+	if (reuseport) {
+		const uint32_t n = srv->srvconf.max_worker - 1;
+		srv_socket->reuseport_fds = malloc(n * sizeof(int));
+		force_assert(NULL != srv_socket->reuseport_fds);
+		for (uint32_t i = 0; i < n; ++i) {
+			int fd = network_server_socket_reuseport(srv, srv_socket, s,
+			                                         family, addr_len,
+			                                         set_v6only);
+			if (-1 == fd) return -1;
+			srv_socket->reuseport_fds[srv_socket->reuseport_used++] = fd;
+		}
+	}
+
 	return 0;
 }
 
+void network_reuseport_select(server *srv, uint32_t worker) {
+	/* keep listen socket for worker and close listen sockets of others;
+	 * worker 0 (or no workers) uses the original srv_socket->fd */
+	for (uint32_t i = 0; i < srv->srv_sockets.used; ++i) {
+		server_socket *srv_socket = srv->srv_sockets.ptr[i];
+		if (0 == srv_socket->reuseport_used) continue;
+		const uint32_t w = worker % (srv_socket->reuseport_used + 1);
+		if (0 != w) {
+			int fd = srv_socket->fd;
+			srv_socket->fd = srv_socket->reuseport_fds[w-1];
+			srv_socket->reuseport_fds[w-1] = fd;
+		}
+		for (uint32_t j = 0; j < srv_socket->reuseport_used; ++j) {
+			close(srv_socket->reuseport_fds[j]);
+		}
+		free(srv_socket->reuseport_fds);
+		srv_socket->reuseport_fds = NULL;
+		srv_socket->reuseport_used = 0;
+	}
+}
+
 int network_close(server *srv) {
 	for (uint32_t i = 0; i < srv->srv_sockets.used; ++i) {
 		server_socket *srv_socket = srv->srv_sockets.ptr[i];
@@ -423,6 +533,11 @@ int network_close(server *srv) {
 			close(srv_socket->fd);
 		}
 
+		for (uint32_t j = 0; j < srv_socket->reuseport_used; ++j) {
+			close(srv_socket->reuseport_fds[j]);
+		}
+		free(srv_socket->reuseport_fds);
+
 		buffer_free(srv_socket->srv_token);
 
 		free(srv_socket);
@@ -12,6 +12,10 @@
 #include <string.h>
 #include <unistd.h>
 
+#ifdef HAVE_SPLICE
+#include <fcntl.h>
+#endif
+
 
 /* on linux 2.4.x you get either sendfile or LFS */
 #if defined HAVE_SYS_SENDFILE_H && defined HAVE_SENDFILE \
@@ -539,6 +543,36 @@ static int network_write_file_chunk_sendfile(int fd, chunkqueue *cq, off_t *p_ma
 
 
 
+#if defined(HAVE_SPLICE)
+
+/* next chunk must be PIPE_CHUNK. splice() from pipe to socket */
+static int network_write_pipe_chunk_splice(int fd, chunkqueue *cq, off_t *p_max_bytes, log_error_st *errh) {
+    chunk* const c = cq->first;
+    ssize_t wr;
+    off_t toSend = c->file.length - c->offset;
+    if (toSend > *p_max_bytes) toSend = *p_max_bytes;
+
+    if (0 == toSend) {
+        chunkqueue_remove_finished_chunks(cq);
+        return 0;
+    }
+
+    wr = splice(c->file.fd, NULL, fd, NULL, (size_t)toSend,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (wr >= 0) {
+        *p_max_bytes -= wr;
+        chunkqueue_mark_written(cq, wr);
+        return (wr > 0 && wr == toSend) ? 0 : -3;
+    } else {
+        return network_write_error(fd, errh);
+    }
+}
+
+#endif
+
+
+
+
 /* return values:
  * >= 0 : no error
  *   -1 : error (on our side)
@@ -560,6 +594,11 @@ static int network_write_chunkqueue_write(int fd, chunkqueue *cq, off_t max_byte
             rc = network_write_file_chunk_no_mmap(fd, cq, &max_bytes, errh);
           #endif
             break;
+      #if defined(HAVE_SPLICE)
+        case PIPE_CHUNK:
+            rc = network_write_pipe_chunk_splice(fd, cq, &max_bytes, errh);
+            break;
+      #endif
         }
 
         if (-3 == rc) return 0;
@@ -589,6 +628,11 @@ static int network_write_chunkqueue_writev(int fd, chunkqueue *cq, off_t max_byt
             rc = network_write_file_chunk_no_mmap(fd, cq, &max_bytes, errh);
           #endif
             break;
+      #if defined(HAVE_SPLICE)
+        case PIPE_CHUNK:
+            rc = network_write_pipe_chunk_splice(fd, cq, &max_bytes, errh);
+            break;
+      #endif
         }
 
         if (-3 == rc) return 0;
@@ -621,6 +665,11 @@ static int network_write_chunkqueue_sendfile(int fd, chunkqueue *cq, off_t max_b
             rc = network_write_file_chunk_no_mmap(fd, cq, &max_bytes, errh);
           #endif
             break;
+      #if defined(HAVE_SPLICE)
+        case PIPE_CHUNK:
+            rc = network_write_pipe_chunk_splice(fd, cq, &max_bytes, errh);
+            break;
+      #endif
         }
 
         if (-3 == rc) return 0;
@@ -4,11 +4,13 @@
 #include "base.h"
 #include "array.h"
 #include "log.h"
+#include "status_counter.h"
 
 #include <string.h>
 #include <stdlib.h>
 
 array plugin_stats; /* global */
+status_histogram status_histograms[STATUS_HIST_MAX]; /* global */
 
 #ifdef HAVE_VALGRIND_VALGRIND_H
 # include <valgrind/valgrind.h>
@@ -418,6 +420,7 @@ static void plugins_call_cleanup(server * const srv) {
             if (p->cleanup)
                 p->cleanup(p->data);
             free(pd->cvlist);
+            free(pd->snapshots);
             free(pd);
             p->data = NULL;
         }
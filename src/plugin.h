@@ -53,6 +53,7 @@ extern array plugin_stats;
 #define PLUGIN_DATA        int id; \
                            int nconfig; \
                            config_plugin_value_t *cvlist; \
+                           config_snapshots *snapshots; \
                            struct plugin *self
 
 typedef struct {
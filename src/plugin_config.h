@@ -170,4 +170,17 @@ typedef struct cond_match_t {
 
 int config_check_cond(request_st *r, int context_ndx);
 
+/* memoized merged plugin_config (p->conf) for the set of true conditions;
+ * usage in *_patch_config():
+ *   if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(plugin_config)))
+ *       return;
+ *   (reset p->conf to p->defaults and merge matching conditions)
+ *   config_plugin_snapshot_save(p, &p->conf);
+ * (merged plugin_config must depend only on defaults and true conditions) */
+typedef struct config_snapshots config_snapshots;
+
+int config_plugin_snapshot_load (request_st *r, void *p_d, void *pconf, size_t sz);
+
+void config_plugin_snapshot_save (void *p_d, const void *pconf);
+
 #endif
@@ -11,6 +11,7 @@
 #include "burl.h"
 #include "http_header.h"
 #include "http_kv.h"
+#include "hpack.h"
 #include "log.h"
 #include "sock_addr.h"
 
@@ -993,3 +994,193 @@ int http_request_parse(request_st * const restrict r, char * const restrict hdrs
 
     return 0;
 }
+
+__attribute_cold__
+static int http_request_parse_h2_pseudo(const char * const restrict k, const uint32_t klen, const char * const restrict v, const uint32_t vlen, const char ** const restrict pseudo, uint32_t * const restrict plen) {
+    /* pseudo-header fields :method :scheme :authority :path
+     * (each pseudo-header must appear at most once) */
+    int i;
+    switch (klen) {
+      case 5:
+        if (0 != memcmp(k, ":path", 5)) return -1;
+        i = 3;
+        break;
+      case 7:
+        if      (0 == memcmp(k, ":method", 7)) i = 0;
+        else if (0 == memcmp(k, ":scheme", 7)) i = 1;
+        else return -1;
+        break;
+      case 10:
+        if (0 != memcmp(k, ":authority", 10)) return -1;
+        i = 2;
+        break;
+      default:
+        return -1;
+    }
+    if (NULL != pseudo[i]) return -1;
+    pseudo[i] = v;
+    plen[i] = vlen;
+    return 0;
+}
+
+int http_request_parse_h2(request_st * const restrict r, const char * const restrict b, const hpack_field * const restrict f, const uint32_t n, const int scheme_port) {
+    /* parse HTTP/2 request header fields decoded from HPACK header block
+     * (RFC 7540 Section 8.1.2 HTTP Header Fields) */
+    const char *pseudo[4] = { NULL, NULL, NULL, NULL };
+    uint32_t plen[4] = { 0, 0, 0, 0 };
+    const unsigned int http_parseopts = r->conf.http_parseopts;
+    const unsigned int http_header_strict =
+      (http_parseopts & HTTP_PARSEOPT_HEADER_STRICT);
+    uint32_t i = 0;
+    int status;
+
+    r->http_version = HTTP_VERSION_2;
+    r->keep_alive = 1;
+
+    /* pseudo-header fields must precede regular header fields */
+    for (; i < n && b[f[i].k] == ':'; ++i) {
+        if (0 != http_request_parse_h2_pseudo(b+f[i].k, f[i].klen,
+                                              b+f[i].v, f[i].vlen,
+                                              pseudo, plen))
+            return http_request_header_line_invalid(r, 400, "invalid HTTP/2 pseudo-header -> 400");
+    }
+
+    if (NULL == pseudo[0])
+        return http_request_header_line_invalid(r, 400, "missing :method -> 400");
+    r->http_method = get_http_method_key(pseudo[0], plen[0]);
+    if (HTTP_METHOD_UNSET == r->http_method)
+        return http_request_header_line_invalid(r, 501, "unknown http-method -> 501");
+
+    if (HTTP_METHOD_CONNECT == r->http_method) {
+        /* :scheme and :path must be omitted for CONNECT (and :authority set)*/
+        if (NULL != pseudo[1] || NULL != pseudo[3] || NULL == pseudo[2])
+            return http_request_header_line_invalid(r, 400, "invalid CONNECT pseudo-headers -> 400");
+        pseudo[3] = pseudo[2];
+        plen[3] = plen[2];
+    }
+    else if (NULL == pseudo[1] || NULL == pseudo[3] || 0 == plen[3])
+        return http_request_header_line_invalid(r, 400, "missing :scheme or :path -> 400");
+
+    /* check uri for invalid characters */
+    for (uint32_t j = 0; j < plen[3]; ++j) {
+        if (!request_uri_is_valid_char(((unsigned char *)pseudo[3])[j]))
+            return http_request_header_char_invalid(r, pseudo[3][j], "invalid character in URI -> 400");
+    }
+    if (pseudo[3][0] != '/'
+        && HTTP_METHOD_CONNECT != r->http_method
+        && !(HTTP_METHOD_OPTIONS == r->http_method
+             && pseudo[3][0] == '*' && 1 == plen[3]))
+        return http_request_header_line_invalid(r, 400, "request-URI parse error -> 400");
+
+    buffer_copy_string_len(&r->target, pseudo[3], plen[3]);
+    buffer_copy_string_len(&r->target_orig, pseudo[3], plen[3]);
+
+    status = http_request_parse_target(r, scheme_port);
+    if (0 != status) return status;
+
+    if (NULL != pseudo[2]) {
+        if (0 == plen[2] || plen[2] >= 1024) /*(expecting < 256)*/
+            return http_request_header_line_invalid(r, 400, "uri-authority empty or too long -> 400");
+        for (uint32_t j = 0; j < plen[2]; ++j) {
+            if (!request_uri_is_valid_char(((unsigned char *)pseudo[2])[j]))
+                return http_request_header_char_invalid(r, pseudo[2][j], "invalid character in :authority -> 400");
+        }
+        /* :authority is inserted as Host header */
+        status = http_request_parse_single_header(r, HTTP_HEADER_HOST,
+                                                  CONST_STR_LEN("Host"),
+                                                  pseudo[2], plen[2]);
+        if (0 != status) return status;
+    }
+
+    for (; i < n; ++i) {
+        const char * const k = b + f[i].k;
+        const char * const v = b + f[i].v;
+        const uint32_t klen = f[i].klen;
+        const uint32_t vlen = f[i].vlen;
+
+        if (0 == klen)
+            return http_request_header_line_invalid(r, 400, "invalid header key -> 400");
+        if (k[0] == ':')
+            return http_request_header_line_invalid(r, 400, "pseudo-header after regular header -> 400");
+
+        /* field names must be lowercase; check for invalid chars */
+        for (uint32_t j = 0; j < klen; ++j) {
+            if ((uint32_t)(k[j] - 'A') < 26)
+                return http_request_header_char_invalid(r, k[j], "invalid uppercase char in HTTP/2 header -> 400");
+        }
+        status = http_request_parse_header_other(r, k, (int)klen, 1);
+        if (0 != status) return status;
+
+        for (uint32_t j = 0; j < vlen; ++j) {
+            if ((((unsigned char *)v)[j] < 32 && v[j] != '\t') || v[j]==127) {
+                if (http_header_strict || v[j] == '\0' || v[j] == '\r'
+                    || v[j] == '\n')
+                    return http_request_header_char_invalid(r, v[j], "invalid character in header -> 400");
+            }
+        }
+
+        const enum http_header_e id = http_header_hkey_get(k, klen);
+        switch (id) {
+          case HTTP_HEADER_CONNECTION:
+          case HTTP_HEADER_TRANSFER_ENCODING:
+          case HTTP_HEADER_UPGRADE:
+            /* connection-specific header fields are malformed in HTTP/2 */
+            return http_request_header_line_invalid(r, 400, "connection-specific header in HTTP/2 request -> 400");
+          case HTTP_HEADER_COOKIE:
+            /* concatenate multiple cookie fields with "; " */
+            if (r->rqst_htags & HTTP_HEADER_COOKIE) {
+                buffer * const vb =
+                  http_header_request_get(r, id, CONST_STR_LEN("Cookie"));
+                if (NULL != vb && 0 != vlen) {
+                    buffer_append_string_len(vb, CONST_STR_LEN("; "));
+                    buffer_append_string_len(vb, v, vlen);
+                }
+                continue;
+            }
+            break;
+          case HTTP_HEADER_HOST:
+            /* :authority takes precedence over Host (RFC 7540 8.1.2.3) */
+            if (NULL != pseudo[2]) continue;
+            break;
+          case HTTP_HEADER_OTHER:
+            if ((klen == 10 && 0 == memcmp(k, "keep-alive", 10))
+                || (klen == 16 && 0 == memcmp(k, "proxy-connection", 16)))
+                return http_request_header_line_invalid(r, 400, "connection-specific header in HTTP/2 request -> 400");
+            /* TE header field must not contain anything other than "trailers" */
+            if (klen == 2 && k[0] == 't' && k[1] == 'e'
+                && !(vlen == 8 && 0 == memcmp(v, "trailers", 8)))
+                return http_request_header_line_invalid(r, 400, "invalid TE in HTTP/2 request -> 400");
+            break;
+          default:
+            break;
+        }
+
+        /* empty header-fields are not allowed by HTTP-RFC, we just ignore them */
+        if (0 == vlen) continue; /* ignore header */
+
+        status = http_request_parse_single_header(r, id, k, klen, v, vlen);
+        if (0 != status) return status;
+    }
+
+    /*(r->http_host might not be set until after parsing request headers)*/
+    buffer_copy_buffer(&r->uri.authority, r->http_host);/*(copy even if empty)*/
+    buffer_to_lower(&r->uri.authority);
+
+    /* post-processing */
+
+    if (r->http_host) {
+        if (0 != http_request_host_policy(r->http_host,
+                                          http_parseopts, scheme_port))
+            return http_request_header_line_invalid(r, 400, "Invalid Hostname -> 400");
+    }
+    else
+        return http_request_header_line_invalid(r, 400, "HTTP/2 but :authority and Host missing -> 400");
+
+    if (0 != r->reqbody_length
+        && http_method_get_or_head(r->http_method)
+        && !(http_parseopts & HTTP_PARSEOPT_METHOD_GET_BODY)) {
+        return http_request_header_line_invalid(r, 400, "GET/HEAD with content-length -> 400");
+    }
+
+    return 0;
+}
@@ -13,6 +13,7 @@ struct log_error_st;    /* declaration */
 struct chunkqueue;      /* declaration */
 struct cond_cache_t;    /* declaration */
 struct cond_match_t;    /* declaration */
+struct hpack_field;     /* declaration */
 
 typedef struct {
     unsigned int http_parseopts;
@@ -111,9 +112,25 @@ typedef enum {
     CON_STATE_CLOSE
 } request_state_t;
 
+typedef enum {
+    H2_STATE_IDLE,
+    H2_STATE_RESERVED_LOCAL,
+    H2_STATE_RESERVED_REMOTE,
+    H2_STATE_OPEN,
+    H2_STATE_HALF_CLOSED_LOCAL,
+    H2_STATE_HALF_CLOSED_REMOTE,
+    H2_STATE_CLOSED
+} request_h2state_t;
+
 struct request_st {
     request_state_t state; /*(modules should not modify request state)*/
     int http_status;
+    request_h2state_t h2state;
+    uint32_t h2id;
+    int32_t h2_rwin;
+    int32_t h2_swin;
+    uint32_t h2_dep;     /* stream dependency (RFC 7540 5.3.1) */
+    uint32_t h2_weight;  /* stream weight 1 - 256 */
 
     http_method_t http_method;
     http_version_t http_version;
@@ -171,6 +188,11 @@ struct request_st {
     struct timespec start_hp;
     time_t start_ts;
 
+    /* request phase timestamps (if conf.high_precision_timestamps) */
+    struct timespec hdrs_hp;    /* request headers received */
+    struct timespec resp_hp;    /* response start */
+    uint64_t backend_usec;      /* time spent waiting on backend */
+
     int error_handler_saved_status; /* error-handler */
     http_method_t error_handler_saved_method; /* error-handler */
 };
@@ -178,6 +200,7 @@ struct request_st {
 
 int http_request_parse(request_st * restrict r, char * restrict hdrs, const unsigned short * restrict hloffsets, int scheme_port);
 int http_request_parse_target(request_st *r, int scheme_port);
+int http_request_parse_h2(request_st * restrict r, const char * restrict b, const struct hpack_field * restrict f, uint32_t n, int scheme_port);
 int http_request_host_normalize(buffer *b, int scheme_port);
 int http_request_host_policy(buffer *b, unsigned int http_parseopts, int scheme_port);
 
@@ -7,11 +7,14 @@
 #include "fdevent.h"
 #include "http_header.h"
 #include "http_kv.h"
+#include "h2.h"
+#include "hpack.h"
 #include "log.h"
 #include "stat_cache.h"
 #include "chunk.h"
 
 #include "plugin.h"
+#include "status_counter.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -46,7 +49,99 @@ static int http_response_omit_header(request_st * const r, const data_string * c
     return 0;
 }
 
+static uint32_t http_response_date(const char **ts) {
+	static time_t tlast;
+	static char tstr[32]; /* 30-chars for "%a, %d %b %Y %H:%M:%S GMT" */
+	static uint32_t tlen;
+
+	/* cache the generated timestamp */
+	const time_t cur_ts = log_epoch_secs;
+	if (tlast != cur_ts) {
+		tlast = cur_ts;
+		tlen = (uint32_t)strftime(tstr, sizeof(tstr),
+		                          "%a, %d %b %Y %H:%M:%S GMT", gmtime(&tlast));
+	}
+
+	*ts = tstr;
+	return tlen;
+}
+
+static int http_response_write_header_h2(request_st * const r) {
+	buffer * const b = r->tmp_buf;
+	buffer_clear(b);
+	hpack_encode_status(b, r->http_status);
+
+	r->con->keep_alive_idle = r->conf.max_keep_alive_idle;
+
+	if (304 == r->http_status && (r->resp_htags & HTTP_HEADER_CONTENT_ENCODING)) {
+		http_header_response_unset(r, HTTP_HEADER_CONTENT_ENCODING, CONST_STR_LEN("Content-Encoding"));
+	}
+
+	/* add all headers; omit connection-specific headers (RFC 7540 8.1.2.2)*/
+	for (size_t i = 0; i < r->resp_headers.used; ++i) {
+		const data_string * const ds = (data_string *)r->resp_headers.data[i];
+
+		if (buffer_string_is_empty(&ds->value)) continue;
+		if (buffer_string_is_empty(&ds->key)) continue;
+		switch (http_header_hkey_get(CONST_BUF_LEN(&ds->key))) {
+		case HTTP_HEADER_CONNECTION:
+		case HTTP_HEADER_TRANSFER_ENCODING:
+		case HTTP_HEADER_UPGRADE:
+			continue;
+		case HTTP_HEADER_OTHER:
+			if (buffer_eq_icase_slen(&ds->key, CONST_STR_LEN("Keep-Alive"))
+			    || buffer_eq_icase_slen(&ds->key,
+			                            CONST_STR_LEN("Proxy-Connection")))
+				continue;
+			break;
+		default:
+			break;
+		}
+		if ((ds->key.ptr[0] & 0xdf) == 'X' && http_response_omit_header(r, ds))
+			continue;
+
+		hpack_encode_field_multi(b, CONST_BUF_LEN(&ds->key),
+		                            CONST_BUF_LEN(&ds->value));
+	}
+
+	if (!(r->resp_htags & HTTP_HEADER_DATE)) {
+		const char *ts;
+		const uint32_t tlen = http_response_date(&ts);
+		hpack_encode_field(b, CONST_STR_LEN("date"), ts, tlen);
+	}
+
+	if (!(r->resp_htags & HTTP_HEADER_SERVER)) {
+		if (!buffer_string_is_empty(r->conf.server_tag)) {
+			hpack_encode_field(b, CONST_STR_LEN("server"),
+			                   CONST_BUF_LEN(r->conf.server_tag));
+		}
+	}
+
+	r->resp_header_len = buffer_string_length(b);
+
+	if (r->conf.log_response_header) {
+		log_error(r->conf.errh,__FILE__,__LINE__,
+		  "Response-Header: (HTTP/2 stream %u, status %d)",
+		  r->h2id, r->http_status);
+		for (size_t i = 0; i < r->resp_headers.used; ++i) {
+			const data_string * const ds = (data_string *)r->resp_headers.data[i];
+			log_error(r->conf.errh,__FILE__,__LINE__,"%s: %s",
+			  ds->key.ptr, ds->value.ptr ? ds->value.ptr : "");
+		}
+	}
+
+	return h2_send_headers(r, r->con, CONST_BUF_LEN(b));
+}
+
 int http_response_write_header(request_st * const r) {
+	if (r->conf.high_precision_timestamps) {
+		struct timespec ts;
+		status_histogram_add_since(STATUS_HIST_TTFB, &r->start_hp, &ts);
+	}
+
+	if (r->http_version == HTTP_VERSION_2)
+		return http_response_write_header_h2(r);
+
 	chunkqueue * const cq = r->write_queue;
 	buffer * const b = chunkqueue_prepend_buffer_open(cq);
 
@@ -100,22 +195,11 @@ int http_response_write_header(request_st * const r) {
 	}
 
 	if (!(r->resp_htags & HTTP_HEADER_DATE)) {
-		static time_t tlast;
-		static char tstr[32]; /* 30-chars for "%a, %d %b %Y %H:%M:%S GMT" */
-		static size_t tlen;
-
 		/* HTTP/1.1 requires a Date: header */
 		buffer_append_string_len(b, CONST_STR_LEN("\r\nDate: "));
-
-		/* cache the generated timestamp */
-		const time_t cur_ts = log_epoch_secs;
-		if (tlast != cur_ts) {
-			tlast = cur_ts;
-			tlen = strftime(tstr, sizeof(tstr),
-			                "%a, %d %b %Y %H:%M:%S GMT", gmtime(&tlast));
-		}
-
-		buffer_append_string_len(b, tstr, tlen);
+		const char *ts;
+		const uint32_t tlen = http_response_date(&ts);
+		buffer_append_string_len(b, ts, tlen);
 	}
 
 	if (!(r->resp_htags & HTTP_HEADER_SERVER)) {
@@ -306,7 +390,7 @@ static handler_t http_response_config (request_st * const r) {
     config_patch_config(r);
 
     /* do we have to downgrade to 1.0 ? */
-    if (!r->conf.allow_http11)
+    if (!r->conf.allow_http11 && r->http_version != HTTP_VERSION_2)
         r->http_version = HTTP_VERSION_1_0;
 
     /* r->conf.max_request_size is in kBytes */
@@ -36,8 +36,20 @@ typedef struct http_response_opts_t {
   void *pdata;
   handler_t(*parse)(request_st *, struct http_response_opts_t *, buffer *, size_t);
   handler_t(*headers)(request_st *, struct http_response_opts_t *);
+  /* (optional) track end of response body from backend so that connection
+   * to backend might be reused; caller sets HTTP_RESPONSE_FRAMING_TRACK */
+  int framing;
+  int keepalive;    /* backend permits reuse of connection after response */
+  off_t framing_rem;/* bytes remaining in body or in current chunk */
 } http_response_opts;
 
+enum {
+  HTTP_RESPONSE_FRAMING_NONE = 0, /* response body ends at EOF */
+  HTTP_RESPONSE_FRAMING_TRACK,    /* (set by caller) */
+  HTTP_RESPONSE_FRAMING_DONE      /* complete response received */
+  /*(additional internal states in http-header-glue.c)*/
+};
+
 typedef int (*http_cgi_header_append_cb)(void *vdata, const char *k, size_t klen, const char *v, size_t vlen);
 int http_cgi_headers(request_st *r, http_cgi_opts *opts, http_cgi_header_append_cb cb, void *vdata);
 
@@ -51,7 +63,7 @@ handler_t http_response_comeback(request_st *r);
 int http_response_redirect_to_directory(request_st *r, int status);
 int http_response_handle_cachable(request_st *r, const buffer *mtime);
 void http_response_body_clear(request_st *r, int preserve_length);
-void http_response_send_file (request_st *r, buffer *path);
+void http_response_send_file (request_st *r, buffer *path, off_t mem_cache_max_sz);
 void http_response_backend_done (request_st *r);
 void http_response_backend_error (request_st *r);
 void http_response_upgrade_read_body_unknown(request_st *r);
@@ -470,7 +470,9 @@ static void show_features (void) {
 #else
       "\t- Nettle support\n"
 #endif
-#ifdef HAVE_LIBPCRE
+#ifdef HAVE_LIBPCRE2
+      "\t+ PCRE2 support\n"
+#elif defined(HAVE_LIBPCRE)
       "\t+ PCRE support\n"
 #else
       "\t- PCRE support\n"
@@ -623,6 +625,9 @@ static void server_sockets_close (server *srv) {
         if (2 != srv->sockets_disabled) network_unregister_sock(srv,srv_socket);
         close(srv_socket->fd);
         srv_socket->fd = -1;
+        for (uint32_t j = 0; j < srv_socket->reuseport_used; ++j)
+            close(srv_socket->reuseport_fds[j]);
+        srv_socket->reuseport_used = 0;
         /* network_close() will cleanup after us */
     }
     srv->sockets_disabled = 3;
@@ -1191,6 +1196,7 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 		srv->srvconf.max_worker = 0;
 		log_error(srv->errh, __FILE__, __LINE__,
 		  "server idle time limit command line option disables server.max-worker config file option.");
+		network_reuseport_select(srv, 0);
 	}
 
 	/* start watcher and workers */
@@ -1200,10 +1206,15 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 		pid_t pid;
 		const int npids = num_childs;
 		int child = 0;
+		int worker = 0;
 		unsigned int timer = 0;
 		for (int n = 0; n < npids; ++n) pids[n] = -1;
 		while (!child && !srv_shutdown && !graceful_shutdown) {
 			if (num_childs > 0) {
+				/* (worker slot is reused by replacement for exited worker) */
+				for (worker = 0; worker < npids-1; ++worker) {
+					if (-1 == pids[worker]) break;
+				}
 				switch ((pid = fork())) {
 				case -1:
 					return -1;
@@ -1213,12 +1224,7 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 					break;
 				default:
 					num_childs--;
-					for (int n = 0; n < npids; ++n) {
-						if (-1 == pids[n]) {
-							pids[n] = pid;
-							break;
-						}
-					}
+					pids[worker] = pid;
 					break;
 				}
 			} else {
@@ -1297,6 +1303,9 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 			return 0;
 		}
 
+		/* keep only listen sockets for this worker (server.reuseport) */
+		network_reuseport_select(srv, (uint32_t)worker);
+
 		/* ignore SIGUSR1 in workers; only parent directs graceful restart */
 	      #ifdef HAVE_SIGACTION
 		{
@@ -1330,6 +1339,7 @@ static int server_main_setup (server * const srv, int argc, char **argv) {
 		log_error(srv->errh, __FILE__, __LINE__, "fdevent_init failed");
 		return -1;
 	}
+	chunkqueue_set_cur_fds(&srv->cur_fds);
 
 	srv->max_fds_lowat = srv->max_fds * 8 / 10;
 	srv->max_fds_hiwat = srv->max_fds * 9 / 10;
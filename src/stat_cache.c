@@ -35,7 +35,9 @@
 /*
  * stat-cache
  *
- * - a splay-tree is used as we can use the caching effect of it
+ * - an open addressing hash table (linear probing) is used for lookups,
+ *   keyed by full 32-bit hash and length of path, and CLOCK eviction when
+ *   configured with a limit on number of entries (server.stat-cache-max-entries)
  */
 
 enum {
@@ -46,15 +48,170 @@ enum {
 
 struct stat_cache_fam;  /* declaration */
 
+typedef struct stat_cache_ht_slot {
+	stat_cache_entry *sce;
+	uint32_t hash;
+	uint32_t len:31;
+	uint32_t ref:1;    /* CLOCK reference bit */
+} stat_cache_ht_slot;
+
+typedef struct stat_cache_ht {
+	stat_cache_ht_slot *slots;
+	uint32_t mask;     /* (num slots) - 1; num slots is power of 2 */
+	uint32_t used;
+	uint32_t max;      /* limit on num entries (0 for no limit) */
+	uint32_t hand;     /* CLOCK hand */
+} stat_cache_ht;
+
 typedef struct stat_cache {
 	int stat_cache_engine;
-	splay_tree *files; /* nodes of tree are (stat_cache_entry *) */
+	stat_cache_ht files; /* (stat_cache_entry *) */
 	struct stat_cache_fam *scf;
+	uint32_t max_fds;  /* limit on open fds kept in stat_cache entries */
+	uint32_t num_fds;
+	uint64_t body_max_total; /* limit on file contents cached in memory */
+	stat_cache_body_stats body_stats;
 } stat_cache;
 
 static stat_cache sc;
 
 
+static void stat_cache_entry_free(void *data);
+
+static uint32_t stat_cache_ht_hash(const char * const name, const uint32_t len)
+{
+    /* mix bits of djbhash since lowest bits select slot */
+    uint32_t h = djbhash(name, len, DJBHASH_INIT);
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    return h;
+}
+
+static stat_cache_ht_slot * stat_cache_ht_find(stat_cache_ht * const ht,
+                                               const char * const name,
+                                               const uint32_t len,
+                                               const uint32_t hash)
+{
+    if (NULL == ht->slots) return NULL;
+    stat_cache_ht_slot * const slots = ht->slots;
+    const uint32_t mask = ht->mask;
+    for (uint32_t i = hash & mask; slots[i].sce; i = (i+1) & mask) {
+        stat_cache_ht_slot * const s = slots+i;
+        if (s->hash == hash && s->len == len
+            && 0 == memcmp(s->sce->name.ptr, name, len)) {
+            if (!s->ref) s->ref = 1;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void stat_cache_ht_delete_slot(stat_cache_ht * const ht, uint32_t i)
+{
+    /* backward shift deletion; no tombstones with linear probing */
+    stat_cache_ht_slot * const slots = ht->slots;
+    const uint32_t mask = ht->mask;
+    for (uint32_t j = i; ; ) {
+        j = (j+1) & mask;
+        if (NULL == slots[j].sce) break;
+        const uint32_t k = slots[j].hash & mask;
+        /* move entry j to i unless its home slot k is cyclically in (i, j] */
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].sce = NULL;
+    --ht->used;
+}
+
+static void stat_cache_ht_place(stat_cache_ht * const ht,
+                                const stat_cache_ht_slot * const s)
+{
+    stat_cache_ht_slot * const slots = ht->slots;
+    const uint32_t mask = ht->mask;
+    uint32_t i = s->hash & mask;
+    while (slots[i].sce) i = (i+1) & mask;
+    slots[i] = *s;
+    ++ht->used;
+}
+
+__attribute_cold__
+__attribute_noinline__
+static void stat_cache_ht_grow(stat_cache_ht * const ht)
+{
+    stat_cache_ht_slot * const oslots = ht->slots;
+    const uint32_t osz = oslots ? ht->mask+1 : 0;
+    const uint32_t nsz = osz ? osz << 1 : 1024;
+    force_assert(nsz > osz);
+    ht->slots = calloc(nsz, sizeof(stat_cache_ht_slot));
+    force_assert(NULL != ht->slots);
+    ht->mask = nsz - 1;
+    ht->used = 0;
+    ht->hand = 0;
+    for (uint32_t i = 0; i < osz; ++i) {
+        if (oslots[i].sce) stat_cache_ht_place(ht, oslots+i);
+    }
+    free(oslots);
+}
+
+static int stat_cache_ht_evict(stat_cache_ht * const ht)
+{
+    /* CLOCK: clear reference bits until finding an entry not referenced
+     * since hand last passed.  Sweep at most once around so that entries
+     * referenced since the last sweep (e.g. by a request in progress)
+     * are not evicted; table is permitted to grow beyond ht->max if all
+     * entries have been referenced */
+    stat_cache_ht_slot * const slots = ht->slots;
+    const uint32_t mask = ht->mask;
+    for (uint32_t n = 0; n <= mask; ++n) {
+        const uint32_t i = ht->hand;
+        ht->hand = (i+1) & mask;
+        if (NULL == slots[i].sce) continue;
+        if (slots[i].ref) {
+            slots[i].ref = 0;
+            continue;
+        }
+        stat_cache_entry_free(slots[i].sce);
+        stat_cache_ht_delete_slot(ht, i);
+        return 1;
+    }
+    return 0;
+}
+
+static stat_cache_ht_slot * stat_cache_ht_insert(stat_cache_ht * const ht,
+                                                 stat_cache_entry * const sce,
+                                                 const uint32_t len,
+                                                 const uint32_t hash)
+{
+    /*(expects that entry is not already present in table)*/
+    if (ht->max && ht->used >= ht->max) stat_cache_ht_evict(ht);
+    if (NULL == ht->slots || ht->used >= (ht->mask >> 1))/*(load <= 0.5)*/
+        stat_cache_ht_grow(ht);
+
+    stat_cache_ht_slot * const slots = ht->slots;
+    const uint32_t mask = ht->mask;
+    uint32_t i = hash & mask;
+    while (slots[i].sce) i = (i+1) & mask;
+    slots[i].sce = sce;
+    slots[i].hash = hash;
+    slots[i].len = len;
+    slots[i].ref = 1;
+    ++ht->used;
+    return slots+i;
+}
+
+static stat_cache_ht_slot * stat_cache_ht_find_name(const char * const name,
+                                                    const uint32_t len)
+{
+    return stat_cache_ht_find(&sc.files, name, len,
+                              stat_cache_ht_hash(name, len));
+}
+
+
+#ifdef HAVE_FAM_H
+
 static void * stat_cache_sptree_find(splay_tree ** const sptree,
                                      const char * const name,
                                      uint32_t len)
@@ -65,8 +222,6 @@ static void * stat_cache_sptree_find(splay_tree ** const sptree,
 }
 
 
-#ifdef HAVE_FAM_H
-
 /* monitor changes in directories using FAM
  *
  * This implementation employing FAM monitors directories as they are used,
@@ -519,10 +674,44 @@ static fam_dir_entry * fam_dir_monitor(stat_cache_fam *scf, char *fn, uint32_t d
 static stat_cache_entry * stat_cache_entry_init(void) {
     stat_cache_entry *sce = calloc(1, sizeof(*sce));
     force_assert(NULL != sce);
+    sce->fd = -1;
+    sce->refcnt = 1; /*(reference held by stat_cache)*/
     return sce;
 }
 
+static void stat_cache_entry_close_fd(stat_cache_entry * const sce) {
+    if (sce->fd < 0) return;
+    close(sce->fd);
+    sce->fd = -1;
+    --sc.num_fds;
+}
+
+static void stat_cache_entry_body_free(stat_cache_entry * const sce) {
+    if (NULL == sce->body.ptr) return;
+    sc.body_stats.bytes -= buffer_string_length(&sce->body);
+    --sc.body_stats.entries;
+    free(sce->body.ptr);
+    sce->body.ptr = NULL;
+    sce->body.used = sce->body.size = 0;
+}
+
+void stat_cache_entry_refchg(void *data, int mod) {
+    /*(mod is +1 or -1; references to sce->fd held by chunks in chunkqueue)*/
+    stat_cache_entry * const sce = data;
+    if ((sce->refcnt += mod) > 0) return;
+
+    stat_cache_entry_close_fd(sce);
+    stat_cache_entry_body_free(sce);
+    free(sce->name.ptr);
+    free(sce->etag.ptr);
+    if (sce->content_type.size) free(sce->content_type.ptr);
+
+    free(sce);
+}
+
 static void stat_cache_entry_free(void *data) {
+    /*(release reference held by stat_cache; entry is freed when the last
+     * response chunk referencing sce->fd is released, if any remain)*/
     stat_cache_entry *sce = data;
     if (!sce) return;
 
@@ -530,13 +719,41 @@ static void stat_cache_entry_free(void *data) {
     /*(decrement refcnt only;
      * defer cancelling FAM monitor on dir even if refcnt reaches zero)*/
     if (sce->fam_dir) --((fam_dir_entry *)sce->fam_dir)->refcnt;
+    sce->fam_dir = NULL;
   #endif
 
-    free(sce->name.ptr);
-    free(sce->etag.ptr);
-    if (sce->content_type.size) free(sce->content_type.ptr);
+    stat_cache_entry_refchg(sce, -1);
+}
 
-    free(sce);
+static stat_cache_entry * stat_cache_entry_detach_fd(stat_cache_entry *sce) {
+    /* discard cached fd and contents (file changed),
+     * returning entry to store in cache */
+    stat_cache_entry_body_free(sce);
+    if (sce->fd < 0) return sce;
+    if (1 == sce->refcnt) {
+        stat_cache_entry_close_fd(sce);
+        return sce;
+    }
+
+    /* fd still in use by response(s) in progress; leave old sce to them */
+    stat_cache_entry * const nsce = stat_cache_entry_init();
+    buffer_copy_buffer(&nsce->name, &sce->name);
+    nsce->stat_ts = sce->stat_ts;
+    nsce->st = sce->st;
+  #ifdef HAVE_FAM_H
+    nsce->fam_dir = sce->fam_dir;
+    sce->fam_dir = NULL;
+  #endif
+    stat_cache_entry_free(sce);
+    return nsce;
+}
+
+static int stat_cache_stat_eq(const struct stat * const sta, const struct stat * const stb) {
+    return sta->st_ino   == stb->st_ino
+        && sta->st_dev   == stb->st_dev
+        && sta->st_size  == stb->st_size
+        && sta->st_mtime == stb->st_mtime
+        && sta->st_ctime == stb->st_ctime;
 }
 
 #if defined(HAVE_XATTR) || defined(HAVE_EXTATTR)
@@ -585,12 +802,15 @@ int stat_cache_init(fdevents *ev, log_error_st *errh) {
 }
 
 void stat_cache_free(void) {
-    splay_tree *sptree = sc.files;
-    while (sptree) {
-        stat_cache_entry_free(sptree->data);
-        sptree = splaytree_delete(sptree, sptree->key);
+    stat_cache_ht * const ht = &sc.files;
+    if (ht->slots) {
+        for (uint32_t i = 0; i <= ht->mask; ++i) {
+            if (ht->slots[i].sce) stat_cache_entry_free(ht->slots[i].sce);
+        }
+        free(ht->slots);
+        ht->slots = NULL;
+        ht->mask = ht->used = ht->hand = 0;
     }
-    sc.files = NULL;
 
   #ifdef HAVE_FAM_H
     stat_cache_free_fam(sc.scf);
@@ -604,6 +824,22 @@ void stat_cache_free(void) {
     sc.stat_cache_engine = STAT_CACHE_ENGINE_SIMPLE; /*(default)*/
 }
 
+void stat_cache_max_entries (uint32_t max_entries) {
+    sc.files.max = max_entries;
+}
+
+void stat_cache_max_fds (uint32_t max_fds) {
+    sc.max_fds = max_fds;
+}
+
+void stat_cache_body_max_total (uint64_t max_total) {
+    sc.body_max_total = max_total;
+}
+
+const stat_cache_body_stats * stat_cache_body_stats_get (void) {
+    return &sc.body_stats;
+}
+
 void stat_cache_xattrname (const char *name) {
   #if defined(HAVE_XATTR) || defined(HAVE_EXTATTR)
     attrname = name;
@@ -771,10 +1007,11 @@ void stat_cache_update_entry(const char *name, uint32_t len,
     if (sc.stat_cache_engine == STAT_CACHE_ENGINE_NONE) return;
     force_assert(0 != len);
     if (name[len-1] == '/') { if (0 == --len) len = 1; }
-    splay_tree **sptree = &sc.files;
-    stat_cache_entry *sce =
-      stat_cache_sptree_find(sptree, name, len);
-    if (sce && buffer_is_equal_string(&sce->name, name, len)) {
+    stat_cache_ht_slot * const s = stat_cache_ht_find_name(name, len);
+    if (s) {
+        stat_cache_entry *sce = s->sce;
+        if (!stat_cache_stat_eq(&sce->st, st))
+            s->sce = sce = stat_cache_entry_detach_fd(sce);
         sce->stat_ts = log_epoch_secs;
         sce->st = *st; /* etagb might be NULL to clear etag (invalidate) */
         buffer_copy_string_len(&sce->etag, CONST_BUF_LEN(etagb));
@@ -789,19 +1026,18 @@ void stat_cache_delete_entry(const char *name, uint32_t len)
     if (sc.stat_cache_engine == STAT_CACHE_ENGINE_NONE) return;
     force_assert(0 != len);
     if (name[len-1] == '/') { if (0 == --len) len = 1; }
-    splay_tree **sptree = &sc.files;
-    stat_cache_entry *sce = stat_cache_sptree_find(sptree, name, len);
-    if (sce && buffer_is_equal_string(&sce->name, name, len)) {
-        stat_cache_entry_free(sce);
-        *sptree = splaytree_delete(*sptree, (*sptree)->key);
+    stat_cache_ht_slot * const s = stat_cache_ht_find_name(name, len);
+    if (s) {
+        stat_cache_entry_free(s->sce);
+        stat_cache_ht_delete_slot(&sc.files, (uint32_t)(s - sc.files.slots));
     }
 }
 
 void stat_cache_invalidate_entry(const char *name, uint32_t len)
 {
-    splay_tree **sptree = &sc.files;
-    stat_cache_entry *sce = stat_cache_sptree_find(sptree, name, len);
-    if (sce && buffer_is_equal_string(&sce->name, name, len)) {
+    stat_cache_ht_slot * const s = stat_cache_ht_find_name(name, len);
+    if (s) {
+        stat_cache_entry * const sce = s->sce = stat_cache_entry_detach_fd(s->sce);
         sce->stat_ts = 0;
       #ifdef HAVE_FAM_H
         if (sce->fam_dir != NULL) {
@@ -814,71 +1050,50 @@ void stat_cache_invalidate_entry(const char *name, uint32_t len)
 
 #ifdef HAVE_FAM_H
 
-static void stat_cache_invalidate_dir_tree_walk(splay_tree *t,
-                                                const char *name, size_t len)
+static void stat_cache_invalidate_dir_tree(const char *name, size_t len)
 {
-    if (t->left)  stat_cache_invalidate_dir_tree_walk(t->left,  name, len);
-    if (t->right) stat_cache_invalidate_dir_tree_walk(t->right, name, len);
-
-    buffer *b = &((stat_cache_entry *)t->data)->name;
-    size_t blen = buffer_string_length(b);
-    if (blen > len && b->ptr[len] == '/' && 0 == memcmp(b->ptr, name, len)) {
-        stat_cache_entry *sce = t->data;
-        sce->stat_ts = 0;
-        if (sce->fam_dir != NULL) {
-            --((fam_dir_entry *)sce->fam_dir)->refcnt;
-            sce->fam_dir = NULL;
+    const stat_cache_ht * const ht = &sc.files;
+    if (NULL == ht->slots) return;
+    for (uint32_t i = 0; i <= ht->mask; ++i) {
+        const stat_cache_ht_slot * const s = ht->slots+i;
+        if (NULL == s->sce || s->len <= len) continue;
+        stat_cache_entry * const sce = s->sce;
+        const buffer * const b = &sce->name;
+        if (b->ptr[len] == '/' && 0 == memcmp(b->ptr, name, len)) {
+            sce->stat_ts = 0;
+            if (sce->fam_dir != NULL) {
+                --((fam_dir_entry *)sce->fam_dir)->refcnt;
+                sce->fam_dir = NULL;
+            }
         }
     }
 }
 
-static void stat_cache_invalidate_dir_tree(const char *name, size_t len)
-{
-    splay_tree * const sptree = sc.files;
-    if (sptree) stat_cache_invalidate_dir_tree_walk(sptree, name, len);
-}
-
 #endif
 
 /*
- * walk though splay_tree and collect contents of dir tree.
- * remove tagged entries in a second loop
+ * walk though hash table and remove contents of dir tree.
+ * (backward shift deletion might move a later entry into current slot,
+ *  so current slot is examined again after deleting an entry)
  */
 
-static void stat_cache_tag_dir_tree(splay_tree *t, const char *name, size_t len,
-                                    int *keys, int *ndx)
-{
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-    if (t->left)  stat_cache_tag_dir_tree(t->left,  name, len, keys, ndx);
-    if (t->right) stat_cache_tag_dir_tree(t->right, name, len, keys, ndx);
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-
-    buffer *b = &((stat_cache_entry *)t->data)->name;
-    size_t blen = buffer_string_length(b);
-    if (blen > len && b->ptr[len] == '/' && 0 == memcmp(b->ptr, name, len))
-        keys[(*ndx)++] = t->key;
-}
-
 __attribute_noinline__
 static void stat_cache_prune_dir_tree(const char *name, size_t len)
 {
-    splay_tree *sptree = sc.files;
-    int max_ndx, i;
-    int keys[8192]; /* 32k size on stack */
-    do {
-        if (!sptree) break;
-        max_ndx = 0;
-        stat_cache_tag_dir_tree(sptree, name, len, keys, &max_ndx);
-        for (i = 0; i < max_ndx; ++i) {
-            const int ndx = keys[i];
-            splay_tree *node = sptree = splaytree_splay(sptree, ndx);
-            if (node && node->key == ndx) {
-                stat_cache_entry_free(node->data);
-                sptree = splaytree_delete(sptree, ndx);
+    stat_cache_ht * const ht = &sc.files;
+    if (NULL == ht->slots) return;
+    for (uint32_t i = 0; i <= ht->mask; ) {
+        const stat_cache_ht_slot * const s = ht->slots+i;
+        if (s->sce && s->len > len) {
+            const buffer * const b = &s->sce->name;
+            if (b->ptr[len] == '/' && 0 == memcmp(b->ptr, name, len)) {
+                stat_cache_entry_free(s->sce);
+                stat_cache_ht_delete_slot(ht, i);
+                continue;
             }
         }
-    } while (max_ndx == sizeof(keys)/sizeof(int));
-    sc.files = sptree;
+        ++i;
+    }
 }
 
 static void stat_cache_delete_tree(const char *name, uint32_t len)
@@ -916,8 +1131,6 @@ void stat_cache_delete_dir(const char *name, uint32_t len)
 stat_cache_entry * stat_cache_get_entry(const buffer *name) {
 	stat_cache_entry *sce = NULL;
 	struct stat st;
-	int file_ndx;
-
 	/* consistency: ensure lookup name does not end in '/' unless root "/"
 	 * (but use full path given with stat(), even with trailing '/') */
 	int final_slash = 0;
@@ -938,46 +1151,40 @@ stat_cache_entry * stat_cache_get_entry(const buffer *name) {
 
 	const time_t cur_ts = log_epoch_secs;
 
-	file_ndx = splaytree_djbhash(name->ptr, len);
-	splay_tree * const sptree = sc.files = splaytree_splay(sc.files, file_ndx);
+	const uint32_t hash = stat_cache_ht_hash(name->ptr, (uint32_t)len);
+	stat_cache_ht_slot *s =
+	  stat_cache_ht_find(&sc.files, name->ptr, (uint32_t)len, hash);
 
-	if (sptree && (sptree->key == file_ndx)) {
+	if (s) {
 		/* we have seen this file already and
 		 * don't stat() it again in the same second */
 
-		sce = sptree->data;
+		sce = s->sce;
 
-		/* check if the name is the same, we might have a collision */
-
-		if (buffer_is_equal_string(&sce->name, name->ptr, len)) {
-			if (sc.stat_cache_engine == STAT_CACHE_ENGINE_SIMPLE) {
-				if (sce->stat_ts == cur_ts) {
-					if (final_slash && !S_ISDIR(sce->st.st_mode)) {
-						errno = ENOTDIR;
-						return NULL;
-					}
-					return sce;
+		if (sc.stat_cache_engine == STAT_CACHE_ENGINE_SIMPLE) {
+			if (sce->stat_ts == cur_ts) {
+				if (final_slash && !S_ISDIR(sce->st.st_mode)) {
+					errno = ENOTDIR;
+					return NULL;
 				}
+				return sce;
 			}
-		      #ifdef HAVE_FAM_H
-			else if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM
-				 && sce->fam_dir) { /* entry is in monitored dir */
-				/* re-stat() periodically, even if monitoring for changes
-				 * (due to limitations in stat_cache.c use of FAM)
-				 * (gaps due to not continually monitoring an entire tree) */
-				if (cur_ts - sce->stat_ts < 16) {
-					if (final_slash && !S_ISDIR(sce->st.st_mode)) {
-						errno = ENOTDIR;
-						return NULL;
-					}
-					return sce;
+		}
+	      #ifdef HAVE_FAM_H
+		else if (sc.stat_cache_engine == STAT_CACHE_ENGINE_FAM
+			 && sce->fam_dir) { /* entry is in monitored dir */
+			/* re-stat() periodically, even if monitoring for changes
+			 * (due to limitations in stat_cache.c use of FAM)
+			 * (gaps due to not continually monitoring an entire tree) */
+			if (cur_ts - sce->stat_ts < 16) {
+				if (final_slash && !S_ISDIR(sce->st.st_mode)) {
+					errno = ENOTDIR;
+					return NULL;
 				}
+				return sce;
 			}
-		      #endif
-		} else {
-			/* collision, forget about the entry */
-			sce = NULL;
 		}
+	      #endif
 	}
 
 	if (-1 == stat(name->ptr, &st)) {
@@ -997,17 +1204,13 @@ stat_cache_entry * stat_cache_get_entry(const buffer *name) {
 		sce = stat_cache_entry_init();
 		buffer_copy_string_len(&sce->name, name->ptr, len);
 
-		/* already splayed file_ndx */
-		if (NULL != sptree && sptree->key == file_ndx) {
-			/* hash collision: replace old entry */
-			stat_cache_entry_free(sptree->data);
-			sptree->data = sce;
-		} else {
-			sc.files = splaytree_insert(sptree, file_ndx, sce);
-		}
+		stat_cache_ht_insert(&sc.files, sce, (uint32_t)len, hash);
 
 	} else {
 
+		if (!stat_cache_stat_eq(&sce->st, &st))
+			s->sce = sce = stat_cache_entry_detach_fd(sce);
+
 		buffer_clear(&sce->etag);
 	      #if defined(HAVE_XATTR) || defined(HAVE_EXTATTR)
 		buffer_clear(&sce->content_type);
@@ -1080,6 +1283,66 @@ int stat_cache_path_contains_symlink(const buffer *name, log_error_st *errh) {
     return 0;
 }
 
+int stat_cache_entry_open (stat_cache_entry * const sce, const int symlinks) {
+	/* returns sce->fd (owned by sce; caller must not close()) if fd is cached,
+	 * else returns newly opened fd which caller must close() (or -1) */
+	if (sce->fd >= 0) return sce->fd;
+
+	/*(Note: O_NOFOLLOW affects only the final path segment,
+	 * the target file, not any intermediate symlinks along path)*/
+	const int fd = fdevent_open_cloexec(sce->name.ptr, symlinks, O_RDONLY, 0);
+	if (fd < 0 || sc.num_fds >= sc.max_fds
+	    || sc.stat_cache_engine == STAT_CACHE_ENGINE_NONE
+	    || !S_ISREG(sce->st.st_mode))
+		return fd;
+
+	/* cache fd only if fd is the file described by sce->st */
+	struct stat st;
+	if (0 == fstat(fd, &st) && stat_cache_stat_eq(&sce->st, &st)) {
+		sce->fd = fd;
+		++sc.num_fds;
+	}
+	return fd;
+}
+
+const buffer * stat_cache_body_get (stat_cache_entry * const sce) {
+	/* returns file contents if cached in memory, else NULL */
+	if (NULL == sce->body.ptr) return NULL;
+	++sc.body_stats.hits;
+	return &sce->body;
+}
+
+const buffer * stat_cache_body_load (stat_cache_entry * const sce, const int fd) {
+	/* read file contents from fd into memory, if within configured limits
+	 * (sce->st.st_size has already been checked by caller) */
+	++sc.body_stats.misses;
+	const off_t sz = sce->st.st_size;
+	if (sc.stat_cache_engine == STAT_CACHE_ENGINE_NONE
+	    || sc.body_stats.bytes + (uint64_t)sz > sc.body_max_total
+	    || 0 == sz)
+		return NULL;
+
+	if (-1 == lseek(fd, 0, SEEK_SET)) return NULL;
+
+	buffer * const b = &sce->body;
+	char * const ptr = buffer_string_prepare_copy(b, (size_t)sz);
+	off_t off = 0;
+	ssize_t rd;
+	do {
+		rd = read(fd, ptr+off, (size_t)(sz-off));
+	} while (rd > 0 ? (off += rd) < sz : (rd < 0 && errno == EINTR));
+	if (off != sz) { /*(error or file changed size)*/
+		free(b->ptr);
+		b->ptr = NULL;
+		b->used = b->size = 0;
+		return NULL;
+	}
+	buffer_commit(b, (size_t)sz);
+	sc.body_stats.bytes += (uint64_t)sz;
+	++sc.body_stats.entries;
+	return b;
+}
+
 int stat_cache_open_rdonly_fstat (const buffer *name, struct stat *st, int symlinks) {
 	/*(Note: O_NOFOLLOW affects only the final path segment, the target file,
 	 * not any intermediate symlinks along the path)*/
@@ -1099,41 +1362,23 @@ int stat_cache_open_rdonly_fstat (const buffer *name, struct stat *st, int symli
  * more than 2 seconds
  *
  *
- * walk though the stat-cache, collect the ids which are too old
- * and remove them in a second loop
+ * walk though the stat-cache and remove entries which are too old
+ * (backward shift deletion might move a later entry into current slot,
+ *  so current slot is examined again after deleting an entry)
  */
 
-static void stat_cache_tag_old_entries(splay_tree * const t, int * const keys, int * const ndx, const time_t max_age, const time_t cur_ts) {
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-    if (t->left)
-        stat_cache_tag_old_entries(t->left, keys, ndx, max_age, cur_ts);
-    if (t->right)
-        stat_cache_tag_old_entries(t->right, keys, ndx, max_age, cur_ts);
-    if (*ndx == 8192) return; /*(must match num array entries in keys[])*/
-
-    const stat_cache_entry * const sce = t->data;
-    if (cur_ts - sce->stat_ts > max_age)
-        keys[(*ndx)++] = t->key;
-}
-
 static void stat_cache_periodic_cleanup(const time_t max_age, const time_t cur_ts) {
-    splay_tree *sptree = sc.files;
-    int max_ndx, i;
-    int keys[8192]; /* 32k size on stack */
-    do {
-        if (!sptree) break;
-        max_ndx = 0;
-        stat_cache_tag_old_entries(sptree, keys, &max_ndx, max_age, cur_ts);
-        for (i = 0; i < max_ndx; ++i) {
-            int ndx = keys[i];
-            sptree = splaytree_splay(sptree, ndx);
-            if (sptree && sptree->key == ndx) {
-                stat_cache_entry_free(sptree->data);
-                sptree = splaytree_delete(sptree, ndx);
-            }
+    stat_cache_ht * const ht = &sc.files;
+    if (NULL == ht->slots) return;
+    for (uint32_t i = 0; i <= ht->mask; ) {
+        const stat_cache_entry * const sce = ht->slots[i].sce;
+        if (sce && cur_ts - sce->stat_ts > max_age) {
+            stat_cache_entry_free(ht->slots[i].sce);
+            stat_cache_ht_delete_slot(ht, i);
+            continue;
         }
-    } while (max_ndx == sizeof(keys)/sizeof(int));
-    sc.files = sptree;
+        ++i;
+    }
 }
 
 void stat_cache_trigger_cleanup(void) {
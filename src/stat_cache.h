@@ -10,7 +10,7 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 
-typedef struct {
+typedef struct stat_cache_entry {
     buffer name;
     time_t stat_ts;
 #ifdef HAVE_FAM_H
@@ -18,7 +18,10 @@ typedef struct {
 #endif
     buffer etag;
     buffer content_type;
+    buffer body; /* file contents cached in memory (small files) */
     struct stat st;
+    int fd;     /* cached open fd (read-only) or -1 */
+    int refcnt; /* references from stat_cache and from response chunks */
 } stat_cache_entry;
 
 __attribute_cold__
@@ -35,6 +38,24 @@ void stat_cache_free(void);
 __attribute_cold__
 void stat_cache_xattrname (const char *name);
 
+__attribute_cold__
+void stat_cache_max_entries (uint32_t max_entries);
+
+__attribute_cold__
+void stat_cache_max_fds (uint32_t max_fds);
+
+__attribute_cold__
+void stat_cache_body_max_total (uint64_t max_total);
+
+typedef struct stat_cache_body_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytes;
+    uint32_t entries;
+} stat_cache_body_stats;
+
+const stat_cache_body_stats * stat_cache_body_stats_get (void);
+
 const buffer * stat_cache_mimetype_by_ext(const array *mimetypes, const char *name, uint32_t nlen);
 #if defined(HAVE_XATTR) || defined(HAVE_EXTATTR)
 const buffer * stat_cache_mimetype_by_xattr(const char *name);
@@ -52,6 +73,10 @@ void stat_cache_invalidate_entry(const char *name, uint32_t len);
 stat_cache_entry * stat_cache_get_entry(const buffer *name);
 int stat_cache_path_contains_symlink(const buffer *name, log_error_st *errh);
 int stat_cache_open_rdonly_fstat (const buffer *name, struct stat *st, int symlinks);
+int stat_cache_entry_open (stat_cache_entry *sce, int symlinks);
+const buffer * stat_cache_body_get (stat_cache_entry *sce);
+const buffer * stat_cache_body_load (stat_cache_entry *sce, int fd);
+void stat_cache_entry_refchg (void *data, int mod);
 
 void stat_cache_trigger_cleanup(void);
 #endif
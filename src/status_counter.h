@@ -7,6 +7,8 @@
 static inline
 int *status_counter_get_counter(const char *s, size_t len);
 static inline
+int *status_counter_register(const char *s, size_t len);
+static inline
 void status_counter_inc(const char *s, size_t len);
 static inline
 void status_counter_dec(const char *s, size_t len);
@@ -23,6 +25,16 @@ int *status_counter_get_counter(const char *s, size_t len) {
     return array_get_int_ptr(&plugin_stats, s, len);
 }
 
+/* resolve counter once (e.g. at config time) and then update it directly
+ * through the returned pointer; counters are never removed from plugin_stats,
+ * so the pointer remains valid until plugins_free() */
+__attribute_cold__
+__attribute_returns_nonnull__
+static inline
+int *status_counter_register(const char *s, size_t len) {
+    return array_get_int_ptr(&plugin_stats, s, len);
+}
+
 static inline
 void status_counter_inc(const char *s, size_t len) {
     ++(*array_get_int_ptr(&plugin_stats, s, len));
@@ -38,5 +50,70 @@ void status_counter_set(const char *s, size_t len, int val) {
     *array_get_int_ptr(&plugin_stats, s, len) = val;
 }
 
+/* latency histograms
+ * (fixed log2 buckets in microseconds; bucket i counts samples <= 2^(i+6) us
+ *  not counted in a lower bucket (OpenMetrics "le"), i.e. 64us .. ~33.5s,
+ *  and the last bucket counts everything larger)
+ * Samples are taken only if r->conf.high_precision_timestamps is enabled,
+ * since request start time is otherwise not recorded with sub-second
+ * precision.  mod_status enables high precision timestamps (server-wide) if
+ * status.metrics-url is configured. */
+
+#include <time.h>       /* (struct timespec) */
+#include "log.h"        /* log_clock_gettime_realtime() */
+
+#define STATUS_HIST_BUCKETS 21
+
+typedef struct status_histogram {
+    uint64_t count;
+    uint64_t sum;                          /* usec */
+    uint64_t bucket[STATUS_HIST_BUCKETS];  /* (not cumulative) */
+} status_histogram;
+
+typedef enum {
+    STATUS_HIST_REQUEST,          /* request start to request done */
+    STATUS_HIST_TTFB,             /* request start to response headers */
+    STATUS_HIST_BACKEND_CONNECT,  /* gw backend connect() to connected */
+    STATUS_HIST_BACKEND_RESPONSE, /* gw backend connected to response end */
+    /* request phases (recorded by mod_status when request is done) */
+    STATUS_HIST_PHASE_READ_HEADER,/* request start to headers received */
+    STATUS_HIST_PHASE_HANDLE,     /* headers received to response start */
+    STATUS_HIST_PHASE_BACKEND,    /* waiting on backend (r->backend_usec) */
+    STATUS_HIST_PHASE_WRITE,      /* response start to request done */
+    STATUS_HIST_MAX
+} status_histogram_id;
+
+extern status_histogram status_histograms[STATUS_HIST_MAX];
+
+static inline
+void status_histogram_add(status_histogram * const h, const uint64_t usec) {
+    uint32_t i = 0;
+    for (uint64_t v = usec ? (usec - 1) >> 6 : 0;
+         v && i < STATUS_HIST_BUCKETS-1; v >>= 1) ++i;
+    ++h->bucket[i];
+    ++h->count;
+    h->sum += usec;
+}
+
+static inline
+uint64_t status_histogram_elapsed(const struct timespec * const ts, const struct timespec * const now) {
+    /* (realtime clock might be stepped backwards; count as 0) */
+    const int64_t usec = (int64_t)(now->tv_sec - ts->tv_sec) * 1000000
+                       + (now->tv_nsec - ts->tv_nsec) / 1000;
+    return usec > 0 ? (uint64_t)usec : 0;
+}
+
+/* record sample from ts until now; now is returned in *now (may be ts)
+ * returns sample (usec) */
+static inline
+uint64_t status_histogram_add_since(const status_histogram_id id, const struct timespec * const ts, struct timespec * const now) {
+    struct timespec t;
+    log_clock_gettime_realtime(&t);
+    const uint64_t usec = status_histogram_elapsed(ts, &t);
+    status_histogram_add(status_histograms+id, usec);
+    *now = t;
+    return usec;
+}
+
 
 #endif
@@ -0,0 +1,112 @@
+#include "first.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "array.h"
+#include "buffer.h"
+
+/* benchmark compiled array_trie against linear array_match_*() scan
+ * (not run as part of test suite)
+ *
+ * usage: bench_array_trie [iterations]
+ */
+
+static double bench_elapsed (const struct timespec * const ts) {
+    struct timespec te;
+    clock_gettime(CLOCK_MONOTONIC, &te);
+    return (double)(te.tv_sec - ts->tv_sec)
+         + (double)(te.tv_nsec - ts->tv_nsec) / 1000000000.0;
+}
+
+static void bench_prefix (const uint32_t n, const uint32_t iter) {
+    /* url.alias-like list: "/dir<n>/" (url path probes hit last third) */
+    array * const a = array_init(n);
+    char s[64];
+    for (uint32_t i = 0; i < n; ++i) {
+        const int len = snprintf(s, sizeof(s), "/dir%u/", i);
+        array_set_key_value(a, s, (uint32_t)len, CONST_STR_LEN("/srv"));
+    }
+    buffer * const b[4] = { buffer_init(), buffer_init(),
+                            buffer_init(), buffer_init() };
+    for (uint32_t j = 0; j < 4; ++j) {
+        const int len = snprintf(s, sizeof(s), "/dir%u/sub/file.html",
+                                 j < 3 ? n - 1 - j * (n / 3) : n + 1);
+        buffer_copy_string_len(b[j], s, (uint32_t)len);
+    }
+
+    array_trie * const t =
+      array_trie_init(a, ARRAY_TRIE_KEY|ARRAY_TRIE_PREFIX|ARRAY_TRIE_NOCASE);
+
+    uintptr_t x = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (uint32_t i = 0; i < iter; ++i)
+        x += (uintptr_t)array_match_key_prefix(a, b[i & 3]);
+    const double linear = bench_elapsed(&ts);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (uint32_t i = 0; i < iter; ++i)
+        x -= (uintptr_t)array_trie_match_key(t, CONST_BUF_LEN(b[i & 3]), 0);
+    const double trie = bench_elapsed(&ts);
+
+    printf("prefix keys %5u: linear %8.1f ns  trie %8.1f ns%s\n", n,
+           linear * 1e9 / iter, trie * 1e9 / iter, x ? "  MISMATCH" : "");
+
+    array_trie_free(t);
+    for (uint32_t j = 0; j < 4; ++j) buffer_free(b[j]);
+    array_free(a);
+}
+
+static void bench_suffix (const uint32_t n, const uint32_t iter) {
+    /* url.access-deny-like list: ".ext<n>" */
+    array * const a = array_init(n);
+    char s[64];
+    for (uint32_t i = 0; i < n; ++i) {
+        const int len = snprintf(s, sizeof(s), ".ext%u", i);
+        array_insert_value(a, s, (uint32_t)len);
+    }
+    buffer * const b[4] = { buffer_init(), buffer_init(),
+                            buffer_init(), buffer_init() };
+    for (uint32_t j = 0; j < 4; ++j) {
+        const int len = snprintf(s, sizeof(s), "/some/path/file.EXT%u",
+                                 j < 3 ? n - 1 - j * (n / 3) : n + 1);
+        buffer_copy_string_len(b[j], s, (uint32_t)len);
+    }
+
+    array_trie * const t =
+      array_trie_init(a, ARRAY_TRIE_VALUE|ARRAY_TRIE_SUFFIX|ARRAY_TRIE_NOCASE);
+
+    uintptr_t x = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (uint32_t i = 0; i < iter; ++i)
+        x += (uintptr_t)array_match_value_suffix_nc(a, b[i & 3]);
+    const double linear = bench_elapsed(&ts);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (uint32_t i = 0; i < iter; ++i)
+        x -= (uintptr_t)array_trie_match_value(t, CONST_BUF_LEN(b[i & 3]), 1);
+    const double trie = bench_elapsed(&ts);
+
+    printf("suffix vals %5u: linear %8.1f ns  trie %8.1f ns%s\n", n,
+           linear * 1e9 / iter, trie * 1e9 / iter, x ? "  MISMATCH" : "");
+
+    array_trie_free(t);
+    for (uint32_t j = 0; j < 4; ++j) buffer_free(b[j]);
+    array_free(a);
+}
+
+int main (int argc, char *argv[]) {
+    const uint32_t iter = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10)
+                                   : 1000000;
+    if (0 == iter) return 1;
+    static const uint32_t sizes[] = { 4, 8, 16, 32, 64, 256, 1024 };
+    for (uint32_t i = 0; i < sizeof(sizes)/sizeof(*sizes); ++i)
+        bench_prefix(sizes[i], iter);
+    for (uint32_t i = 0; i < sizeof(sizes)/sizeof(*sizes); ++i)
+        bench_suffix(sizes[i], iter);
+    return 0;
+}
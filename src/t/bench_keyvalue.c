@@ -0,0 +1,183 @@
+#include "first.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "keyvalue.c"
+
+/* benchmark url.rewrite/url.redirect rule list matching with literal
+ * prefilter against sequential regex execution of every rule
+ * (not run as part of test suite)
+ *
+ * usage: bench_keyvalue [iterations]
+ */
+
+#if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
+
+static double bench_elapsed (const struct timespec * const ts) {
+    struct timespec te;
+    clock_gettime(CLOCK_MONOTONIC, &te);
+    return (double)(te.tv_sec - ts->tv_sec)
+         + (double)(te.tv_nsec - ts->tv_nsec) / 1000000000.0;
+}
+
+static int bench_sequential (const pcre_keyvalue_buffer *kvb, pcre_keyvalue_ctx *ctx, const buffer *input, buffer *result) {
+    /* (pcre_keyvalue_buffer_process() without prefilter) */
+    for (int i = 0, used = (int)kvb->used; i < used; ++i) {
+        const pcre_keyvalue * const kv = kvb->kv+i;
+      #ifdef HAVE_PCRE2_H
+        int n = pcre2_match(kv->code, (PCRE2_SPTR)CONST_BUF_LEN(input),
+                            0, 0, kv->match_data, NULL);
+        if (n < 0) continue;
+        pcre_keyvalue_buffer_subst(result, &kv->value, input->ptr,
+                                   pcre2_get_ovector_pointer(kv->match_data),
+                                   n, ctx);
+      #else
+        int ovec[60];
+        int n = pcre_exec(kv->key, kv->key_extra, CONST_BUF_LEN(input),
+                          0, 0, ovec, sizeof(ovec)/sizeof(int));
+        if (n < 0) continue;
+        pcre_keyvalue_buffer_subst(result, &kv->value, input->ptr, ovec, n, ctx);
+      #endif
+        return i;
+    }
+    return -1;
+}
+
+static void bench_rules (const char *name, pcre_keyvalue_buffer * const kvb, const char * const * const urls, const uint32_t nurls, const uint32_t iter) {
+    buffer * const input = buffer_init();
+    buffer * const result = buffer_init();
+    pcre_keyvalue_ctx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int x = 0;
+
+    for (uint32_t j = 0; j < nurls; ++j) {
+        buffer_copy_string(input, urls[j]);
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        for (uint32_t i = 0; i < iter; ++i)
+            x += bench_sequential(kvb, &ctx, input, result);
+        const double seq = bench_elapsed(&ts);
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        for (uint32_t i = 0; i < iter; ++i) {
+            ctx.m = -1;
+            pcre_keyvalue_buffer_process(kvb, &ctx, input, result);
+            x -= ctx.m;
+        }
+        const double pf = bench_elapsed(&ts);
+
+        printf("%-9s %4u rules  %-32s sequential %9.1f ns  prefilter %8.1f ns\n",
+               name, kvb->used, urls[j],
+               seq * 1e9 / iter, pf * 1e9 / iter);
+    }
+    if (x) printf("MISMATCH\n");
+
+    buffer_free(input);
+    buffer_free(result);
+}
+
+static pcre_keyvalue_buffer * bench_kvb (const buffer * const kv, const uint32_t n) {
+    /* (kv strings must persist for pcre_keyvalue_buffer_append()) */
+    pcre_keyvalue_buffer * const kvb = pcre_keyvalue_buffer_init();
+    log_error_st * const errh = log_error_st_init();
+    for (uint32_t i = 0; i < n; i += 2) {
+        if (!pcre_keyvalue_buffer_append(errh, kvb, kv+i, kv+i+1))
+            exit(1);
+    }
+    log_error_st_free(errh);
+    return kvb;
+}
+
+static buffer * bench_strings (const uint32_t n) {
+    buffer * const kv = calloc(n, sizeof(buffer));
+    if (NULL == kv) exit(1);
+    return kv;
+}
+
+static void bench_redirect_map (const uint32_t n, const uint32_t iter) {
+    /* site migration: list of old URL -> new URL redirects */
+    buffer * const kv = bench_strings(n * 2);
+    char s[128];
+    for (uint32_t i = 0; i < n; ++i) {
+        int len = snprintf(s, sizeof(s),
+          "^/%s/%u-old-article-title(?:\\?(.*))?$",
+          (i & 1) ? "news" : "blog", i);
+        buffer_copy_string_len(kv+i*2, s, (uint32_t)len);
+        len = snprintf(s, sizeof(s), "/articles/%u?$1", i);
+        buffer_copy_string_len(kv+i*2+1, s, (uint32_t)len);
+    }
+    pcre_keyvalue_buffer * const kvb = bench_kvb(kv, n * 2);
+
+    char u[3][64];
+    snprintf(u[0], sizeof(u[0]), "/blog/%u-old-article-title", n / 2 & ~1u);
+    snprintf(u[1], sizeof(u[1]), "/news/%u-old-article-title?a=b", (n-1)|1);
+    const char * const urls[] = { u[0], u[1], "/about/", "/images/logo.png" };
+    bench_rules("redirect", kvb, urls, sizeof(urls)/sizeof(*urls), iter);
+
+    pcre_keyvalue_buffer_free(kvb);
+    for (uint32_t i = 0; i < n * 2; ++i) free(kv[i].ptr);
+    free(kv);
+}
+
+static void bench_front_controller (const uint32_t iter) {
+    /* typical application rule list (static bypass, API, front controller) */
+    static const char * const rules[] = {
+      "^/favicon\\.ico$",               "$0",
+      "^/robots\\.txt$",                "$0",
+      "^/static/(.*)$",                 "$0",
+      "^/assets/(.*)\\.(?:css|js)$",    "$0",
+      "^/uploads/(.*)\\.jpe?g$",        "$0",
+      "\\.(?:png|gif|svg|woff2?)$",     "$0",
+      "^/api/v1/users/([0-9]+)$",       "/api.php?v=1&user=$1",
+      "^/api/v1/orders/([0-9]+)$",      "/api.php?v=1&order=$1",
+      "^/api/v1/(.*)$",                 "/api.php?v=1&path=$1",
+      "^/api/v2/(.*)$",                 "/api.php?v=2&path=$1",
+      "^/admin/(.*)$",                  "/admin/index.php?path=$1",
+      "^/wp-admin/(.*)$",               "/wp-admin/$1",
+      "^/wp-content/(.*)$",             "/wp-content/$1",
+      "^/feed/?$",                      "/index.php?feed=rss2",
+      "^/sitemap\\.xml$",               "/sitemap.php",
+      "^/(?:de|fr|es)/(.*)$",           "/index.php?path=$1",
+      "^/(.*)\\.php$",                  "$0",
+      "^/([^?]*)(?:\\?(.*))?$",         "/index.php?path=$1&$2",
+    };
+    const uint32_t n = sizeof(rules)/sizeof(*rules);
+    buffer * const kv = bench_strings(n);
+    for (uint32_t i = 0; i < n; ++i)
+        buffer_copy_string(kv+i, rules[i]);
+    pcre_keyvalue_buffer * const kvb = bench_kvb(kv, n);
+
+    static const char * const urls[] = {
+      "/static/css/site.css", "/api/v2/items/7", "/sitemap.xml",
+      "/2020/05/a-post-title/?c=1"
+    };
+    bench_rules("frontctl", kvb, urls, sizeof(urls)/sizeof(*urls), iter);
+
+    pcre_keyvalue_buffer_free(kvb);
+    for (uint32_t i = 0; i < n; ++i) free(kv[i].ptr);
+    free(kv);
+}
+
+int main (int argc, char *argv[]) {
+    const uint32_t iter = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10)
+                                   : 100000;
+    if (0 == iter) return 1;
+    bench_front_controller(iter);
+    static const uint32_t sizes[] = { 10, 30, 100, 300, 1000 };
+    for (uint32_t i = 0; i < sizeof(sizes)/sizeof(*sizes); ++i)
+        bench_redirect_map(sizes[i], iter);
+    return 0;
+}
+
+#else
+
+int main (void) {
+    fprintf(stderr, "pcre support is missing\n");
+    return 1;
+}
+
+#endif
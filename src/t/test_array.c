@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "array.h"
 #include "buffer.h"
@@ -63,10 +64,74 @@ static void test_array_set_key_value (void) {
     array_free(a);
 }
 
+static void test_array_trie_check (const array * const a, const int flags) {
+    static const char * const probes[] = {
+      "", "/", "/a", "/ab", "/abc", "/abcd", "/ABC", "/Abc/def", "/x/y/z",
+      "/index.html", "/index.HTML", "/index.htm", "/f.tar.gz", "/f.GZ",
+      "/cgi-bin/x.pl", "/CGI-BIN/x.pl", "/static/img/a.png", "/static/",
+      "/Static/js/app.js", ".js", "js", "/\xff\xfe", "/\xffz"
+    };
+    array_trie * const t = array_trie_init(a, flags);
+    assert(t->a == a);
+    for (uint32_t i = 0; i < sizeof(probes)/sizeof(*probes); ++i) {
+        buffer * const b = buffer_init_string(probes[i]);
+        for (int nc = 0; nc <= 1; ++nc) {
+            const void *x;
+            const void *y;
+            if (flags & ARRAY_TRIE_VALUE) {
+                x = (flags & ARRAY_TRIE_SUFFIX)
+                  ? (nc ? array_match_value_suffix_nc(a, b)
+                        : array_match_value_suffix(a, b))
+                  : (nc ? array_match_value_prefix_nc(a, b)
+                        : array_match_value_prefix(a, b));
+                y = array_trie_match_value(t, CONST_BUF_LEN(b), nc);
+            }
+            else {
+                x = (flags & ARRAY_TRIE_SUFFIX)
+                  ? (nc ? array_match_key_suffix_nc(a, b)
+                        : array_match_key_suffix(a, b))
+                  : (nc ? array_match_key_prefix_nc(a, b)
+                        : array_match_key_prefix(a, b));
+                y = array_trie_match_key(t, CONST_BUF_LEN(b), nc);
+            }
+            assert(x == y);
+        }
+        buffer_free(b);
+    }
+    array_trie_free(t);
+}
+
+static void test_array_trie (void) {
+    /* (order matters; first match in array order, not longest match) */
+    static const char * const strs[] = {
+      "/abc", "/ab", "/ABCD", "/cgi-bin/", "/static/img/", "/static/",
+      ".html", ".HTM", ".gz", ".tar.gz", ".js", "/a", "/\xff",
+      "/x/y/z", "/x/", "/index.html", "/abcd", ".pl", "/Static/js/"
+    };
+    const uint32_t n = sizeof(strs)/sizeof(*strs);
+    array * const k = array_init(0);
+    array * const v = array_init(0);
+    for (uint32_t i = 0; i < n; ++i) {
+        array_set_key_value(k, strs[i], strlen(strs[i]), CONST_STR_LEN(""));
+        array_insert_value(v, strs[i], strlen(strs[i]));
+        for (int flags = 0; flags < 8; ++flags) {
+            /* linear below ARRAY_TRIE_LINEAR_MAX, compiled trie above */
+            test_array_trie_check((flags & ARRAY_TRIE_VALUE) ? v : k, flags);
+        }
+    }
+    /* empty element matches every string */
+    array_insert_value(v, CONST_STR_LEN(""));
+    for (int flags = ARRAY_TRIE_VALUE; flags < 8; flags += 2)
+        test_array_trie_check(v, flags);
+    array_free(k);
+    array_free(v);
+}
+
 int main() {
     test_array_get_int_ptr();
     test_array_insert_value();
     test_array_set_key_value();
+    test_array_trie();
 
     return 0;
 }
@@ -7,6 +7,8 @@
 
 #include "configfile-glue.c"
 
+array plugin_stats; /* (status_counter.h) */
+
 const struct {
     const char *string;
     const char *rmtstr;
@@ -72,8 +74,287 @@ static void test_configfile_addrbuf_eq_remote_ip_mask (void) {
 	log_error_st_free(r.conf.errh);
 }
 
+static data_config * test_config_cond (array * const a, data_config * const parent, data_config * const prev, const comp_key_t comp, const config_cond_t cond, const char * const comp_key, const char * const str) {
+	data_config * const dc = data_config_init();
+	dc->context_ndx = (int)a->used;
+	dc->comp = comp;
+	dc->cond = cond;
+	dc->parent = parent;
+	dc->prev = prev;
+	if (prev) prev->next = dc;
+	buffer_copy_string(dc->comp_key, comp_key);
+	if (str) buffer_copy_string(&dc->string, str);
+	if (parent) vector_config_weak_push(&parent->children, dc);
+	if (a->used == a->size) {
+		a->size += 16;
+		a->data = realloc(a->data, a->size * sizeof(*a->data));
+		force_assert(a->data);
+	}
+	a->data[a->used++] = (data_unset *)dc;
+	return dc;
+}
+
+static void test_configfile_cond_index (void) {
+	/* config_context (not sorted; only data[] and used are accessed) */
+	array a;
+	memset(&a, 0, sizeof(a));
+	data_config * const root =
+	  test_config_cond(&a, NULL, NULL, COMP_UNSET, CONFIG_COND_UNSET, "", NULL);
+
+	/* $HTTP["host"] == "h<n>.example.org" { ... } (indexed group)
+	 * h2 contains an indexed group of $HTTP["url"] == "/p<n>" conditions,
+	 * h3 has an else-branch, h12 duplicates h5, and a "host:port" sibling
+	 * condition is evaluated on its own (not indexed) */
+	data_config *host[13], *url[10], *h3else, *hostport;
+	char s[32];
+	for (int i = 0; i < 13; ++i) {
+		snprintf(s, sizeof(s), "h%d.example.org", i == 12 ? 5 : i);
+		host[i] = test_config_cond(&a, root, NULL, COMP_HTTP_HOST,
+		                           CONFIG_COND_EQ, "HTTP[\"host\"]", s);
+		if (2 == i) {
+			for (int j = 0; j < 10; ++j) {
+				snprintf(s, sizeof(s), "/p%d", j);
+				url[j] = test_config_cond(&a, host[2], NULL, COMP_HTTP_URL,
+				                          CONFIG_COND_EQ, "HTTP[\"url\"]", s);
+			}
+		}
+		if (3 == i)
+			h3else = test_config_cond(&a, root, host[3], COMP_HTTP_HOST,
+			                          CONFIG_COND_ELSE, "HTTP[\"host\"]", "");
+	}
+	hostport = test_config_cond(&a, root, NULL, COMP_HTTP_HOST, CONFIG_COND_EQ,
+	                            "HTTP[\"host\"]", "h1.example.org:8080");
+
+	config_cond_index_build(&a);
+	config_reference.data = (const data_config * const *)a.data;
+	config_reference.used = a.used;
+
+	assert(NULL != host[0]->cond_index);
+	assert(host[0]->cond_index == host[12]->cond_index);
+	assert(13 == host[0]->cond_index->used);
+	assert(NULL != url[0]->cond_index);
+	assert(host[0]->cond_index != url[0]->cond_index);
+	assert(NULL == hostport->cond_index);
+	assert(NULL == h3else->cond_index);
+
+	request_st r;
+	connection con;
+	server_socket srv_socket;
+	memset(&r, 0, sizeof(request_st));
+	memset(&con, 0, sizeof(connection));
+	memset(&srv_socket, 0, sizeof(server_socket));
+	r.con = &con;
+	con.srv_socket = &srv_socket;
+	con.dst_addr_buf = buffer_init();
+	r.tmp_buf = buffer_init();
+	r.conf.errh = log_error_st_init();
+	r.conf.errh->errorlog_fd = -1; /* (disable) */
+	r.cond_cache = calloc(a.used, sizeof(cond_cache_t));
+	force_assert(r.cond_cache);
+	r.conditional_is_valid = (1 << COMP_HTTP_HOST) | (1 << COMP_HTTP_URL);
+	sock_addr_inet_pton(&srv_socket.addr, "127.0.0.1", AF_INET, 80);
+
+	/* hit in indexed group (including duplicate), and else-branch */
+	buffer_copy_string(&r.uri.authority, "h5.example.org");
+	buffer_copy_string(&r.uri.path, "/p7");
+	config_cond_cache_reset(&r);
+	assert(!config_check_cond(&r, host[0]->context_ndx));
+	assert(config_check_cond(&r, host[5]->context_ndx));
+	assert(config_check_cond(&r, host[12]->context_ndx));
+	assert(!config_check_cond(&r, host[11]->context_ndx));
+	assert(config_check_cond(&r, h3else->context_ndx));
+	assert(!config_check_cond(&r, hostport->context_ndx));
+	/* nested group under non-matching indexed condition */
+	assert(!config_check_cond(&r, url[7]->context_ndx));
+
+	/* miss falls through to else-branch */
+	buffer_copy_string(&r.uri.authority, "nomatch.example.org");
+	config_cond_cache_reset(&r);
+	assert(config_check_cond(&r, h3else->context_ndx));
+	for (int i = 0; i < 13; ++i)
+		assert(!config_check_cond(&r, host[i]->context_ndx));
+	assert(!config_check_cond(&r, hostport->context_ndx));
+
+	/* nested indexed group under matching indexed condition */
+	buffer_copy_string(&r.uri.authority, "h2.example.org");
+	config_cond_cache_reset(&r);
+	assert(config_check_cond(&r, url[7]->context_ndx));
+	assert(!config_check_cond(&r, url[6]->context_ndx));
+	assert(config_check_cond(&r, host[2]->context_ndx));
+	assert(!config_check_cond(&r, host[3]->context_ndx));
+	assert(config_check_cond(&r, h3else->context_ndx));
+
+	/* reset of host conditions re-resolves indexed group;
+	 * results of nested url conditions are recalculated */
+	buffer_copy_string(&r.uri.authority, "h3.example.org");
+	config_cond_cache_reset_item(&r, COMP_HTTP_HOST);
+	assert(!config_check_cond(&r, url[7]->context_ndx));
+	assert(!config_check_cond(&r, host[2]->context_ndx));
+	assert(config_check_cond(&r, host[3]->context_ndx));
+	assert(!config_check_cond(&r, h3else->context_ndx));
+	buffer_copy_string(&r.uri.authority, "h2.example.org");
+	buffer_copy_string(&r.uri.path, "/p9");
+	config_cond_cache_reset_item(&r, COMP_HTTP_HOST);
+	config_cond_cache_reset_item(&r, COMP_HTTP_URL);
+	assert(!config_check_cond(&r, url[7]->context_ndx));
+	assert(config_check_cond(&r, url[9]->context_ndx));
+
+	/* request host with :port matches indexed "host" conditions;
+	 * "host:port" condition matches host with server port appended */
+	buffer_copy_string(&r.uri.authority, "h1.example.org:8080");
+	config_cond_cache_reset(&r);
+	assert(config_check_cond(&r, host[1]->context_ndx));
+	assert(config_check_cond(&r, hostport->context_ndx));
+	assert(!config_check_cond(&r, host[0]->context_ndx));
+	buffer_copy_string(&r.uri.authority, "h1.example.org");
+	config_cond_cache_reset(&r);
+	assert(!config_check_cond(&r, hostport->context_ndx));
+	assert(config_check_cond(&r, host[1]->context_ndx));
+	sock_addr_inet_pton(&srv_socket.addr, "127.0.0.1", AF_INET, 8080);
+	config_cond_cache_reset(&r);
+	assert(config_check_cond(&r, hostport->context_ndx));
+	assert(config_check_cond(&r, host[1]->context_ndx));
+
+	free(r.cond_cache);
+	free(r.uri.authority.ptr);
+	free(r.uri.path.ptr);
+	buffer_free(r.tmp_buf);
+	buffer_free(con.dst_addr_buf);
+	log_error_st_free(r.conf.errh);
+
+	config_cond_index_free(&a);
+	assert(NULL == host[12]->cond_index);
+	memset(&config_reference, 0, sizeof(config_reference));
+	for (uint32_t i = 0; i < a.used; ++i)
+		a.data[i]->fn->free(a.data[i]);
+	free(a.data);
+}
+
+typedef struct {
+	PLUGIN_DATA;
+	unsigned int conf; /* (bit per true condition) */
+} test_plugin_data;
+
+static unsigned int test_plugin_patch_config (request_st * const r, test_plugin_data * const p) {
+	/* same pattern as mod_*_patch_config() */
+	if (config_plugin_snapshot_load(r, p, &p->conf, sizeof(p->conf)))
+		return p->conf;
+	p->conf = 0;
+	for (int i = 1, used = p->nconfig; i < used; ++i) {
+		if (config_check_cond(r, (uint32_t)p->cvlist[i].k_id))
+			p->conf |= 1u << i;
+	}
+	config_plugin_snapshot_save(p, &p->conf);
+	return p->conf;
+}
+
+static void test_configfile_plugin_snapshot (void) {
+	array a;
+	memset(&a, 0, sizeof(a));
+	data_config * const root =
+	  test_config_cond(&a, NULL, NULL, COMP_UNSET, CONFIG_COND_UNSET, "", NULL);
+	/* $HTTP["url"] == "/a", $HTTP["url"] == "/b",
+	 * and (CONFIG_SNAPSHOT_NMAX+2) $HTTP["url"] != "/x" conditions */
+	data_config *ua, *ub, *ux[CONFIG_SNAPSHOT_NMAX+2];
+	ua = test_config_cond(&a, root, NULL, COMP_HTTP_URL, CONFIG_COND_EQ,
+	                      "HTTP[\"url\"]", "/a");
+	ub = test_config_cond(&a, root, NULL, COMP_HTTP_URL, CONFIG_COND_EQ,
+	                      "HTTP[\"url\"]", "/b");
+	for (int i = 0; i < CONFIG_SNAPSHOT_NMAX+2; ++i)
+		ux[i] = test_config_cond(&a, root, NULL, COMP_HTTP_URL,
+		                         CONFIG_COND_NE, "HTTP[\"url\"]", "/x");
+	config_reference.data = (const data_config * const *)a.data;
+	config_reference.used = a.used;
+
+	/* plugin with conditions on "/a", "/b", and 1 "!= /x" */
+	config_plugin_value_t cva[4];
+	memset(cva, 0, sizeof(cva));
+	cva[1].k_id = ua->context_ndx;
+	cva[2].k_id = ub->context_ndx;
+	cva[3].k_id = ux[0]->context_ndx;
+	test_plugin_data pa;
+	memset(&pa, 0, sizeof(pa));
+	pa.nconfig = 4;
+	pa.cvlist = cva;
+
+	/* plugin with (CONFIG_SNAPSHOT_NMAX+2) "!= /x" conditions */
+	config_plugin_value_t cvx[CONFIG_SNAPSHOT_NMAX+3];
+	memset(cvx, 0, sizeof(cvx));
+	for (int i = 0; i < CONFIG_SNAPSHOT_NMAX+2; ++i)
+		cvx[i+1].k_id = ux[i]->context_ndx;
+	test_plugin_data px;
+	memset(&px, 0, sizeof(px));
+	px.nconfig = CONFIG_SNAPSHOT_NMAX+3;
+	px.cvlist = cvx;
+
+	request_st r;
+	memset(&r, 0, sizeof(request_st));
+	r.conf.errh = log_error_st_init();
+	r.conf.errh->errorlog_fd = -1; /* (disable) */
+	r.cond_cache = calloc(a.used, sizeof(cond_cache_t));
+	force_assert(r.cond_cache);
+	r.conditional_is_valid = (1 << COMP_HTTP_URL);
+
+	/* miss, then hit */
+	buffer_copy_string(&r.uri.path, "/a");
+	config_cond_cache_reset(&r);
+	assert(0x2 + 0x8 == test_plugin_patch_config(&r, &pa));
+	assert(NULL != pa.snapshots);
+	int * const hits =
+	  status_counter_get_counter(CONST_STR_LEN("config.snapshot.hits"));
+	int * const misses =
+	  status_counter_get_counter(CONST_STR_LEN("config.snapshot.misses"));
+	assert(0 == *hits && 1 == *misses);
+	pa.conf = 0;
+	config_cond_cache_reset(&r);
+	assert(0x2 + 0x8 == test_plugin_patch_config(&r, &pa));
+	assert(1 == *hits && 1 == *misses);
+
+	/* snapshot not used after condition cache reset with different
+	 * true conditions (and reused when conditions are true again) */
+	buffer_copy_string(&r.uri.path, "/b");
+	config_cond_cache_reset(&r);
+	assert(0x4 + 0x8 == test_plugin_patch_config(&r, &pa));
+	assert(1 == *hits && 2 == *misses);
+	buffer_copy_string(&r.uri.path, "/a");
+	config_cond_cache_reset_item(&r, COMP_HTTP_URL);
+	assert(0x2 + 0x8 == test_plugin_patch_config(&r, &pa));
+	assert(2 == *hits && 2 == *misses);
+	buffer_copy_string(&r.uri.path, "/b");
+	config_cond_cache_reset_item(&r, COMP_HTTP_URL);
+	assert(0x4 + 0x8 == test_plugin_patch_config(&r, &pa));
+	assert(3 == *hits && 2 == *misses);
+
+	/* no true conditions: defaults (not cached) */
+	buffer_copy_string(&r.uri.path, "/x");
+	config_cond_cache_reset(&r);
+	assert(0 == test_plugin_patch_config(&r, &pa));
+	assert(3 == *hits && 2 == *misses);
+
+	/* more than CONFIG_SNAPSHOT_NMAX true conditions: merged, not cached */
+	buffer_copy_string(&r.uri.path, "/a");
+	config_cond_cache_reset(&r);
+	const unsigned int all = ((1u << (CONFIG_SNAPSHOT_NMAX+2)) - 1) << 1;
+	assert(all == test_plugin_patch_config(&r, &px));
+	assert(all == test_plugin_patch_config(&r, &px));
+	assert(NULL == px.snapshots);
+	assert(3 == *hits && 2 == *misses);
+
+	free(pa.snapshots);
+	free(r.cond_cache);
+	free(r.uri.path.ptr);
+	log_error_st_free(r.conf.errh);
+	array_free_data(&plugin_stats);
+	memset(&config_reference, 0, sizeof(config_reference));
+	for (uint32_t i = 0; i < a.used; ++i)
+		a.data[i]->fn->free(a.data[i]);
+	free(a.data);
+}
+
 int main (void) {
 	test_configfile_addrbuf_eq_remote_ip_mask();
+	test_configfile_cond_index();
+	test_configfile_plugin_snapshot();
 
 	return 0;
 }
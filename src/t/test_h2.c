@@ -0,0 +1,607 @@
+#include "first.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "h2.h"
+#include "base.h"
+#include "burl.h"
+#include "chunk.h"
+#include "connections.h"    /* request_acquire() request_release() */
+#include "fdevent.h"
+#include "log.h"
+#include "request.h"
+
+/*
+ * stub functions
+ */
+
+request_st * request_acquire (connection * const con) {
+    request_st * const r = calloc(1, sizeof(request_st));
+    force_assert(r);
+    r->con = con;
+    r->conf = con->request.conf;
+    r->tmp_buf = con->request.tmp_buf;
+    r->read_queue = chunkqueue_init();
+    r->write_queue = chunkqueue_init();
+    return r;
+}
+
+void request_release (request_st * const r) {
+    chunkqueue_free(r->read_queue);
+    chunkqueue_free(r->write_queue);
+    free(r->target_orig.ptr);
+    free(r->target.ptr);
+    free(r->uri.scheme.ptr);
+    free(r->uri.authority.ptr);
+    free(r->uri.path.ptr);
+    free(r->uri.query.ptr);
+    array_free_data(&r->rqst_headers);
+    free(r);
+}
+
+int fdevent_open_cloexec (const char *pathname, int symlinks, int flags, mode_t mode) {
+    UNUSED(pathname);
+    UNUSED(symlinks);
+    UNUSED(flags);
+    UNUSED(mode);
+    return -1;
+}
+
+int fdevent_mkstemp_append (char *path) {
+    UNUSED(path);
+    return -1;
+}
+
+
+/* "GET http://www.example.org/" (static table and literals without indexing;
+ * HPACK dynamic table is not modified) */
+static const char test_h2_req[] =
+  "\x82\x86\x84\x01\x0fwww.example.org";
+
+static void test_h2_frame (connection * const con, const uint8_t type, const uint8_t flags, const uint32_t sid, const char * const payload, const uint32_t len) {
+    uint8_t s[9];
+    s[0] = (uint8_t)(len >> 16);
+    s[1] = (uint8_t)(len >> 8);
+    s[2] = (uint8_t)(len);
+    s[3] = type;
+    s[4] = flags;
+    s[5] = (uint8_t)(sid >> 24);
+    s[6] = (uint8_t)(sid >> 16);
+    s[7] = (uint8_t)(sid >> 8);
+    s[8] = (uint8_t)(sid);
+    chunkqueue_append_mem(con->read_queue, (const char *)s, sizeof(s));
+    if (len) chunkqueue_append_mem(con->read_queue, payload, len);
+}
+
+static void test_h2_priority_frame (connection * const con, const uint32_t sid, const int exclusive, const uint32_t dep, const uint32_t weight) {
+    char p[5];
+    p[0] = (char)((dep >> 24) | (exclusive ? 0x80 : 0));
+    p[1] = (char)(dep >> 16);
+    p[2] = (char)(dep >> 8);
+    p[3] = (char)(dep);
+    p[4] = (char)(weight - 1);
+    test_h2_frame(con, H2_FTYPE_PRIORITY, 0, sid, p, sizeof(p));
+}
+
+static void test_h2_headers_prio (connection * const con, const uint32_t sid, const int exclusive, const uint32_t dep, const uint32_t weight) {
+    char p[5 + sizeof(test_h2_req)-1];
+    p[0] = (char)((dep >> 24) | (exclusive ? 0x80 : 0));
+    p[1] = (char)(dep >> 16);
+    p[2] = (char)(dep >> 8);
+    p[3] = (char)(dep);
+    p[4] = (char)(weight - 1);
+    memcpy(p+5, test_h2_req, sizeof(test_h2_req)-1);
+    test_h2_frame(con, H2_FTYPE_HEADERS,
+                  H2_FLAG_END_STREAM|H2_FLAG_END_HEADERS|H2_FLAG_PRIORITY,
+                  sid, p, sizeof(p));
+}
+
+static void test_h2_headers (connection * const con, const uint32_t sid) {
+    test_h2_frame(con, H2_FTYPE_HEADERS,
+                  H2_FLAG_END_STREAM|H2_FLAG_END_HEADERS, sid,
+                  test_h2_req, sizeof(test_h2_req)-1);
+}
+
+/* collect frames sent to client (con->write_queue) */
+static uint32_t test_h2_sent (connection * const con, buffer * const b) {
+    buffer_clear(b);
+    for (const chunk *c = con->write_queue->first; c; c = c->next) {
+        force_assert(c->type == MEM_CHUNK);
+        buffer_append_string_len(b, c->mem->ptr + c->offset,
+                                 buffer_string_length(c->mem) - c->offset);
+    }
+    chunkqueue_reset(con->write_queue);
+    return buffer_string_length(b);
+}
+
+/* find n-th frame (0-based) of given type in frames collected into b */
+static const uint8_t * test_h2_sent_frame (const buffer * const b, const uint8_t type, uint32_t n) {
+    const uint8_t *s = (const uint8_t *)b->ptr;
+    const uint8_t * const end = s + buffer_string_length(b);
+    while (s + 9 <= end) {
+        const uint32_t len = ((uint32_t)s[0] << 16) | (s[1] << 8) | s[2];
+        force_assert(s + 9 + len <= end);
+        if (s[3] == type && 0 == n--) return s;
+        s += 9 + len;
+    }
+    return NULL;
+}
+
+static uint32_t test_h2_u32 (const uint8_t * const s) {
+    return ((uint32_t)s[0] << 24) | ((uint32_t)s[1] << 16)
+         | ((uint32_t)s[2] << 8) | s[3];
+}
+
+static void test_h2_check_goaway (connection * const con, buffer * const b, const request_h2error_t e) {
+    test_h2_sent(con, b);
+    const uint8_t * const s = test_h2_sent_frame(b, H2_FTYPE_GOAWAY, 0);
+    force_assert(NULL != s);
+    force_assert(test_h2_u32(s+13) == (uint32_t)e);
+    force_assert(con->h2->sent_goaway == (int32_t)e);
+}
+
+static void test_h2_check_rst_stream (connection * const con, buffer * const b, const uint32_t sid, const request_h2error_t e) {
+    test_h2_sent(con, b);
+    const uint8_t * const s = test_h2_sent_frame(b, H2_FTYPE_RST_STREAM, 0);
+    force_assert(NULL != s);
+    force_assert((test_h2_u32(s+5) & 0x7fffffff) == sid);
+    force_assert(test_h2_u32(s+9) == (uint32_t)e);
+    force_assert(NULL == test_h2_sent_frame(b, H2_FTYPE_GOAWAY, 0));
+}
+
+static void test_h2_con_init (connection * const con, server * const srv) {
+    memset(con, 0, sizeof(*con));
+    con->srv = srv;
+    con->fd = -1;
+    con->proto_default_port = 80;
+    con->read_queue = chunkqueue_init();
+    con->write_queue = chunkqueue_init();
+    request_st * const h2r = &con->request;
+    h2r->con = con;
+    h2r->tmp_buf = buffer_init();
+    h2r->conf.errh = log_error_st_init();
+    h2r->conf.errh->errorlog_fd = -1; /* (disable) */
+    h2r->conf.max_request_field_size = 8192;
+    h2r->conf.max_keep_alive_requests = 100;
+    h2r->conf.http_parseopts = HTTP_PARSEOPT_HEADER_STRICT
+                             | HTTP_PARSEOPT_HOST_STRICT
+                             | HTTP_PARSEOPT_HOST_NORMALIZE;
+    /* client connection preface "PRI * HTTP/2.0\r\n\r\n" is consumed by
+     * HTTP/1.x request parsing; remainder is parsed by h2_parse_frames() */
+    h2_init_con(h2r, con, NULL);
+    chunkqueue_append_mem(con->read_queue, CONST_STR_LEN("SM\r\n\r\n"));
+}
+
+static void test_h2_con_init_settings (connection * const con, server * const srv, buffer * const b) {
+    test_h2_con_init(con, srv);
+    test_h2_frame(con, H2_FTYPE_SETTINGS, 0, 0, NULL, 0);
+    force_assert(0 == h2_parse_frames(con));
+    test_h2_sent(con, b);
+}
+
+static void test_h2_con_free (connection * const con) {
+    h2_con_free(con);
+    chunkqueue_free(con->read_queue);
+    chunkqueue_free(con->write_queue);
+    buffer_free(con->request.tmp_buf);
+    log_error_st_free(con->request.conf.errh);
+}
+
+static void test_h2_preface_settings (server * const srv, buffer * const b) {
+    connection con;
+    const uint8_t *s;
+
+    /* server connection preface and client preface followed by SETTINGS */
+    test_h2_con_init(&con, srv);
+    test_h2_sent(&con, b);
+    s = test_h2_sent_frame(b, H2_FTYPE_SETTINGS, 0);
+    force_assert(NULL != s && 0 == s[4] && 6 == s[2]);
+    force_assert(H2_SETTINGS_MAX_CONCURRENT_STREAMS == s[10]);
+    force_assert(srv->srvconf.h2_max_concurrent_streams == test_h2_u32(s+11));
+    force_assert(NULL != test_h2_sent_frame(b, H2_FTYPE_WINDOW_UPDATE, 0));
+
+    /* partial client preface */
+    chunkqueue_reset(con.read_queue);
+    chunkqueue_append_mem(con.read_queue, CONST_STR_LEN("SM\r\n"));
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    chunkqueue_append_mem(con.read_queue, CONST_STR_LEN("\r\n"));
+    /* SETTINGS_INITIAL_WINDOW_SIZE = 1000 */
+    test_h2_frame(&con, H2_FTYPE_SETTINGS, 0, 0,
+                  "\x00\x04\x00\x00\x03\xe8", 6);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == con.h2->preface);
+    force_assert(1000 == con.h2->s_initial_window_size);
+    test_h2_sent(&con, b);
+    s = test_h2_sent_frame(b, H2_FTYPE_SETTINGS, 0);
+    force_assert(NULL != s && (s[4] & H2_FLAG_ACK) && 0 == s[2]);
+
+    /* SETTINGS ACK (from client) is not acknowledged */
+    test_h2_frame(&con, H2_FTYPE_SETTINGS, H2_FLAG_ACK, 0, NULL, 0);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+
+    /* PING is answered with PING ACK */
+    test_h2_frame(&con, H2_FTYPE_PING, 0, 0, "12345678", 8);
+    force_assert(0 == h2_parse_frames(&con));
+    test_h2_sent(&con, b);
+    s = test_h2_sent_frame(b, H2_FTYPE_PING, 0);
+    force_assert(NULL != s && (s[4] & H2_FLAG_ACK));
+    force_assert(0 == memcmp(s+9, "12345678", 8));
+
+    /* SETTINGS ACK with payload */
+    test_h2_frame(&con, H2_FTYPE_SETTINGS, H2_FLAG_ACK, 0, "\0\0\0\0\0\0", 6);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_FRAME_SIZE_ERROR);
+    test_h2_con_free(&con);
+
+    /* invalid client preface */
+    test_h2_con_init(&con, srv);
+    test_h2_sent(&con, b);
+    chunkqueue_reset(con.read_queue);
+    chunkqueue_append_mem(con.read_queue, CONST_STR_LEN("XX\r\n\r\n"));
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* first frame after client preface is not SETTINGS */
+    test_h2_con_init(&con, srv);
+    test_h2_sent(&con, b);
+    test_h2_frame(&con, H2_FTYPE_PING, 0, 0, "12345678", 8);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* first frame after client preface is SETTINGS ACK */
+    test_h2_con_init(&con, srv);
+    test_h2_sent(&con, b);
+    test_h2_frame(&con, H2_FTYPE_SETTINGS, H2_FLAG_ACK, 0, NULL, 0);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* SETTINGS length not a multiple of 6 */
+    test_h2_con_init(&con, srv);
+    test_h2_sent(&con, b);
+    test_h2_frame(&con, H2_FTYPE_SETTINGS, 0, 0, "\x00\x04\x00", 3);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_FRAME_SIZE_ERROR);
+    test_h2_con_free(&con);
+
+    /* invalid SETTINGS_ENABLE_PUSH value */
+    test_h2_con_init(&con, srv);
+    test_h2_sent(&con, b);
+    test_h2_frame(&con, H2_FTYPE_SETTINGS, 0, 0,
+                  "\x00\x02\x00\x00\x00\x02", 6);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+}
+
+static void test_h2_streams (server * const srv, buffer * const b) {
+    connection con;
+
+    /* streams up to SETTINGS_MAX_CONCURRENT_STREAMS; then REFUSED_STREAM */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_headers(&con, 1);
+    test_h2_headers(&con, 3);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    force_assert(2 == con.h2->rused);
+    request_st * const r = con.h2->r[0];
+    force_assert(1 == r->h2id);
+    force_assert(H2_STATE_HALF_CLOSED_REMOTE == r->h2state);
+    force_assert(CON_STATE_REQUEST_END == r->state);
+    force_assert(0 == r->http_status);
+    force_assert(HTTP_METHOD_GET == r->http_method);
+    force_assert(HTTP_VERSION_2 == r->http_version);
+    force_assert(buffer_eq_slen(&r->target, CONST_STR_LEN("/")));
+    force_assert(3 == con.h2->r[1]->h2id);
+    test_h2_headers(&con, 5);
+    force_assert(0 == h2_parse_frames(&con));
+    test_h2_check_rst_stream(&con, b, 5, H2_E_REFUSED_STREAM);
+    force_assert(2 == con.h2->rused);
+
+    /* stream slot is available after stream is retired */
+    h2_retire_stream(con.h2->r[0], &con);
+    force_assert(1 == con.h2->rused);
+    test_h2_headers(&con, 7);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    force_assert(2 == con.h2->rused);
+    force_assert(7 == con.h2->r[1]->h2id);
+
+    /* HEADERS on closed stream is connection error */
+    test_h2_headers(&con, 5);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* HEADERS on lower (closed) stream id is connection error */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_headers(&con, 3);
+    test_h2_headers(&con, 1);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    force_assert(1 == con.h2->rused);
+    test_h2_con_free(&con);
+
+    /* HEADERS on even (server-initiated) stream id */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_headers(&con, 2);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* DATA on idle stream */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_frame(&con, H2_FTYPE_DATA, H2_FLAG_END_STREAM, 1, "x", 1);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* frame larger than SETTINGS_MAX_FRAME_SIZE (default) */
+    test_h2_con_init_settings(&con, srv, b);
+    {
+        char *x = calloc(1, 16385);
+        force_assert(x);
+        test_h2_frame(&con, H2_FTYPE_DATA, 0, 1, x, 16385);
+        free(x);
+    }
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_FRAME_SIZE_ERROR);
+    test_h2_con_free(&con);
+
+    /* WINDOW_UPDATE with 0 increment on connection */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_frame(&con, H2_FTYPE_WINDOW_UPDATE, 0, 0, "\0\0\0\0", 4);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* PUSH_PROMISE from client */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_frame(&con, H2_FTYPE_PUSH_PROMISE, H2_FLAG_END_HEADERS, 1,
+                  "\0\0\0\2", 4);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* RST_STREAM from client closes stream */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_headers(&con, 1);
+    test_h2_frame(&con, H2_FTYPE_RST_STREAM, 0, 1, "\0\0\0\x08", 4);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(H2_STATE_CLOSED == con.h2->r[0]->h2state);
+    force_assert(CON_STATE_ERROR == con.h2->r[0]->state);
+    test_h2_con_free(&con);
+}
+
+static void test_h2_continuation (server * const srv, buffer * const b) {
+    connection con;
+
+    /* header block split across HEADERS and CONTINUATION frames */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_frame(&con, H2_FTYPE_HEADERS, H2_FLAG_END_STREAM, 1,
+                  test_h2_req, 2);
+    test_h2_frame(&con, H2_FTYPE_CONTINUATION, 0, 1,
+                  test_h2_req+2, 2);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == con.h2->rused);
+    force_assert(1 == con.h2->hsid);
+    test_h2_frame(&con, H2_FTYPE_CONTINUATION, H2_FLAG_END_HEADERS, 1,
+                  test_h2_req+4, sizeof(test_h2_req)-1-4);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    force_assert(0 == con.h2->hsid);
+    force_assert(1 == con.h2->rused);
+    force_assert(0 == con.h2->r[0]->http_status);
+    force_assert(H2_STATE_HALF_CLOSED_REMOTE == con.h2->r[0]->h2state);
+    force_assert(buffer_eq_slen(&con.h2->r[0]->target, CONST_STR_LEN("/")));
+
+    /* other frame between HEADERS and CONTINUATION */
+    test_h2_frame(&con, H2_FTYPE_HEADERS, H2_FLAG_END_STREAM, 3,
+                  test_h2_req, 2);
+    test_h2_frame(&con, H2_FTYPE_PING, 0, 0, "12345678", 8);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* CONTINUATION on different stream */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_frame(&con, H2_FTYPE_HEADERS, H2_FLAG_END_STREAM, 1,
+                  test_h2_req, 2);
+    test_h2_frame(&con, H2_FTYPE_CONTINUATION, H2_FLAG_END_HEADERS, 3,
+                  test_h2_req+2, sizeof(test_h2_req)-1-2);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* CONTINUATION without HEADERS */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_frame(&con, H2_FTYPE_CONTINUATION, H2_FLAG_END_HEADERS, 1,
+                  test_h2_req, sizeof(test_h2_req)-1);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+
+    /* HEADERS with PRIORITY and CONTINUATION */
+    test_h2_con_init_settings(&con, srv, b);
+    {
+        char p[5 + 2];
+        memcpy(p, "\0\0\0\0\x3f", 5); /* weight 64 */
+        memcpy(p+5, test_h2_req, 2);
+        test_h2_frame(&con, H2_FTYPE_HEADERS,
+                      H2_FLAG_END_STREAM|H2_FLAG_PRIORITY, 1, p, sizeof(p));
+    }
+    test_h2_frame(&con, H2_FTYPE_CONTINUATION, H2_FLAG_END_HEADERS, 1,
+                  test_h2_req+2, sizeof(test_h2_req)-1-2);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(1 == con.h2->rused);
+    force_assert(64 == con.h2->r[0]->h2_weight);
+    force_assert(0 == con.h2->r[0]->http_status);
+    test_h2_con_free(&con);
+}
+
+static void test_h2_authority (server * const srv, buffer * const b) {
+    connection con;
+    request_st *r;
+
+    /* :authority and Host with same value */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_frame(&con, H2_FTYPE_HEADERS,
+                  H2_FLAG_END_STREAM|H2_FLAG_END_HEADERS, 1,
+                  CONST_STR_LEN("\x82\x86\x84\x01\x0fwww.example.org"
+                                "\x0f\x17\x0fwww.example.org"));
+    /* :authority and Host with different value; :authority is used */
+    test_h2_frame(&con, H2_FTYPE_HEADERS,
+                  H2_FLAG_END_STREAM|H2_FLAG_END_HEADERS, 3,
+                  CONST_STR_LEN("\x82\x86\x84\x01\x0fwww.example.org"
+                                "\x0f\x17\x0dother.example"));
+    /* Host without :authority */
+    test_h2_frame(&con, H2_FTYPE_HEADERS,
+                  H2_FLAG_END_STREAM|H2_FLAG_END_HEADERS, 5,
+                  CONST_STR_LEN("\x82\x86\x84\x0f\x17\x0dother.example"));
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    force_assert(3 == con.h2->rused);
+    r = con.h2->r[0];
+    force_assert(0 == r->http_status);
+    force_assert(buffer_eq_slen(r->http_host, CONST_STR_LEN("www.example.org")));
+    r = con.h2->r[1];
+    force_assert(0 == r->http_status);
+    force_assert(buffer_eq_slen(r->http_host, CONST_STR_LEN("www.example.org")));
+    force_assert(buffer_eq_slen(&r->uri.authority,
+                                CONST_STR_LEN("www.example.org")));
+    r = con.h2->r[2];
+    force_assert(0 == r->http_status);
+    force_assert(buffer_eq_slen(r->http_host, CONST_STR_LEN("other.example")));
+    test_h2_con_free(&con);
+}
+
+static void test_h2_stream_ready (request_st * const r) {
+    r->state = CON_STATE_WRITE;
+    chunkqueue_append_mem(r->write_queue, CONST_STR_LEN("data"));
+}
+
+static void test_h2_priority (server * const srv, buffer * const b) {
+    connection con;
+    h2con *h2c;
+    request_st *r1, *r3, *r5, *r7;
+    const off_t avail = 1 << 20;
+
+    test_h2_con_init_settings(&con, srv, b);
+    h2c = con.h2;
+    test_h2_headers(&con, 1);                  /* default weight 16 */
+    test_h2_headers_prio(&con, 3, 0, 1, 201);  /* depends on 1 */
+    test_h2_headers_prio(&con, 5, 0, 0, 33);
+    test_h2_headers_prio(&con, 7, 0, 9, 64);   /* idle dependency -> root */
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    force_assert(4 == h2c->rused);
+    r1 = h2c->r[0];
+    r3 = h2c->r[1];
+    r5 = h2c->r[2];
+    r7 = h2c->r[3];
+    force_assert(16 == r1->h2_weight && 0 == r1->h2_dep);
+    force_assert(201 == r3->h2_weight && 1 == r3->h2_dep);
+    force_assert(33 == r5->h2_weight && 0 == r5->h2_dep);
+    force_assert(64 == r7->h2_weight && 0 == r7->h2_dep);
+
+    /* streams precede dependents; then ordered by weight */
+    h2_prio_order(&con);
+    force_assert(r7 == h2c->r[0]);
+    force_assert(r5 == h2c->r[1]);
+    force_assert(r1 == h2c->r[2]);
+    force_assert(r3 == h2c->r[3]);
+
+    /* DATA of dependent stream is not sent while parent has DATA to send;
+     * sibling streams share available space by weight */
+    test_h2_stream_ready(r1);
+    test_h2_stream_ready(r3);
+    test_h2_stream_ready(r5);
+    force_assert(0 == h2_send_limit(r3, &con, avail));
+    force_assert(avail / (16+33) * 16 == h2_send_limit(r1, &con, avail));
+    force_assert(avail / (16+33) * 33 == h2_send_limit(r5, &con, avail));
+    /* (r7 has no DATA to send and is not counted in share of r1 and r5) */
+    force_assert(avail / (16+33+64) * 64 == h2_send_limit(r7, &con, avail));
+    chunkqueue_reset(r1->write_queue);
+    force_assert(avail / 201 * 201 == h2_send_limit(r3, &con, avail));
+    /* (at least one frame) */
+    force_assert(16384 == h2_send_limit(r5, &con, 1024));
+    chunkqueue_append_mem(r1->write_queue, CONST_STR_LEN("data"));
+
+    /* PRIORITY: exclusive dependency on root; other streams become
+     * dependents of stream 1 */
+    test_h2_priority_frame(&con, 1, 1, 0, 256);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    force_assert(256 == r1->h2_weight && 0 == r1->h2_dep);
+    force_assert(1 == r3->h2_dep && 1 == r5->h2_dep && 1 == r7->h2_dep);
+    h2_prio_order(&con);
+    force_assert(r1 == h2c->r[0]);
+    force_assert(r3 == h2c->r[1]);
+    force_assert(r7 == h2c->r[2]);
+    force_assert(r5 == h2c->r[3]);
+    force_assert(avail / 256 * 256 == h2_send_limit(r1, &con, avail));
+    force_assert(0 == h2_send_limit(r5, &con, avail));
+
+    /* PRIORITY: dependency on own dependent; dependent is moved to the
+     * previous parent (root) (RFC 7540 5.3.3) */
+    test_h2_priority_frame(&con, 1, 0, 3, 16);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == r3->h2_dep && 3 == r1->h2_dep);
+    h2_prio_order(&con);
+    force_assert(r3 == h2c->r[0]);
+    force_assert(r1 == h2c->r[1]);
+
+    /* retired stream: dependents depend on parent of retired stream */
+    h2_retire_stream(r1, &con);
+    force_assert(3 == r5->h2_dep && 3 == r7->h2_dep);
+    h2_prio_order(&con);
+    force_assert(r3 == h2c->r[0]);
+    force_assert(r7 == h2c->r[1]);
+    force_assert(r5 == h2c->r[2]);
+
+    /* PRIORITY frame for stream depending on itself */
+    test_h2_priority_frame(&con, 5, 0, 5, 16);
+    force_assert(0 == h2_parse_frames(&con));
+    test_h2_check_rst_stream(&con, b, 5, H2_E_PROTOCOL_ERROR);
+    force_assert(CON_STATE_ERROR == r5->state);
+
+    /* PRIORITY frame with invalid length */
+    test_h2_frame(&con, H2_FTYPE_PRIORITY, 0, 7, "\0\0\0\0", 4);
+    force_assert(0 == h2_parse_frames(&con));
+    test_h2_check_rst_stream(&con, b, 7, H2_E_FRAME_SIZE_ERROR);
+
+    /* PRIORITY frame for idle stream is ignored */
+    test_h2_priority_frame(&con, 11, 0, 3, 16);
+    force_assert(0 == h2_parse_frames(&con));
+    force_assert(0 == test_h2_sent(&con, b));
+    test_h2_con_free(&con);
+
+    /* HEADERS for stream depending on itself */
+    test_h2_con_init_settings(&con, srv, b);
+    test_h2_headers_prio(&con, 1, 0, 1, 16);
+    force_assert(-1 == h2_parse_frames(&con));
+    test_h2_check_goaway(&con, b, H2_E_PROTOCOL_ERROR);
+    test_h2_con_free(&con);
+}
+
+int main (void) {
+    server srv;
+    memset(&srv, 0, sizeof(srv));
+    srv.srvconf.h2_max_concurrent_streams = 2;
+    buffer * const b = buffer_init();
+
+    test_h2_preface_settings(&srv, b);
+    test_h2_streams(&srv, b);
+    test_h2_continuation(&srv, b);
+    srv.srvconf.h2_max_concurrent_streams = 8;
+    test_h2_authority(&srv, b);
+    test_h2_priority(&srv, b);
+
+    buffer_free(b);
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "first.h"
+
+#include <string.h>
+
+#include "hpack.h"
+
+typedef struct {
+    const char *k;
+    const char *v;
+} test_field;
+
+static void check_decode (hpack_dtable * const dt, buffer * const b, hpack_fields * const f, const char * const s, const size_t len, const test_field * const t, const uint32_t n, const uint32_t size) {
+    force_assert(0 == hpack_decode(dt, (const unsigned char *)s, len, b, f, 65536));
+    force_assert(f->used == n);
+    for (uint32_t i = 0; i < n; ++i) {
+        const hpack_field * const hf = f->ptr + i;
+        force_assert(hf->klen == strlen(t[i].k));
+        force_assert(0 == memcmp(b->ptr+hf->k, t[i].k, hf->klen));
+        force_assert(hf->vlen == strlen(t[i].v));
+        force_assert(0 == memcmp(b->ptr+hf->v, t[i].v, hf->vlen));
+    }
+    force_assert(dt->size == size);
+}
+
+static void test_hpack_decode_requests (void) {
+    /* RFC 7541 C.4 Request Examples with Huffman Coding */
+    static const test_field t1[] = {
+      { ":method", "GET" }
+     ,{ ":scheme", "http" }
+     ,{ ":path", "/" }
+     ,{ ":authority", "www.example.com" }
+    };
+    static const test_field t2[] = {
+      { ":method", "GET" }
+     ,{ ":scheme", "http" }
+     ,{ ":path", "/" }
+     ,{ ":authority", "www.example.com" }
+     ,{ "cache-control", "no-cache" }
+    };
+    static const test_field t3[] = {
+      { ":method", "GET" }
+     ,{ ":scheme", "https" }
+     ,{ ":path", "/index.html" }
+     ,{ ":authority", "www.example.com" }
+     ,{ "custom-key", "custom-value" }
+    };
+    hpack_dtable dt;
+    hpack_fields f = { NULL, 0, 0 };
+    buffer * const b = buffer_init();
+    hpack_dtable_init(&dt, HPACK_DEFAULT_TABLE_SIZE);
+
+    check_decode(&dt, b, &f, CONST_STR_LEN(
+      "\x82\x86\x84\x41\x8c\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff"),
+      t1, sizeof(t1)/sizeof(*t1), 57);
+    check_decode(&dt, b, &f, CONST_STR_LEN(
+      "\x82\x86\x84\xbe\x58\x86\xa8\xeb\x10\x64\x9c\xbf"),
+      t2, sizeof(t2)/sizeof(*t2), 110);
+    check_decode(&dt, b, &f, CONST_STR_LEN(
+      "\x82\x87\x85\xbf\x40\x88\x25\xa8\x49\xe9\x5b\xa9\x7d\x7f\x89\x25"
+      "\xa8\x49\xe9\x5b\xb8\xe8\xb4\xbf"),
+      t3, sizeof(t3)/sizeof(*t3), 164);
+
+    hpack_dtable_free(&dt);
+    hpack_fields_free(&f);
+    buffer_free(b);
+}
+
+static void test_hpack_decode_responses (void) {
+    /* RFC 7541 C.6 Response Examples with Huffman Coding
+     * (dynamic table size 256 exercises eviction) */
+    static const test_field t1[] = {
+      { ":status", "302" }
+     ,{ "cache-control", "private" }
+     ,{ "date", "Mon, 21 Oct 2013 20:13:21 GMT" }
+     ,{ "location", "https://www.example.com" }
+    };
+    static const test_field t2[] = {
+      { ":status", "307" }
+     ,{ "cache-control", "private" }
+     ,{ "date", "Mon, 21 Oct 2013 20:13:21 GMT" }
+     ,{ "location", "https://www.example.com" }
+    };
+    static const test_field t3[] = {
+      { ":status", "200" }
+     ,{ "cache-control", "private" }
+     ,{ "date", "Mon, 21 Oct 2013 20:13:22 GMT" }
+     ,{ "location", "https://www.example.com" }
+     ,{ "content-encoding", "gzip" }
+     ,{ "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" }
+    };
+    hpack_dtable dt;
+    hpack_fields f = { NULL, 0, 0 };
+    buffer * const b = buffer_init();
+    hpack_dtable_init(&dt, 256);
+
+    check_decode(&dt, b, &f, CONST_STR_LEN(
+      "\x48\x82\x64\x02\x58\x85\xae\xc3\x77\x1a\x4b\x61\x96\xd0\x7a\xbe"
+      "\x94\x10\x54\xd4\x44\xa8\x20\x05\x95\x04\x0b\x81\x66\xe0\x82\xa6"
+      "\x2d\x1b\xff\x6e\x91\x9d\x29\xad\x17\x18\x63\xc7\x8f\x0b\x97\xc8"
+      "\xe9\xae\x82\xae\x43\xd3"),
+      t1, sizeof(t1)/sizeof(*t1), 222);
+    check_decode(&dt, b, &f, CONST_STR_LEN(
+      "\x48\x83\x64\x0e\xff\xc1\xc0\xbf"),
+      t2, sizeof(t2)/sizeof(*t2), 222);
+    check_decode(&dt, b, &f, CONST_STR_LEN(
+      "\x88\xc1\x61\x96\xd0\x7a\xbe\x94\x10\x54\xd4\x44\xa8\x20\x05\x95"
+      "\x04\x0b\x81\x66\xe0\x84\xa6\x2d\x1b\xff\xc0\x5a\x83\x9b\xd9\xab"
+      "\x77\xad\x94\xe7\x82\x1d\xd7\xf2\xe6\xc7\xb3\x35\xdf\xdf\xcd\x5b"
+      "\x39\x60\xd5\xaf\x27\x08\x7f\x36\x72\xc1\xab\x27\x0f\xb5\x29\x1f"
+      "\x95\x87\x31\x60\x65\xc0\x03\xed\x4e\xe5\xb1\x06\x3d\x50\x07"),
+      t3, sizeof(t3)/sizeof(*t3), 215);
+
+    hpack_dtable_free(&dt);
+    hpack_fields_free(&f);
+    buffer_free(b);
+}
+
+static void test_hpack_decode_errors (void) {
+    hpack_dtable dt;
+    hpack_fields f = { NULL, 0, 0 };
+    buffer * const b = buffer_init();
+    hpack_dtable_init(&dt, HPACK_DEFAULT_TABLE_SIZE);
+
+    /* index 0 */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\x80"), b, &f, 65536));
+    /* index beyond dynamic table */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\xbe"), b, &f, 65536));
+    /* truncated integer */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\xff\x80"), b, &f, 65536));
+    /* string length beyond block */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\x04\x05/"), b, &f, 65536));
+    /* Huffman padding not all 1 bits */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\x04\x81\x00"), b, &f, 65536));
+    /* Huffman padding longer than 7 bits */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\x04\x82\x63\xff"), b, &f, 65536));
+    /* table size update larger than limit */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\x3f\xe2\x1f"), b, &f, 65536));
+    /* table size update after header field */
+    force_assert(-1 == hpack_decode(&dt, (const unsigned char *)
+                                    CONST_STR_LEN("\x82\x20"), b, &f, 65536));
+
+    /* header list exceeds max; dynamic table updated regardless */
+    force_assert(1 == hpack_decode(&dt, (const unsigned char *)
+      CONST_STR_LEN("\x82\x40\x01k\x01v"), b, &f, 40));
+    force_assert(f.used == 0);
+    force_assert(dt.used == 1 && dt.size == 34);
+
+    hpack_dtable_free(&dt);
+    hpack_fields_free(&f);
+    buffer_free(b);
+}
+
+static void test_hpack_encode (void) {
+    static const test_field t[] = {
+      { ":status", "200" }
+     ,{ ":status", "302" }
+     ,{ "content-type", "text/html; charset=utf-8" }
+     ,{ "x-custom", "Value with UPPER case \x01\xff" }
+     ,{ "etag", "" }
+     ,{ "set-cookie", "a=1; Path=/" }
+     ,{ "set-cookie", "b=2" }
+     ,{ "set-cookie", "c=3" }
+     ,{ "vary", "Accept" }
+    };
+    hpack_dtable dt;
+    hpack_fields f = { NULL, 0, 0 };
+    buffer * const b = buffer_init();
+    buffer * const e = buffer_init();
+    hpack_dtable_init(&dt, HPACK_DEFAULT_TABLE_SIZE);
+
+    buffer_copy_string_len(e, CONST_STR_LEN(""));
+    hpack_encode_status(e, 200);
+    force_assert(buffer_is_equal_string(e, CONST_STR_LEN("\x88")));
+    hpack_encode_status(e, 302);
+    hpack_encode_field(e, CONST_STR_LEN("Content-Type"),
+                          CONST_STR_LEN("text/html; charset=utf-8"));
+    hpack_encode_field(e, CONST_STR_LEN("X-Custom"),
+                          CONST_STR_LEN("Value with UPPER case \x01\xff"));
+    hpack_encode_field(e, CONST_STR_LEN("ETag"), CONST_STR_LEN(""));
+    /* repeated header joined by http_header_response_insert() */
+    hpack_encode_field_multi(e, CONST_STR_LEN("Set-Cookie"),
+      CONST_STR_LEN("a=1; Path=/\r\nSet-Cookie: b=2\r\nset-cookie: c=3"));
+    hpack_encode_field_multi(e, CONST_STR_LEN("Vary"), CONST_STR_LEN("Accept"));
+
+    check_decode(&dt, b, &f, CONST_BUF_LEN(e), t, sizeof(t)/sizeof(*t), 0);
+
+    hpack_dtable_free(&dt);
+    hpack_fields_free(&f);
+    buffer_free(e);
+    buffer_free(b);
+}
+
+int main (void) {
+    test_hpack_decode_requests();
+    test_hpack_decode_responses();
+    test_hpack_decode_errors();
+    test_hpack_encode();
+    return 0;
+}
+
@@ -11,7 +11,7 @@
 #include "base.h"   /* struct server */
 #include "plugin_config.h" /* struct cond_match_t */
 
-#ifdef HAVE_PCRE_H
+#if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
 static pcre_keyvalue_buffer * test_keyvalue_test_kvb_init (void) {
     pcre_keyvalue_buffer *kvb = pcre_keyvalue_buffer_init();
 
@@ -117,11 +117,136 @@ static void test_keyvalue_pcre_keyvalue_buffer_process (void) {
     buffer_free(query);
     pcre_keyvalue_buffer_free(kvb);
 }
+
+static void test_keyvalue_literals_eq (const char *pattern, const char *pfx, const char *sfx) {
+    char p[PCRE_KEYVALUE_LITERAL_MAX], x[PCRE_KEYVALUE_LITERAL_MAX];
+    uint32_t plen, slen;
+    pcre_keyvalue_literals(pattern, (uint32_t)strlen(pattern), p, &plen, x, &slen);
+    assert(plen == strlen(pfx) && 0 == memcmp(p, pfx, plen));
+    assert(slen == strlen(sfx) && 0 == memcmp(x, sfx, slen));
+}
+
+static void test_keyvalue_literals (void) {
+    test_keyvalue_literals_eq("^/foo($|\\?.+)", "/foo", "");
+    test_keyvalue_literals_eq("^/bar(?:$|\\?(.+))", "/bar", "");
+    test_keyvalue_literals_eq("^(/[^?]*)(?:\\?(.*))?$", "", "");
+    test_keyvalue_literals_eq("^/foo$", "/foo", "/foo");
+    test_keyvalue_literals_eq("^/a/b\\.c\\?d=(.*)", "/a/b.c?d=", "");
+    test_keyvalue_literals_eq("\\.php$", "", ".php");
+    test_keyvalue_literals_eq("^/(.*)\\.html?$", "/", "");
+    test_keyvalue_literals_eq("^/(.*)\\.html$", "/", ".html");
+    test_keyvalue_literals_eq("^/abc?d", "/ab", "");
+    test_keyvalue_literals_eq("^/ab*", "/a", "");
+    test_keyvalue_literals_eq("^/ab{2}", "/a", "");
+    test_keyvalue_literals_eq("^/ab+c", "/ab", "");
+    test_keyvalue_literals_eq("^/a[]b]c$", "/a", "c");
+    test_keyvalue_literals_eq("^/a[[:alpha:]]x$", "/a", "x");
+    test_keyvalue_literals_eq("^/a\\d12$", "/a", "");
+    test_keyvalue_literals_eq("^/a\\x{41}b$", "/a", "b");
+    test_keyvalue_literals_eq("^/a\\k<n>$", "/a", "");
+    test_keyvalue_literals_eq("^/a(b|c)d$", "/a", "d");
+    test_keyvalue_literals_eq("^/a$x", "/a", "");
+    /* not prefiltered */
+    test_keyvalue_literals_eq("^/a|^/b", "", "");
+    test_keyvalue_literals_eq("(?i)^/abc$", "", "");
+    test_keyvalue_literals_eq("^/a(?i)bc$", "", "");
+    test_keyvalue_literals_eq("^/a\\Q(\\E|x", "", "");
+    test_keyvalue_literals_eq("^/a[\\Q](\\E]|x", "", "");
+    test_keyvalue_literals_eq("^/a\\c(|x", "", "");
+    test_keyvalue_literals_eq("(*CR)^/a$", "", "");
+    /* literals longer than limit are truncated */
+    test_keyvalue_literals_eq("^/0123456789012345678901234567890123456789$",
+                              "/0123456789012345678901234567890",
+                              "89012345678901234567890123456789");
+}
+
+static int test_keyvalue_match_linear (const pcre_keyvalue_buffer *kvb, const buffer *input) {
+    for (uint32_t i = 0; i < kvb->used; ++i) {
+        const pcre_keyvalue * const kv = kvb->kv+i;
+      #ifdef HAVE_PCRE2_H
+        if (pcre2_match(kv->code, (PCRE2_SPTR)CONST_BUF_LEN(input),
+                        0, 0, kv->match_data, NULL) >= 0)
+            return (int)i;
+      #else
+        int ovec[30];
+        if (pcre_exec(kv->key, kv->key_extra, CONST_BUF_LEN(input),
+                      0, 0, ovec, 30) >= 0)
+            return (int)i;
+      #endif
+    }
+    return -1;
+}
+
+static void test_keyvalue_prefilter (void) {
+    /* result of prefiltered rule list must match sequential regex loop */
+    static const char * const patterns[] = {
+      "^/blog/20[0-9]{2}/(.*)$",
+      "^/blog/2019/special$",
+      "^/static/(.*)\\.css$",
+      "\\.php$",
+      "^/api/v1/users/([0-9]+)$",
+      "^/api/v1/users/me$",
+      "^/api/v2/",
+      "^/old-(page|post)-([0-9]+)\\.html$",
+      "^/shop/item\\?id=([0-9]+)",
+      "^/a|^/z",
+      "(?i)^/CASE/",
+      "^/downloads/.*\\.(zip|tgz)$",
+      "^/docs/$",
+      "^/docs/(.+)/$",
+      "^/docs/",
+      "/index\\.html$",
+      "^/wiki/([^/]+)$",
+      "^/x$",
+      "^/",
+    };
+    static const char * const urls[] = {
+      "/blog/2019/special", "/blog/2020/post", "/blog/1999/post",
+      "/static/site.css", "/static/site.js", "/info.php", "/a/b.php\n",
+      "/api/v1/users/42", "/api/v1/users/me", "/api/v2/anything",
+      "/old-page-3.html", "/old-post-x.html", "/shop/item?id=7",
+      "/zoo", "/case/x", "/CaSe/y", "/downloads/a/b.zip", "/downloads/c.gz",
+      "/docs/", "/docs/x/", "/docs/x", "/sub/index.html", "/wiki/Main",
+      "/x", "/x\n", "/", "", "nope",
+    };
+    static buffer keys[sizeof(patterns)/sizeof(*patterns)];
+    static const buffer value = { "/r", sizeof("/r"), 0 };
+    pcre_keyvalue_buffer * const kvb = pcre_keyvalue_buffer_init();
+    log_error_st * const errh = log_error_st_init();
+    buffer * const url = buffer_init();
+    buffer * const result = buffer_init();
+    pcre_keyvalue_ctx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    /* repeat rule list so that candidate bitset spans multiple words */
+    for (uint32_t j = 0; j < 5; ++j) {
+        for (uint32_t i = 0; i < sizeof(patterns)/sizeof(*patterns); ++i) {
+            keys[i].ptr = (char *)patterns[i];
+            keys[i].used = (uint32_t)strlen(patterns[i]) + 1;
+            assert(pcre_keyvalue_buffer_append(errh, kvb, keys+i, &value));
+        }
+        for (uint32_t i = 0; i < sizeof(urls)/sizeof(*urls); ++i) {
+            buffer_copy_string(url, urls[i]);
+            const int m = test_keyvalue_match_linear(kvb, url);
+            ctx.m = -1;
+            handler_t rc = pcre_keyvalue_buffer_process(kvb, &ctx, url, result);
+            assert(rc == (m >= 0 ? HANDLER_FINISHED : HANDLER_GO_ON));
+            assert(ctx.m == m);
+        }
+    }
+
+    buffer_free(url);
+    buffer_free(result);
+    log_error_st_free(errh);
+    pcre_keyvalue_buffer_free(kvb);
+}
 #endif
 
 int main (void) {
-  #ifdef HAVE_PCRE_H
+  #if defined(HAVE_PCRE2_H) || defined(HAVE_PCRE_H)
     test_keyvalue_pcre_keyvalue_buffer_process();
+    test_keyvalue_literals();
+    test_keyvalue_prefilter();
   #endif
     return 0;
 }
@@ -7,6 +7,16 @@
 
 #include "mod_access.c"
 
+static int test_mod_access_check_arrays(const array *allow, const array *deny, const buffer *urlpath, const int lc) {
+    const int flags = ARRAY_TRIE_VALUE|ARRAY_TRIE_SUFFIX|ARRAY_TRIE_NOCASE;
+    array_trie * const tallow = array_trie_init(allow, flags);
+    array_trie * const tdeny  = array_trie_init(deny, flags);
+    const int rc = mod_access_check(tallow, tdeny, urlpath, lc);
+    array_trie_free(tallow);
+    array_trie_free(tdeny);
+    return rc;
+}
+
 static void test_mod_access_check(void) {
     array *allow    = array_init(0);
     array *deny     = array_init(0);
@@ -15,17 +25,17 @@ static void test_mod_access_check(void) {
 
     /* empty allow and deny lists */
     buffer_copy_string_len(urlpath, CONST_STR_LEN("/"));
-    assert(1 == mod_access_check(allow, deny, urlpath, lc));
+    assert(1 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
 
     array_insert_value(deny, CONST_STR_LEN("~"));
     array_insert_value(deny, CONST_STR_LEN(".inc"));
 
     /* deny */
     buffer_copy_string_len(urlpath, CONST_STR_LEN("/index.html~"));
-    assert(0 == mod_access_check(allow, deny, urlpath, lc));
+    assert(0 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
     lc = 1;
     buffer_copy_string_len(urlpath, CONST_STR_LEN("/index.INC"));
-    assert(0 == mod_access_check(allow, deny, urlpath, lc));
+    assert(0 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
     lc = 0;
 
     array_insert_value(allow, CONST_STR_LEN(".txt"));
@@ -33,15 +43,33 @@ static void test_mod_access_check(void) {
 
     /* explicitly allowed */
     buffer_copy_string_len(urlpath, CONST_STR_LEN("/ssi-include.txt"));
-    assert(1 == mod_access_check(allow, deny, urlpath, lc));
+    assert(1 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
     lc = 1;
     buffer_copy_string_len(urlpath, CONST_STR_LEN("/ssi-include.TXT"));
-    assert(1 == mod_access_check(allow, deny, urlpath, lc));
+    assert(1 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
     lc = 0;
 
     /* allow not empty and urlpath not explicitly allowed */
     buffer_copy_string_len(urlpath, CONST_STR_LEN("/cgi.pl"));
-    assert(0 == mod_access_check(allow, deny, urlpath, lc));
+    assert(0 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
+
+    /* larger lists (compiled to trie) */
+    array_reset_data_strings(allow);
+    static const char * const exts[] = {
+      ".c", ".h", ".html", ".htm", ".css", ".js", ".png", ".jpg", ".gif",
+      ".svg", ".txt", ".xml", ".json"
+    };
+    for (uint32_t i = 0; i < sizeof(exts)/sizeof(*exts); ++i)
+        array_insert_value(allow, exts[i], strlen(exts[i]));
+    buffer_copy_string_len(urlpath, CONST_STR_LEN("/index.htm"));
+    assert(1 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
+    buffer_copy_string_len(urlpath, CONST_STR_LEN("/index.tm"));
+    assert(0 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
+    buffer_copy_string_len(urlpath, CONST_STR_LEN("/main.C"));
+    assert(0 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
+    lc = 1;
+    assert(1 == test_mod_access_check_arrays(allow, deny, urlpath, lc));
+    lc = 0;
 
     array_free(allow);
     array_free(deny);
@@ -71,3 +99,16 @@ int config_check_cond(request_st *r, int context_ndx) {
     UNUSED(context_ndx);
     return 0;
 }
+
+int config_plugin_snapshot_load(request_st *r, void *p_d, void *pconf, size_t sz) {
+    UNUSED(r);
+    UNUSED(p_d);
+    UNUSED(pconf);
+    UNUSED(sz);
+    return 0;
+}
+
+void config_plugin_snapshot_save(void *p_d, const void *pconf) {
+    UNUSED(p_d);
+    UNUSED(pconf);
+}
@@ -61,3 +61,16 @@ int config_check_cond(request_st *r, int context_ndx) {
     UNUSED(context_ndx);
     return 0;
 }
+
+int config_plugin_snapshot_load(request_st *r, void *p_d, void *pconf, size_t sz) {
+    UNUSED(r);
+    UNUSED(p_d);
+    UNUSED(pconf);
+    UNUSED(sz);
+    return 0;
+}
+
+void config_plugin_snapshot_save(void *p_d, const void *pconf) {
+    UNUSED(p_d);
+    UNUSED(pconf);
+}
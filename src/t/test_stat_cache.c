@@ -0,0 +1,206 @@
+#include "first.h"
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "stat_cache.c"
+
+static stat_cache_entry * test_stat_cache_entry(const char *name, uint32_t len) {
+    stat_cache_entry * const sce = stat_cache_entry_init();
+    buffer_copy_string_len(&sce->name, name, len);
+    return sce;
+}
+
+static uint32_t test_stat_cache_path(char *buf, uint32_t i) {
+    return (uint32_t)
+      snprintf(buf, 64, "/srv/www/htdocs/d%u/f%u.html", i % 97, i);
+}
+
+static void test_stat_cache_ht_basic(void) {
+    stat_cache_ht * const ht = &sc.files;
+    char path[64];
+    const uint32_t n = 10000;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t len = test_stat_cache_path(path, i);
+        assert(NULL == stat_cache_ht_find_name(path, len));
+        stat_cache_ht_insert(ht, test_stat_cache_entry(path, len), len,
+                             stat_cache_ht_hash(path, len));
+    }
+    assert(ht->used == n);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t len = test_stat_cache_path(path, i);
+        stat_cache_ht_slot * const s = stat_cache_ht_find_name(path, len);
+        assert(s);
+        assert(buffer_is_equal_string(&s->sce->name, path, len));
+    }
+
+    /* prefix of an existing path is a different entry */
+    assert(NULL == stat_cache_ht_find_name(CONST_STR_LEN("/srv/www/htdocs/d1")));
+
+    /* remove odd entries; even entries must remain reachable after
+     * backward shift deletion */
+    for (uint32_t i = 1; i < n; i += 2) {
+        const uint32_t len = test_stat_cache_path(path, i);
+        stat_cache_delete_entry(path, len);
+    }
+    assert(ht->used == n/2);
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t len = test_stat_cache_path(path, i);
+        stat_cache_ht_slot * const s = stat_cache_ht_find_name(path, len);
+        assert((i & 1) ? NULL == s : NULL != s);
+    }
+
+    /* remove dir tree */
+    stat_cache_prune_dir_tree(CONST_STR_LEN("/srv/www/htdocs/d2"));
+    for (uint32_t i = 0; i < n; i += 2) {
+        const uint32_t len = test_stat_cache_path(path, i);
+        stat_cache_ht_slot * const s = stat_cache_ht_find_name(path, len);
+        assert((i % 97 == 2) ? NULL == s : NULL != s);
+    }
+
+    /* remove all entries (stat_ts is 0) */
+    stat_cache_periodic_cleanup(2, 100);
+    assert(0 == ht->used);
+
+    stat_cache_free();
+}
+
+static void test_stat_cache_ht_evict(void) {
+    stat_cache_ht * const ht = &sc.files;
+    char path[64];
+    ht->max = 100;
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        const uint32_t len = test_stat_cache_path(path, i);
+        stat_cache_ht_insert(ht, test_stat_cache_entry(path, len), len,
+                             stat_cache_ht_hash(path, len));
+        /* keep entry 0 referenced */
+        assert(stat_cache_ht_find_name(path, test_stat_cache_path(path, 0)));
+    }
+    assert(ht->used <= 101);
+    assert(stat_cache_ht_find_name(path, test_stat_cache_path(path, 0)));
+    assert(stat_cache_ht_find_name(path, test_stat_cache_path(path, 999)));
+
+    stat_cache_free();
+    ht->max = 0;
+}
+
+/*
+ * micro-benchmark: lookup throughput of stat_cache hash table and of
+ * (previously used) splay tree keyed by djbhash
+ *   test_stat_cache bench [num-paths]
+ */
+
+static double test_stat_cache_secs(const struct timespec *ts0) {
+    struct timespec ts1;
+    clock_gettime(CLOCK_MONOTONIC, &ts1);
+    return (double)(ts1.tv_sec - ts0->tv_sec)
+         + (double)(ts1.tv_nsec - ts0->tv_nsec) / 1000000000.0;
+}
+
+static void test_stat_cache_bench(const uint32_t n) {
+    char path[64];
+    struct timespec ts0;
+    uint32_t found;
+    stat_cache_ht * const ht = &sc.files;
+    splay_tree *sptree = NULL;
+    stat_cache_entry ** const sces = malloc(n * sizeof(*sces));
+    force_assert(sces);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t len = test_stat_cache_path(path, i);
+        sces[i] = test_stat_cache_entry(path, len);
+        stat_cache_ht_insert(ht, sces[i], len, stat_cache_ht_hash(path, len));
+        const int ndx = splaytree_djbhash(path, len);
+        sptree = splaytree_splay(sptree, ndx);
+        if (NULL == sptree || sptree->key != ndx) /*(else: collision)*/
+            sptree = splaytree_insert(sptree, ndx, sces[i]);
+    }
+
+    /* lookups in a different order than insertion */
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+    found = 0;
+    for (uint32_t i = 0, j = 0; i < n; ++i, j = (j + 7919) % n) {
+        const uint32_t len = test_stat_cache_path(path, j);
+        found += (NULL != stat_cache_ht_find_name(path, len));
+    }
+    printf("hash table: %u lookups (%u found) in %.3f secs\n",
+           n, found, test_stat_cache_secs(&ts0));
+
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+    found = 0;
+    for (uint32_t i = 0, j = 0; i < n; ++i, j = (j + 7919) % n) {
+        const uint32_t len = test_stat_cache_path(path, j);
+        const int ndx = splaytree_djbhash(path, len);
+        sptree = splaytree_splay(sptree, ndx);
+        found += (sptree && sptree->key == ndx
+                  && buffer_is_equal_string(
+                       &((stat_cache_entry *)sptree->data)->name, path, len));
+    }
+    printf("splay tree: %u lookups (%u found) in %.3f secs\n",
+           n, found, test_stat_cache_secs(&ts0));
+
+    while (sptree) sptree = splaytree_delete(sptree, sptree->key);
+    stat_cache_free(); /*(frees sces[])*/
+    free(sces);
+}
+
+int main (int argc, char **argv) {
+    test_stat_cache_ht_basic();
+    test_stat_cache_ht_evict();
+
+    if (argc > 1 && 0 == strcmp(argv[1], "bench"))
+        test_stat_cache_bench(argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10)
+                                       : 1000000);
+
+    return 0;
+}
+
+/*
+ * stub functions
+ */
+
+int fdevent_open_cloexec(const char *pathname, int symlinks, int flags, mode_t mode) {
+    UNUSED(pathname);
+    UNUSED(symlinks);
+    UNUSED(flags);
+    UNUSED(mode);
+    return -1;
+}
+
+#ifdef HAVE_FAM_H
+
+void fdevent_fdnode_event_del(fdevents *ev, fdnode *fdn) {
+    UNUSED(ev);
+    UNUSED(fdn);
+}
+
+void fdevent_fdnode_event_set(fdevents *ev, fdnode *fdn, int events) {
+    UNUSED(ev);
+    UNUSED(fdn);
+    UNUSED(events);
+}
+
+fdnode * fdevent_register(fdevents *ev, int fd, fdevent_handler handler, void *ctx) {
+    UNUSED(ev);
+    UNUSED(fd);
+    UNUSED(handler);
+    UNUSED(ctx);
+    return NULL;
+}
+
+void fdevent_unregister(fdevents *ev, int fd) {
+    UNUSED(ev);
+    UNUSED(fd);
+}
+
+void fdevent_setfd_cloexec(int fd) {
+    UNUSED(fd);
+}
+
+#endif
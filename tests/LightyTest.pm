@@ -198,6 +198,8 @@ sub handle_http {
 	my @request = $t->{REQUEST};
 	my @response = $t->{RESPONSE};
 	my $slow = defined $t->{SLOWREQUEST};
+	my $halfclose = !defined $t->{NOHALFCLOSE};
+	my $cork = defined $t->{CORKREQUEST} && $halfclose && defined &Socket::TCP_CORK;
 	my $is_debug = $ENV{"TRACE_HTTP"};
 
 	my $remote =
@@ -215,6 +217,13 @@ sub handle_http {
 
 	if (!$slow) {
 		diag("\nsending request header to ".$host.":".$self->{PORT}) if $is_debug;
+		# (send request and TCP FIN in same packet after server accept()s
+		#  connection; half-close is then detected by server before the
+		#  request is processed)
+		if ($cork) {
+			select(undef, undef, undef, 0.1);
+			setsockopt($remote, Socket::IPPROTO_TCP(), Socket::TCP_CORK(), 1);
+		}
 		foreach(@request) {
 			# pipeline requests
 			s/\r//g;
@@ -223,7 +232,8 @@ sub handle_http {
 			print $remote $_.$BLANK;
 			diag("\n<< ".$_) if $is_debug;
 		}
-		shutdown($remote, 1) if ($^O ne "openbsd" && $^O ne "dragonfly"); # I've stopped writing data
+		shutdown($remote, 1) if ($halfclose && $^O ne "openbsd" && $^O ne "dragonfly"); # I've stopped writing data
+		setsockopt($remote, Socket::IPPROTO_TCP(), Socket::TCP_CORK(), 0) if $cork;
 	} else {
 		diag("\nsending request header to ".$host.":".$self->{PORT}) if $is_debug;
 		foreach(@request) {
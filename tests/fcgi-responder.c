@@ -1,58 +1,286 @@
-#ifdef HAVE_CONFIG_H
-#include "config.h"
-#endif
-#ifdef HAVE_FASTCGI_FASTCGI_H
-#include <fastcgi/fcgi_stdio.h>
-#else
-#include <fcgi_stdio.h>
-#endif
+/*
+ * simple and trivial FastCGI server with hard-coded results for use in unit tests
+ * - listens on STDIN_FILENO (socket on STDIN_FILENO must be set up by caller)
+ * - processes a single FastCGI request at a time (no FCGI_MPXS_CONNS)
+ * - honors FCGI_KEEP_CONN: serves further requests on the same connection
+ * - arbitrary limitation: reads FCGI_PARAMS up to 64k in size
+ * - request body (FCGI_STDIN) is read and discarded
+ * - no read or write timeouts; might block
+ *
+ * special QUERY_STRING values (in addition to those in scgi-responder.c):
+ * - "keep-conn": response body is the number of requests served on the
+ *   current connection (1 unless connection was kept with FCGI_KEEP_CONN)
+ * - "close-after-response": as "keep-conn", and then close the connection
+ *   even if FCGI_KEEP_CONN was requested (stale connection in client pool)
+ *
+ * License: BSD 3-clause (same as lighttpd)
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+
+#define FCGI_VERSION_1           1
+#define FCGI_BEGIN_REQUEST       1
+#define FCGI_ABORT_REQUEST       2
+#define FCGI_END_REQUEST         3
+#define FCGI_PARAMS              4
+#define FCGI_STDIN               5
+#define FCGI_STDOUT              6
+#define FCGI_KEEP_CONN           1
+#define FCGI_REQUEST_COMPLETE    0
+
+static int finished;
+static unsigned char buf[65536];
+
+
+static int
+fcgi_read (const int fd, unsigned char *p, size_t len)
+{
+    while (len) {
+        ssize_t rd;
+        do {
+            rd = recv(fd, p, len, 0);
+        } while (rd < 0 && errno == EINTR);
+        if (rd <= 0)
+            return -1;
+        p += rd;
+        len -= (size_t)rd;
+    }
+    return 0;
+}
+
+
+static int
+fcgi_write (const int fd, const unsigned char *p, size_t len)
+{
+    while (len) {
+        ssize_t wr;
+        do {
+            wr = send(fd, p, len, 0);
+        } while (wr < 0 && errno == EINTR);
+        if (wr <= 0)
+            return -1;
+        p += wr;
+        len -= (size_t)wr;
+    }
+    return 0;
+}
+
+
+static void
+fcgi_header (unsigned char * const h, const int type, const int request_id,
+             const size_t len)
+{
+    h[0] = FCGI_VERSION_1;
+    h[1] = (unsigned char)type;
+    h[2] = (unsigned char)(request_id >> 8);
+    h[3] = (unsigned char)(request_id);
+    h[4] = (unsigned char)(len >> 8);
+    h[5] = (unsigned char)(len);
+    h[6] = 0; /* padding */
+    h[7] = 0; /* reserved */
+}
+
+
+static int
+fcgi_stdout (const int fd, const int request_id, const char *s)
+{
+    unsigned char h[8];
+    const size_t len = strlen(s);
+    fcgi_header(h, FCGI_STDOUT, request_id, len);
+    return fcgi_write(fd, h, sizeof(h)) || fcgi_write(fd, (unsigned char *)s, len);
+}
+
+
+static uint32_t
+fcgi_nv_len (const unsigned char **p, const unsigned char * const end)
+{
+    const unsigned char *s = *p;
+    if (s == end)
+        return ~0u;
+    if (!(s[0] & 0x80)) {
+        *p = s+1;
+        return s[0];
+    }
+    if (end - s < 4)
+        return ~0u;
+    *p = s+4;
+    return ((uint32_t)(s[0] & 0x7f) << 24) | ((uint32_t)s[1] << 16)
+         | ((uint32_t)s[2] << 8) | s[3];
+}
+
+
+static char *
+fcgi_getenv (const unsigned char *r, const size_t rlen, const char * const name)
+{
+    /* simple search;
+     * if many lookups are done, then should use more efficient data structure*/
+    static char v[4096];
+    const unsigned char * const end = r+rlen;
+    const size_t len = strlen(name);
+    while (r < end) {
+        const uint32_t klen = fcgi_nv_len(&r, end);
+        const uint32_t vlen = fcgi_nv_len(&r, end);
+        if (klen == ~0u || vlen == ~0u || (size_t)(end - r) < klen + vlen)
+            return NULL;
+        if (klen == len && 0 == memcmp(r, name, len)) {
+            if (vlen >= sizeof(v))
+                return NULL;
+            memcpy(v, r+klen, vlen);
+            v[vlen] = '\0';
+            return v;
+        }
+        r += klen + vlen;
+    }
+    return NULL;
+}
+
+
+static int
+fcgi_respond (const int fd, const int request_id, const unsigned char *r,
+              const size_t rlen, const int connreqs)
+{
+    char *p;
+    char body[4096];
+    int rc, close_conn = 0;
+
+    /*(from scgi-responder.c, substituting fcgi_stdout() for printf()
+     * and fcgi_getenv() for scgi_getenv())*/
+    if (NULL != (p = fcgi_getenv(r, rlen, "QUERY_STRING"))) {
+        if (0 == strcmp(p, "lf")) {
+            rc = fcgi_stdout(fd, request_id, "Status: 200 OK\n\n");
+        } else if (0 == strcmp(p, "crlf")) {
+            rc = fcgi_stdout(fd, request_id, "Status: 200 OK\r\n\r\n");
+        } else if (0 == strcmp(p, "slow-lf")) {
+            rc = fcgi_stdout(fd, request_id, "Status: 200 OK\n")
+              || fcgi_stdout(fd, request_id, "\n");
+        } else if (0 == strcmp(p,"slow-crlf")) {
+            rc = fcgi_stdout(fd, request_id, "Status: 200 OK\r\n")
+              || fcgi_stdout(fd, request_id, "\r\n");
+        } else if (0 == strcmp(p, "die-at-end")) {
+            rc = fcgi_stdout(fd, request_id, "Status: 200 OK\r\n\r\n");
+            finished = 1;
+        } else if (0 == strcmp(p, "close-after-response")) {
+            rc = fcgi_stdout(fd, request_id, "Status: 200 OK\r\n\r\n");
+            close_conn = 1;
+        } else {
+            rc = fcgi_stdout(fd, request_id, "Status: 200 OK\r\n\r\n");
+        }
+    } else {
+        rc = fcgi_stdout(fd, request_id, "Status: 500 Internal Foo\r\n\r\n");
+        p = "";
+    }
+
+    if (0 == strcmp(p, "path_info")) {
+        p = fcgi_getenv(r, rlen, "PATH_INFO");
+        snprintf(body, sizeof(body), "%s", p ? p : "");
+    } else if (0 == strcmp(p, "script_name")) {
+        p = fcgi_getenv(r, rlen, "SCRIPT_NAME");
+        snprintf(body, sizeof(body), "%s", p ? p : "");
+    } else if (0 == strcmp(p, "var")) {
+        p = fcgi_getenv(r, rlen, "X_LIGHTTPD_FCGI_AUTH");
+        snprintf(body, sizeof(body), "%s", p ? p : "(no value)");
+    } else if (0 == strcmp(p, "keep-conn") || close_conn) {
+        snprintf(body, sizeof(body), "%d", connreqs);
+    } else {
+        snprintf(body, sizeof(body), "test123");
+    }
+
+    if (0 == rc && *body)
+        rc = fcgi_stdout(fd, request_id, body);
+
+    if (0 == rc) {
+        /* end of FCGI_STDOUT stream, then FCGI_END_REQUEST */
+        unsigned char h[16];
+        fcgi_header(h, FCGI_STDOUT, request_id, 0);
+        rc = fcgi_write(fd, h, 8);
+        fcgi_header(h, FCGI_END_REQUEST, request_id, 8);
+        memset(h+8, 0, 8); /* appStatus 0, FCGI_REQUEST_COMPLETE */
+        h[12] = FCGI_REQUEST_COMPLETE;
+        if (0 == rc)
+            rc = fcgi_write(fd, h, sizeof(h));
+    }
+
+    return rc || close_conn;
+}
+
+
+static void
+fcgi_process (const int fd)
+{
+    int connreqs = 0;
+    int request_id = 0;
+    int keep_conn = 0;
+    size_t plen = 0;
+    unsigned char h[8];
+
+    while (0 == fcgi_read(fd, h, sizeof(h))) {
+        const int type = h[1];
+        const int id = (h[2] << 8) | h[3];
+        const size_t len = ((size_t)h[4] << 8) | h[5];
+        const size_t padding = h[6];
+        unsigned char c[65535+255];
+
+        if (h[0] != FCGI_VERSION_1)
+            return; /* invalid FastCGI record */
+        if (0 != fcgi_read(fd, c, len + padding))
+            return; /* timeout or error receiving record */
+
+        switch (type) {
+          case FCGI_BEGIN_REQUEST:
+            if (len != 8 || 0 != request_id)
+                return; /* invalid or multiplexed request */
+            request_id = id;
+            keep_conn = (c[2] & FCGI_KEEP_CONN);
+            plen = 0;
+            break;
+          case FCGI_PARAMS:
+            if (id != request_id)
+                return;
+            if (len > sizeof(buf) - plen)
+                return; /* FCGI_PARAMS longer than arbitrary limit */
+            memcpy(buf+plen, c, len);
+            plen += len;
+            break;
+          case FCGI_STDIN:
+            if (id != request_id)
+                return;
+            if (0 != len)
+                break; /* discard request body */
+            ++connreqs;
+            if (0 != fcgi_respond(fd, request_id, buf, plen, connreqs)
+                || !keep_conn || finished)
+                return;
+            request_id = 0;
+            break;
+          case FCGI_ABORT_REQUEST:
+            return;
+          default:
+            break; /* ignore */
+        }
+    }
+}
+
+
+int
+main (void)
+{
+    int fd;
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) & ~O_NONBLOCK);
+
+    do {
+        fd = accept(STDIN_FILENO, NULL, NULL);
+        if (fd < 0)
+            continue;
+        fcgi_process(fd);
+    } while (fd >= 0 ? 0 == close(fd) && !finished : errno == EINTR);
 
-int main (void) {
-	int num_requests = 1;
-
-	while (num_requests > 0 &&
-	       FCGI_Accept() >= 0) {
-		char* p;
-
-		if (NULL != (p = getenv("QUERY_STRING"))) {
-			if (0 == strcmp(p, "lf")) {
-				printf("Status: 200 OK\n\n");
-			} else if (0 == strcmp(p, "crlf")) {
-				printf("Status: 200 OK\r\n\r\n");
-			} else if (0 == strcmp(p, "slow-lf")) {
-				printf("Status: 200 OK\n");
-				fflush(stdout);
-				printf("\n");
-			} else if (0 == strcmp(p,"slow-crlf")) {
-				printf("Status: 200 OK\r\n");
-				fflush(stdout);
-				printf("\r\n");
-			} else if (0 == strcmp(p, "die-at-end")) {
-				printf("Status: 200 OK\r\n\r\n");
-				num_requests--;
-			} else {
-				printf("Status: 200 OK\r\n\r\n");
-			}
-		} else {
-			printf("Status: 500 Internal Foo\r\n\r\n");
-		}
-
-		if (0 == strcmp(p, "path_info")) {
-			printf("%s", getenv("PATH_INFO"));
-		} else if (0 == strcmp(p, "script_name")) {
-			printf("%s", getenv("SCRIPT_NAME"));
-		} else if (0 == strcmp(p, "var")) {
-			p = getenv("X_LIGHTTPD_FCGI_AUTH");
-			printf("%s", p ? p : "(no value)");
-		} else {
-			printf("test123");
-		}
-
-		if (0 == num_requests) FCGI_Finish();
-	}
-
-	return 0;
+    return 0;
 }
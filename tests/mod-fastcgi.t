@@ -7,7 +7,7 @@ BEGIN {
 }
 
 use strict;
-use Test::More tests => 44;
+use Test::More tests => 57;
 use LightyTest;
 
 my $tf = LightyTest->new();
@@ -359,6 +359,87 @@ EOF
 	ok($tf->stop_proc == 0, "Stopping lighttpd");
 }
 
+SKIP: {
+	skip "no fcgi-responder found", 13
+	  unless (-x $tf->{BASEDIR}."/tests/fcgi-responder" || -x $tf->{BASEDIR}."/tests/fcgi-responder.exe");
+
+	$tf->{CONFIGFILE} = 'fastcgi-keepconn.conf';
+	ok($tf->start_proc == 0, "Starting lighttpd with $tf->{CONFIGFILE}") or die();
+
+	$t->{REQUEST}  = ( <<EOF
+GET /index.fcgi?keep-conn HTTP/1.0
+Host: www.example.org
+EOF
+ );
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '1' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - new connection per request');
+	ok($tf->handle_http($t) == 0, 'FastCGI - new connection per request (no keepalive-max-idle)');
+
+	$t->{REQUEST}  = ( <<EOF
+GET /index.fcgi?keep-conn HTTP/1.0
+Host: keepconn.example.org
+EOF
+ );
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '1' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - FCGI_KEEP_CONN first request');
+
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '2' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - FCGI_KEEP_CONN connection reused');
+
+	$t->{REQUEST}  = ( <<EOF
+GET /index.fcgi?close-after-response HTTP/1.0
+Host: keepconn.example.org
+EOF
+ );
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '3' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - FCGI_KEEP_CONN backend closes after response');
+
+	$t->{REQUEST}  = ( <<EOF
+GET /index.fcgi?keep-conn HTTP/1.0
+Host: keepconn.example.org
+EOF
+ );
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '1' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - FCGI_KEEP_CONN stale connection not reused');
+
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '2' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - FCGI_KEEP_CONN new connection reused');
+
+	$t->{REQUEST}  = ( <<EOF
+GET /index.fcgi?crlf HTTP/1.0
+Host: keepconn.example.org
+EOF
+ );
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => 'test123' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - FCGI_KEEP_CONN regular response');
+
+	# client TCP half-close is propagated to backend (tcp-fin-propagate);
+	# (per-connection) half-close must not be applied to later requests
+	$t->{REQUEST}  = ( <<EOF
+GET /index.fcgi?close-after-response HTTP/1.0
+Host: tcpfin.example.org
+EOF
+ );
+	$t->{CORKREQUEST} = 1;
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '1' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - half-closed request with tcp-fin-propagate');
+	delete $t->{CORKREQUEST};
+
+	$t->{REQUEST}  = ( <<EOF
+GET /index.fcgi?keep-conn HTTP/1.0
+Host: tcpfin.example.org
+EOF
+ );
+	$t->{NOHALFCLOSE} = 1;
+	ok($tf->handle_http($t) == 0, 'FastCGI - request after half-closed request');
+
+	$t->{RESPONSE} = [ { 'HTTP-Protocol' => 'HTTP/1.0', 'HTTP-Status' => 200, 'HTTP-Content' => '2' } ];
+	ok($tf->handle_http($t) == 0, 'FastCGI - FCGI_KEEP_CONN reused after half-closed request');
+	delete $t->{NOHALFCLOSE};
+
+	ok($tf->stop_proc == 0, "Stopping lighttpd");
+}
+
 exit 0;
 
 cleanup: ;